@@ -6,18 +6,55 @@
 #define _CRTDBG_MAP_ALLOC
 
 #include <stdio.h>
+#include <string.h>
 #include "src/repl.h"
+#include "src/script.h"
 #include <crtdbg.h>
 
-int main(void)
+int main(int argc, char** argv)
 {
-    printf("Welcome to the Monkeypreter!\n");
-    repl();
+    int status = EXIT_SUCCESS;
+
+    //monkeypreter [--no-cache] [--disassemble] [--no-jit] [--interpret] [--emit-c] <file> runs a script, no arguments starts the REPL
+    struct ScriptOptions options = { .useCache = true, .disassemble = false, .noJit = false, .interpret = false };
+    bool emitC = false;
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--no-cache") == 0) {
+            options.useCache = false;
+        }
+        else if (strcmp(argv[i], "--disassemble") == 0) {
+            options.disassemble = true;
+        }
+        else if (strcmp(argv[i], "--no-jit") == 0) {
+            options.noJit = true;
+        }
+        else if (strcmp(argv[i], "--interpret") == 0) {
+            options.interpret = true;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0) {
+            emitC = true;
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc > 1 && emitC) {
+        status = emitCScript(argv[argc - 1]);
+    }
+    else if (argc > 1) {
+        status = runScript(argv[argc - 1], options);
+    }
+    else {
+        printf("Welcome to the Monkeypreter!\n");
+        repl();
+    }
 
 #ifdef TOGGLE_MEM_TRACK
     //Dump memory leaks if defined
     _CrtDumpMemoryLeaks();
 #endif
+    return status;
 }
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
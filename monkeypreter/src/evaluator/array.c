@@ -0,0 +1,385 @@
+#include "array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "object.h"
+
+//Slot value, raw integer for packed arrays
+union ArrayElement {
+	struct Object* obj;
+	int64_t integer;
+};
+
+static struct ArrayNode* newArrayNode(void);
+static void releaseArrayNode(struct ArrayNode* node, uint32_t level);
+static struct ArrayNode* newArrayPath(uint32_t level, struct ArrayNode* node);
+static struct ArrayNode* pushArrayTail(uint32_t level, const struct ArrayNode* parent, struct ArrayNode* tailNode, size_t count);
+static struct ArrayObject pushArray(const struct ArrayObject* arr, union ArrayElement elem);
+
+static struct ArrayNode* newArrayNode(void) {
+	struct ArrayNode* node = (struct ArrayNode*)malloc(sizeof * node);
+
+	if (!node) {
+		perror("malloc (create array node) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	node->refs = 1;
+	node->count = 0;
+	return node;
+}
+
+static void releaseArrayNode(struct ArrayNode* node, uint32_t level) {
+	if (!node || --node->refs > 0) {
+		return;
+	}
+
+	//Leaves only point to objects, the GC owns those
+	if (level > 0) {
+		for (uint32_t i = 0; i < node->count; i++) {
+			releaseArrayNode(node->children[i], level - ARRAY_BITS);
+		}
+	}
+
+	free(node);
+}
+
+//Offset of the first element that lives in the tail
+static size_t arrayTailOffset(size_t count) {
+	if (count < ARRAY_WIDTH) {
+		return 0;
+	}
+	return ((count - 1) >> ARRAY_BITS) << ARRAY_BITS;
+}
+
+//Leaf in the trie holding idx, idx must be in front of the tail
+static struct ArrayNode* arrayLeafFor(const struct ArrayObject* arr, size_t idx) {
+	struct ArrayNode* node = arr->root;
+	for (uint32_t level = arr->shift; level > 0; level -= ARRAY_BITS) {
+		node = node->children[(idx >> level) & ARRAY_MASK];
+	}
+	return node;
+}
+
+static struct ArrayNode* newArrayPath(uint32_t level, struct ArrayNode* node) {
+	if (level == 0) {
+		node->refs++;
+		return node;
+	}
+
+	struct ArrayNode* path = newArrayNode();
+	path->children[0] = newArrayPath(level - ARRAY_BITS, node);
+	path->count = 1;
+	return path;
+}
+
+//Path copy down to the slot where the full tail gets stored, siblings are shared
+static struct ArrayNode* pushArrayTail(uint32_t level, const struct ArrayNode* parent, struct ArrayNode* tailNode, size_t count) {
+	const uint32_t subIdx = (uint32_t)(((count - 1) >> level) & ARRAY_MASK);
+	const uint32_t parentCount = parent ? parent->count : 0;
+	struct ArrayNode* node = newArrayNode();
+
+	for (uint32_t i = 0; i < parentCount; i++) {
+		node->children[i] = parent->children[i];
+		if (i != subIdx) {
+			node->children[i]->refs++;
+		}
+	}
+
+	struct ArrayNode* toInsert;
+	if (level == ARRAY_BITS) {
+		tailNode->refs++;
+		toInsert = tailNode;
+	}
+	else if (subIdx < parentCount) {
+		toInsert = pushArrayTail(level - ARRAY_BITS, parent->children[subIdx], tailNode, count);
+	}
+	else {
+		toInsert = newArrayPath(level - ARRAY_BITS, tailNode);
+	}
+
+	node->children[subIdx] = toInsert;
+	node->count = subIdx + 1;
+	return node;
+}
+
+static void setArraySlot(const struct ArrayObject* arr, struct ArrayNode* leaf, size_t slot, union ArrayElement elem) {
+	if (arr->packed) {
+		leaf->integers[slot] = elem.integer;
+	}
+	else {
+		leaf->objects[slot] = elem.obj;
+	}
+}
+
+static struct ArrayObject pushArray(const struct ArrayObject* arr, union ArrayElement elem) {
+	const size_t count = arr->start + arr->size;
+	const size_t tailLen = count - arrayTailOffset(count);
+	struct ArrayObject pushed = *arr;
+	pushed.size++;
+
+	//Room left in the tail
+	if (tailLen < ARRAY_WIDTH) {
+		if (arr->root) {
+			arr->root->refs++;
+		}
+
+		//Nobody appended past our end yet, so the slot is free to claim: older arrays never read beyond their size
+		if (arr->tail && arr->tail->count == tailLen) {
+			setArraySlot(arr, arr->tail, tailLen, elem);
+			arr->tail->count++;
+			arr->tail->refs++;
+			return pushed;
+		}
+
+		pushed.tail = newArrayNode();
+		if (tailLen > 0) {
+			//Packed slots are wider than pointers on 32 bit targets
+			memcpy(pushed.tail->integers, arr->tail->integers, tailLen * (arr->packed ? sizeof(int64_t) : sizeof(struct Object*)));
+		}
+		setArraySlot(arr, pushed.tail, tailLen, elem);
+		pushed.tail->count = (uint32_t)tailLen + 1;
+		return pushed;
+	}
+
+	//Tail is full, move it into the trie
+	if ((count >> ARRAY_BITS) > ((size_t)1 << arr->shift)) {
+		//Root overflow, grow one level
+		pushed.root = newArrayNode();
+		pushed.root->children[0] = arr->root;
+		arr->root->refs++;
+		pushed.root->children[1] = newArrayPath(arr->shift, arr->tail);
+		pushed.root->count = 2;
+		pushed.shift = arr->shift + ARRAY_BITS;
+	}
+	else {
+		pushed.root = pushArrayTail(arr->shift, arr->root, arr->tail, count);
+	}
+
+	pushed.tail = newArrayNode();
+	setArraySlot(arr, pushed.tail, 0, elem);
+	pushed.tail->count = 1;
+	return pushed;
+}
+
+//In place push, only valid while arr is the sole owner of its nodes
+static void appendArrayElement(struct ArrayObject* arr, union ArrayElement elem) {
+	struct ArrayObject next = pushArray(arr, elem);
+	releaseArray(arr);
+	*arr = next;
+}
+
+//Boxes every element of a packed array
+static struct ArrayObject unpackArray(struct MonkeyGC* gc, const struct ArrayObject* arr) {
+	struct ArrayObject boxed;
+	initArray(&boxed);
+	boxed.packed = false;
+
+	size_t offset = 0;
+	size_t chunkLen = 0;
+	for (size_t i = 0; i < arr->size; i += chunkLen) {
+		const struct ArrayNode* leaf = arrayChunk(arr, i, &offset, &chunkLen);
+		for (size_t j = 0; j < chunkLen; j++) {
+			union ArrayElement elem;
+			elem.obj = createObject(gc, OBJ_INT);
+			elem.obj->value.integer = leaf->integers[offset + j];
+			appendArrayElement(&boxed, elem);
+		}
+	}
+	return boxed;
+}
+
+void initArray(struct ArrayObject* arr) {
+	arr->size = 0;
+	arr->start = 0;
+	arr->shift = ARRAY_BITS;
+	arr->packed = true;
+	arr->root = NULL;
+	arr->tail = NULL;
+}
+
+void releaseArray(struct ArrayObject* arr) {
+	releaseArrayNode(arr->root, arr->shift);
+	releaseArrayNode(arr->tail, 0);
+	initArray(arr);
+}
+
+void initArrayFromList(struct ArrayObject* arr, const struct ObjectList* list) {
+	initArray(arr);
+
+	for (size_t i = 0; i < list->size; i++) {
+		if (list->objects[i]->type != OBJ_INT) {
+			arr->packed = false;
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < list->size; i++) {
+		union ArrayElement elem;
+		if (arr->packed) {
+			elem.integer = list->objects[i]->value.integer;
+		}
+		else {
+			elem.obj = list->objects[i];
+		}
+		appendArrayElement(arr, elem);
+	}
+}
+
+struct Object* arrayFromList(struct MonkeyGC* gc, const struct ObjectList* list) {
+	struct Object* obj = createObject(gc, OBJ_ARRAY);
+	initArrayFromList(&obj->value.arr, list);
+	return obj;
+}
+
+//In place append for arrays still being built by a builtin, nobody else may hold them yet
+void appendArrayObject(struct MonkeyGC* gc, struct Object* arr, struct Object* obj) {
+	union ArrayElement elem;
+
+	if (arr->value.arr.packed && obj->type == OBJ_INT) {
+		elem.integer = obj->value.integer;
+		appendArrayElement(&arr->value.arr, elem);
+		return;
+	}
+
+	if (arr->value.arr.packed) {
+		struct ArrayObject boxed = unpackArray(gc, &arr->value.arr);
+		releaseArray(&arr->value.arr);
+		arr->value.arr = boxed;
+	}
+
+	elem.obj = obj;
+	appendArrayElement(&arr->value.arr, elem);
+}
+
+struct Object* arrayFromIntegers(struct MonkeyGC* gc, const int64_t* values, size_t count) {
+	struct Object* obj = createObject(gc, OBJ_ARRAY);
+	initArray(&obj->value.arr);
+	appendArrayIntegers(&obj->value.arr, values, count);
+	return obj;
+}
+
+//Bulk in place append for packed arrays that own their nodes, fills the tail a leaf at a time
+void appendArrayIntegers(struct ArrayObject* arr, const int64_t* values, size_t count) {
+	size_t i = 0;
+	while (i < count) {
+		union ArrayElement elem;
+		elem.integer = values[i];
+		appendArrayElement(arr, elem);
+		i++;
+
+		const size_t room = ARRAY_WIDTH - arr->tail->count;
+		const size_t toCopy = count - i < room ? count - i : room;
+		memcpy(arr->tail->integers + arr->tail->count, values + i, toCopy * sizeof(int64_t));
+		arr->tail->count += (uint32_t)toCopy;
+		arr->size += toCopy;
+		i += toCopy;
+	}
+}
+
+size_t arrayLength(const struct Object* arr) {
+	return arr->value.arr.size;
+}
+
+//Leaf holding index, elements [offset, offset + chunkLen) of it are contiguous and visible
+struct ArrayNode* arrayChunk(const struct ArrayObject* arr, size_t index, size_t* offset, size_t* chunkLen) {
+	const size_t count = arr->start + arr->size;
+	const size_t tailOffset = arrayTailOffset(count);
+	const size_t idx = arr->start + index;
+
+	if (idx >= tailOffset) {
+		*offset = idx - tailOffset;
+		*chunkLen = count - idx;
+		return arr->tail;
+	}
+
+	//Leaves in front of the tail are always full
+	*offset = idx & ARRAY_MASK;
+	*chunkLen = ARRAY_WIDTH - *offset;
+	return arrayLeafFor(arr, idx);
+}
+
+//Boxes packed integers, so every call on a packed array allocates
+struct Object* arrayGet(struct MonkeyGC* gc, const struct Object* arr, size_t index) {
+	size_t offset = 0;
+	size_t chunkLen = 0;
+	const struct ArrayNode* leaf = arrayChunk(&arr->value.arr, index, &offset, &chunkLen);
+
+	if (!arr->value.arr.packed) {
+		return leaf->objects[offset];
+	}
+
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = leaf->integers[offset];
+	return obj;
+}
+
+int64_t arrayGetInteger(const struct Object* arr, size_t index) {
+	size_t offset = 0;
+	size_t chunkLen = 0;
+	const struct ArrayNode* leaf = arrayChunk(&arr->value.arr, index, &offset, &chunkLen);
+
+	if (!arr->value.arr.packed) {
+		return leaf->objects[offset]->value.integer;
+	}
+	return leaf->integers[offset];
+}
+
+//Run of integers starting at index: points straight into a packed leaf, boxed arrays are copied into scratch (ARRAY_WIDTH entries).
+//Returns NULL if a boxed element is not an integer
+const int64_t* arrayIntegerChunk(const struct Object* arr, size_t index, int64_t* scratch, size_t* chunkLen) {
+	size_t offset = 0;
+	const struct ArrayNode* leaf = arrayChunk(&arr->value.arr, index, &offset, chunkLen);
+
+	if (arr->value.arr.packed) {
+		return leaf->integers + offset;
+	}
+
+	for (size_t i = 0; i < *chunkLen; i++) {
+		const struct Object* elem = leaf->objects[offset + i];
+		if (elem->type != OBJ_INT) {
+			return NULL;
+		}
+		scratch[i] = elem->value.integer;
+	}
+	return scratch;
+}
+
+struct Object* arrayPush(struct MonkeyGC* gc, const struct Object* arr, struct Object* obj) {
+	struct Object* pushedObj = createObject(gc, OBJ_ARRAY);
+	union ArrayElement elem;
+
+	if (arr->value.arr.packed && obj->type == OBJ_INT) {
+		elem.integer = obj->value.integer;
+		pushedObj->value.arr = pushArray(&arr->value.arr, elem);
+		return pushedObj;
+	}
+
+	elem.obj = obj;
+
+	if (!arr->value.arr.packed) {
+		pushedObj->value.arr = pushArray(&arr->value.arr, elem);
+		return pushedObj;
+	}
+
+	//First non integer, fall back to boxed elements
+	pushedObj->value.arr = unpackArray(gc, &arr->value.arr);
+	appendArrayElement(&pushedObj->value.arr, elem);
+	return pushedObj;
+}
+
+//Everything but the first element, shares the trie
+struct Object* arrayRest(struct MonkeyGC* gc, const struct Object* arr) {
+	struct Object* rest = createObject(gc, OBJ_ARRAY);
+	rest->value.arr = arr->value.arr;
+	rest->value.arr.start++;
+	rest->value.arr.size--;
+
+	if (rest->value.arr.root) {
+		rest->value.arr.root->refs++;
+	}
+	if (rest->value.arr.tail) {
+		rest->value.arr.tail->refs++;
+	}
+	return rest;
+}
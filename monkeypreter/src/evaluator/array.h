@@ -0,0 +1,55 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+//Persistent vector: 32-way trie + tail buffer
+#define ARRAY_BITS 5
+#define ARRAY_WIDTH (1 << ARRAY_BITS)
+#define ARRAY_MASK (ARRAY_WIDTH - 1)
+
+struct Object;
+struct MonkeyGC;
+struct ObjectList;
+
+//Trie nodes are shared between arrays, so they are refcounted instead of tracked by the GC
+struct ArrayNode {
+	uint32_t refs;
+	//Filled slots
+	uint32_t count;
+	union {
+		struct ArrayNode* children[ARRAY_WIDTH];
+		struct Object* objects[ARRAY_WIDTH];
+		//Leaves of packed arrays
+		int64_t integers[ARRAY_WIDTH];
+	};
+};
+
+struct ArrayObject {
+	//Visible elements
+	size_t size;
+	//Elements hidden in front (cdr shares the trie with its source)
+	size_t start;
+	uint32_t shift;
+	//Every element is an integer, leaves hold raw int64 instead of boxed objects
+	bool packed;
+	//NULL while all elements fit in the tail
+	struct ArrayNode* root;
+	struct ArrayNode* tail;
+};
+
+void initArray(struct ArrayObject* arr);
+void releaseArray(struct ArrayObject* arr);
+//Fills an empty array, for arrays that are not created through the GC
+void initArrayFromList(struct ArrayObject* arr, const struct ObjectList* list);
+struct Object* arrayFromList(struct MonkeyGC* gc, const struct ObjectList* list);
+struct Object* arrayFromIntegers(struct MonkeyGC* gc, const int64_t* values, size_t count);
+size_t arrayLength(const struct Object* arr);
+struct Object* arrayGet(struct MonkeyGC* gc, const struct Object* arr, size_t index);
+int64_t arrayGetInteger(const struct Object* arr, size_t index);
+struct ArrayNode* arrayChunk(const struct ArrayObject* arr, size_t index, size_t* offset, size_t* chunkLen);
+const int64_t* arrayIntegerChunk(const struct Object* arr, size_t index, int64_t* scratch, size_t* chunkLen);
+void appendArrayIntegers(struct ArrayObject* arr, const int64_t* values, size_t count);
+void appendArrayObject(struct MonkeyGC* gc, struct Object* arr, struct Object* obj);
+struct Object* arrayPush(struct MonkeyGC* gc, const struct Object* arr, struct Object* obj);
+struct Object* arrayRest(struct MonkeyGC* gc, const struct Object* arr);
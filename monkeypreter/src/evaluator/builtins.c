@@ -1,7 +1,12 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "object.h"
 #include <string.h>
 #include "evaluator.h"
+#include "simd.h"
+#include "sort.h"
+#include "builtins.h"
+#include "hash_map.h"
 
 struct BuiltinFunction {
 	char name[MAX_IDENT_LENGTH];
@@ -24,7 +29,7 @@ struct Object* len(struct ObjectList* args, struct MonkeyGC* gc) {
 
 	if (arg->type == OBJ_ARRAY) {
 		obj = createObject(gc, OBJ_INT);
-		obj->value.integer = (int64_t)arg->value.arr.size;
+		obj->value.integer = (int64_t)arrayLength(arg);
 		return obj;
 	}
 
@@ -42,8 +47,8 @@ struct Object* first(struct ObjectList* args, struct MonkeyGC* gc) {
 		return newEvalError(gc, "argument to `first` must be ARRAY, got %s", objectTypeToStr(arg->type));
 	}
 
-	if (arg->value.arr.size > 0) {
-		return arg->value.arr.objects[0];
+	if (arrayLength(arg) > 0) {
+		return arrayGet(gc, arg, 0);
 	}
 
 	return &NullObj;
@@ -61,10 +66,10 @@ struct Object* last(struct ObjectList* args, struct MonkeyGC* gc) {
 		return newEvalError(gc, "argument to `last` must be ARRAY, got %s", objectTypeToStr(arg->type));
 	}
 
-	const size_t arrSize = arg->value.arr.size;
+	const size_t arrSize = arrayLength(arg);
 
 	if (arrSize > 0) {
-		return arg->value.arr.objects[arrSize - 1];
+		return arrayGet(gc, arg, arrSize - 1);
 	}
 
 	return &NullObj;
@@ -82,26 +87,8 @@ struct Object* cdr(struct ObjectList* args, struct MonkeyGC* gc) {
 		return newEvalError(gc, "argument to `cdr` must be ARRAY, got %s", objectTypeToStr(arg->type));
 	}
 
-	const size_t arrSize = arg->value.arr.size;
-	const size_t arrCap = arg->value.arr.cap;
-
-	if (arrSize > 0) {
-
-		struct Object* obj = createObject(gc, OBJ_ARRAY);
-
-		struct ObjectList copyList;
-		copyList.size = arrSize - 1;
-		copyList.cap = arrCap;
-		copyList.objects = (struct Object**)malloc(arrCap * sizeof(struct Object*));
-
-		if(!copyList.objects) {
-			perror("malloc (cdr copy) returned `NULL`\n");
-			exit(EXIT_FAILURE);
-		}
-		memcpy(copyList.objects, arg->value.arr.objects + 1, copyList.size * sizeof(struct Object*));
-
-		obj->value.arr = copyList;
-		return obj;
+	if (arrayLength(arg) > 0) {
+		return arrayRest(gc, arg);
 	}
 
 	return &NullObj;
@@ -116,41 +103,459 @@ struct Object* push(struct ObjectList* args, struct MonkeyGC* gc) {
 	if (args->objects[0]->type != OBJ_ARRAY) {
 		return newEvalError(gc, "argument to `push` must be ARRAY, got %s", objectTypeToStr(args->objects[0]->type));
 	}
-	struct Object* arr = args->objects[0];
-	struct Object* objToAdd = args->objects[1];
+	//Persistent push, shares all but the tail with the source array
+	return arrayPush(gc, args->objects[0], args->objects[1]);
+}
 
-	const size_t arrSize = arr->value.arr.size;
-	const size_t arrCap = arr->value.arr.cap;
+//print never calls back into the evaluator, so one buffer serves every call
+static char printBuffer[WRITER_CHUNK_SIZE];
 
-	struct Object* obj = createObject(gc, OBJ_ARRAY);
+struct Object* print(struct ObjectList* args, struct MonkeyGC* gc) {
+	(void)gc;
+	struct Writer writer = createStreamWriter(stdout, printBuffer, sizeof(printBuffer));
 
-	struct ObjectList copyList;
-	copyList.size = arrSize;
-	copyList.cap = copyList.size + 1 >= arrCap ? arrCap + 1 : arrCap;
-	copyList.objects = (struct Object**)malloc(copyList.cap * sizeof(struct Object*));
-	if (!copyList.objects) {
-		perror("malloc (push copy) returned `NULL`\n");
-		exit(EXIT_FAILURE);
+	for (size_t i = 0; i < args->size; i++) {
+		writeObject(&writer, args->objects[i]);
+	}
+
+	freeWriter(&writer);
+	return &NullObj;
+}
+
+//Numeric builtins, packed arrays are handed to the SIMD kernels leaf by leaf
+struct Object* sum(struct ObjectList* args, struct MonkeyGC* gc) {
+	if (args->size != 1) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=1", args->size);
 	}
-	memcpy(copyList.objects, arr->value.arr.objects, arrSize * sizeof(struct Object*));
 
-	copyList.objects[copyList.size] = objToAdd;
-	copyList.size++;
+	struct Object* arg = args->objects[0];
 
-	obj->value.arr = copyList;
+	if (arg->type != OBJ_ARRAY) {
+		return newEvalError(gc, "argument to `sum` must be ARRAY, got %s", objectTypeToStr(arg->type));
+	}
 
+	int64_t scratch[ARRAY_WIDTH];
+	uint64_t total = 0;
+	size_t chunkLen = 0;
+	for (size_t i = 0; i < arrayLength(arg); i += chunkLen) {
+		const int64_t* chunk = arrayIntegerChunk(arg, i, scratch, &chunkLen);
+		if (!chunk) {
+			return newEvalError(gc, "argument to `sum` must only contain INTEGER");
+		}
+		total += (uint64_t)sumIntegers(chunk, chunkLen);
+	}
+
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = (int64_t)total;
 	return obj;
 }
 
-struct Object* print(struct ObjectList* args, struct MonkeyGC* gc) {
+//min and max are macros in MSVC's stdlib.h
+static struct Object* extremum(struct ObjectList* args, struct MonkeyGC* gc, const char* name, bool wantMax) {
+	if (args->size != 1) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=1", args->size);
+	}
+
+	struct Object* arg = args->objects[0];
+
+	if (arg->type != OBJ_ARRAY) {
+		return newEvalError(gc, "argument to `%s` must be ARRAY, got %s", name, objectTypeToStr(arg->type));
+	}
+
+	if (arrayLength(arg) == 0) {
+		return &NullObj;
+	}
+
+	int64_t scratch[ARRAY_WIDTH];
+	int64_t result = 0;
+	size_t chunkLen = 0;
+	for (size_t i = 0; i < arrayLength(arg); i += chunkLen) {
+		const int64_t* chunk = arrayIntegerChunk(arg, i, scratch, &chunkLen);
+		if (!chunk) {
+			return newEvalError(gc, "argument to `%s` must only contain INTEGER", name);
+		}
+
+		const int64_t chunkResult = wantMax ? maxIntegers(chunk, chunkLen) : minIntegers(chunk, chunkLen);
+		if (i == 0 || (wantMax ? chunkResult > result : chunkResult < result)) {
+			result = chunkResult;
+		}
+	}
+
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = result;
+	return obj;
+}
+
+struct Object* minimum(struct ObjectList* args, struct MonkeyGC* gc) {
+	return extremum(args, gc, "min", false);
+}
+
+struct Object* maximum(struct ObjectList* args, struct MonkeyGC* gc) {
+	return extremum(args, gc, "max", true);
+}
+
+//Two integer arrays of equal length, NULL if ok
+static struct Object* checkIntegerArrayPair(struct ObjectList* args, struct MonkeyGC* gc, const char* name) {
+	if (args->size != 2) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=2", args->size);
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		if (args->objects[i]->type != OBJ_ARRAY) {
+			return newEvalError(gc, "argument to `%s` must be ARRAY, got %s", name, objectTypeToStr(args->objects[i]->type));
+		}
+	}
+
+	if (arrayLength(args->objects[0]) != arrayLength(args->objects[1])) {
+		return newEvalError(gc, "arguments to `%s` must have the same length, got %llu and %llu", name,
+			(unsigned long long)arrayLength(args->objects[0]), (unsigned long long)arrayLength(args->objects[1]));
+	}
+
+	return NULL;
+}
+
+struct Object* dot(struct ObjectList* args, struct MonkeyGC* gc) {
+	struct Object* error = checkIntegerArrayPair(args, gc, "dot");
+	if (error) {
+		return error;
+	}
+
+	struct Object* left = args->objects[0];
+	struct Object* right = args->objects[1];
+	int64_t leftScratch[ARRAY_WIDTH];
+	int64_t rightScratch[ARRAY_WIDTH];
+	uint64_t total = 0;
+
+	//Leaves of both arrays do not have to line up, advance by the shorter run
+	size_t i = 0;
+	while (i < arrayLength(left)) {
+		size_t leftLen = 0;
+		size_t rightLen = 0;
+		const int64_t* leftChunk = arrayIntegerChunk(left, i, leftScratch, &leftLen);
+		const int64_t* rightChunk = arrayIntegerChunk(right, i, rightScratch, &rightLen);
+		if (!leftChunk || !rightChunk) {
+			return newEvalError(gc, "arguments to `dot` must only contain INTEGER");
+		}
+
+		const size_t runLen = leftLen < rightLen ? leftLen : rightLen;
+		total += (uint64_t)dotIntegers(leftChunk, rightChunk, runLen);
+		i += runLen;
+	}
+
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = (int64_t)total;
+	return obj;
+}
+
+static struct Object* elementwise(struct ObjectList* args, struct MonkeyGC* gc, const char* name,
+	void (*kernel) (int64_t* dst, const int64_t* left, const int64_t* right, size_t count)) {
+
+	struct Object* error = checkIntegerArrayPair(args, gc, name);
+	if (error) {
+		return error;
+	}
+
+	struct Object* left = args->objects[0];
+	struct Object* right = args->objects[1];
+	struct Object* result = arrayFromIntegers(gc, NULL, 0);
+	int64_t leftScratch[ARRAY_WIDTH];
+	int64_t rightScratch[ARRAY_WIDTH];
+	int64_t out[ARRAY_WIDTH];
+
+	size_t i = 0;
+	while (i < arrayLength(left)) {
+		size_t leftLen = 0;
+		size_t rightLen = 0;
+		const int64_t* leftChunk = arrayIntegerChunk(left, i, leftScratch, &leftLen);
+		const int64_t* rightChunk = arrayIntegerChunk(right, i, rightScratch, &rightLen);
+		if (!leftChunk || !rightChunk) {
+			return newEvalError(gc, "arguments to `%s` must only contain INTEGER", name);
+		}
+
+		const size_t runLen = leftLen < rightLen ? leftLen : rightLen;
+		kernel(out, leftChunk, rightChunk, runLen);
+		appendArrayIntegers(&result->value.arr, out, runLen);
+		i += runLen;
+	}
+
+	return result;
+}
+
+struct Object* add(struct ObjectList* args, struct MonkeyGC* gc) {
+	return elementwise(args, gc, "add", addIntegers);
+}
+
+struct Object* mul(struct ObjectList* args, struct MonkeyGC* gc) {
+	return elementwise(args, gc, "mul", mulIntegers);
+}
+
+//range(end) or range(start, end), end is exclusive
+struct Object* range(struct ObjectList* args, struct MonkeyGC* gc) {
+	if (args->size != 1 && args->size != 2) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=1 or 2", args->size);
+	}
 
 	for (size_t i = 0; i < args->size; i++) {
-		printf("%s", inspectObject(args->objects[i]));
+		if (args->objects[i]->type != OBJ_INT) {
+			return newEvalError(gc, "argument to `range` must be INTEGER, got %s", objectTypeToStr(args->objects[i]->type));
+		}
+	}
+
+	const int64_t start = args->size == 2 ? args->objects[0]->value.integer : 0;
+	const int64_t end = args->objects[args->size - 1]->value.integer;
+	struct Object* result = arrayFromIntegers(gc, NULL, 0);
+	int64_t out[ARRAY_WIDTH];
+
+	size_t remaining = end > start ? (size_t)((uint64_t)end - (uint64_t)start) : 0;
+	int64_t next = start;
+	while (remaining > 0) {
+		const size_t runLen = remaining < ARRAY_WIDTH ? remaining : ARRAY_WIDTH;
+		fillIntegerRange(out, next, runLen);
+		appendArrayIntegers(&result->value.arr, out, runLen);
+		next += (int64_t)runLen;
+		remaining -= runLen;
+	}
+
+	return result;
+}
+
+//Higher order builtins loop in C and call back into the evaluator with one argument list reused for every element
+static struct Object* checkCallback(struct Object* fn, size_t argCount, struct MonkeyGC* gc, const char* name) {
+	if (fn->type == OBJ_BUILTIN) {
+		return NULL;
+	}
+
+	if (fn->type != OBJ_FUNCTION) {
+		return newEvalError(gc, "argument to `%s` must be FUNCTION, got %s", name, objectTypeToStr(fn->type));
+	}
+
+	const size_t parameterCount = functionParameterCount(fn);
+	if (parameterCount != argCount) {
+		return newEvalError(gc, "function passed to `%s` must take %llu arguments, got %llu", name,
+			(unsigned long long)argCount, (unsigned long long)parameterCount);
+	}
+
+	return NULL;
+}
+
+static struct Object* checkArrayAndCallback(struct ObjectList* args, size_t wantArgs, size_t callbackArgs, struct MonkeyGC* gc, const char* name) {
+	if (args->size != wantArgs) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=%d", (int)args->size, (int)wantArgs);
+	}
+
+	if (args->objects[0]->type != OBJ_ARRAY) {
+		return newEvalError(gc, "argument to `%s` must be ARRAY, got %s", name, objectTypeToStr(args->objects[0]->type));
+	}
+
+	return checkCallback(args->objects[wantArgs - 1], callbackArgs, gc, name);
+}
+
+struct Object* map(struct ObjectList* args, struct MonkeyGC* gc) {
+	struct Object* error = checkArrayAndCallback(args, 2, 1, gc, "map");
+	if (error) {
+		return error;
+	}
+
+	struct Object* arr = args->objects[0];
+	struct Object* fn = args->objects[1];
+	struct Object* argBuffer[1];
+	struct ObjectList callArgs = { 1, 1, argBuffer };
+	struct Object* result = arrayFromIntegers(gc, NULL, 0);
+
+	for (size_t i = 0; i < arrayLength(arr); i++) {
+		argBuffer[0] = arrayGet(gc, arr, i);
+		struct Object* mapped = applyFunction(fn, &callArgs, gc);
+		if (isError(mapped)) {
+			return mapped;
+		}
+		appendArrayObject(gc, result, mapped);
+	}
+
+	return result;
+}
+
+struct Object* filter(struct ObjectList* args, struct MonkeyGC* gc) {
+	struct Object* error = checkArrayAndCallback(args, 2, 1, gc, "filter");
+	if (error) {
+		return error;
+	}
+
+	struct Object* arr = args->objects[0];
+	struct Object* fn = args->objects[1];
+	struct Object* argBuffer[1];
+	struct ObjectList callArgs = { 1, 1, argBuffer };
+	struct Object* result = arrayFromIntegers(gc, NULL, 0);
+
+	for (size_t i = 0; i < arrayLength(arr); i++) {
+		struct Object* elem = arrayGet(gc, arr, i);
+		argBuffer[0] = elem;
+		struct Object* keep = applyFunction(fn, &callArgs, gc);
+		if (isError(keep)) {
+			return keep;
+		}
+
+		if (isTruthy(keep)) {
+			appendArrayObject(gc, result, elem);
+		}
+	}
+
+	return result;
+}
+
+//reduce(arr, initial, fn(acc, elem))
+struct Object* reduce(struct ObjectList* args, struct MonkeyGC* gc) {
+	struct Object* error = checkArrayAndCallback(args, 3, 2, gc, "reduce");
+	if (error) {
+		return error;
+	}
+
+	struct Object* arr = args->objects[0];
+	struct Object* fn = args->objects[2];
+	struct Object* argBuffer[2];
+	struct ObjectList callArgs = { 2, 2, argBuffer };
+	struct Object* acc = args->objects[1];
+
+	for (size_t i = 0; i < arrayLength(arr); i++) {
+		argBuffer[0] = acc;
+		argBuffer[1] = arrayGet(gc, arr, i);
+		acc = applyFunction(fn, &callArgs, gc);
+		if (isError(acc)) {
+			return acc;
+		}
+	}
+
+	return acc;
+}
+
+struct Object* each(struct ObjectList* args, struct MonkeyGC* gc) {
+	struct Object* error = checkArrayAndCallback(args, 2, 1, gc, "each");
+	if (error) {
+		return error;
+	}
+
+	struct Object* arr = args->objects[0];
+	struct Object* fn = args->objects[1];
+	struct Object* argBuffer[1];
+	struct ObjectList callArgs = { 1, 1, argBuffer };
+
+	for (size_t i = 0; i < arrayLength(arr); i++) {
+		argBuffer[0] = arrayGet(gc, arr, i);
+		struct Object* evaluated = applyFunction(fn, &callArgs, gc);
+		if (isError(evaluated)) {
+			return evaluated;
+		}
 	}
 
 	return &NullObj;
 }
 
+struct SortComparator {
+	struct Object* fn;
+	struct ObjectList args;
+	struct Object* argBuffer[2];
+	struct MonkeyGC* gc;
+	struct Object* error;
+};
+
+static int callSortComparator(void* ctx, struct Object* a, struct Object* b) {
+	struct SortComparator* cmp = (struct SortComparator*)ctx;
+	cmp->argBuffer[0] = a;
+	cmp->argBuffer[1] = b;
+
+	struct Object* result = applyFunction(cmp->fn, &cmp->args, cmp->gc);
+	if (isError(result)) {
+		cmp->error = result;
+		return -1;
+	}
+	return isTruthy(result) ? 1 : 0;
+}
+
+static struct Object* sortIntegerArray(struct Object* arr, struct MonkeyGC* gc) {
+	const size_t count = arrayLength(arr);
+	int64_t* values = (int64_t*)malloc(2 * count * sizeof(int64_t) + 1);
+	if (!values) {
+		perror("malloc (sort integers) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	size_t chunkLen = 0;
+	for (size_t i = 0; i < count; i += chunkLen) {
+		const int64_t* chunk = arrayIntegerChunk(arr, i, values + i, &chunkLen);
+		if (chunk != values + i) {
+			memcpy(values + i, chunk, chunkLen * sizeof(int64_t));
+		}
+	}
+
+	sortIntegers(values, values + count, count);
+	struct Object* result = arrayFromIntegers(gc, values, count);
+	free(values);
+	return result;
+}
+
+//sort(arr) or sort(arr, fn(a, b) { a < b }), always returns a new array
+struct Object* sort(struct ObjectList* args, struct MonkeyGC* gc) {
+	if (args->size != 1 && args->size != 2) {
+		return newEvalError(gc, "wrong number of arguments. got=%d, want=1 or 2", args->size);
+	}
+
+	struct Object* arr = args->objects[0];
+	if (arr->type != OBJ_ARRAY) {
+		return newEvalError(gc, "argument to `sort` must be ARRAY, got %s", objectTypeToStr(arr->type));
+	}
+
+	struct Object* error = args->size == 2 ? checkCallback(args->objects[1], 2, gc, "sort") : NULL;
+	if (error) {
+		return error;
+	}
+
+	const size_t count = arrayLength(arr);
+	if (args->size == 1 && arr->value.arr.packed) {
+		return sortIntegerArray(arr, gc);
+	}
+
+	struct Object** items = (struct Object**)malloc((count + count / 2 + 1) * sizeof(struct Object*));
+	if (!items) {
+		perror("malloc (sort objects) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bool allInts = true;
+	bool allStrings = true;
+	for (size_t i = 0; i < count; i++) {
+		items[i] = arrayGet(gc, arr, i);
+		allInts = allInts && items[i]->type == OBJ_INT;
+		allStrings = allStrings && items[i]->type == OBJ_STRING;
+	}
+
+	if (args->size == 1) {
+		if (allInts) {
+			free(items);
+			return sortIntegerArray(arr, gc);
+		}
+
+		if (!allStrings) {
+			free(items);
+			return newEvalError(gc, "argument to `sort` must only contain INTEGER or STRING without a comparator");
+		}
+
+		sortStringObjects(items, count);
+	}
+	else {
+		struct SortComparator cmp = { args->objects[1], { 2, 2, NULL }, { NULL, NULL }, gc, NULL };
+		cmp.args.objects = cmp.argBuffer;
+
+		if (!sortObjects(items, items + count, count, callSortComparator, &cmp)) {
+			free(items);
+			return cmp.error;
+		}
+	}
+
+	struct ObjectList sorted = { count, count, items };
+	struct Object* result = arrayFromList(gc, &sorted);
+	free(items);
+	return result;
+}
+
 struct BuiltinFunction builtinFunctions[] = {
 	{"len", len},
 	{"first", first},
@@ -158,6 +563,18 @@ struct BuiltinFunction builtinFunctions[] = {
 	{"cdr", cdr},
 	{"push", push},
 	{"print", print},
+	{"sum", sum},
+	{"min", minimum},
+	{"max", maximum},
+	{"dot", dot},
+	{"add", add},
+	{"mul", mul},
+	{"range", range},
+	{"map", map},
+	{"filter", filter},
+	{"reduce", reduce},
+	{"each", each},
+	{"sort", sort},
 };
 
 struct Object builtinFunctionsObjects[] = {
@@ -167,11 +584,23 @@ struct Object builtinFunctionsObjects[] = {
 	{OBJ_BUILTIN, {.builtin = cdr}, false, NULL},
 	{OBJ_BUILTIN, {.builtin = push}, false, NULL},
 	{OBJ_BUILTIN, {.builtin = print}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = sum}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = minimum}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = maximum}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = dot}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = add}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = mul}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = range}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = map}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = filter}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = reduce}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = each}, false, NULL},
+	{OBJ_BUILTIN, {.builtin = sort}, false, NULL},
 };
 
 #define builtinSize (sizeof(builtinFunctions) / sizeof(builtinFunctions[0]))
 
-struct Object* getBuiltin(char* key) {
+struct Object* getBuiltin(const char* key) {
 	struct Object* obj = &NullObj;
 	for (size_t i = 0; i < builtinSize; i++) {
 		if (strcmp(key, builtinFunctions[i].name) == 0) {
@@ -180,3 +609,33 @@ struct Object* getBuiltin(char* key) {
 	}
 	return obj;
 }
+
+bool builtinShadowed[builtinSize];
+static bool builtinSlotsReady = false;
+//Slots (hash % 256) of the builtin names, most names bound by a script miss all of them
+static bool builtinSlots[256];
+
+struct Object* resolveBuiltin(const char* key) {
+	struct Object* obj = getBuiltin(key);
+	return obj->type == OBJ_NULL ? NULL : obj;
+}
+
+void noteBuiltinBinding(const char* key, uint32_t hash) {
+	if (!builtinSlotsReady) {
+		for (size_t i = 0; i < builtinSize; i++) {
+			builtinSlots[hashString(builtinFunctions[i].name) & 255] = true;
+		}
+		builtinSlotsReady = true;
+	}
+
+	if (!builtinSlots[hash & 255]) {
+		return;
+	}
+
+	for (size_t i = 0; i < builtinSize; i++) {
+		if (strcmp(key, builtinFunctions[i].name) == 0) {
+			builtinShadowed[i] = true;
+			return;
+		}
+	}
+}
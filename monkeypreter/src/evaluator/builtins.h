@@ -1,3 +1,22 @@
 #pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "object.h"
 
-struct Object* getBuiltin(char* key);
\ No newline at end of file
+struct Object* getBuiltin(const char* key);
+
+//Builtin an identifier refers to unless an environment binds the same name, NULL for any other name.
+//Resolved once when the identifier is parsed or compiled instead of on every lookup that misses
+struct Object* resolveBuiltin(const char* key);
+//Called for every binding made in an environment. Once a builtin's name has been bound anywhere,
+//references to that builtin search the environments first like any other name
+void noteBuiltinBinding(const char* key, uint32_t hash);
+
+extern struct Object builtinFunctionsObjects[];
+extern bool builtinShadowed[];
+
+//builtin is a result of resolveBuiltin. Checked by the register vm, the function pointers, the
+//generated C and the tree evaluator, the compact evaluator searches the environments first
+static inline bool isBuiltinShadowed(const struct Object* builtin) {
+	return builtinShadowed[builtin - builtinFunctionsObjects];
+}
@@ -0,0 +1,301 @@
+#include "captures.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash_map.h"
+
+//Not bound by a statement of the function body itself
+#define CAPTURE_NO_STATEMENT SIZE_MAX
+
+//Parameter or `let` of a function
+struct CaptureLocal {
+	const char* name;
+	bool parameter;
+	size_t lets;
+	//Statement of the body holding the first `let`, CAPTURE_NO_STATEMENT when it is nested in an `if`
+	size_t statement;
+};
+
+//Function literal being walked
+struct CaptureScope {
+	struct FunctionLiteral* function;
+	struct CaptureLocal* locals;
+	size_t localsLen;
+	size_t localsCap;
+	//Statement of the body being walked
+	size_t statement;
+};
+
+//Scopes are addressed by index, walking a nested function may move them
+struct CaptureWalk {
+	struct CaptureScope* scopes;
+	size_t size;
+	size_t cap;
+};
+
+static void walkCaptureExpression(struct CaptureWalk* walk, struct Expression* expr);
+
+static struct CaptureLocal* findCaptureLocal(const struct CaptureScope* scope, const char* name) {
+	for (size_t i = 0; i < scope->localsLen; i++) {
+		if (strcmp(scope->locals[i].name, name) == 0) {
+			return &scope->locals[i];
+		}
+	}
+	return NULL;
+}
+
+static void addCaptureLocal(struct CaptureScope* scope, const char* name, bool parameter, size_t statement) {
+	struct CaptureLocal* local = findCaptureLocal(scope, name);
+	if (!local) {
+		if (scope->localsLen == scope->localsCap) {
+			scope->localsCap = scope->localsCap ? scope->localsCap * 2 : 8;
+			struct CaptureLocal* tmp = (struct CaptureLocal*)realloc(scope->locals, scope->localsCap * sizeof *tmp);
+			if (!tmp) {
+				perror("realloc (capture locals) returned `NULL`\n");
+				exit(EXIT_FAILURE);
+			}
+			scope->locals = tmp;
+		}
+		local = &scope->locals[scope->localsLen++];
+		local->name = name;
+		local->parameter = false;
+		local->lets = 0;
+		local->statement = CAPTURE_NO_STATEMENT;
+	}
+
+	if (parameter) {
+		local->parameter = true;
+		return;
+	}
+	if (local->lets++ == 0) {
+		local->statement = statement;
+	}
+}
+
+static void collectCaptureLets(struct CaptureScope* scope, const struct Expression* expr);
+
+static void collectCaptureBlockLets(struct CaptureScope* scope, const struct BlockStatement* block, bool body) {
+	if (!block) {
+		return;
+	}
+
+	for (size_t i = 0; i < block->size; i++) {
+		const struct Statement* stmt = &block->statements[i];
+		if (stmt->type == STMT_LET) {
+			addCaptureLocal(scope, stmt->identifier.value, false, body ? i : CAPTURE_NO_STATEMENT);
+		}
+		collectCaptureLets(scope, stmt->expr);
+	}
+}
+
+//Bindings of an `if` go into the function too, bindings of nested functions don't
+static void collectCaptureLets(struct CaptureScope* scope, const struct Expression* expr) {
+	if (!expr) {
+		return;
+	}
+
+	switch (expr->type) {
+		case EXPR_PREFIX:
+			collectCaptureLets(scope, expr->prefix.right);
+			break;
+
+		case EXPR_INFIX:
+			collectCaptureLets(scope, expr->infix.left);
+			collectCaptureLets(scope, expr->infix.right);
+			break;
+
+		case EXPR_IF:
+			collectCaptureLets(scope, expr->ifelse.condition);
+			collectCaptureBlockLets(scope, expr->ifelse.consequence, false);
+			collectCaptureBlockLets(scope, expr->ifelse.alternative, false);
+			break;
+
+		case EXPR_CALL:
+			collectCaptureLets(scope, expr->call.function);
+			for (size_t i = 0; i < expr->call.arguments.size; i++) {
+				collectCaptureLets(scope, expr->call.arguments.values[i]);
+			}
+			break;
+
+		case EXPR_ARRAY:
+			for (size_t i = 0; i < expr->array.elements.size; i++) {
+				collectCaptureLets(scope, expr->array.elements.values[i]);
+			}
+			break;
+
+		case EXPR_INDEX:
+			collectCaptureLets(scope, expr->indexExpr.left);
+			collectCaptureLets(scope, expr->indexExpr.index);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void addCapture(struct FunctionLiteral* function, const char* name) {
+	for (size_t i = 0; i < function->capturesLen; i++) {
+		if (strcmp(function->captures[i].name, name) == 0) {
+			return;
+		}
+	}
+
+	struct CapturedName* tmp = (struct CapturedName*)realloc(function->captures, (function->capturesLen + 1) * sizeof *tmp);
+	if (!tmp) {
+		perror("realloc (captured names) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	function->captures = tmp;
+	function->captures[function->capturesLen].name = name;
+	function->captures[function->capturesLen].hash = hashString(name);
+	function->capturesLen++;
+}
+
+//A name read in the innermost function: when a function around it binds the name, every function
+//in between captures it. They can copy the value if it is bound once before the outermost of them is created.
+//A binding that may not have happened yet when the name is read (a `let` in a later statement or in an `if`)
+//doesn't end the search: the functions inside it read it from its frame and can't copy,
+//the binding around it is captured up to that function as well
+static void resolveCaptureName(struct CaptureWalk* walk, const char* name) {
+	size_t end = walk->size;
+	if (end == 0) {
+		return;
+	}
+
+	const struct CaptureLocal* own = findCaptureLocal(&walk->scopes[end - 1], name);
+	if (own && (own->parameter || own->statement < walk->scopes[end - 1].statement)) {
+		return;
+	}
+
+	for (size_t k = end - 1; k-- > 0;) {
+		const struct CaptureLocal* local = findCaptureLocal(&walk->scopes[k], name);
+		if (!local) {
+			continue;
+		}
+
+		const bool definite = local->parameter || local->statement < walk->scopes[k].statement;
+		const bool bound = local->parameter ? local->lets == 0 : local->lets == 1 && local->statement < walk->scopes[k].statement;
+		for (size_t j = k + 1; j < end; j++) {
+			addCapture(walk->scopes[j].function, name);
+			if (!bound) {
+				walk->scopes[j].function->flat = false;
+			}
+		}
+		if (definite) {
+			return;
+		}
+		end = k + 1;
+	}
+}
+
+static void walkCaptureStatements(struct CaptureWalk* walk, struct BlockStatement* block, bool body) {
+	if (!block) {
+		return;
+	}
+
+	for (size_t i = 0; i < block->size; i++) {
+		if (body) {
+			walk->scopes[walk->size - 1].statement = i;
+		}
+		walkCaptureExpression(walk, block->statements[i].expr);
+	}
+}
+
+static void walkCaptureFunction(struct CaptureWalk* walk, struct FunctionLiteral* function) {
+	free(function->captures);
+	function->captures = NULL;
+	function->capturesLen = 0;
+	function->flat = true;
+	function->freesFrame = true;
+
+	if (walk->size == walk->cap) {
+		walk->cap = walk->cap ? walk->cap * 2 : 8;
+		struct CaptureScope* tmp = (struct CaptureScope*)realloc(walk->scopes, walk->cap * sizeof *tmp);
+		if (!tmp) {
+			perror("realloc (capture scopes) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+		walk->scopes = tmp;
+	}
+	struct CaptureScope* scope = &walk->scopes[walk->size++];
+	scope->function = function;
+	scope->locals = NULL;
+	scope->localsLen = 0;
+	scope->localsCap = 0;
+	scope->statement = 0;
+
+	for (size_t i = 0; i < function->parameters.size; i++) {
+		addCaptureLocal(scope, function->parameters.values[i].value, true, CAPTURE_NO_STATEMENT);
+	}
+	collectCaptureBlockLets(scope, function->body, true);
+
+	walkCaptureStatements(walk, function->body, true);
+
+	free(walk->scopes[--walk->size].locals);
+	//A function that isn't flat holds on to the environment of the call creating it
+	if (walk->size > 0 && !function->flat) {
+		walk->scopes[walk->size - 1].function->freesFrame = false;
+	}
+}
+
+static void walkCaptureExpression(struct CaptureWalk* walk, struct Expression* expr) {
+	if (!expr) {
+		return;
+	}
+
+	switch (expr->type) {
+		case EXPR_IDENT:
+			resolveCaptureName(walk, expr->ident.value);
+			break;
+
+		case EXPR_PREFIX:
+			walkCaptureExpression(walk, expr->prefix.right);
+			break;
+
+		case EXPR_INFIX:
+			walkCaptureExpression(walk, expr->infix.left);
+			walkCaptureExpression(walk, expr->infix.right);
+			break;
+
+		case EXPR_IF:
+			walkCaptureExpression(walk, expr->ifelse.condition);
+			walkCaptureStatements(walk, expr->ifelse.consequence, false);
+			walkCaptureStatements(walk, expr->ifelse.alternative, false);
+			break;
+
+		case EXPR_FUNCTION:
+			walkCaptureFunction(walk, &expr->function);
+			break;
+
+		case EXPR_CALL:
+			walkCaptureExpression(walk, expr->call.function);
+			for (size_t i = 0; i < expr->call.arguments.size; i++) {
+				walkCaptureExpression(walk, expr->call.arguments.values[i]);
+			}
+			break;
+
+		case EXPR_ARRAY:
+			for (size_t i = 0; i < expr->array.elements.size; i++) {
+				walkCaptureExpression(walk, expr->array.elements.values[i]);
+			}
+			break;
+
+		case EXPR_INDEX:
+			walkCaptureExpression(walk, expr->indexExpr.left);
+			walkCaptureExpression(walk, expr->indexExpr.index);
+			break;
+
+		case EXPR_INT:
+		case EXPR_BOOL:
+		case EXPR_STRING:
+			break;
+	}
+}
+
+void analyzeCaptures(Program* program) {
+	struct CaptureWalk walk = { NULL, 0, 0 };
+	for (size_t i = 0; i < program->size; i++) {
+		walkCaptureExpression(&walk, program->statements[i].expr);
+	}
+	free(walk.scopes);
+}
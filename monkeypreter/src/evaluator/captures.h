@@ -0,0 +1,14 @@
+#pragma once
+#include "../parser/ast.h"
+
+//Free variable analysis of the function literals, before the tree evaluator runs the program.
+//Fills captures, flat and freesFrame of every struct FunctionLiteral:
+// - captures are the names a function reads from the functions around it (globals are no captures)
+// - a function is flat when each of those names is bound exactly once before the function is created,
+//   a parameter that is never rebound or a single `let` in an earlier statement of the function body.
+//   It gets an environment with copies of only those values instead of the one it is created in
+// - a call of a function with no function in its body that isn't flat frees its environment on return.
+//   This is the escape analysis of the frames: no other environment or object can refer to such a frame
+//   once the call returns, releaseEnvironment puts it back onto the frame stack
+//Running it again on the same program gives the same result
+void analyzeCaptures(Program* program);
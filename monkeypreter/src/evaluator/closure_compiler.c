@@ -0,0 +1,548 @@
+#include "closure_compiler.h"
+#include <stdio.h>
+#include <string.h>
+#include "builtins.h"
+#include "constants.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "hash_map.h"
+#include "object.h"
+
+//Calls and array literals with up to this many entries keep them on the stack
+#define COMPILED_STACK_ARGS 8
+
+typedef struct Object* (*CompiledFn)(const struct CompiledNode* node, struct ObjectEnvironment* env);
+
+struct CompiledName {
+	const char* text;
+	uint32_t hash;
+	//Builtin of the same name or NULL
+	struct Object* builtin;
+};
+
+//Which operands a node uses depends on fn, the rest stay zero
+struct CompiledNode {
+	CompiledFn fn;
+	const struct CompiledNode* a;
+	const struct CompiledNode* b;
+	const struct CompiledNode* c;
+	//Literal value, or the right operand of an infix node on an integer literal
+	struct Object* constant;
+	//Identifiers and let
+	struct CompiledName name;
+	//Block statements, call arguments and array elements, or the parameters of a function
+	const struct CompiledNode* const* entries;
+	const struct CompiledName* parameters;
+	uint32_t count;
+	enum OperatorType op;
+	//Functions, for inspecting them
+	const struct CompactAst* ast;
+	NodeRef ref;
+};
+
+static struct Object* newCompiledInteger(struct MonkeyGC* gc, int64_t value) {
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = value;
+	return obj;
+}
+
+static struct Object* compiledConstant(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	(void)env;
+	return node->constant;
+}
+
+static struct Object* compiledNull(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	(void)node;
+	(void)env;
+	return &NullObj;
+}
+
+//Literals of an AST whose constants were not bound
+static struct Object* compiledInteger(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	return newCompiledInteger(env->gc, compactInteger(&node->ast->nodes[node->ref]));
+}
+
+static struct Object* compiledString(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* obj = createObject(env->gc, OBJ_STRING);
+	strcpy_s(obj->value.string, MAX_IDENT_LENGTH, node->name.text);
+	return obj;
+}
+
+static struct Object* compiledIdentifier(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* builtin = node->name.builtin;
+	if (builtin && !isBuiltinShadowed(builtin)) {
+		return builtin;
+	}
+
+	struct Object* obj = environmentGetHashed(env, node->name.text, node->name.hash);
+	if (obj->type != OBJ_NULL) {
+		return obj;
+	}
+
+	if (builtin) {
+		return builtin;
+	}
+
+	return newEvalError(env->gc, "identifier not found: %s", node->name.text);
+}
+
+static struct Object* compiledNegate(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* right = node->a->fn(node->a, env);
+	if (isError(right)) {
+		return right;
+	}
+	return nativeBoolToBoolObj(right->type == OBJ_BOOL ? !right->value.boolean : right->type == OBJ_NULL);
+}
+
+static struct Object* compiledMinus(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* right = node->a->fn(node->a, env);
+	if (isError(right)) {
+		return right;
+	}
+	if (right->type == OBJ_INT) {
+		return newCompiledInteger(env->gc, (int64_t)(0 - (uint64_t)right->value.integer));
+	}
+	return evalPrefixExpression(node->op, right, env->gc);
+}
+
+static struct Object* compiledPrefix(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* right = node->a->fn(node->a, env);
+	if (isError(right)) {
+		return right;
+	}
+	return evalPrefixExpression(node->op, right, env->gc);
+}
+
+//Right before left like evalExpression so the same error wins. Returns the error or NULL
+static struct Object* evalCompiledOperands(const struct CompiledNode* node, struct ObjectEnvironment* env, struct Object** left, struct Object** right) {
+	*right = node->b->fn(node->b, env);
+	if (isError(*right)) {
+		return *right;
+	}
+
+	*left = node->a->fn(node->a, env);
+	if (isError(*left)) {
+		return *left;
+	}
+	return NULL;
+}
+
+static struct Object* compiledInfix(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* left;
+	struct Object* right;
+	struct Object* error = evalCompiledOperands(node, env, &left, &right);
+	if (error) {
+		return error;
+	}
+	return evalInfixExpression(node->op, left, right, env->gc);
+}
+
+//Two functions per integer operator, one evaluating both operands and one for an integer literal on the right,
+//which needs neither evaluating nor checking. Operands guard fails on take the generic path
+#define COMPILED_INT_OPERATOR(name, guard, result) \
+	static struct Object* compiled##name(const struct CompiledNode* node, struct ObjectEnvironment* env) { \
+		struct Object* left; \
+		struct Object* right; \
+		struct Object* error = evalCompiledOperands(node, env, &left, &right); \
+		if (error) { \
+			return error; \
+		} \
+		if (left->type != OBJ_INT || right->type != OBJ_INT || !(guard)) { \
+			return evalInfixExpression(node->op, left, right, env->gc); \
+		} \
+		return result; \
+	} \
+	static struct Object* compiled##name##Constant(const struct CompiledNode* node, struct ObjectEnvironment* env) { \
+		struct Object* left = node->a->fn(node->a, env); \
+		struct Object* right = node->constant; \
+		if (isError(left)) { \
+			return left; \
+		} \
+		if (left->type != OBJ_INT || !(guard)) { \
+			return evalInfixExpression(node->op, left, right, env->gc); \
+		} \
+		return result; \
+	}
+
+#define LEFT_INT left->value.integer
+#define RIGHT_INT right->value.integer
+
+COMPILED_INT_OPERATOR(Add, true, newCompiledInteger(env->gc, (int64_t)((uint64_t)LEFT_INT + (uint64_t)RIGHT_INT)))
+COMPILED_INT_OPERATOR(Subtract, true, newCompiledInteger(env->gc, (int64_t)((uint64_t)LEFT_INT - (uint64_t)RIGHT_INT)))
+COMPILED_INT_OPERATOR(Multiply, true, newCompiledInteger(env->gc, (int64_t)((uint64_t)LEFT_INT * (uint64_t)RIGHT_INT)))
+//Zero and INT64_MIN / -1 keep whatever evalInfixExpression does with them
+COMPILED_INT_OPERATOR(Divide, RIGHT_INT != 0 && (RIGHT_INT != -1 || LEFT_INT != INT64_MIN), newCompiledInteger(env->gc, LEFT_INT / RIGHT_INT))
+COMPILED_INT_OPERATOR(Lt, true, nativeBoolToBoolObj(LEFT_INT < RIGHT_INT))
+COMPILED_INT_OPERATOR(Gt, true, nativeBoolToBoolObj(LEFT_INT > RIGHT_INT))
+COMPILED_INT_OPERATOR(Eq, true, nativeBoolToBoolObj(LEFT_INT == RIGHT_INT))
+COMPILED_INT_OPERATOR(NotEq, true, nativeBoolToBoolObj(LEFT_INT != RIGHT_INT))
+
+#undef LEFT_INT
+#undef RIGHT_INT
+#undef COMPILED_INT_OPERATOR
+
+static struct Object* compiledIf(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* condition = node->a->fn(node->a, env);
+	if (isError(condition)) {
+		return condition;
+	}
+
+	if (isTruthy(condition)) {
+		return node->b->fn(node->b, env);
+	}
+
+	if (node->c) {
+		return node->c->fn(node->c, env);
+	}
+	return &NullObj;
+}
+
+static struct Object* compiledFunction(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* obj = createObject(env->gc, OBJ_FUNCTION);
+	obj->value.function.parameters.values = NULL;
+	obj->value.function.parameters.size = 0;
+	obj->value.function.parameters.cap = 0;
+	obj->value.function.body = NULL;
+	obj->value.function.env = env;
+	obj->value.function.compactAst = node->ast;
+	obj->value.function.compactNode = node->ref;
+	obj->value.function.compiled = node;
+	obj->value.function.vmFunction = NULL;
+	obj->value.function.native = NULL;
+	obj->value.function.freesFrame = false;
+	obj->value.function.ownsEnv = false;
+	return obj;
+}
+
+//Evaluates every entry of node into values, which starts out on stackBuffer. Returns the first error or NULL
+static struct Object* evalCompiledList(const struct CompiledNode* node, struct ObjectEnvironment* env, struct ObjectList* values, struct Object** stackBuffer) {
+	values->size = 0;
+	values->cap = node->count;
+	values->objects = stackBuffer;
+	if (node->count > COMPILED_STACK_ARGS) {
+		values->objects = (struct Object**)malloc(node->count * sizeof *values->objects);
+		if (!values->objects) {
+			perror("malloc (compiled list) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (uint32_t i = 0; i < node->count; i++) {
+		const struct CompiledNode* entry = node->entries[i];
+		struct Object* evaluated = entry->fn(entry, env);
+		if (isError(evaluated)) {
+			return evaluated;
+		}
+		values->objects[values->size++] = evaluated;
+	}
+	return NULL;
+}
+
+static struct Object* compiledCall(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* calledFunc = node->a->fn(node->a, env);
+	if (isError(calledFunc)) {
+		return calledFunc;
+	}
+
+	struct Object* stackBuffer[COMPILED_STACK_ARGS];
+	struct ObjectList args;
+	struct Object* result = evalCompiledList(node, env, &args, stackBuffer);
+	if (!result) {
+		//Compiled functions calling each other skip the dispatch in applyFunction
+		result = calledFunc->type == OBJ_FUNCTION && calledFunc->value.function.compiled
+			? applyCompiledFunction(calledFunc, &args, env->gc)
+			: applyFunction(calledFunc, &args, env->gc);
+	}
+
+	if (args.objects != stackBuffer) {
+		free(args.objects);
+	}
+	return result;
+}
+
+static struct Object* compiledArray(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* stackBuffer[COMPILED_STACK_ARGS];
+	struct ObjectList elements;
+	struct Object* result = evalCompiledList(node, env, &elements, stackBuffer);
+	if (!result) {
+		result = arrayFromList(env->gc, &elements);
+	}
+
+	if (elements.objects != stackBuffer) {
+		free(elements.objects);
+	}
+	return result;
+}
+
+static struct Object* compiledIndex(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* left = node->a->fn(node->a, env);
+	if (isError(left)) {
+		return left;
+	}
+
+	struct Object* index = node->b->fn(node->b, env);
+	if (isError(index)) {
+		return index;
+	}
+
+	if (left->type != OBJ_ARRAY || index->type != OBJ_INT) {
+		return evalIndexExpression(left, index, env->gc);
+	}
+
+	const int64_t i = index->value.integer;
+	if (i < 0 || (size_t)i >= arrayLength(left)) {
+		return &NullObj;
+	}
+	return arrayGet(env->gc, left, (size_t)i);
+}
+
+static struct Object* compiledLet(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* obj = node->a->fn(node->a, env);
+	if (isError(obj)) {
+		return obj;
+	}
+	return environmentSetHashed(env, node->name.text, node->name.hash, obj);
+}
+
+//Binding a literal can't fail
+static struct Object* compiledLetConstant(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	return environmentSetHashed(env, node->name.text, node->name.hash, node->a->constant);
+}
+
+static struct Object* compiledReturn(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	struct Object* obj = node->a->fn(node->a, env);
+	if (isError(obj)) {
+		return obj;
+	}
+	//Wrap instead of retagging obj, it may still be bound to a name
+	struct Object* retObj = createObject(env->gc, OBJ_RETURN);
+	retObj->value.retObj = obj;
+	return retObj;
+}
+
+static struct Object* compiledBlock(const struct CompiledNode* node, struct ObjectEnvironment* env) {
+	const uint32_t last = node->count - 1;
+	for (uint32_t i = 0; i < last; i++) {
+		const struct CompiledNode* statement = node->entries[i];
+		struct Object* obj = statement->fn(statement, env);
+		if (obj->type == OBJ_RETURN || isError(obj)) {
+			return obj;
+		}
+	}
+
+	//Whatever the last statement gives is the value of the block anyway
+	return node->entries[last]->fn(node->entries[last], env);
+}
+
+//Literal nodes the compiler can read the value of up front
+static struct Object* literalConstant(const struct CompactAst* ast, const struct CompactNode* node) {
+	if (node->type == CNODE_BOOL) {
+		return nativeBoolToBoolObj(node->a);
+	}
+	return compactConstant(ast, node);
+}
+
+static CompiledFn infixFn(enum OperatorType op, bool constantInt) {
+	switch (op) {
+		case OP_ADD: return constantInt ? compiledAddConstant : compiledAdd;
+		case OP_SUBTRACT: return constantInt ? compiledSubtractConstant : compiledSubtract;
+		case OP_MULTIPLY: return constantInt ? compiledMultiplyConstant : compiledMultiply;
+		case OP_DIVIDE: return constantInt ? compiledDivideConstant : compiledDivide;
+		case OP_LT: return constantInt ? compiledLtConstant : compiledLt;
+		case OP_GT: return constantInt ? compiledGtConstant : compiledGt;
+		case OP_EQ: return constantInt ? compiledEqConstant : compiledEq;
+		case OP_NOT_EQ: return constantInt ? compiledNotEqConstant : compiledNotEq;
+		default: return compiledInfix;
+	}
+}
+
+static struct CompiledName compiledName(const struct CompactAst* ast, uint32_t text) {
+	struct CompiledName name;
+	name.text = compactText(ast, text);
+	name.hash = hashString(name.text);
+	name.builtin = resolveBuiltin(name.text);
+	return name;
+}
+
+//Points node at the compiled entries of a compact node list
+static void compileList(struct CompiledProgram* program, struct CompiledNode* node, uint32_t list) {
+	size_t count = 0;
+	const uint32_t* refs = compactList(program->ast, list, &count);
+	for (size_t i = 0; i < count; i++) {
+		program->entries[list + 1 + i] = &program->nodes[refs[i]];
+	}
+	node->entries = &program->entries[list + 1];
+	node->count = (uint32_t)count;
+}
+
+static void compileNode(struct CompiledProgram* program, NodeRef ref) {
+	const struct CompactAst* ast = program->ast;
+	const struct CompactNode* source = &ast->nodes[ref];
+	struct CompiledNode* node = &program->nodes[ref];
+	memset(node, 0, sizeof *node);
+	node->ast = ast;
+	node->ref = ref;
+
+	const struct CompiledNode* a = source->a != NODE_NONE ? &program->nodes[source->a] : NULL;
+	const struct CompiledNode* b = source->b != NODE_NONE ? &program->nodes[source->b] : NULL;
+
+	switch (source->type) {
+		case CNODE_INT:
+			node->constant = compactConstant(ast, source);
+			node->fn = node->constant ? compiledConstant : compiledInteger;
+			break;
+
+		case CNODE_BOOL:
+			node->constant = nativeBoolToBoolObj(source->a);
+			node->fn = compiledConstant;
+			break;
+
+		case CNODE_STRING:
+			node->constant = compactConstant(ast, source);
+			node->name.text = compactText(ast, source->a);
+			node->fn = node->constant ? compiledConstant : compiledString;
+			break;
+
+		case CNODE_IDENT:
+			node->name = compiledName(ast, source->a);
+			node->fn = compiledIdentifier;
+			break;
+
+		case CNODE_PREFIX:
+			node->a = a;
+			node->op = (enum OperatorType)source->op;
+			node->fn = node->op == OP_NEGATE ? compiledNegate : node->op == OP_SUBTRACT ? compiledMinus : compiledPrefix;
+			break;
+
+		case CNODE_INFIX: {
+			node->a = a;
+			node->b = b;
+			node->op = (enum OperatorType)source->op;
+			const struct CompactNode* right = &ast->nodes[source->b];
+			node->constant = right->type == CNODE_INT ? compactConstant(ast, right) : NULL;
+			node->fn = infixFn(node->op, node->constant != NULL);
+			break;
+		}
+
+		case CNODE_IF:
+			node->a = a;
+			node->b = b;
+			node->c = source->c != NODE_NONE ? &program->nodes[source->c] : NULL;
+			node->fn = compiledIf;
+			break;
+
+		case CNODE_FUNCTION: {
+			size_t count = 0;
+			const uint32_t* parameters = compactList(ast, source->a, &count);
+			for (size_t i = 0; i < count; i++) {
+				program->names[source->a + 1 + i] = compiledName(ast, parameters[i]);
+			}
+			node->parameters = &program->names[source->a + 1];
+			node->count = (uint32_t)count;
+			node->b = b;
+			node->fn = compiledFunction;
+			break;
+		}
+
+		case CNODE_CALL:
+			node->a = a;
+			compileList(program, node, source->b);
+			node->fn = compiledCall;
+			break;
+
+		case CNODE_ARRAY:
+			compileList(program, node, source->a);
+			node->constant = compactConstant(ast, source);
+			node->fn = node->constant ? compiledConstant : compiledArray;
+			break;
+
+		case CNODE_INDEX:
+			node->a = a;
+			node->b = b;
+			node->fn = compiledIndex;
+			break;
+
+		case CNODE_LET:
+			node->name = compiledName(ast, source->a);
+			node->a = b;
+			node->fn = literalConstant(ast, &ast->nodes[source->b]) ? compiledLetConstant : compiledLet;
+			break;
+
+		case CNODE_RETURN:
+			node->a = a;
+			node->fn = compiledReturn;
+			break;
+
+		case CNODE_BLOCK:
+			compileList(program, node, source->a);
+			node->fn = node->count > 0 ? compiledBlock : compiledNull;
+			break;
+	}
+}
+
+struct CompiledProgram* compileProgram(const struct CompactAst* ast) {
+	struct CompiledProgram* program = (struct CompiledProgram*)malloc(sizeof *program);
+	if (!program) {
+		perror("malloc (compiled program) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	program->ast = ast;
+	program->nodes = (struct CompiledNode*)malloc((ast->nodesLen + 1) * sizeof *program->nodes);
+	program->entries = (const struct CompiledNode**)malloc((ast->listsLen + 1) * sizeof *program->entries);
+	program->names = (struct CompiledName*)malloc((ast->listsLen + 1) * sizeof *program->names);
+	if (!program->nodes || !program->entries || !program->names) {
+		perror("malloc (compiled nodes) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (NodeRef i = 0; i < ast->nodesLen; i++) {
+		compileNode(program, i);
+	}
+	return program;
+}
+
+void freeCompiledProgram(struct CompiledProgram* program) {
+	if (!program) {
+		return;
+	}
+	free(program->nodes);
+	free(program->entries);
+	free(program->names);
+	free(program);
+}
+
+struct Object* evalCompiledProgram(const struct CompiledProgram* program, struct ObjectEnvironment* env) {
+	const struct CompiledNode* root = &program->nodes[program->ast->root];
+
+	struct Object* obj = &NullObj;
+	for (uint32_t i = 0; i < root->count; i++) {
+		obj = root->entries[i]->fn(root->entries[i], env);
+		//Mark intermediate result
+		markMonkeyObject(obj);
+		if (env->gc->size >= env->gc->maxSize)
+			collectMonkeyGarbage(env->gc, env);
+
+		if (obj->type == OBJ_RETURN) {
+			return unwrapReturnValue(obj);
+		}
+
+		if (isError(obj)) {
+			return obj;
+		}
+	}
+	return obj;
+}
+
+struct Object* applyCompiledFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	(void)gc;
+	const struct CompiledNode* node = fn->value.function.compiled;
+
+	struct ObjectEnvironment* env = newEnclosedEnvironment(fn->value.function.env);
+	//Missing arguments leave their parameters unbound, like a local before its `let`
+	for (uint32_t i = 0; i < node->count && i < args->size; i++) {
+		environmentSetHashed(env, node->parameters[i].text, node->parameters[i].hash, args->objects[i]);
+	}
+
+	return unwrapReturnValue(node->b->fn(node->b, env));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "../parser/compact_ast.h"
+#include "environment.h"
+
+struct ObjectList;
+
+//Turns every node of a compact AST into a C function pointer plus the operands it needs, resolved once:
+//child nodes, literal objects, identifiers with their hash and the integer right operand of `x - 1`.
+//Running a node is a call through its pointer, no switch on the node type, and error checks are left
+//out where the operand is a literal.
+//Same semantics as evalProgram, ast has to be bound and outlive the compiled program
+struct CompiledProgram {
+	const struct CompactAst* ast;
+	//One per compact node, with the same index
+	struct CompiledNode* nodes;
+	//Node lists and parameter names, at the offset of their compact list
+	const struct CompiledNode** entries;
+	struct CompiledName* names;
+};
+
+struct CompiledProgram* compileProgram(const struct CompactAst* ast);
+//After every function object created from program is gone
+void freeCompiledProgram(struct CompiledProgram* program);
+struct Object* evalCompiledProgram(const struct CompiledProgram* program, struct ObjectEnvironment* env);
+struct Object* applyCompiledFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
@@ -0,0 +1,558 @@
+#include "compact_evaluator.h"
+#include <stdio.h>
+#include <string.h>
+#include "builtins.h"
+#include "constants.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object.h"
+
+//Calls and array literals with up to this many entries keep them on the stack
+#define COMPACT_STACK_ARGS 8
+
+//GCC and Clang jump from the dispatch point straight to the handler through a table of label
+//addresses, other compilers go through the switch the handlers are written in
+#if defined(__GNUC__) || defined(__clang__)
+#define COMPACT_COMPUTED_GOTO
+#define TARGET(code) target_##code: case code
+#else
+#define TARGET(code) case code
+#endif
+
+static struct Object* evalCompactNode(const struct CompactAst* ast, NodeRef ref, struct ObjectEnvironment* env);
+
+static struct Object* evalCompactIdentifier(const struct CompactAst* ast, uint32_t text, struct ObjectEnvironment* env) {
+	const char* name = compactText(ast, text);
+	struct Object* obj = environmentGet(env, name);
+	if (obj->type != OBJ_NULL) {
+		return obj;
+	}
+
+	obj = getBuiltin(name);
+	if (obj->type != OBJ_NULL) {
+		return obj;
+	}
+
+	return newEvalError(env->gc, "identifier not found: %s", name);
+}
+
+//Evaluates every entry of list into values, which starts out on stackBuffer. Returns the first error or NULL
+static struct Object* evalCompactList(const struct CompactAst* ast, uint32_t list, struct ObjectEnvironment* env, struct ObjectList* values, struct Object** stackBuffer) {
+	size_t count = 0;
+	const uint32_t* entries = compactList(ast, list, &count);
+
+	values->size = 0;
+	values->cap = count;
+	values->objects = stackBuffer;
+	if (count > COMPACT_STACK_ARGS) {
+		values->objects = (struct Object**)malloc(count * sizeof *values->objects);
+		if (!values->objects) {
+			perror("malloc (compact list) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		struct Object* evaluated = evalCompactNode(ast, entries[i], env);
+		if (isError(evaluated)) {
+			return evaluated;
+		}
+		values->objects[values->size++] = evaluated;
+	}
+	return NULL;
+}
+
+static struct Object* evalCompactCall(const struct CompactAst* ast, const struct CompactNode* node, struct ObjectEnvironment* env) {
+	struct Object* calledFunc = evalCompactNode(ast, node->a, env);
+	if (isError(calledFunc)) {
+		return calledFunc;
+	}
+
+	struct Object* stackBuffer[COMPACT_STACK_ARGS];
+	struct ObjectList args;
+	struct Object* result = evalCompactList(ast, node->b, env, &args, stackBuffer);
+	if (!result) {
+		result = applyFunction(calledFunc, &args, env->gc);
+	}
+
+	if (args.objects != stackBuffer) {
+		free(args.objects);
+	}
+	return result;
+}
+
+static struct Object* evalCompactArray(const struct CompactAst* ast, const struct CompactNode* node, struct ObjectEnvironment* env) {
+	struct Object* stackBuffer[COMPACT_STACK_ARGS];
+	struct ObjectList elements;
+	struct Object* result = evalCompactList(ast, node->a, env, &elements, stackBuffer);
+	if (!result) {
+		result = arrayFromList(env->gc, &elements);
+	}
+
+	if (elements.objects != stackBuffer) {
+		free(elements.objects);
+	}
+	return result;
+}
+
+//Operands of an infix node, right before left like evalExpression so the same error wins. Returns the error or NULL
+static struct Object* evalCompactOperands(const struct CompactAst* ast, const struct CompactNode* node, struct ObjectEnvironment* env, struct Object** left, struct Object** right) {
+	*right = evalCompactNode(ast, node->b, env);
+	if (isError(*right)) {
+		return *right;
+	}
+
+	*left = evalCompactNode(ast, node->a, env);
+	if (isError(*left)) {
+		return *left;
+	}
+	return NULL;
+}
+
+//Operands of an index node, left first. Returns the error or NULL
+static struct Object* evalCompactIndexOperands(const struct CompactAst* ast, const struct CompactNode* node, struct ObjectEnvironment* env, struct Object** left, struct Object** index) {
+	*left = evalCompactNode(ast, node->a, env);
+	if (isError(*left)) {
+		return *left;
+	}
+
+	*index = evalCompactNode(ast, node->b, env);
+	if (isError(*index)) {
+		return *index;
+	}
+	return NULL;
+}
+
+//Variant of an infix node for the operand types of its first execution
+static uint16_t quickenInfix(uint16_t opcode, const struct Object* left, const struct Object* right) {
+	if (left->type == OBJ_INT && right->type == OBJ_INT) {
+		switch (opcode) {
+			case CODE_ADD: return CODE_ADD_INT;
+			case CODE_SUBTRACT: return CODE_SUBTRACT_INT;
+			case CODE_MULTIPLY: return CODE_MULTIPLY_INT;
+			case CODE_DIVIDE: return CODE_DIVIDE_INT;
+			case CODE_LT: return CODE_LT_INT;
+			case CODE_GT: return CODE_GT_INT;
+			case CODE_EQ: return CODE_EQ_INT;
+			case CODE_NOT_EQ: return CODE_NOT_EQ_INT;
+			default: return CODE_INFIX;
+		}
+	}
+
+	if (left->type == OBJ_STRING && right->type == OBJ_STRING && opcode == CODE_ADD) {
+		return CODE_ADD_STRING;
+	}
+
+	if (left->type == OBJ_BOOL && right->type == OBJ_BOOL && (opcode == CODE_EQ || opcode == CODE_NOT_EQ)) {
+		return opcode == CODE_EQ ? CODE_EQ_BOOL : CODE_NOT_EQ_BOOL;
+	}
+	return CODE_INFIX;
+}
+
+static struct Object* newCompactInteger(struct MonkeyGC* gc, int64_t value) {
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = value;
+	return obj;
+}
+
+static struct Object* evalCompactNode(const struct CompactAst* ast, NodeRef ref, struct ObjectEnvironment* env) {
+#ifdef COMPACT_COMPUTED_GOTO
+#define COMPACT_TARGET_ADDRESS(code) &&target_##code,
+	static void* const dispatchTable[CODE_COUNT] = { COMPACT_OPCODES(COMPACT_TARGET_ADDRESS) };
+#undef COMPACT_TARGET_ADDRESS
+#endif
+
+	//Not const, nodes are quickened in place
+	struct CompactNode* node;
+	struct Object* obj;
+	struct Object* left;
+	struct Object* right;
+
+	//Tail positions, the branch an if takes and the last statement of a block, come back here instead of recursing
+dispatch:
+	if (ref == NODE_NONE) {
+		return &NullObj;
+	}
+	node = &ast->nodes[ref];
+
+#ifdef COMPACT_COMPUTED_GOTO
+	goto *dispatchTable[node->opcode];
+#endif
+
+	switch ((enum CompactOpcode)node->opcode) {
+		TARGET(CODE_INT): {
+			obj = compactConstant(ast, node);
+			return obj ? obj : newCompactInteger(env->gc, compactInteger(node));
+		}
+
+		TARGET(CODE_BOOL): {
+			return nativeBoolToBoolObj(node->a);
+		}
+
+		TARGET(CODE_STRING): {
+			obj = compactConstant(ast, node);
+			if (obj) {
+				return obj;
+			}
+			obj = createObject(env->gc, OBJ_STRING);
+			strcpy_s(obj->value.string, MAX_IDENT_LENGTH, compactText(ast, node->a));
+			return obj;
+		}
+
+		TARGET(CODE_IDENT): {
+			return evalCompactIdentifier(ast, node->a, env);
+		}
+
+		TARGET(CODE_NEGATE): {
+			right = evalCompactNode(ast, node->a, env);
+			if (isError(right)) {
+				return right;
+			}
+			return nativeBoolToBoolObj(right->type == OBJ_BOOL ? !right->value.boolean : right->type == OBJ_NULL);
+		}
+
+		TARGET(CODE_MINUS): {
+			right = evalCompactNode(ast, node->a, env);
+			if (isError(right)) {
+				return right;
+			}
+			node->opcode = right->type == OBJ_INT ? CODE_MINUS_INT : CODE_PREFIX;
+			return evalPrefixExpression((enum OperatorType)node->op, right, env->gc);
+		}
+
+		TARGET(CODE_MINUS_INT): {
+			right = evalCompactNode(ast, node->a, env);
+			if (isError(right)) {
+				return right;
+			}
+			if (right->type == OBJ_INT) {
+				return newCompactInteger(env->gc, (int64_t)(0 - (uint64_t)right->value.integer));
+			}
+			node->opcode = CODE_PREFIX;
+			return evalPrefixExpression((enum OperatorType)node->op, right, env->gc);
+		}
+
+		TARGET(CODE_PREFIX): {
+			right = evalCompactNode(ast, node->a, env);
+			if (isError(right)) {
+				return right;
+			}
+			return evalPrefixExpression((enum OperatorType)node->op, right, env->gc);
+		}
+
+		//First execution of an infix node, the generic path computes the result
+		TARGET(CODE_ADD):
+		TARGET(CODE_SUBTRACT):
+		TARGET(CODE_MULTIPLY):
+		TARGET(CODE_DIVIDE):
+		TARGET(CODE_LT):
+		TARGET(CODE_GT):
+		TARGET(CODE_EQ):
+		TARGET(CODE_NOT_EQ): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			node->opcode = quickenInfix(node->opcode, left, right);
+			return evalInfixExpression((enum OperatorType)node->op, left, right, env->gc);
+		}
+
+		TARGET(CODE_INFIX): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			return evalInfixExpression((enum OperatorType)node->op, left, right, env->gc);
+		}
+
+		TARGET(CODE_ADD_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return newCompactInteger(env->gc, (int64_t)((uint64_t)left->value.integer + (uint64_t)right->value.integer));
+		}
+
+		TARGET(CODE_SUBTRACT_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return newCompactInteger(env->gc, (int64_t)((uint64_t)left->value.integer - (uint64_t)right->value.integer));
+		}
+
+		TARGET(CODE_MULTIPLY_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return newCompactInteger(env->gc, (int64_t)((uint64_t)left->value.integer * (uint64_t)right->value.integer));
+		}
+
+		TARGET(CODE_DIVIDE_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			//Zero and INT64_MIN / -1 keep whatever evalInfixExpression does with them
+			if (left->type != OBJ_INT || right->type != OBJ_INT || right->value.integer == 0 || (right->value.integer == -1 && left->value.integer == INT64_MIN)) {
+				goto generalizeInfix;
+			}
+			return newCompactInteger(env->gc, left->value.integer / right->value.integer);
+		}
+
+		TARGET(CODE_LT_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.integer < right->value.integer);
+		}
+
+		TARGET(CODE_GT_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.integer > right->value.integer);
+		}
+
+		TARGET(CODE_EQ_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.integer == right->value.integer);
+		}
+
+		TARGET(CODE_NOT_EQ_INT): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_INT || right->type != OBJ_INT) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.integer != right->value.integer);
+		}
+
+		TARGET(CODE_ADD_STRING): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_STRING || right->type != OBJ_STRING) {
+				goto generalizeInfix;
+			}
+			return evalStringInfixExpression(OP_ADD, left, right, env->gc);
+		}
+
+		TARGET(CODE_EQ_BOOL): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_BOOL || right->type != OBJ_BOOL) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.boolean == right->value.boolean);
+		}
+
+		TARGET(CODE_NOT_EQ_BOOL): {
+			obj = evalCompactOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_BOOL || right->type != OBJ_BOOL) {
+				goto generalizeInfix;
+			}
+			return nativeBoolToBoolObj(left->value.boolean != right->value.boolean);
+		}
+
+		//A guard failed, the node stays generic from now on instead of flipping between variants
+		generalizeInfix: {
+			node->opcode = CODE_INFIX;
+			return evalInfixExpression((enum OperatorType)node->op, left, right, env->gc);
+		}
+
+		TARGET(CODE_IF): {
+			struct Object* condition = evalCompactNode(ast, node->a, env);
+			if (isError(condition)) {
+				return condition;
+			}
+
+			if (isTruthy(condition)) {
+				ref = node->b;
+				goto dispatch;
+			}
+
+			if (node->c != NODE_NONE) {
+				ref = node->c;
+				goto dispatch;
+			}
+			return &NullObj;
+		}
+
+		TARGET(CODE_FUNCTION): {
+			obj = createObject(env->gc, OBJ_FUNCTION);
+			obj->value.function.parameters.values = NULL;
+			obj->value.function.parameters.size = 0;
+			obj->value.function.parameters.cap = 0;
+			obj->value.function.body = NULL;
+			obj->value.function.env = env;
+			obj->value.function.compactAst = ast;
+			obj->value.function.compactNode = ref;
+			obj->value.function.compiled = NULL;
+			obj->value.function.vmFunction = NULL;
+			obj->value.function.native = NULL;
+			obj->value.function.freesFrame = false;
+			obj->value.function.ownsEnv = false;
+			return obj;
+		}
+
+		TARGET(CODE_CALL): {
+			return evalCompactCall(ast, node, env);
+		}
+
+		TARGET(CODE_ARRAY): {
+			obj = compactConstant(ast, node);
+			return obj ? obj : evalCompactArray(ast, node, env);
+		}
+
+		TARGET(CODE_INDEX): {
+			obj = evalCompactIndexOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			node->opcode = left->type == OBJ_ARRAY && right->type == OBJ_INT ? CODE_INDEX_ARRAY : CODE_INDEX_ANY;
+			return evalIndexExpression(left, right, env->gc);
+		}
+
+		TARGET(CODE_INDEX_ARRAY): {
+			obj = evalCompactIndexOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			if (left->type != OBJ_ARRAY || right->type != OBJ_INT) {
+				node->opcode = CODE_INDEX_ANY;
+				return evalIndexExpression(left, right, env->gc);
+			}
+
+			const int64_t index = right->value.integer;
+			if (index < 0 || (size_t)index >= arrayLength(left)) {
+				return &NullObj;
+			}
+			return arrayGet(env->gc, left, (size_t)index);
+		}
+
+		TARGET(CODE_INDEX_ANY): {
+			obj = evalCompactIndexOperands(ast, node, env, &left, &right);
+			if (obj) {
+				return obj;
+			}
+			return evalIndexExpression(left, right, env->gc);
+		}
+
+		TARGET(CODE_LET): {
+			obj = evalCompactNode(ast, node->b, env);
+			if (isError(obj)) {
+				return obj;
+			}
+			environmentSet(env, compactText(ast, node->a), obj);
+			return obj;
+		}
+
+		TARGET(CODE_RETURN): {
+			obj = evalCompactNode(ast, node->a, env);
+			if (isError(obj)) {
+				return obj;
+			}
+			//Wrap instead of retagging obj, it may still be bound to a name
+			struct Object* retObj = createObject(env->gc, OBJ_RETURN);
+			retObj->value.retObj = obj;
+			return retObj;
+		}
+
+		TARGET(CODE_BLOCK): {
+			size_t count = 0;
+			const uint32_t* statements = compactList(ast, node->a, &count);
+			if (count == 0) {
+				return &NullObj;
+			}
+
+			for (size_t i = 0; i + 1 < count; i++) {
+				obj = evalCompactNode(ast, statements[i], env);
+				if (obj->type == OBJ_RETURN || isError(obj)) {
+					return obj;
+				}
+			}
+
+			//Whatever the last statement gives is the value of the block anyway
+			ref = statements[count - 1];
+			goto dispatch;
+		}
+
+		case CODE_COUNT:
+			break;
+	}
+
+	return &NullObj;
+}
+
+struct Object* evalCompactProgram(const struct CompactAst* ast, struct ObjectEnvironment* env) {
+	size_t count = 0;
+	const uint32_t* statements = compactList(ast, ast->nodes[ast->root].a, &count);
+
+	struct Object* obj = &NullObj;
+	for (size_t i = 0; i < count; i++) {
+		obj = evalCompactNode(ast, statements[i], env);
+		//Mark intermediate result
+		markMonkeyObject(obj);
+		if (env->gc->size >= env->gc->maxSize)
+			collectMonkeyGarbage(env->gc, env);
+
+		if (obj->type == OBJ_RETURN) {
+			return unwrapReturnValue(obj);
+		}
+
+		if (isError(obj)) {
+			return obj;
+		}
+	}
+	return obj;
+}
+
+struct Object* applyCompactFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	(void)gc;
+	const struct CompactAst* ast = fn->value.function.compactAst;
+	const struct CompactNode* node = &ast->nodes[fn->value.function.compactNode];
+
+	size_t count = 0;
+	const uint32_t* parameters = compactList(ast, node->a, &count);
+
+	struct ObjectEnvironment* env = newEnclosedEnvironment(fn->value.function.env);
+	//Missing arguments leave their parameters unbound, like a local before its `let`
+	for (size_t i = 0; i < count && i < args->size; i++) {
+		environmentSet(env, compactText(ast, parameters[i]), args->objects[i]);
+	}
+
+	return unwrapReturnValue(evalCompactNode(ast, node->b, env));
+}
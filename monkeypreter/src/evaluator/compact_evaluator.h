@@ -0,0 +1,10 @@
+#pragma once
+#include "../parser/compact_ast.h"
+#include "environment.h"
+
+struct ObjectList;
+
+//Same semantics as evalProgram, walks the flat node pool instead of the pointer tree.
+//ast has to outlive every function object created from it
+struct Object* evalCompactProgram(const struct CompactAst* ast, struct ObjectEnvironment* env);
+struct Object* applyCompactFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
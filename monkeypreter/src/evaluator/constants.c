@@ -0,0 +1,197 @@
+#include "constants.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "object.h"
+
+static void bindExpression(struct Expression* expr);
+
+static struct Object** allocConstantList(size_t count) {
+	//One extra slot, empty arrays are constants too
+	struct Object** objects = (struct Object**)malloc((count + 1) * sizeof *objects);
+	if (!objects) {
+		perror("malloc (constant list) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	return objects;
+}
+
+static struct Object* newConstantArray(struct Object** elements, size_t count) {
+	struct ObjectList list = { count, count, elements };
+	struct Object* obj = createImmortalObject(OBJ_ARRAY);
+	initArrayFromList(&obj->value.arr, &list);
+	return obj;
+}
+
+//Booleans already are static objects and need no binding
+static struct Object* literalObject(const struct Expression* expr) {
+	if (expr->type == EXPR_BOOL) {
+		return nativeBoolToBoolObj(expr->boolean);
+	}
+	return expr->constant;
+}
+
+static void bindArrayLiteral(struct Expression* expr) {
+	const struct ExpressionList* elements = &expr->array.elements;
+	for (size_t i = 0; i < elements->size; i++) {
+		bindExpression(elements->values[i]);
+	}
+
+	struct Object** objects = allocConstantList(elements->size);
+	for (size_t i = 0; i < elements->size; i++) {
+		objects[i] = literalObject(elements->values[i]);
+		if (!objects[i]) {
+			free(objects);
+			return;
+		}
+	}
+
+	expr->constant = newConstantArray(objects, elements->size);
+	free(objects);
+}
+
+static void bindStatements(struct Statement* statements, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		bindExpression(statements[i].expr);
+	}
+}
+
+static void bindBlock(struct BlockStatement* bs) {
+	if (bs) {
+		bindStatements(bs->statements, bs->size);
+	}
+}
+
+static void bindExpression(struct Expression* expr) {
+	if (!expr || expr->constant) {
+		return;
+	}
+
+	switch (expr->type) {
+		case EXPR_INT:
+			expr->constant = createImmortalObject(OBJ_INT);
+			expr->constant->value.integer = expr->integer;
+			break;
+
+		case EXPR_STRING:
+			expr->constant = createImmortalObject(OBJ_STRING);
+			strcpy_s(expr->constant->value.string, MAX_IDENT_LENGTH, expr->string);
+			break;
+
+		case EXPR_ARRAY:
+			bindArrayLiteral(expr);
+			break;
+
+		case EXPR_PREFIX:
+			bindExpression(expr->prefix.right);
+			break;
+
+		case EXPR_INFIX:
+			bindExpression(expr->infix.left);
+			bindExpression(expr->infix.right);
+			break;
+
+		case EXPR_IF:
+			bindExpression(expr->ifelse.condition);
+			bindBlock(expr->ifelse.consequence);
+			bindBlock(expr->ifelse.alternative);
+			break;
+
+		case EXPR_FUNCTION:
+			bindBlock(expr->function.body);
+			break;
+
+		case EXPR_CALL:
+			bindExpression(expr->call.function);
+			for (size_t i = 0; i < expr->call.arguments.size; i++) {
+				bindExpression(expr->call.arguments.values[i]);
+			}
+			break;
+
+		case EXPR_INDEX:
+			bindExpression(expr->indexExpr.left);
+			bindExpression(expr->indexExpr.index);
+			break;
+
+		case EXPR_IDENT:
+		case EXPR_BOOL:
+			break;
+	}
+}
+
+void bindConstants(Program* program) {
+	bindStatements(program->statements, program->size);
+}
+
+//Array slot stays empty when an element has none, the evaluator builds that array every time
+static struct Object* newCompactConstantArray(const struct CompactAst* ast, const struct CompactNode* node) {
+	size_t count = 0;
+	const uint32_t* elements = compactList(ast, node->a, &count);
+
+	struct Object** objects = allocConstantList(count);
+	for (size_t i = 0; i < count; i++) {
+		const struct CompactNode* element = &ast->nodes[elements[i]];
+		objects[i] = element->type == CNODE_BOOL ? nativeBoolToBoolObj(element->a) : compactConstant(ast, element);
+		if (!objects[i]) {
+			free(objects);
+			return NULL;
+		}
+	}
+
+	struct Object* obj = newConstantArray(objects, count);
+	free(objects);
+	return obj;
+}
+
+void bindCompactConstants(struct CompactAst* ast) {
+	if (ast->constants || ast->constantsLen == 0) {
+		return;
+	}
+
+	ast->constants = (struct Object**)calloc(ast->constantsLen, sizeof *ast->constants);
+	if (!ast->constants) {
+		perror("calloc (compact constants) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	//Elements come after their array, walking backwards binds them first
+	for (NodeRef i = ast->nodesLen; i-- > 0;) {
+		const struct CompactNode* node = &ast->nodes[i];
+		if (!compactHasConstant(node) || ast->constants[node->c]) {
+			continue;
+		}
+
+		struct Object* obj = NULL;
+		switch (node->type) {
+			case CNODE_INT:
+				obj = createImmortalObject(OBJ_INT);
+				obj->value.integer = compactInteger(node);
+				break;
+
+			case CNODE_STRING:
+				obj = createImmortalObject(OBJ_STRING);
+				strcpy_s(obj->value.string, MAX_IDENT_LENGTH, compactText(ast, node->a));
+				break;
+
+			case CNODE_ARRAY:
+				obj = newCompactConstantArray(ast, node);
+				break;
+		}
+		ast->constants[node->c] = obj;
+	}
+}
+
+void freeCompactConstants(struct CompactAst* ast) {
+	if (!ast->constants) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < ast->constantsLen; i++) {
+		if (ast->constants[i]) {
+			freeObject(ast->constants[i]);
+		}
+	}
+	free(ast->constants);
+	ast->constants = NULL;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "../parser/ast.h"
+#include "../parser/compact_ast.h"
+
+//Literals become immortal objects once before evaluation, evaluating one allocates nothing.
+//Integers, strings and arrays holding only literals are bound, the GC never sees them
+
+//Attaches a constant to every literal of the tree, freeExpression frees them with the AST
+void bindConstants(Program* program);
+//Fills the constant pool of the compact AST
+void bindCompactConstants(struct CompactAst* ast);
+//Before freeCompactAst or closeAstCache, after the GC is gone
+void freeCompactConstants(struct CompactAst* ast);
+
+//NULL while the pool is not bound
+static inline struct Object* compactConstant(const struct CompactAst* ast, const struct CompactNode* node) {
+	return ast->constants && compactHasConstant(node) ? ast->constants[node->c] : NULL;
+}
@@ -1,6 +1,10 @@
 #include "environment.h"
 #include <stdio.h>
 #include "hash_map.h"
+#include "builtins.h"
+#include "gc.h"
+
+uint32_t bindingVersions[BINDING_VERSION_SLOTS];
 
 struct ObjectEnvironment* newEnvironment(struct MonkeyGC* gc) {
 	struct ObjectEnvironment* env = (struct ObjectEnvironment*)malloc(sizeof * env);
@@ -15,12 +19,18 @@ struct ObjectEnvironment* newEnvironment(struct MonkeyGC* gc) {
 }
 
 struct ObjectEnvironment* newEnclosedEnvironment(struct ObjectEnvironment* outer) {
-	struct ObjectEnvironment* env = newEnvironment(outer->gc);
+	struct ObjectEnvironment* env = outer->gc->frames;
+	if (env) {
+		outer->gc->frames = env->outer;
+	}
+	else {
+		env = newEnvironment(outer->gc);
+	}
 	env->outer = outer;
 	return env;
 }
 
-struct Object* environmentGet(struct ObjectEnvironment* env, char* key) {
+struct Object* environmentGet(struct ObjectEnvironment* env, const char* key) {
 	struct Object* obj = (struct Object*)lookupKeyInHashMap(env->store, key);
 	if(obj == NULL && env->outer != NULL) {
 		obj = environmentGet(env->outer, key);
@@ -33,12 +43,42 @@ struct Object* environmentGet(struct ObjectEnvironment* env, char* key) {
 	return obj;
 }
 
-struct Object* environmentSet(struct ObjectEnvironment* env, char* key, struct Object* data) {
-	insertIntoHashMap(env->store, key, data);
+struct Object* environmentGetHashed(struct ObjectEnvironment* env, const char* key, uint32_t hash) {
+	for (; env != NULL; env = env->outer) {
+		struct Object* obj = (struct Object*)lookupHashedKeyInHashMap(env->store, key, hash);
+		if (obj != NULL) {
+			return obj;
+		}
+	}
+	return &NullObj;
+}
+
+struct Object* environmentSetHashed(struct ObjectEnvironment* env, const char* key, uint32_t hash, struct Object* data) {
+	insertHashedIntoHashMap(env->store, key, hash, data);
+	bindingVersions[hash & (BINDING_VERSION_SLOTS - 1)]++;
+	noteBuiltinBinding(key, hash);
 	return data;
 }
 
+struct Object* environmentSet(struct ObjectEnvironment* env, const char* key, struct Object* data) {
+	return environmentSetHashed(env, key, hashString(key), data);
+}
+
+void releaseEnvironment(struct ObjectEnvironment* env) {
+	resetHashMap(env->store);
+	env->outer = env->gc->frames;
+	env->gc->frames = env;
+}
+
+void invalidateBindingVersions(void) {
+	for (uint32_t i = 0; i < BINDING_VERSION_SLOTS; i++) {
+		bindingVersions[i]++;
+	}
+}
+
 void deleteEnvironment(struct ObjectEnvironment* env) {
 	destroyHashMap(env->store);
 	free(env);
+	//A new environment may get the same address, no cached lookup can stay valid
+	invalidateBindingVersions();
 }
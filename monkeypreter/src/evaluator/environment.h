@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 struct ObjectEnvironment {
 	struct HashMap* store;
@@ -8,7 +9,27 @@ struct ObjectEnvironment {
 
 struct ObjectEnvironment* newEnvironment(struct MonkeyGC* gc);
 struct ObjectEnvironment* newEnclosedEnvironment(struct ObjectEnvironment* outer);
-struct Object* environmentGet(struct ObjectEnvironment* env, char* key);
-struct Object* environmentSet(struct ObjectEnvironment* env, char* key, struct Object* data);
+struct Object* environmentGet(struct ObjectEnvironment* env, const char* key);
+struct Object* environmentSet(struct ObjectEnvironment* env, const char* key, struct Object* data);
+//key together with its hashString, for callers that hash every name once up front
+struct Object* environmentGetHashed(struct ObjectEnvironment* env, const char* key, uint32_t hash);
+struct Object* environmentSetHashed(struct ObjectEnvironment* env, const char* key, uint32_t hash, struct Object* data);
 void deleteEnvironment(struct ObjectEnvironment* env);
+//For an environment nothing refers to anymore. It goes onto the frame stack of its GC, the next
+//newEnclosedEnvironment reuses it with its buckets and nodes, deleteMonkeyGC frees it.
+//The binding versions stay, callers releasing an environment that was the outer environment
+//of another one (closure environments, see FunctionObject.ownsEnv) invalidate them
+void releaseEnvironment(struct ObjectEnvironment* env);
+
+//Counts the bindings made in any environment, per slot of the name's hash. A lookup result
+//stays valid while the version of its name is unchanged (as long as no environment on the way binds it)
+#define BINDING_VERSION_SLOTS 256
+extern uint32_t bindingVersions[BINDING_VERSION_SLOTS];
+
+//After an environment that may have been the outer environment of another one is freed or reused
+void invalidateBindingVersions(void);
+
+static inline uint32_t bindingVersion(uint32_t hash) {
+	return bindingVersions[hash & (BINDING_VERSION_SLOTS - 1)];
+}
 void deleteAllEnvironment(struct ObjectEnvironment* env);
\ No newline at end of file
@@ -3,26 +3,33 @@
 #include <stdio.h>
 #include <string.h>
 #include "builtins.h"
+#include "captures.h"
+#include "closure_compiler.h"
+#include "compact_evaluator.h"
 #include "gc.h"
+#include "hash_map.h"
 #include "object.h"
+#include "../vm/vm.h"
 
 struct Object* evalStatement(struct Statement* stmt, struct ObjectEnvironment* env);
 struct Object* evalExpression(struct Expression* expr, struct ObjectEnvironment* env);
-struct Object* evalPrefixExpression(enum OperatorType op, struct Object* right, struct MonkeyGC* gc);
 struct Object* evalBangOperatorExpression(struct Object* right);
 struct Object* evalMinusPrefixExpression(struct Object* right, struct MonkeyGC* gc);
-struct Object* evalInfixExpression(enum OperatorType op, struct Object* left, struct Object* right, struct MonkeyGC* gc);
 struct Object* evalIntegerInfixExpression(enum OperatorType op, struct Object* left, struct Object* right, struct MonkeyGC* gc);
 struct Object* evalIfExpression(struct IfExpression* expr, struct ObjectEnvironment* env);
 struct Object* evalBlockStatement(struct BlockStatement* bs, struct ObjectEnvironment* env);
 struct Object* evalIdentifier(struct Expression* expr, struct ObjectEnvironment* env);
 struct ObjectList evalExpressions(const struct ExpressionList* expressions, struct ObjectEnvironment* env);
 struct Object* applyFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
+struct Object* evalCallee(struct CallExpression* call, struct ObjectEnvironment* env);
+//applyFunction for one type of function object, NULL for objects that are no function
+typedef struct Object* (*FunctionApplier)(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
+FunctionApplier functionApplier(const struct Object* fn);
+struct Object* applyBuiltinFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
 struct ObjectEnvironment* extendFunctionEnv(struct Object* fn, struct ObjectList* args);
-struct Object* unwrapReturnValue(struct Object* obj);
+struct ObjectEnvironment* closureEnvironment(const struct FunctionLiteral* function, struct ObjectEnvironment* env);
 struct Object* evalStringInfixExpression(enum OperatorType op, struct Object* left, struct Object* right, struct MonkeyGC* gc);
-struct Object* evalIndexExpression(struct Object* left, struct Object* index, struct MonkeyGC* gc);
-struct Object* evalArrayIndexExpression(struct Object* arr, struct Object* index);
+struct Object* evalArrayIndexExpression(struct Object* arr, struct Object* index, struct MonkeyGC* gc);
 
 const char* operatorToStr(enum OperatorType op)
 {
@@ -48,6 +55,7 @@ const char* operatorToStr(enum OperatorType op)
 }
 
 struct Object* evalProgram(Program* program, struct ObjectEnvironment* env) {
+	analyzeCaptures(program);
 	struct Object* obj = &NullObj;
 	for (size_t i = 0; i < program->size; i++) {
 		obj = evalStatement(&program->statements[i], env);
@@ -87,11 +95,10 @@ struct Object* evalStatement(struct Statement* stmt, struct ObjectEnvironment* e
 		if (isError(obj)) {
 			return obj;
 		}
-		struct Object* retObj = createObject(env->gc, obj->type);
-		retObj->value = obj->value;
-		obj->type = OBJ_RETURN;
-		obj->value.retObj = retObj;
-		return obj;
+		//Wrap instead of retagging obj, it may still be bound to a name or be a constant
+		struct Object* retObj = createObject(env->gc, OBJ_RETURN);
+		retObj->value.retObj = obj;
+		return retObj;
 	}
 
 	case STMT_LET: {
@@ -111,6 +118,11 @@ struct Object* evalStatement(struct Statement* stmt, struct ObjectEnvironment* e
 struct Object* evalExpression(struct Expression* expr, struct ObjectEnvironment* env) {
 	struct Object* obj = &NullObj;
 
+	//Literals bound by bindConstants evaluate to the same object every time
+	if (expr->constant) {
+		return expr->constant;
+	}
+
 	switch (expr->type) {
 	case EXPR_INT:
 		obj = createObject(env->gc, OBJ_INT);
@@ -153,13 +165,19 @@ struct Object* evalExpression(struct Expression* expr, struct ObjectEnvironment*
 		struct Object* func = createObject(env->gc, OBJ_FUNCTION);
 		func->value.function.parameters = expr->function.parameters;
 		func->value.function.body = expr->function.body;
-		func->value.function.env = env;
+		func->value.function.env = closureEnvironment(&expr->function, env);
+		func->value.function.compactAst = NULL;
+		func->value.function.compiled = NULL;
+		func->value.function.vmFunction = NULL;
+		func->value.function.native = NULL;
+		func->value.function.freesFrame = expr->function.freesFrame;
+		func->value.function.ownsEnv = expr->function.flat && expr->function.capturesLen > 0 && expr->function.freesFrame;
 		return func;
 	}
 
 	case EXPR_CALL: {
 
-		struct Object* calledFunc = evalExpression(expr->call.function, env);
+		struct Object* calledFunc = expr->call.function->type == EXPR_IDENT ? evalCallee(&expr->call, env) : evalExpression(expr->call.function, env);
 		//printf("Calling fn ( %s ) \n", inspectObject(calledFunc));
 		if (isError(calledFunc)) {
 			return calledFunc;
@@ -173,7 +191,13 @@ struct Object* evalExpression(struct Expression* expr, struct ObjectEnvironment*
 
 		//printf("Args evaluated %llu\n", args.size);
 
-		//Apply function with args
+		//Apply function with args, builtins and cached callees are called directly
+		if (calledFunc->type == OBJ_BUILTIN) {
+			return applyBuiltinFunction(calledFunc, &args, env->gc);
+		}
+		if (calledFunc == expr->call.cache.callee && expr->call.cache.apply) {
+			return expr->call.cache.apply(calledFunc, &args, env->gc);
+		}
 		return applyFunction(calledFunc, &args, env->gc);
 	}
 
@@ -182,15 +206,18 @@ struct Object* evalExpression(struct Expression* expr, struct ObjectEnvironment*
 		strcpy_s(obj->value.string, MAX_IDENT_LENGTH, expr->string);
 		break;
 
-	case EXPR_ARRAY:
-		obj = createObject(env->gc, OBJ_ARRAY);
+	case EXPR_ARRAY: {
 		struct ObjectList elements = evalExpressions(&(expr->array.elements), env);
 
 		if (elements.size == 1 && isError(elements.objects[0])) {
-			return elements.objects[0];
+			obj = elements.objects[0];
+			free(elements.objects);
+			return obj;
 		}
-		obj->value.arr = elements;
+		obj = arrayFromList(env->gc, &elements);
+		free(elements.objects);
 		break;
+	}
 
 	case EXPR_INDEX:
 		struct Object* indexLeft = evalExpression(expr->indexExpr.left, env);
@@ -355,20 +382,53 @@ struct Object* newEvalError(struct MonkeyGC* gc, const char* format, ...) {
 }
 
 struct Object* evalIdentifier(struct Expression* expr, struct ObjectEnvironment* env) {
+	//A builtin no environment ever bound needs no lookup
+	struct Object* builtin = expr->ident.builtin;
+	if (builtin && !isBuiltinShadowed(builtin)) {
+		return builtin;
+	}
+
 	struct Object* obj = environmentGet(env, expr->ident.value);
 	if (obj->type != OBJ_NULL) {
 		return obj;
 	}
 
-	obj = getBuiltin(expr->ident.value);
-
-	if (obj->type != OBJ_NULL) {
-		return obj;
+	if (builtin) {
+		return builtin;
 	}
 
 	return newEvalError(env->gc, "identifier not found: %s", expr->ident.value);
 }
 
+//Callee of a call through a name. When the calling environment does not bind the name itself, the
+//lookup from its outer environment is cached on the call until some environment binds the name again
+struct Object* evalCallee(struct CallExpression* call, struct ObjectEnvironment* env) {
+	struct Object* builtin = call->function->ident.builtin;
+	if (builtin && !isBuiltinShadowed(builtin)) {
+		return builtin;
+	}
+
+	struct CallCache* cache = &call->cache;
+	const char* name = call->function->ident.value;
+	if (cache->callee && env->outer == cache->scope && bindingVersion(cache->hash) == cache->version
+		&& !lookupHashedKeyInHashMap(env->store, name, cache->hash)) {
+		return cache->callee;
+	}
+
+	//The GC may have freed the cached callee, a new object at its address must not take its applier
+	cache->callee = NULL;
+	struct Object* obj = evalIdentifier(call->function, env);
+	const uint32_t hash = hashString(name);
+	if (!isError(obj) && !lookupHashedKeyInHashMap(env->store, name, hash)) {
+		cache->scope = env->outer;
+		cache->hash = hash;
+		cache->version = bindingVersion(hash);
+		cache->callee = obj;
+		cache->apply = functionApplier(obj);
+	}
+	return obj;
+}
+
 struct ObjectList evalExpressions(const struct ExpressionList* expressions, struct ObjectEnvironment* env) {
 	struct ObjectList args;
 	args.size = 0;
@@ -400,30 +460,96 @@ struct ObjectList evalExpressions(const struct ExpressionList* expressions, stru
 	return args;
 }
 
-struct Object* applyFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+struct Object* applyAstFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	(void)gc;
+	struct ObjectEnvironment* extendedEnv = extendFunctionEnv(fn, args);
+	struct Object* evaluated = evalBlockStatement(fn->value.function.body, extendedEnv);
+	//printf("Evaluated after apply func: %s\n", objectTypeToStr(evaluated->type));
+	//printf("Evaluated after apply func: %s\n", inspectObject(evaluated));
+	if (fn->value.function.freesFrame) {
+		releaseEnvironment(extendedEnv);
+	}
+	//Unwrap return value to stop it from bubbling up to outer functions and stopping execution in all functions
+	return unwrapReturnValue(evaluated);
+}
+
+struct Object* applyBuiltinFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	return fn->value.builtin(args, gc);
+}
+
+FunctionApplier functionApplier(const struct Object* fn) {
+	if (fn->type == OBJ_FUNCTION && fn->value.function.native) {
+		return fn->value.function.native->entry;
+	}
+
+	if (fn->type == OBJ_FUNCTION && fn->value.function.vmFunction) {
+		return applyVmFunction;
+	}
+
+	if (fn->type == OBJ_FUNCTION && fn->value.function.compiled) {
+		return applyCompiledFunction;
+	}
+
+	if (fn->type == OBJ_FUNCTION && fn->value.function.compactAst) {
+		return applyCompactFunction;
+	}
 
 	if (fn->type == OBJ_FUNCTION) {
-		struct ObjectEnvironment* extendedEnv = extendFunctionEnv(fn, args);
-		struct Object* evaluated = evalBlockStatement(fn->value.function.body, extendedEnv);
-		//printf("Evaluated after apply func: %s\n", objectTypeToStr(evaluated->type));
-		//printf("Evaluated after apply func: %s\n", inspectObject(evaluated));
-		//deleteEnvironment(extendedEnv);
-		//Unwrap return value to stop it from bubbling up to outer functions and stopping execution in all functions
-		return unwrapReturnValue(evaluated);
+		return applyAstFunction;
 	}
 
 	if (fn->type == OBJ_BUILTIN) {
-		return fn->value.builtin(args, gc);
+		return applyBuiltinFunction;
+	}
+
+	return NULL;
+}
+
+struct Object* applyFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	const FunctionApplier apply = functionApplier(fn);
+	if (apply) {
+		return apply(fn, args, gc);
 	}
 
 	return newEvalError(gc, "not a function: %s", objectTypeToStr(fn->type));
 }
 
+//Flat functions get an environment of their own holding copies of the captured values, the
+//global environment behind it has everything else they read. Others keep the environment they are created in
+struct ObjectEnvironment* closureEnvironment(const struct FunctionLiteral* function, struct ObjectEnvironment* env) {
+	if (!function->flat) {
+		return env;
+	}
+
+	struct ObjectEnvironment* globals = env;
+	while (globals->outer) {
+		globals = globals->outer;
+	}
+	if (function->capturesLen == 0) {
+		return globals;
+	}
+
+	struct ObjectEnvironment* captured = newEnclosedEnvironment(globals);
+	for (size_t i = 0; i < function->capturesLen; i++) {
+		const struct CapturedName* name = &function->captures[i];
+		//A parameter left unbound by a missing argument is not copied, reading it reads the globals
+		for (struct ObjectEnvironment* scope = env; scope != globals; scope = scope->outer) {
+			struct Object* value = (struct Object*)lookupHashedKeyInHashMap(scope->store, name->name, name->hash);
+			if (value) {
+				environmentSetHashed(captured, name->name, name->hash, value);
+				break;
+			}
+		}
+	}
+	return captured;
+}
+
 struct ObjectEnvironment* extendFunctionEnv(struct Object* fn, struct ObjectList* args) {
 
 	struct ObjectEnvironment* env = newEnclosedEnvironment(fn->value.function.env);
 
-	for (size_t i = 0; i < fn->value.function.parameters.size; i++) {
+	//Missing arguments leave their parameters unbound, like a local before its `let`
+	for (size_t i = 0; i < fn->value.function.parameters.size && i < args->size; i++) {
 		environmentSet(env, fn->value.function.parameters.values[i].value, args->objects[i]);
 	}
 	return env;
@@ -459,19 +585,18 @@ struct Object* evalStringInfixExpression(enum OperatorType op, struct Object* le
 
 struct Object* evalIndexExpression(struct Object* left, struct Object* index, struct MonkeyGC* gc) {
 	if (left->type == OBJ_ARRAY && index->type == OBJ_INT) {
-		return evalArrayIndexExpression(left, index);
+		return evalArrayIndexExpression(left, index, gc);
 	}
 
 	return newEvalError(gc, "index operator not supported: %s", objectTypeToStr(left->type));
 }
 
-struct Object* evalArrayIndexExpression(struct Object* arr, struct Object* index) {
+struct Object* evalArrayIndexExpression(struct Object* arr, struct Object* index, struct MonkeyGC* gc) {
 	int64_t idx = index->value.integer;
-	size_t max = arr->value.arr.size - 1;
 
-	if (idx < 0 || (size_t)idx > max) {
+	if (idx < 0 || (size_t)idx >= arrayLength(arr)) {
 		return &NullObj;
 	}
 
-	return arr->value.arr.objects[idx];
+	return arrayGet(gc, arr, (size_t)idx);
 }
\ No newline at end of file
@@ -2,5 +2,14 @@
 #include "../parser/ast.h"
 #include "environment.h"
 
+struct ObjectList;
+
 struct Object* evalProgram(Program* program, struct ObjectEnvironment* env);
-struct Object* newEvalError(struct MonkeyGC* gc, const char* format, ...);
\ No newline at end of file
+struct Object* newEvalError(struct MonkeyGC* gc, const char* format, ...);
+struct Object* applyFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
+//Shared with the compact evaluator
+struct Object* evalPrefixExpression(enum OperatorType op, struct Object* right, struct MonkeyGC* gc);
+struct Object* evalInfixExpression(enum OperatorType op, struct Object* left, struct Object* right, struct MonkeyGC* gc);
+struct Object* evalStringInfixExpression(enum OperatorType op, struct Object* left, struct Object* right, struct MonkeyGC* gc);
+struct Object* evalIndexExpression(struct Object* left, struct Object* index, struct MonkeyGC* gc);
+struct Object* unwrapReturnValue(struct Object* obj);
\ No newline at end of file
@@ -18,15 +18,33 @@ struct MonkeyGC* createMonkeyGC(void) {
 
 	gc->head = NULL;
 	gc->size = 0;
+	gc->frames = NULL;
 	//Trigger GC after 100 objects
 	gc->maxSize = 100;
 	return gc;
 }
 
+//Environment of a collected flat closure, see FunctionObject.ownsEnv
+static void releaseOwnedEnvironment(struct Object* obj) {
+	if (obj->type == OBJ_FUNCTION && obj->value.function.ownsEnv) {
+		releaseEnvironment(obj->value.function.env);
+	}
+}
+
+static void freeFrameStack(struct MonkeyGC* gc) {
+	while (gc->frames != NULL) {
+		struct ObjectEnvironment* trash = gc->frames;
+		gc->frames = trash->outer;
+		destroyHashMap(trash->store);
+		free(trash);
+	}
+}
+
 void deleteMonkeyGC(struct MonkeyGC* gc) {
 
 	int counter = 0;
 	if (gc->size <= 0) {
+		freeFrameStack(gc);
 		free(gc);
 		return;
 	}
@@ -35,11 +53,13 @@ void deleteMonkeyGC(struct MonkeyGC* gc) {
 	while(curr != NULL) {
 		struct Object* trash = curr;
 		curr = curr->next;
+		releaseOwnedEnvironment(trash);
 		freeObject(trash);
 		counter++;
 	}
 
 	printf("Deleted %d objects that were still doing some monkey business\n", counter);
+	freeFrameStack(gc);
 	free(gc);
 }
 
@@ -74,11 +94,17 @@ void markMonkeyObject(struct Object* obj) {
 		markMonkeyObject(obj->value.retObj);
 	}
 
-	//Mark objects in array
-	if(obj->type == OBJ_ARRAY) {
+	//Mark objects in array, packed arrays hold no objects
+	if(obj->type == OBJ_ARRAY && !obj->value.arr.packed) {
+
+		size_t offset = 0;
+		size_t chunkLen = 0;
+		for (size_t i = 0; i < obj->value.arr.size; i += chunkLen) {
+			struct ArrayNode* leaf = arrayChunk(&obj->value.arr, i, &offset, &chunkLen);
 
-		for (size_t i = 0; i < obj->value.arr.size; i ++) {
-			markMonkeyObject(obj->value.arr.objects[i]);
+			for (size_t j = 0; j < chunkLen; j++) {
+				markMonkeyObject(leaf->objects[offset + j]);
+			}
 		}
 	}
 
@@ -111,6 +137,7 @@ void markMonkeyObjectEnvironment(struct ObjectEnvironment* env) {
 size_t sweepMonkeyGc(struct MonkeyGC* gc) {
 	struct Object** object = &gc->head;
 	size_t garbageCounter = 0;
+	bool releasedEnv = false;
 	while (*object != NULL) {
 		//Not reached, free and remove from list
 		if (!(*object)->mark) {
@@ -120,9 +147,15 @@ size_t sweepMonkeyGc(struct MonkeyGC* gc) {
 #ifdef LOG_GC
 			printf("Collect garbage: \n");
 			printf("\t - Type: %s\n", objectTypeToStr(trash->type));
-			printf("\t - Value: %s\n", inspectObject(trash));
+			char* trashStr = inspectObject(trash);
+			printf("\t - Value: %s\n", trashStr);
+			free(trashStr);
 			printf("Current GC size = %llu\n", gc->size);
 #endif
+			if (trash->type == OBJ_FUNCTION && trash->value.function.ownsEnv) {
+				releaseEnvironment(trash->value.function.env);
+				releasedEnv = true;
+			}
 			freeObject(trash);
 			gc->size--;
 			garbageCounter++;
@@ -143,6 +176,11 @@ size_t sweepMonkeyGc(struct MonkeyGC* gc) {
 		(*object)->mark = false;
 		object = &(*object)->next;
 	}
+
+	//Calls of the collected closures had those environments as their outer one, cached lookups may point at them
+	if (releasedEnv) {
+		invalidateBindingVersions();
+	}
 	
 	return garbageCounter;
 }
@@ -5,6 +5,9 @@ struct MonkeyGC {
 	struct Object* head;
 	size_t size;
 	size_t maxSize;
+	//Released environments, linked through outer. newEnclosedEnvironment takes them first.
+	//Only the tree evaluator (the REPL) releases any, scripts on the other engines never fill it
+	struct ObjectEnvironment* frames;
 };
 
 struct MonkeyGC* createMonkeyGC(void);
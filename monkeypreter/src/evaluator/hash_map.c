@@ -29,6 +29,7 @@ struct HashMap* createHashMap(uint32_t cap) {
 
 	hm->size = 0;
 	hm->cap = cap;
+	hm->spare = NULL;
 	//hm->keyType = keyType;
 	//hm->dataType = dataType;
 	hm->elems = (struct HashNode**)calloc(cap, sizeof(struct HashNode*));
@@ -43,36 +44,49 @@ struct HashMap* createHashMap(uint32_t cap) {
 
 void destroyHashMap(struct HashMap* hm) {
 	clear(hm);
+	while (hm->spare != NULL) {
+		struct HashNode* trash = hm->spare;
+		hm->spare = trash->next;
+		free(trash);
+	}
 	free(hm->elems);
 	free(hm);
 }
 
 bool insertIntoHashMap(struct HashMap* hm, const char* key, void* data) {
+	if (key == NULL) return false;
+	return insertHashedIntoHashMap(hm, key, hashString(key), data);
+}
+
+bool insertHashedIntoHashMap(struct HashMap* hm, const char* key, uint32_t hash, void* data) {
 
 	//if (key == NULL || hm == NULL || hashMapContains(hm, key)) return false;
 	if (key == NULL || hm == NULL) return false;
 
-	const uint32_t index = getIndex(hm, key);
+	const uint32_t index = hash % hm->cap;
 
 	//Rebind value
-	if(hashMapContains(hm, key)) {
-		struct HashNode* curr = hm->elems[index];
-
-		while (curr != NULL) {
-			if (strcmp(curr->key, key) == 0) {
-				//free object or not? gc can handle it
-				curr->data = data;
-				return true;
-			}
-			curr = curr->next;
+	struct HashNode* curr = hm->elems[index];
+	while (curr != NULL) {
+		if (strcmp(curr->key, key) == 0) {
+			//free object or not? gc can handle it
+			curr->data = data;
+			return true;
 		}
+		curr = curr->next;
 	}
 
-	//Create new node
-	struct HashNode* node = (struct HashNode*)malloc(sizeof * node);
-	if (!node) {
-		perror("malloc (insert hashmap node) returned `NULL`\n");
-		exit(EXIT_FAILURE);
+	//Create new node, or take one from a reset
+	struct HashNode* node = hm->spare;
+	if (node) {
+		hm->spare = node->next;
+	}
+	else {
+		node = (struct HashNode*)malloc(sizeof * node);
+		if (!node) {
+			perror("malloc (insert hashmap node) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
 	}
 
 	strcpy_s(node->key, MAX_IDENT_LENGTH, key);
@@ -106,11 +120,15 @@ bool hashMapContains(struct HashMap* hm, const char* key) {
 	return false;
 }
 void* lookupKeyInHashMap(struct HashMap* hm, const char* key) {
+	if (key == NULL) return NULL;
+	return lookupHashedKeyInHashMap(hm, key, hashString(key));
+}
 
-	if (key == NULL || hm == NULL || !hashMapContains(hm, key)) return NULL;
+void* lookupHashedKeyInHashMap(struct HashMap* hm, const char* key, uint32_t hash) {
 
-	uint32_t index = getIndex(hm, key);
-	struct HashNode* curr = hm->elems[index];
+	if (key == NULL || hm == NULL) return NULL;
+
+	struct HashNode* curr = hm->elems[hash % hm->cap];
 
 	while (curr != NULL) {
 		if (strcmp(curr->key, key) == 0) {
@@ -152,6 +170,20 @@ bool deleteKeyFromHashMap(struct HashMap* hm, const char* key) {
 	return true;
 }
 
+void resetHashMap(struct HashMap* hm) {
+	for (uint32_t i = 0; hm->size > 0 && i < hm->cap; i++) {
+		struct HashNode* curr = hm->elems[i];
+		while (curr != NULL) {
+			struct HashNode* next = curr->next;
+			curr->next = hm->spare;
+			hm->spare = curr;
+			hm->size--;
+			curr = next;
+		}
+		hm->elems[i] = NULL;
+	}
+}
+
 static uint32_t getIndex(struct HashMap* hm, const char* key) {
 	return hashString(key) % hm->cap;
 }
@@ -11,11 +11,20 @@ struct HashMap {
 	uint32_t size;
 	uint32_t cap;
 	struct HashNode** elems;
+	//Nodes of a reset, the next inserts take them instead of allocating
+	struct HashNode* spare;
 };
 
+//Hash of a key, callers that look the same key up often can compute it once
+uint32_t hashString(const char* key);
 struct HashMap* createHashMap(uint32_t cap);
 void destroyHashMap(struct HashMap* hm);
 bool insertIntoHashMap(struct HashMap* hm, const char* key, void* data);
+//hash has to be hashString(key)
+bool insertHashedIntoHashMap(struct HashMap* hm, const char* key, uint32_t hash, void* data);
 bool hashMapContains(struct HashMap* hm, const char* key);
 void* lookupKeyInHashMap(struct HashMap* hm, const char* key);
-bool deleteKeyFromHashMap(struct HashMap* hm, const char* key);
\ No newline at end of file
+void* lookupHashedKeyInHashMap(struct HashMap* hm, const char* key, uint32_t hash);
+bool deleteKeyFromHashMap(struct HashMap* hm, const char* key);
+//Removes every entry but keeps the buckets and nodes for the next inserts
+void resetHashMap(struct HashMap* hm);
\ No newline at end of file
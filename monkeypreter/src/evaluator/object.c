@@ -41,6 +41,20 @@ struct Object* createObject(struct MonkeyGC* gc, enum ObjectType type) {
 	return obj;
 }
 
+struct Object* createImmortalObject(enum ObjectType type) {
+	struct Object* obj = (struct Object*)malloc(sizeof *obj);
+
+	if (!obj) {
+		perror("malloc (create immortal object) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	obj->type = type;
+	//Never unmarked, marking stops here and the sweep never sees it
+	obj->mark = true;
+	obj->next = NULL;
+	return obj;
+}
+
 void freeObject(struct Object* obj) {
 	switch(obj->type) {
 		case OBJ_NULL: 
@@ -53,23 +67,17 @@ void freeObject(struct Object* obj) {
 			break;
 
 		case OBJ_RETURN:
-			if(!obj->value.retObj->mark)
-				freeObject(obj->value.retObj);
+			//retObj is tracked by the GC on its own
 			break;
 
 		case OBJ_FUNCTION:
-			free(obj->value.function.parameters.values);
-			freeBlockStatement(obj->value.function.body);
+			//Parameters and body belong to the AST, every evaluation of the literal shares them
 			//Do not delete env
 			break;
 
 		case OBJ_ARRAY:
-			for(size_t i = 0; i < obj->value.arr.size; i++) {
-				if(!obj->value.arr.objects[i]->mark)
-					freeObject(obj->value.arr.objects[i]);
-				
-			}
-			free(obj->value.arr.objects);
+			//Elements are shared with other arrays and owned by the GC, only drop our hold on the trie
+			releaseArray(&obj->value.arr);
 			break;
 	}
 
@@ -83,75 +91,112 @@ bool isTruthy(struct Object* obj) {
 	return false;
 }
 
-#define MAX_OBJECT_SIZE 1000000
-
-char* inspectObject(const struct Object* obj) {
-	char* msg = (char*) malloc(MAX_OBJECT_SIZE);
-	if (!msg) {
-		perror("malloc (inspect object) returned `NULL`\n");
-		return NULL;
-	}
-	msg[0] = '\0';
-	int success = 0;
-
+void writeObject(struct Writer* writer, const struct Object* obj) {
 	switch (obj->type) {
 		case OBJ_NULL:
-			success = sprintf_s(msg, MAX_OBJECT_SIZE, "NULL");
+			writeStr(writer, "NULL");
 			break;
 
 		case OBJ_INT:
-			success = sprintf_s(msg, MAX_OBJECT_SIZE, "%lld", obj->value.integer);
+			writeInt(writer, obj->value.integer);
 			break;
 
 		case OBJ_BOOL:
-			success = sprintf_s(msg, MAX_OBJECT_SIZE, "%s", obj->value.boolean ? "true" : "false");
+			writeStr(writer, obj->value.boolean ? "true" : "false");
 			break;
 
 		case OBJ_RETURN:
-			return inspectObject(obj->value.retObj);
+			writeObject(writer, obj->value.retObj);
+			break;
 
 		case OBJ_ERROR:
-			success = sprintf_s(msg, MAX_OBJECT_SIZE, "ERROR: %s", obj->value.error.msg);
+			writeStr(writer, "ERROR: ");
+			writeStr(writer, obj->value.error.msg);
 			break;
 
-		case OBJ_FUNCTION:
-			strcat_s(msg, MAX_OBJECT_SIZE, "fn");
-			strcat_s(msg, MAX_OBJECT_SIZE, "(");
+		case OBJ_FUNCTION: {
+			if (obj->value.function.native) {
+				writeStr(writer, obj->value.function.native->text);
+				break;
+			}
+
+			if (obj->value.function.compactAst) {
+				const struct CompactAst* ast = obj->value.function.compactAst;
+				const struct CompactNode* node = &ast->nodes[obj->value.function.compactNode];
+				size_t count = 0;
+				const uint32_t* parameters = compactList(ast, node->a, &count);
+
+				writeStr(writer, "fn(");
+				for (size_t i = 0; i < count; i++) {
+					if (i > 0) {
+						writeStr(writer, ", ");
+					}
+
+					writeStr(writer, compactText(ast, parameters[i]));
+				}
+				writeStr(writer, ") {\n");
+				writeCompactNode(writer, ast, node->b);
+				writeStr(writer, "\n}");
+				break;
+			}
+
+			writeStr(writer, "fn(");
 			for (size_t i = 0; i < obj->value.function.parameters.size; i++) {
 				if (i > 0) {
-					strcat_s(msg, MAX_OBJECT_SIZE, ", ");
+					writeStr(writer, ", ");
 				}
 
-				strcat_s(msg, MAX_OBJECT_SIZE, obj->value.function.parameters.values[i].value);
+				writeStr(writer, obj->value.function.parameters.values[i].value);
 			}
-			strcat_s(msg, MAX_OBJECT_SIZE, ") {\n");
-			blockStatementToStr(msg, obj->value.function.body);
-			strcat_s(msg, MAX_OBJECT_SIZE, "\n}");
+			writeStr(writer, ") {\n");
+
+			writeBlockStatement(writer, obj->value.function.body);
+			writeStr(writer, "\n}");
 			break;
+		}
 
 		case OBJ_STRING:
-			success = sprintf_s(msg, MAX_OBJECT_SIZE, "%s\n", obj->value.string);
+			writeStr(writer, obj->value.string);
+			writeChar(writer, '\n');
 			break;
 
 		case OBJ_BUILTIN:
-			strcat_s(msg, MAX_OBJECT_SIZE, "builtin function\n");
+			writeStr(writer, "builtin function\n");
 			break;
 
-		case OBJ_ARRAY:
-			strcat_s(msg, MAX_OBJECT_SIZE, "[");
-			for (size_t i = 0; i < obj->value.arr.size; i++) {
-				if (i > 0) {
-					strcat_s(msg, MAX_OBJECT_SIZE, ", ");
+		case OBJ_ARRAY: {
+			writeChar(writer, '[');
+
+			//Walk leaf by leaf instead of looking every element up from the root
+			size_t chunkLen = 0;
+			for (size_t i = 0; i < arrayLength(obj); i += chunkLen) {
+				size_t offset = 0;
+				const struct ArrayNode* leaf = arrayChunk(&obj->value.arr, i, &offset, &chunkLen);
+
+				for (size_t j = 0; j < chunkLen; j++) {
+					if (i + j > 0) {
+						writeStr(writer, ", ");
+					}
+
+					if (obj->value.arr.packed) {
+						writeInt(writer, leaf->integers[offset + j]);
+					}
+					else {
+						writeObject(writer, leaf->objects[offset + j]);
+					}
 				}
-
-				strcat_s(msg, MAX_OBJECT_SIZE, inspectObject(obj->value.arr.objects[i]));
 			}
 
-			strcat_s(msg, MAX_OBJECT_SIZE, "]");
-
+			writeChar(writer, ']');
 			break;
+		}
 	}
-	return msg;
+}
+
+char* inspectObject(const struct Object* obj) {
+	struct Writer writer = createStringWriter(64);
+	writeObject(&writer, obj);
+	return takeWriterString(&writer);
 }
 
 const char* objectTypeToStr(const enum ObjectType type)
@@ -174,3 +219,14 @@ const char* objectTypeToStr(const enum ObjectType type)
 bool isError(struct Object* obj) {
 	return obj->type == OBJ_ERROR;
 }
+
+size_t functionParameterCount(const struct Object* fn) {
+	if (fn->value.function.native) {
+		return fn->value.function.native->parameterCount;
+	}
+	if (fn->value.function.compactAst) {
+		const struct CompactAst* ast = fn->value.function.compactAst;
+		return ast->lists[ast->nodes[fn->value.function.compactNode].a];
+	}
+	return fn->value.function.parameters.size;
+}
@@ -3,7 +3,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "environment.h"
+#include "array.h"
 #include "../parser/ast.h"
+#include "../parser/compact_ast.h"
+#include "../util/writer.h"
+
+struct CompiledNode;
+struct VmFunction;
+struct NativeFunction;
 
 enum ObjectType {
 	OBJ_NULL,
@@ -25,6 +32,20 @@ struct FunctionObject {
 	struct IdentifierList parameters;
 	struct BlockStatement* body;
 	struct ObjectEnvironment* env;
+	//Functions of a compact AST leave parameters and body empty and point at their FUNCTION node
+	const struct CompactAst* compactAst;
+	NodeRef compactNode;
+	//Set when the compact AST was compiled, calls run the compiled body
+	const struct CompiledNode* compiled;
+	//Or the bytecode of the register VM
+	const struct VmFunction* vmFunction;
+	//Or C code written by the transpiler and compiled ahead of time
+	const struct NativeFunction* native;
+	//Functions of the tree evaluator, see analyzeCaptures
+	bool freesFrame;
+	//env holds the values of a flat closure whose calls all free their frame. Nothing else refers
+	//to it, it goes back onto the frame stack when the GC collects the function
+	bool ownsEnv;
 };
 
 struct ObjectList {
@@ -33,6 +54,14 @@ struct ObjectList {
 	struct Object** objects;
 };
 
+//Emitted once per function literal by the transpiler
+struct NativeFunction {
+	struct Object* (*entry)(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
+	//The literal as writeObject prints it
+	const char* text;
+	size_t parameterCount;
+};
+
 union ObjectVal {
 	bool boolean;
 	int64_t integer;
@@ -43,7 +72,7 @@ union ObjectVal {
 	//Builtin fn pointer that returns object
 	struct Object* (*builtin) (struct ObjectList* args, struct MonkeyGC* gc);
 	//Array
-	struct ObjectList arr;
+	struct ArrayObject arr;
 };
 
 struct Object {
@@ -62,9 +91,14 @@ extern struct Object TrueObj;
 extern struct Object FalseObj;
 
 struct Object* createObject(struct MonkeyGC* garbageCollector, enum ObjectType type);
+//Not tracked by the GC and never collected, the owner frees it with freeObject
+struct Object* createImmortalObject(enum ObjectType type);
 void freeObject(struct Object* obj);
+//Caller frees the returned string
 char* inspectObject(const struct Object* obj);
+void writeObject(struct Writer* writer, const struct Object* obj);
 const char* objectTypeToStr(const enum ObjectType type);
 struct Object* nativeBoolToBoolObj(bool input);
 bool isTruthy(struct Object* obj);
-bool isError(struct Object* obj);
\ No newline at end of file
+bool isError(struct Object* obj);
+size_t functionParameterCount(const struct Object* fn);
\ No newline at end of file
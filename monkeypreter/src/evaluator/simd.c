@@ -0,0 +1,316 @@
+#include "simd.h"
+#include <stdbool.h>
+#include "../util/cpu_features.h"
+
+#ifdef MONKEY_X64
+#include <immintrin.h>
+#endif
+
+struct SimdKernels {
+	int64_t(*sum) (const int64_t* values, size_t count);
+	int64_t(*min) (const int64_t* values, size_t count);
+	int64_t(*max) (const int64_t* values, size_t count);
+	int64_t(*dot) (const int64_t* left, const int64_t* right, size_t count);
+	void (*add) (int64_t* dst, const int64_t* left, const int64_t* right, size_t count);
+	void (*mul) (int64_t* dst, const int64_t* left, const int64_t* right, size_t count);
+	void (*fillRange) (int64_t* dst, int64_t start, size_t count);
+};
+
+static struct SimdKernels kernels;
+static bool kernelsReady = false;
+
+//Scalar fallbacks, also used for the leftovers of the vector loops.
+//Unsigned math so overflow wraps instead of being undefined
+static int64_t sumScalar(const int64_t* values, size_t count) {
+	uint64_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		total += (uint64_t)values[i];
+	}
+	return (int64_t)total;
+}
+
+static int64_t minScalar(const int64_t* values, size_t count) {
+	int64_t result = values[0];
+	for (size_t i = 1; i < count; i++) {
+		result = values[i] < result ? values[i] : result;
+	}
+	return result;
+}
+
+static int64_t maxScalar(const int64_t* values, size_t count) {
+	int64_t result = values[0];
+	for (size_t i = 1; i < count; i++) {
+		result = values[i] > result ? values[i] : result;
+	}
+	return result;
+}
+
+static int64_t dotScalar(const int64_t* left, const int64_t* right, size_t count) {
+	uint64_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		total += (uint64_t)left[i] * (uint64_t)right[i];
+	}
+	return (int64_t)total;
+}
+
+static void addScalar(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = (int64_t)((uint64_t)left[i] + (uint64_t)right[i]);
+	}
+}
+
+static void mulScalar(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = (int64_t)((uint64_t)left[i] * (uint64_t)right[i]);
+	}
+}
+
+static void fillRangeScalar(int64_t* dst, int64_t start, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = (int64_t)((uint64_t)start + i);
+	}
+}
+
+#ifdef MONKEY_X64
+
+//SSE2 is part of the x64 baseline. No 64 bit compare before SSE4.2, so min and max stay scalar here
+static int64_t sumSSE2(const int64_t* values, size_t count) {
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i*)(values + i)));
+	}
+
+	int64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return (int64_t)((uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)sumScalar(values + i, count - i));
+}
+
+//Low 64 bits of a 64x64 multiply from 32x32 partial products:
+//lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32)
+static __m128i mulLow64SSE2(__m128i a, __m128i b) {
+	const __m128i low = _mm_mul_epu32(a, b);
+	const __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+	return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+}
+
+static int64_t dotSSE2(const int64_t* left, const int64_t* right, size_t count) {
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(left + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(right + i));
+		acc = _mm_add_epi64(acc, mulLow64SSE2(a, b));
+	}
+
+	int64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return (int64_t)((uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)dotScalar(left + i, right + i, count - i));
+}
+
+static void addSSE2(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(left + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(right + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi64(a, b));
+	}
+	addScalar(dst + i, left + i, right + i, count - i);
+}
+
+static void mulSSE2(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(left + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(right + i));
+		_mm_storeu_si128((__m128i*)(dst + i), mulLow64SSE2(a, b));
+	}
+	mulScalar(dst + i, left + i, right + i, count - i);
+}
+
+static void fillRangeSSE2(int64_t* dst, int64_t start, size_t count) {
+	__m128i current = _mm_set_epi64x(start + 1, start);
+	const __m128i step = _mm_set1_epi64x(2);
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		_mm_storeu_si128((__m128i*)(dst + i), current);
+		current = _mm_add_epi64(current, step);
+	}
+	fillRangeScalar(dst + i, (int64_t)((uint64_t)start + i), count - i);
+}
+
+MONKEY_TARGET_AVX2 static int64_t sumAVX2(const int64_t* values, size_t count) {
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i*)(values + i)));
+	}
+
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	uint64_t total = (uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)lanes[2] + (uint64_t)lanes[3];
+	return (int64_t)(total + (uint64_t)sumScalar(values + i, count - i));
+}
+
+MONKEY_TARGET_AVX2 static int64_t minAVX2(const int64_t* values, size_t count) {
+	if (count < 4) {
+		return minScalar(values, count);
+	}
+
+	__m256i acc = _mm256_loadu_si256((const __m256i*)values);
+	size_t i = 4;
+	for (; i + 4 <= count; i += 4) {
+		const __m256i next = _mm256_loadu_si256((const __m256i*)(values + i));
+		acc = _mm256_blendv_epi8(acc, next, _mm256_cmpgt_epi64(acc, next));
+	}
+
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	int64_t result = minScalar(lanes, 4);
+	if (i < count) {
+		const int64_t rest = minScalar(values + i, count - i);
+		result = rest < result ? rest : result;
+	}
+	return result;
+}
+
+MONKEY_TARGET_AVX2 static int64_t maxAVX2(const int64_t* values, size_t count) {
+	if (count < 4) {
+		return maxScalar(values, count);
+	}
+
+	__m256i acc = _mm256_loadu_si256((const __m256i*)values);
+	size_t i = 4;
+	for (; i + 4 <= count; i += 4) {
+		const __m256i next = _mm256_loadu_si256((const __m256i*)(values + i));
+		acc = _mm256_blendv_epi8(acc, next, _mm256_cmpgt_epi64(next, acc));
+	}
+
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	int64_t result = maxScalar(lanes, 4);
+	if (i < count) {
+		const int64_t rest = maxScalar(values + i, count - i);
+		result = rest > result ? rest : result;
+	}
+	return result;
+}
+
+MONKEY_TARGET_AVX2 static __m256i mulLow64AVX2(__m256i a, __m256i b) {
+	const __m256i low = _mm256_mul_epu32(a, b);
+	const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+MONKEY_TARGET_AVX2 static int64_t dotAVX2(const int64_t* left, const int64_t* right, size_t count) {
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(left + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(right + i));
+		acc = _mm256_add_epi64(acc, mulLow64AVX2(a, b));
+	}
+
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	uint64_t total = (uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)lanes[2] + (uint64_t)lanes[3];
+	return (int64_t)(total + (uint64_t)dotScalar(left + i, right + i, count - i));
+}
+
+MONKEY_TARGET_AVX2 static void addAVX2(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(left + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(right + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi64(a, b));
+	}
+	addScalar(dst + i, left + i, right + i, count - i);
+}
+
+MONKEY_TARGET_AVX2 static void mulAVX2(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(left + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(right + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), mulLow64AVX2(a, b));
+	}
+	mulScalar(dst + i, left + i, right + i, count - i);
+}
+
+MONKEY_TARGET_AVX2 static void fillRangeAVX2(int64_t* dst, int64_t start, size_t count) {
+	__m256i current = _mm256_add_epi64(_mm256_set1_epi64x(start), _mm256_set_epi64x(3, 2, 1, 0));
+	const __m256i step = _mm256_set1_epi64x(4);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		_mm256_storeu_si256((__m256i*)(dst + i), current);
+		current = _mm256_add_epi64(current, step);
+	}
+	fillRangeScalar(dst + i, (int64_t)((uint64_t)start + i), count - i);
+}
+
+#endif
+
+static void initKernels(void) {
+	kernels.sum = sumScalar;
+	kernels.min = minScalar;
+	kernels.max = maxScalar;
+	kernels.dot = dotScalar;
+	kernels.add = addScalar;
+	kernels.mul = mulScalar;
+	kernels.fillRange = fillRangeScalar;
+
+#ifdef MONKEY_X64
+	kernels.sum = sumSSE2;
+	kernels.dot = dotSSE2;
+	kernels.add = addSSE2;
+	kernels.mul = mulSSE2;
+	kernels.fillRange = fillRangeSSE2;
+
+	if (cpuHasAVX2()) {
+		kernels.sum = sumAVX2;
+		kernels.min = minAVX2;
+		kernels.max = maxAVX2;
+		kernels.dot = dotAVX2;
+		kernels.add = addAVX2;
+		kernels.mul = mulAVX2;
+		kernels.fillRange = fillRangeAVX2;
+	}
+#endif
+
+	kernelsReady = true;
+}
+
+int64_t sumIntegers(const int64_t* values, size_t count) {
+	if (!kernelsReady) initKernels();
+	return kernels.sum(values, count);
+}
+
+int64_t minIntegers(const int64_t* values, size_t count) {
+	if (!kernelsReady) initKernels();
+	return kernels.min(values, count);
+}
+
+int64_t maxIntegers(const int64_t* values, size_t count) {
+	if (!kernelsReady) initKernels();
+	return kernels.max(values, count);
+}
+
+int64_t dotIntegers(const int64_t* left, const int64_t* right, size_t count) {
+	if (!kernelsReady) initKernels();
+	return kernels.dot(left, right, count);
+}
+
+void addIntegers(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	if (!kernelsReady) initKernels();
+	kernels.add(dst, left, right, count);
+}
+
+void mulIntegers(int64_t* dst, const int64_t* left, const int64_t* right, size_t count) {
+	if (!kernelsReady) initKernels();
+	kernels.mul(dst, left, right, count);
+}
+
+void fillIntegerRange(int64_t* dst, int64_t start, size_t count) {
+	if (!kernelsReady) initKernels();
+	kernels.fillRange(dst, start, count);
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+//Integer kernels for packed arrays, picks AVX2, SSE2 or scalar code on first use.
+//Arithmetic wraps around like the evaluator's int64 math
+int64_t sumIntegers(const int64_t* values, size_t count);
+//count must be > 0
+int64_t minIntegers(const int64_t* values, size_t count);
+int64_t maxIntegers(const int64_t* values, size_t count);
+int64_t dotIntegers(const int64_t* left, const int64_t* right, size_t count);
+void addIntegers(int64_t* dst, const int64_t* left, const int64_t* right, size_t count);
+void mulIntegers(int64_t* dst, const int64_t* left, const int64_t* right, size_t count);
+void fillIntegerRange(int64_t* dst, int64_t start, size_t count);
@@ -0,0 +1,212 @@
+#include "sort.h"
+#include <string.h>
+#include "object.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+//Below this insertion sort beats the radix passes
+#define SMALL_SORT 32
+
+static void insertionSortIntegers(int64_t* values, size_t count) {
+	for (size_t i = 1; i < count; i++) {
+		int64_t value = values[i];
+		size_t j = i;
+		for (; j > 0 && values[j - 1] > value; j--) {
+			values[j] = values[j - 1];
+		}
+		values[j] = value;
+	}
+}
+
+void sortIntegers(int64_t* values, int64_t* scratch, size_t count) {
+	if (count < SMALL_SORT) {
+		insertionSortIntegers(values, count);
+		return;
+	}
+
+	//Flipping the sign bit makes the unsigned byte order match the signed order
+	const uint64_t signBit = (uint64_t)1 << 63;
+	uint64_t* keys = (uint64_t*)values;
+	uint64_t* buffer = (uint64_t*)scratch;
+
+	//Histograms for every pass are built in one read of the input
+	size_t counts[RADIX_PASSES][RADIX_BUCKETS];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < count; i++) {
+		keys[i] ^= signBit;
+		for (int pass = 0; pass < RADIX_PASSES; pass++) {
+			counts[pass][(keys[i] >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+		}
+	}
+
+	uint64_t* src = keys;
+	uint64_t* dst = buffer;
+	for (int pass = 0; pass < RADIX_PASSES; pass++) {
+		size_t* bucket = counts[pass];
+		int shift = pass * RADIX_BITS;
+
+		//Every key has the same byte here, the pass would not move anything
+		if (bucket[(src[0] >> shift) & (RADIX_BUCKETS - 1)] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++) {
+			size_t bucketSize = bucket[b];
+			bucket[b] = offset;
+			offset += bucketSize;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			dst[bucket[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+		}
+
+		uint64_t* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != keys) {
+		memcpy(keys, src, count * sizeof(uint64_t));
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		keys[i] ^= signBit;
+	}
+}
+
+static void swapObjects(struct Object** items, size_t a, size_t b) {
+	struct Object* tmp = items[a];
+	items[a] = items[b];
+	items[b] = tmp;
+}
+
+//Character at depth, strings are NUL terminated so depth never runs past the end of a compared string
+static int charAt(const struct Object* obj, size_t depth) {
+	return (unsigned char)obj->value.string[depth];
+}
+
+//Bentley-Sedgewick multikey quicksort: 3-way partition on one character, only the equal part goes one character deeper
+static void multikeySort(struct Object** items, size_t count, size_t depth) {
+	while (count > 1) {
+		if (count < SMALL_SORT) {
+			for (size_t i = 1; i < count; i++) {
+				for (size_t j = i; j > 0 && strcmp(items[j - 1]->value.string + depth, items[j]->value.string + depth) > 0; j--) {
+					swapObjects(items, j, j - 1);
+				}
+			}
+			return;
+		}
+
+		swapObjects(items, 0, count / 2);
+		int pivot = charAt(items[0], depth);
+
+		//items[0, lt) < pivot, items[lt, i) == pivot, items(gt, count) > pivot
+		size_t lt = 0;
+		size_t i = 1;
+		size_t gt = count - 1;
+		while (i <= gt) {
+			int c = charAt(items[i], depth);
+			if (c < pivot) {
+				swapObjects(items, lt++, i++);
+			}
+			else if (c > pivot) {
+				swapObjects(items, i, gt--);
+			}
+			else {
+				i++;
+			}
+		}
+
+		multikeySort(items, lt, depth);
+		multikeySort(items + gt + 1, count - gt - 1, depth);
+
+		//Equal part ended on the terminator, every string in it is identical
+		if (pivot == 0) {
+			return;
+		}
+
+		items += lt;
+		count = gt + 1 - lt;
+		depth++;
+	}
+}
+
+void sortStringObjects(struct Object** items, size_t count) {
+	multikeySort(items, count, 0);
+}
+
+//Binary insertion keeps comparisons at log2(n) per element on the small runs
+static bool binaryInsertionSort(struct Object** items, size_t count, ObjectLessFn less, void* ctx) {
+	for (size_t i = 1; i < count; i++) {
+		struct Object* item = items[i];
+
+		//Upper bound, equal items stay in front for stability
+		size_t lo = 0;
+		size_t hi = i;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			int result = less(ctx, item, items[mid]);
+			if (result < 0) {
+				return false;
+			}
+
+			if (result) {
+				hi = mid;
+			}
+			else {
+				lo = mid + 1;
+			}
+		}
+
+		memmove(items + lo + 1, items + lo, (i - lo) * sizeof(struct Object*));
+		items[lo] = item;
+	}
+
+	return true;
+}
+
+bool sortObjects(struct Object** items, struct Object** scratch, size_t count, ObjectLessFn less, void* ctx) {
+	if (count <= 8) {
+		return binaryInsertionSort(items, count, less, ctx);
+	}
+
+	size_t half = count / 2;
+	if (!sortObjects(items, scratch, half, less, ctx) || !sortObjects(items + half, scratch, count - half, less, ctx)) {
+		return false;
+	}
+
+	//Halves already in order, one call instead of a merge
+	int result = less(ctx, items[half], items[half - 1]);
+	if (result <= 0) {
+		return result == 0;
+	}
+
+	//Right half entirely before the left one (reversed input), rotate instead of merging
+	result = less(ctx, items[count - 1], items[0]);
+	if (result < 0) {
+		return false;
+	}
+
+	memcpy(scratch, items, half * sizeof(struct Object*));
+	if (result) {
+		memmove(items, items + half, (count - half) * sizeof(struct Object*));
+		memcpy(items + count - half, scratch, half * sizeof(struct Object*));
+		return true;
+	}
+
+	size_t left = 0;
+	size_t right = half;
+	size_t out = 0;
+	while (left < half && right < count) {
+		result = less(ctx, items[right], scratch[left]);
+		if (result < 0) {
+			return false;
+		}
+		items[out++] = result ? items[right++] : scratch[left++];
+	}
+
+	memcpy(items + out, scratch + left, (half - left) * sizeof(struct Object*));
+	return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+struct Object;
+
+//LSD radix sort, scratch must hold count values
+void sortIntegers(int64_t* values, int64_t* scratch, size_t count);
+//Multikey quicksort on the contents of OBJ_STRING objects
+void sortStringObjects(struct Object** items, size_t count);
+
+//Returns 1 if a must come before b, 0 if not and -1 to abort the sort
+typedef int (*ObjectLessFn) (void* ctx, struct Object* a, struct Object* b);
+
+//Stable merge sort that tries to call less as few times as possible, scratch must hold count / 2 + 1 items.
+//Returns false if less aborted, the contents of items are unspecified then
+bool sortObjects(struct Object** items, struct Object** scratch, size_t count, ObjectLessFn less, void* ctx);
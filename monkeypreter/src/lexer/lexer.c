@@ -1,6 +1,29 @@
 #include "lexer.h"
-#include <ctype.h>
+#include <stdint.h>
 #include <string.h>
+#include "../util/cpu_features.h"
+
+#ifdef MONKEY_X64
+#include <immintrin.h>
+#endif
+
+#define CHAR_LETTER 1
+#define CHAR_DIGIT 2
+#define CHAR_SPACE 4
+
+//Character classes for ASCII, everything above 127 is 0
+static const unsigned char charClasses[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 4, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+};
+
+#define CHAR_CLASS(ch) charClasses[(unsigned char)(ch)]
 
 void readChar(Lexer* lexer);
 void readIdentifier(Lexer* lexer, Token* token);
@@ -8,29 +31,205 @@ bool isLetter(char ch);
 void readNumber(Lexer* lexer, Token* token);
 char peekChar(const Lexer* lexer);
 void readString(Lexer* lexer, char* str);
+#ifdef MONKEY_X64
+static bool lexerUsesAVX2(void);
+#endif
 
 Lexer createLexer(const char* input)
 {
-	Lexer l = { input, strlen(input),-1, 0, input[0] };
+	return createLexerWithLength(input, strlen(input));
+}
+
+Lexer createLexerWithLength(const char* input, size_t inputLength)
+{
+#ifdef MONKEY_X64
+	//Pick the scan kernels now, before lexers on other threads can race on it
+	lexerUsesAVX2();
+#endif
+
+	Lexer l = { input, inputLength, 0, 0, 0 };
 	readChar(&l);
 	return l;
 }
 
+//Characters checked one by one before a scan switches to the vector loops
+#define SCAN_HEAD 8
+
+#ifdef MONKEY_X64
+//Vector versions of the class table, one byte lane per character.
+//Range checks use the signed compare trick: x + (128 - low) < -128 + count <=> low <= x < low + count
+static __m128i classMask16(__m128i v, unsigned char charClass) {
+	if (charClass == CHAR_LETTER) {
+		const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		const __m128i shifted = _mm_add_epi8(lower, _mm_set1_epi8((char)(128 - 'a')));
+		const __m128i alpha = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + 26)));
+		return _mm_or_si128(alpha, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+	}
+
+	if (charClass == CHAR_DIGIT) {
+		const __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(128 - '0')));
+		return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + 10)));
+	}
+
+	const __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+	const __m128i newlines = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+	return _mm_or_si128(spaces, newlines);
+}
+
+MONKEY_TARGET_AVX2 static __m256i classMask32(__m256i v, unsigned char charClass) {
+	if (charClass == CHAR_LETTER) {
+		const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		const __m256i shifted = _mm256_add_epi8(lower, _mm256_set1_epi8((char)(128 - 'a')));
+		const __m256i alpha = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 26)), shifted);
+		return _mm256_or_si256(alpha, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+	}
+
+	if (charClass == CHAR_DIGIT) {
+		const __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(128 - '0')));
+		return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 10)), shifted);
+	}
+
+	const __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+	const __m256i newlines = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+	return _mm256_or_si256(spaces, newlines);
+}
+
+//Both return how many whole blocks of start[0, limit) matched, or the exact run length once a block does not
+static size_t scanClassSSE2(const char* start, size_t limit, unsigned char charClass) {
+	size_t length = 0;
+	for (; length + 16 <= limit; length += 16) {
+		const __m128i block = _mm_loadu_si128((const __m128i*)(start + length));
+		const uint32_t misses = ~(uint32_t)_mm_movemask_epi8(classMask16(block, charClass)) & 0xFFFF;
+		if (misses) {
+			return length + countTrailingZeros(misses);
+		}
+	}
+	return length;
+}
+
+MONKEY_TARGET_AVX2 static size_t scanClassAVX2(const char* start, size_t limit, unsigned char charClass) {
+	size_t length = 0;
+	for (; length + 32 <= limit; length += 32) {
+		const __m256i block = _mm256_loadu_si256((const __m256i*)(start + length));
+		const uint32_t misses = ~(uint32_t)_mm256_movemask_epi8(classMask32(block, charClass));
+		if (misses) {
+			return length + countTrailingZeros(misses);
+		}
+	}
+	return length;
+}
+
+//Offset of the first '"' or NUL in the whole blocks of start[0, limit), limit rounded down if there is none
+static size_t findStringEndSSE2(const char* start, size_t limit) {
+	size_t length = 0;
+	for (; length + 16 <= limit; length += 16) {
+		const __m128i block = _mm_loadu_si128((const __m128i*)(start + length));
+		const __m128i ends = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')), _mm_cmpeq_epi8(block, _mm_setzero_si128()));
+		const uint32_t hits = (uint32_t)_mm_movemask_epi8(ends);
+		if (hits) {
+			return length + countTrailingZeros(hits);
+		}
+	}
+	return length;
+}
+
+MONKEY_TARGET_AVX2 static size_t findStringEndAVX2(const char* start, size_t limit) {
+	size_t length = 0;
+	for (; length + 32 <= limit; length += 32) {
+		const __m256i block = _mm256_loadu_si256((const __m256i*)(start + length));
+		const __m256i ends = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(block, _mm256_setzero_si256()));
+		const uint32_t hits = (uint32_t)_mm256_movemask_epi8(ends);
+		if (hits) {
+			return length + countTrailingZeros(hits);
+		}
+	}
+	return length;
+}
+
+//0 = not checked yet, 1 = SSE2, 2 = AVX2
+static int vectorLevel = 0;
+
+static bool lexerUsesAVX2(void) {
+	if (vectorLevel == 0) {
+		vectorLevel = cpuHasAVX2() ? 2 : 1;
+	}
+	return vectorLevel == 2;
+}
+#endif
+
+//Rest of a long run, starting at `length` once the short prefix matched
+static size_t scanClassWide(const char* start, size_t length, size_t limit, unsigned char charClass) {
+#ifdef MONKEY_X64
+	length += lexerUsesAVX2() ? scanClassAVX2(start + length, limit - length, charClass) : scanClassSSE2(start + length, limit - length, charClass);
+#endif
+
+	//Leftovers shorter than a block, stops right away if the vector loop found the end
+	while (length < limit && (CHAR_CLASS(start[length]) & charClass)) {
+		length++;
+	}
+	return length;
+}
+
+//Length of the run of `charClass` characters starting at the current char, at most maxLength.
+//Most runs are a few characters long, so only go wide once a whole short prefix matched
+static inline size_t scanClass(const Lexer* lexer, unsigned char charClass, size_t maxLength) {
+	const char* start = lexer->input + lexer->position;
+	const size_t available = lexer->inputLength - lexer->position;
+	const size_t limit = available < maxLength ? available : maxLength;
+	const size_t head = limit < SCAN_HEAD ? limit : SCAN_HEAD;
+
+	size_t length = 0;
+	while (length < head && (CHAR_CLASS(start[length]) & charClass)) {
+		length++;
+	}
+
+	return length == SCAN_HEAD ? scanClassWide(start, length, limit, charClass) : length;
+}
+
+//Offset of the closing '"' (or NUL / end of input) of the string starting at `start`
+static size_t findStringEnd(const char* start, size_t available) {
+	const size_t head = available < SCAN_HEAD ? available : SCAN_HEAD;
+	size_t length = 0;
+	while (length < head && start[length] != '"' && start[length] != '\0') {
+		length++;
+	}
+
+#ifdef MONKEY_X64
+	if (length == SCAN_HEAD) {
+		length += lexerUsesAVX2() ? findStringEndAVX2(start + length, available - length) : findStringEndSSE2(start + length, available - length);
+	}
+#endif
+
+	while (length < available && start[length] != '"' && start[length] != '\0') {
+		length++;
+	}
+	return length;
+}
+
+//Moves the current char `count` characters forward
+static void skipChars(Lexer* lexer, size_t count) {
+	lexer->readPosition = lexer->position + count;
+	readChar(lexer);
+}
+
 void skipWhiteSpace(Lexer* lexer) {
-	char ch = lexer->ch;
-	while(ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
-	{
-		readChar(lexer);
-		ch = lexer->ch;
+	if (CHAR_CLASS(lexer->ch) & CHAR_SPACE) {
+		skipChars(lexer, scanClass(lexer, CHAR_SPACE, SIZE_MAX));
 	}
 }
 
 Token nextToken(Lexer* lexer) {
+	size_t literalStart;
+	return nextTokenAt(lexer, &literalStart);
+}
+
+Token nextTokenAt(Lexer* lexer, size_t* literalStart) {
 	Token token;
 	token.type = TokenTypeIllegal;
 	token.literal[0] = '\0';
 
 	skipWhiteSpace(lexer);
+	*literalStart = lexer->position;
 
 	switch (lexer->ch)
 	{
@@ -124,6 +323,7 @@ Token nextToken(Lexer* lexer) {
 			break;
 		case '"':
 			token.type = TokenTypeString;
+			*literalStart += 1;
 			readString(lexer, token.literal);
 			break;
 		case '[':
@@ -155,7 +355,7 @@ Token nextToken(Lexer* lexer) {
 				return token;
 			}
 
-			if (isdigit(lexer->ch)) {
+			if (CHAR_CLASS(lexer->ch) & CHAR_DIGIT) {
 				readNumber(lexer, &token);
 				return token;
 			}
@@ -181,43 +381,30 @@ void readChar(Lexer* lexer)
 		lexer->ch = lexer->input[lexer->readPosition];
 	}
 
-	lexer->position = (int) lexer->readPosition;
+	lexer->position = lexer->readPosition;
 	lexer->readPosition++;
 }
 
 //Fill literal in token
 void readIdentifier(Lexer* lexer, Token* token) {
-	//Set literal
-	size_t i = 0;
-	while(isLetter(lexer->ch) && i < MAX_IDENT_LENGTH - 1)
-	{
-		token->literal[i] = lexer->ch;
-		i++;
-		readChar(lexer);
-	}
-	token->literal[i] = '\0';
-	//Sets type
-	getIdentType(token);
+	const size_t length = scanClass(lexer, CHAR_LETTER, MAX_IDENT_LENGTH - 1);
+	memcpy(token->literal, lexer->input + lexer->position, length);
+	token->literal[length] = '\0';
+	token->type = lookupIdentType(token->literal, length);
+	skipChars(lexer, length);
 }
 
 //Fill literal in token number
 void readNumber(Lexer* lexer, Token* token) {
-	//Set literal
-	size_t i = 0;
-	while (isdigit(lexer->ch) && i < MAX_IDENT_LENGTH - 1)
-	{
-		token->literal[i] = lexer->ch;
-		i++;
-		readChar(lexer);
-	}
-	token->literal[i] = '\0';
-
-	//Sets type
+	const size_t length = scanClass(lexer, CHAR_DIGIT, MAX_IDENT_LENGTH - 1);
+	memcpy(token->literal, lexer->input + lexer->position, length);
+	token->literal[length] = '\0';
 	token->type = TokenTypeInt;
+	skipChars(lexer, length);
 }
 
 bool isLetter(const char ch) {
-	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch == '_');
+	return CHAR_CLASS(ch) & CHAR_LETTER;
 }
 
 char peekChar(const Lexer* lexer) {
@@ -228,16 +415,16 @@ char peekChar(const Lexer* lexer) {
 	return lexer->input[lexer->readPosition];
 }
 
+//Strings longer than a literal are truncated, the rest is skipped up to the closing quote
 void readString(Lexer* lexer, char* str) {
-	int index = 0;
-	while(true) {
-		readChar(lexer);
-		if (lexer->ch == '"' || lexer->ch == 0)
-			break;
+	const size_t contentStart = lexer->position + 1;
+	const size_t available = contentStart < lexer->inputLength ? lexer->inputLength - contentStart : 0;
+	const size_t length = findStringEnd(lexer->input + contentStart, available);
 
-		str[index] = lexer->ch;
-		index++;
-	}
+	const size_t copied = length < MAX_IDENT_LENGTH - 1 ? length : MAX_IDENT_LENGTH - 1;
+	memcpy(str, lexer->input + contentStart, copied);
+	str[copied] = '\0';
 
-	str[index] = '\0';
+	//Current char ends on the closing quote (or end of input), nextToken steps over it
+	skipChars(lexer, length + 1);
 }
\ No newline at end of file
@@ -7,10 +7,14 @@
 typedef struct Lexer {
 	const char* input;
 	size_t inputLength;
-	int position; //current position (points to current char)
+	size_t position; //current position (points to current char)
 	size_t readPosition; //current reading position 
 	char ch; //current char
 } Lexer;
 
 Lexer createLexer(const char* input);
-Token nextToken(Lexer* lexer);
\ No newline at end of file
+//Input does not need to be NUL terminated (memory mapped files)
+Lexer createLexerWithLength(const char* input, size_t inputLength);
+Token nextToken(Lexer* lexer);
+//Also reports where the literal starts in the input (inside the quotes for strings)
+Token nextTokenAt(Lexer* lexer, size_t* literalStart);
\ No newline at end of file
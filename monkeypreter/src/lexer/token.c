@@ -13,32 +13,42 @@ const char* tokenTypeToStr(TokenType type) {
 	return tokenNames[type];
 }
 
-//Get type based on literal
-void getIdentType(Token* t) {
+//Perfect hash over the keywords: (length + 2 * first + last) & 7 has no collisions,
+//found by brute force search over small multipliers. Slot 5 is unused
+#define KEYWORD_SLOTS 8
 
-	if (strcmp(t->literal, "let") == 0) {
-		t->type = TokenTypeLet;
-	}
-	else if (strcmp(t->literal, "fn") == 0) {
-		t->type = TokenTypeFunction;
-	}
-	else if (strcmp(t->literal, "true") == 0) {
-		t->type = TokenTypeTrue;
-	}
-	else if (strcmp(t->literal, "false") == 0) {
-		t->type = TokenTypeFalse;
-	}
-	else if (strcmp(t->literal, "if") == 0) {
-		t->type = TokenTypeIf;
-	}
-	else if (strcmp(t->literal, "else") == 0) {
-		t->type = TokenTypeElse;
-	}
-	else if (strcmp(t->literal, "return") == 0) {
-		t->type = TokenTypeReturn;
+struct Keyword {
+	const char* literal;
+	size_t length;
+	TokenType type;
+};
+
+static const struct Keyword keywords[KEYWORD_SLOTS] = {
+	{"return", 6, TokenTypeReturn},
+	{"true", 4, TokenTypeTrue},
+	{"if", 2, TokenTypeIf},
+	{"else", 4, TokenTypeElse},
+	{"fn", 2, TokenTypeFunction},
+	{NULL, 0, TokenTypeIdent},
+	{"false", 5, TokenTypeFalse},
+	{"let", 3, TokenTypeLet},
+};
+
+TokenType lookupIdentType(const char* literal, size_t length) {
+	if (length == 0) {
+		return TokenTypeIdent;
 	}
-	else
-	{
-		t->type = TokenTypeIdent;
+
+	const size_t slot = (length + 2 * (unsigned char)literal[0] + (unsigned char)literal[length - 1]) & (KEYWORD_SLOTS - 1);
+	const struct Keyword* keyword = &keywords[slot];
+	if (keyword->length == length && memcmp(keyword->literal, literal, length) == 0) {
+		return keyword->type;
 	}
-}
\ No newline at end of file
+
+	return TokenTypeIdent;
+}
+
+//Get type based on literal
+void getIdentType(Token* t) {
+	t->type = lookupIdentType(t->literal, strlen(t->literal));
+}
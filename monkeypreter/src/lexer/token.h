@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 
 #define MAX_IDENT_LENGTH 64
 #define MAX_STRING_LENGTH 1024
@@ -45,4 +46,5 @@ typedef struct Token
 } Token;
 
 const char* tokenTypeToStr(TokenType type);
+TokenType lookupIdentType(const char* literal, size_t length);
 void getIdentType(Token* t);
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "token_buffer.h"
+#include <stdio.h>
+#include <string.h>
+
+static void growTokenBuffer(TokenBuffer* buffer) {
+	buffer->cap *= 2;
+	uint8_t* types = (uint8_t*)realloc(buffer->types, buffer->cap * sizeof *buffer->types);
+	size_t* starts = (size_t*)realloc(buffer->starts, buffer->cap * sizeof *buffer->starts);
+	uint8_t* lengths = (uint8_t*)realloc(buffer->lengths, buffer->cap * sizeof *buffer->lengths);
+
+	if (!types || !starts || !lengths) {
+		perror("realloc (grow token buffer) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	buffer->types = types;
+	buffer->starts = starts;
+	buffer->lengths = lengths;
+}
+
+TokenBuffer createTokenBuffer(Lexer* lexer) {
+	TokenBuffer buffer;
+	buffer.input = lexer->input;
+	buffer.size = 0;
+	//Roughly one token per 4 bytes of source
+	buffer.cap = lexer->inputLength / 4 + 16;
+	buffer.types = (uint8_t*)malloc(buffer.cap * sizeof *buffer.types);
+	buffer.starts = (size_t*)malloc(buffer.cap * sizeof *buffer.starts);
+	buffer.lengths = (uint8_t*)malloc(buffer.cap * sizeof *buffer.lengths);
+
+	if (!buffer.types || !buffer.starts || !buffer.lengths) {
+		perror("malloc (create token buffer) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while (true) {
+		if (buffer.size == buffer.cap) {
+			growTokenBuffer(&buffer);
+		}
+
+		size_t start;
+		const Token token = nextTokenAt(lexer, &start);
+		buffer.types[buffer.size] = (uint8_t)token.type;
+		buffer.starts[buffer.size] = start;
+		buffer.lengths[buffer.size] = (uint8_t)strlen(token.literal);
+		buffer.size++;
+
+		if (token.type == TokenTypeEof) {
+			break;
+		}
+	}
+
+	return buffer;
+}
+
+void freeTokenBuffer(TokenBuffer* buffer) {
+	free(buffer->types);
+	free(buffer->starts);
+	free(buffer->lengths);
+	buffer->size = 0;
+	buffer->cap = 0;
+}
+
+Token getBufferedToken(const TokenBuffer* buffer, size_t index) {
+	//Last token is always EOF
+	if (index >= buffer->size) {
+		index = buffer->size - 1;
+	}
+
+	Token token;
+	token.type = (TokenType)buffer->types[index];
+	memcpy(token.literal, buffer->input + buffer->starts[index], buffer->lengths[index]);
+	token.literal[buffer->lengths[index]] = '\0';
+	return token;
+}
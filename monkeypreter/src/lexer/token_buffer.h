@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include "lexer.h"
+
+//All tokens of an input lexed up front, one array per field.
+//Literals are never copied, they are slices of the input
+typedef struct TokenBuffer {
+	const char* input;
+	size_t size;
+	size_t cap;
+	uint8_t* types;
+	size_t* starts;
+	//Literals are shorter than MAX_IDENT_LENGTH
+	uint8_t* lengths;
+} TokenBuffer;
+
+//Lexes everything up to and including EOF, the input has to outlive the buffer
+TokenBuffer createTokenBuffer(Lexer* lexer);
+void freeTokenBuffer(TokenBuffer* buffer);
+//Indices past the end return the EOF token
+Token getBufferedToken(const TokenBuffer* buffer, size_t index);
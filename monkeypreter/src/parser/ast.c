@@ -1,14 +1,16 @@
 #include "ast.h"
 #include <stdio.h>
 #include <string.h>
+#include "../evaluator/object.h"
 
-#define MAX_PROGRAM_LEN 1000000
+//Initial capacity of string writers, they grow geometrically from there
+#define PROGRAM_STR_CAP 256
 
 //Internal declarations
 void freeStatements(struct Statement* stmts, size_t size);
 void freeExpression(struct Expression* expr);
-void statementToStr(char* str, const struct Statement* stmt);
-void exprStatementToStr(char* str, struct Expression* expr);
+void writeStatement(struct Writer* writer, const struct Statement* stmt);
+void writeExpression(struct Writer* writer, const struct Expression* expr);
 
 void freeProgram(Program* program) {
 	freeStatements(program->statements, program->size);
@@ -39,16 +41,16 @@ void freeExpression(struct Expression* expr) {
 			break;
 
 		case EXPR_IF: 
-			free(expr->ifelse.condition);
+			freeExpression(expr->ifelse.condition);
 			freeBlockStatement(expr->ifelse.consequence);
 			freeBlockStatement(expr->ifelse.alternative);
 			break;
 
 		case EXPR_FUNCTION:
-			//Hand over ownership to object
-			//GC will handle
-			//free(expr->function.parameters.values);
-			//freeBlockStatement(expr->function.body);
+			//Function objects share these, the AST has to outlive them
+			free(expr->function.parameters.values);
+			freeBlockStatement(expr->function.body);
+			free(expr->function.captures);
 			break;
 
 		case EXPR_CALL: 
@@ -79,7 +81,10 @@ void freeExpression(struct Expression* expr) {
 			break;
 
 	}
-	
+
+	if (expr->constant) {
+		freeObject(expr->constant);
+	}
 	free(expr);
 }
 
@@ -96,150 +101,155 @@ void freeBlockStatement(struct BlockStatement* bs) {
 
 
 char* programToStr(const Program* program) {
-	char* str = (char*) malloc(MAX_PROGRAM_LEN);
+	struct Writer writer = createStringWriter(PROGRAM_STR_CAP);
+	writeProgram(&writer, program);
+	return takeWriterString(&writer);
+}
 
-	if (!str) {
-		perror("malloc(programToStr) returned `NULL`");
-		return NULL;
-	}
+char* blockStatementToStr(const struct BlockStatement* bs) {
+	struct Writer writer = createStringWriter(PROGRAM_STR_CAP);
+	writeBlockStatement(&writer, bs);
+	return takeWriterString(&writer);
+}
 
-	//Init with NTC for strcat to look for when adding next string
-	str[0] = '\0';
+void printProgram(FILE* stream, const Program* program) {
+	char buffer[WRITER_CHUNK_SIZE];
+	struct Writer writer = createStreamWriter(stream, buffer, sizeof(buffer));
+	writeProgram(&writer, program);
+	freeWriter(&writer);
+}
 
+void writeProgram(struct Writer* writer, const Program* program) {
 	for (size_t i = 0; i < program->size; i++) {
-		statementToStr(str, &program->statements[i]);
-		//strcat_s(str, MAX_PROGRAM_LEN, "\n");
+		writeStatement(writer, &program->statements[i]);
 	}
-	return str;
 }
 
-void letStatementToStr(char* str, const struct Statement* stmt) {
-	strcat_s(str, MAX_PROGRAM_LEN, stmt->token.literal);
-	strcat_s(str, MAX_PROGRAM_LEN, " ");
-	strcat_s(str, MAX_PROGRAM_LEN, stmt->identifier.value);
-	strcat_s(str, MAX_PROGRAM_LEN, " = ");
-	exprStatementToStr(str, stmt->expr);
-	strcat_s(str, MAX_PROGRAM_LEN, ";");
+void writeLetStatement(struct Writer* writer, const struct Statement* stmt) {
+	writeStr(writer, stmt->token.literal);
+	writeChar(writer, ' ');
+	writeStr(writer, stmt->identifier.value);
+	writeStr(writer, " = ");
+	writeExpression(writer, stmt->expr);
+	writeChar(writer, ';');
 }
 
-void retStatementToStr(char* str, const struct Statement* stmt) {
-	strcat_s(str, MAX_PROGRAM_LEN, stmt->token.literal);
-	strcat_s(str, MAX_PROGRAM_LEN, " ");
-	exprStatementToStr(str, stmt->expr);
-	strcat_s(str, MAX_PROGRAM_LEN, ";");
+void writeRetStatement(struct Writer* writer, const struct Statement* stmt) {
+	writeStr(writer, stmt->token.literal);
+	writeChar(writer, ' ');
+	writeExpression(writer, stmt->expr);
+	writeChar(writer, ';');
 }
 
-void blockStatementToStr(char* str, const struct BlockStatement* bs) {
+void writeBlockStatement(struct Writer* writer, const struct BlockStatement* bs) {
 	for(size_t i = 0; i < bs->size; i++) {
-		statementToStr(str, &bs->statements[i]);
+		writeStatement(writer, &bs->statements[i]);
+	}
+}
+
+void writeExpressionList(struct Writer* writer, const struct ExpressionList* expressions) {
+	for (size_t i = 0; i < expressions->size; i++) {
+		if (i > 0) {
+			writeStr(writer, ", ");
+		}
+		writeExpression(writer, expressions->values[i]);
 	}
 }
 
-void exprStatementToStr(char* str, struct Expression* expr) {
+void writeExpression(struct Writer* writer, const struct Expression* expr) {
 	switch (expr->type) {
 		case EXPR_PREFIX:
-			strcat_s(str, MAX_PROGRAM_LEN, "(");
-			strcat_s(str, MAX_PROGRAM_LEN, expr->token.literal);
-			exprStatementToStr(str, expr->prefix.right);
-			strcat_s(str, MAX_PROGRAM_LEN, ")");
+			writeChar(writer, '(');
+			writeStr(writer, expr->token.literal);
+			writeExpression(writer, expr->prefix.right);
+			writeChar(writer, ')');
 			break;
 
 		case EXPR_INFIX:
-			strcat_s(str, MAX_PROGRAM_LEN, "(");
-			exprStatementToStr(str, expr->infix.left);
-			strcat_s(str, MAX_PROGRAM_LEN, " ");
-			strcat_s(str, MAX_PROGRAM_LEN, expr->token.literal);
-			strcat_s(str, MAX_PROGRAM_LEN, " ");
-			exprStatementToStr(str, expr->infix.right);
-			strcat_s(str, MAX_PROGRAM_LEN, ")");
+			writeChar(writer, '(');
+			writeExpression(writer, expr->infix.left);
+			writeChar(writer, ' ');
+			writeStr(writer, expr->token.literal);
+			writeChar(writer, ' ');
+			writeExpression(writer, expr->infix.right);
+			writeChar(writer, ')');
 			break;
 
 		case EXPR_IDENT:
-			strcat_s(str, MAX_PROGRAM_LEN, expr->ident.value);
+			writeStr(writer, expr->ident.value);
 			break;
 
 		case EXPR_INT:
 		case EXPR_BOOL:
 		case EXPR_STRING:
-			strcat_s(str, MAX_PROGRAM_LEN, expr->token.literal);
+			writeStr(writer, expr->token.literal);
 			break;
 
 		case EXPR_IF:
-			strcat_s(str, MAX_PROGRAM_LEN, "if");
-			exprStatementToStr(str, expr->ifelse.condition);
-			strcat_s(str, MAX_PROGRAM_LEN, " ");
-			blockStatementToStr(str, expr->ifelse.consequence);
+			writeStr(writer, "if");
+			writeExpression(writer, expr->ifelse.condition);
+			writeChar(writer, ' ');
+			writeBlockStatement(writer, expr->ifelse.consequence);
 			if(expr->ifelse.alternative) {
-				strcat_s(str, MAX_PROGRAM_LEN, "else");
-				blockStatementToStr(str, expr->ifelse.alternative);
+				writeStr(writer, "else");
+				writeBlockStatement(writer, expr->ifelse.alternative);
 			}
 			break;
 
 		case EXPR_FUNCTION:
-			strcat_s(str, MAX_PROGRAM_LEN, expr->function.token.literal);
-			strcat_s(str, MAX_PROGRAM_LEN, "(");
+			writeStr(writer, expr->function.token.literal);
+			writeChar(writer, '(');
 			for(size_t i = 0; i < expr->function.parameters.size; i++) {
 				if(i > 0) {
-					strcat_s(str, MAX_PROGRAM_LEN, ", ");
+					writeStr(writer, ", ");
 				}
 
-				strcat_s(str, MAX_PROGRAM_LEN, expr->function.parameters.values[i].value);
+				writeStr(writer, expr->function.parameters.values[i].value);
 			}
-			strcat_s(str, MAX_PROGRAM_LEN, ")");
-			strcat_s(str, MAX_PROGRAM_LEN, "{\n");
-			blockStatementToStr(str, expr->function.body);
-			strcat_s(str, MAX_PROGRAM_LEN, "\n}");
+			writeChar(writer, ')');
+			writeStr(writer, "{\n");
+			writeBlockStatement(writer, expr->function.body);
+			writeStr(writer, "\n}");
 			break;
 			
 		case EXPR_CALL:
-			exprStatementToStr(str, expr->call.function);
-			strcat_s(str, MAX_PROGRAM_LEN, "(");
-			for (size_t i = 0; i < expr->call.arguments.size; i++) {
-				if (i > 0) {
-					strcat_s(str, MAX_PROGRAM_LEN, ", ");
-				}
-				exprStatementToStr(str, expr->call.arguments.values[i]);
-			}
-			strcat_s(str, MAX_PROGRAM_LEN, ")");
+			writeExpression(writer, expr->call.function);
+			writeChar(writer, '(');
+			writeExpressionList(writer, &expr->call.arguments);
+			writeChar(writer, ')');
 			break;
 
 		case EXPR_ARRAY:
-			strcat_s(str, MAX_PROGRAM_LEN, "[");
-			for (size_t i = 0; i < expr->array.elements.size; i++) {
-				if (i > 0) {
-					strcat_s(str, MAX_PROGRAM_LEN, ", ");
-				}
-				exprStatementToStr(str, expr->array.elements.values[i]);
-			}
-			strcat_s(str, MAX_PROGRAM_LEN, "]");
+			writeChar(writer, '[');
+			writeExpressionList(writer, &expr->array.elements);
+			writeChar(writer, ']');
 			break;
 
 		case EXPR_INDEX:
-			strcat_s(str, MAX_PROGRAM_LEN, "(");
-			exprStatementToStr(str, expr->indexExpr.left);
-			strcat_s(str, MAX_PROGRAM_LEN, "[");
-			exprStatementToStr(str, expr->indexExpr.index);
-			strcat_s(str, MAX_PROGRAM_LEN, "]");
-			strcat_s(str, MAX_PROGRAM_LEN, ")");
+			writeChar(writer, '(');
+			writeExpression(writer, expr->indexExpr.left);
+			writeChar(writer, '[');
+			writeExpression(writer, expr->indexExpr.index);
+			writeStr(writer, "])");
 			break;
 
 
 		default:
-			strcat_s(str, MAX_PROGRAM_LEN, expr->token.literal);
+			writeStr(writer, expr->token.literal);
 	}
 }
 
-void statementToStr(char* str, const struct Statement* stmt) {
+void writeStatement(struct Writer* writer, const struct Statement* stmt) {
 
 	switch (stmt->type) {
 		case STMT_LET:
-			letStatementToStr(str, stmt);
+			writeLetStatement(writer, stmt);
 			break;
 		case STMT_RETURN:
-			retStatementToStr(str, stmt);
+			writeRetStatement(writer, stmt);
 			break;
 		case STMT_EXPR:
-			exprStatementToStr(str, stmt->expr);
+			writeExpression(writer, stmt->expr);
 			break;
 	}
 }
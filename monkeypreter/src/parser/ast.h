@@ -1,6 +1,12 @@
 #pragma once
 #include <stdint.h>
 #include "../lexer/lexer.h"
+#include "../util/writer.h"
+
+struct Object;
+struct ObjectEnvironment;
+struct ObjectList;
+struct MonkeyGC;
 
 enum ExpressionType {
     EXPR_INFIX = 1,
@@ -59,6 +65,8 @@ struct IfExpression {
 struct Identifier {
 	Token token;
 	char value[MAX_IDENT_LENGTH];
+	//Builtin of the same name, set by the parser for identifier expressions. NULL otherwise
+	struct Object* builtin;
 };
 
 struct IdentifierList {
@@ -67,10 +75,21 @@ struct IdentifierList {
     size_t cap;
 };
 
+//Name a function reads from the functions around it
+struct CapturedName {
+    const char* name;
+    uint32_t hash;
+};
+
 struct FunctionLiteral {
     Token token;
     struct IdentifierList parameters;
     struct BlockStatement* body;
+    //Filled by analyzeCaptures, until then the function keeps the environment it is created in
+    struct CapturedName* captures;
+    size_t capturesLen;
+    bool flat;
+    bool freesFrame;
 };
 
 struct ExpressionList {
@@ -79,10 +98,24 @@ struct ExpressionList {
     size_t cap;
 };
 
+//Monomorphic inline cache of a call through a name, filled by the evaluator on the first call
+struct CallCache {
+    //Outer environment of the calling environment, the callee was found from there
+    struct ObjectEnvironment* scope;
+    uint32_t hash;
+    //bindingVersion of the name at that time
+    uint32_t version;
+    //NULL while empty
+    struct Object* callee;
+    //Body of applyFunction for the callee's type
+    struct Object* (*apply)(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
+};
+
 struct CallExpression {
     Token token;
     struct Expression* function;
     struct ExpressionList arguments;
+    struct CallCache cache;
 };
 
 struct ArrayLiteral {
@@ -104,6 +137,8 @@ struct HashLiteral {
 struct Expression {
     enum ExpressionType type;
 	Token token;
+	//Immortal object of a literal, NULL until bindConstants
+	struct Object* constant;
     union {
         int64_t integer;
         bool boolean;
@@ -140,9 +175,15 @@ typedef struct Program {
 } Program;
 
 
+//Caller frees the returned string
 char* programToStr(const Program* program);
+//Caller frees the returned string
+char* blockStatementToStr(const struct BlockStatement* bs);
+//Writes the program to stream as it goes, without building the whole string first
+void printProgram(FILE* stream, const Program* program);
+void writeProgram(struct Writer* writer, const Program* program);
+void writeBlockStatement(struct Writer* writer, const struct BlockStatement* bs);
 enum OperatorType parseOperator(TokenType tokenType);
-void blockStatementToStr(char* str, const struct BlockStatement* bs);
 //Free memory
 void freeProgram(Program* program);
 void freeBlockStatement(struct BlockStatement* bs);
\ No newline at end of file
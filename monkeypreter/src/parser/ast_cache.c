@@ -0,0 +1,344 @@
+#include "ast_cache.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char astCacheMagic[8] = "MONKAST";
+#define AST_CACHE_BYTE_ORDER 0x0102030405060708ull
+
+static uint64_t rotateLeft(uint64_t value, unsigned bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t mixWord(uint64_t hash, uint64_t word) {
+	word *= 0x87C37B91114253D5ull;
+	word = rotateLeft(word, 31);
+	word *= 0x4CF5AD432745937Full;
+	hash ^= word;
+	return rotateLeft(hash, 27) * 5 + 0x52DCE729;
+}
+
+uint64_t astCacheHash(const void* data, size_t len) {
+	//Eight bytes per step, a 200 MB script hashes in a fraction of its parse time
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ len;
+
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof word);
+		hash = mixWord(hash, word);
+	}
+
+	if (i < len) {
+		uint64_t word = 0;
+		memcpy(&word, bytes + i, len - i);
+		hash = mixWord(hash, word);
+	}
+
+	//Final avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static uint64_t payloadHash(const struct CompactAst* ast) {
+	uint64_t hash = astCacheHash(ast->nodes, (size_t)ast->nodesLen * sizeof *ast->nodes);
+	hash = mixWord(hash, astCacheHash(ast->lists, (size_t)ast->listsLen * sizeof *ast->lists));
+	return mixWord(hash, astCacheHash(ast->text, ast->textLen));
+}
+
+static bool readEnv(const char* name, char* buffer, size_t cap) {
+#ifdef _WIN32
+	size_t len = 0;
+	return getenv_s(&len, buffer, cap, name) == 0 && len > 1;
+#else
+	const char* value = getenv(name);
+	if (!value || !value[0] || strlen(value) >= cap) {
+		return false;
+	}
+	strcpy_s(buffer, cap, value);
+	return true;
+#endif
+}
+
+static FILE* openFile(const char* path, const char* mode) {
+#ifdef _WIN32
+	FILE* file = NULL;
+	return fopen_s(&file, path, mode) == 0 ? file : NULL;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+bool defaultAstCacheDir(char* dir, size_t cap) {
+	if (readEnv("MONKEY_CACHE_DIR", dir, cap)) {
+		return true;
+	}
+
+	char temp[AST_CACHE_MAX_PATH];
+#ifdef _WIN32
+	if (!readEnv("TEMP", temp, sizeof temp)) {
+		return false;
+	}
+#else
+	if (!readEnv("TMPDIR", temp, sizeof temp)) {
+		strcpy_s(temp, sizeof temp, "/tmp");
+	}
+#endif
+
+	const int len = snprintf(dir, cap, "%s/monkeypreter-cache", temp);
+	return len > 0 && (size_t)len < cap;
+}
+
+bool createAstCacheDir(const char* dir) {
+#ifdef _WIN32
+	return _mkdir(dir) == 0 || errno == EEXIST;
+#else
+	return mkdir(dir, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool astCachePath(const char* dir, uint64_t sourceHash, char* path, size_t cap) {
+	const int len = snprintf(path, cap, "%s/%016llx-v%d.mast", dir, (unsigned long long)sourceHash, AST_CACHE_VERSION);
+	return len > 0 && (size_t)len < cap;
+}
+
+static bool validChild(const struct CompactAst* ast, NodeRef parent, NodeRef ref) {
+	//Children are always added after their parent, which also rules out cycles
+	return ref == NODE_NONE || (ref > parent && ref < ast->nodesLen);
+}
+
+static bool validBlock(const struct CompactAst* ast, NodeRef parent, NodeRef ref) {
+	return ref != NODE_NONE && validChild(ast, parent, ref) && ast->nodes[ref].type == CNODE_BLOCK;
+}
+
+static bool validList(const struct CompactAst* ast, uint32_t list) {
+	return list < ast->listsLen && ast->lists[list] <= ast->listsLen - list - 1;
+}
+
+static bool validNodeList(const struct CompactAst* ast, NodeRef parent, uint32_t list) {
+	if (!validList(ast, list)) {
+		return false;
+	}
+
+	size_t count = 0;
+	const uint32_t* entries = compactList(ast, list, &count);
+	for (size_t i = 0; i < count; i++) {
+		if (!validChild(ast, parent, entries[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool validConstant(const struct CompactAst* ast, uint32_t constant) {
+	return constant == NODE_NONE || constant < ast->constantsLen;
+}
+
+//The evaluator trusts every index, so each one is checked once here
+static bool validCompactAst(const struct CompactAst* ast) {
+	if (ast->textLen > 0 && ast->text[ast->textLen - 1] != '\0') {
+		return false;
+	}
+
+	if (ast->root >= ast->nodesLen || ast->nodes[ast->root].type != CNODE_BLOCK) {
+		return false;
+	}
+
+	for (NodeRef i = 0; i < ast->nodesLen; i++) {
+		const struct CompactNode* node = &ast->nodes[i];
+		bool valid = false;
+
+		switch (node->type) {
+			case CNODE_INT:
+				valid = validConstant(ast, node->c);
+				break;
+
+			case CNODE_BOOL:
+				valid = true;
+				break;
+
+			case CNODE_STRING:
+				valid = node->a < ast->textLen && validConstant(ast, node->c);
+				break;
+
+			case CNODE_IDENT:
+				valid = node->a < ast->textLen;
+				break;
+
+			case CNODE_PREFIX:
+				valid = node->op <= OP_NEGATE && validChild(ast, i, node->a);
+				break;
+
+			case CNODE_INFIX:
+				valid = node->op <= OP_NEGATE && validChild(ast, i, node->a) && validChild(ast, i, node->b);
+				break;
+
+			case CNODE_IF:
+				valid = validChild(ast, i, node->a) && validBlock(ast, i, node->b) && (node->c == NODE_NONE || validBlock(ast, i, node->c));
+				break;
+
+			case CNODE_FUNCTION: {
+				valid = validList(ast, node->a) && validBlock(ast, i, node->b);
+				size_t count = 0;
+				const uint32_t* parameters = valid ? compactList(ast, node->a, &count) : NULL;
+				for (size_t j = 0; j < count; j++) {
+					valid = valid && parameters[j] < ast->textLen;
+				}
+				break;
+			}
+
+			case CNODE_CALL:
+				valid = validChild(ast, i, node->a) && validNodeList(ast, i, node->b);
+				break;
+
+			case CNODE_ARRAY:
+				valid = validNodeList(ast, i, node->a) && validConstant(ast, node->c);
+				break;
+
+			case CNODE_INDEX:
+				valid = validChild(ast, i, node->a) && validChild(ast, i, node->b);
+				break;
+
+			case CNODE_LET:
+				valid = node->a < ast->textLen && validChild(ast, i, node->b);
+				break;
+
+			case CNODE_RETURN:
+				valid = validChild(ast, i, node->a);
+				break;
+
+			case CNODE_BLOCK:
+				valid = validNodeList(ast, i, node->a);
+				break;
+		}
+
+		//The evaluator jumps through a table indexed by the opcode
+		if (!valid || node->opcode != compactOpcode(node)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool openAstCache(const char* path, uint64_t sourceHash, size_t sourceSize, struct AstCache* cache) {
+	memset(cache, 0, sizeof *cache);
+
+	//A miss is the normal case, mapFile would complain about it
+	FILE* probe = openFile(path, "rb");
+	if (!probe) {
+		return false;
+	}
+	fclose(probe);
+
+	//Private so the compact interpreter (script option interpret) can quicken nodes in place,
+	//only the pages it writes are copied
+	if (!mapFilePrivate(path, &cache->file)) {
+		return false;
+	}
+
+	struct AstCacheHeader header;
+	if (cache->file.size < sizeof header) {
+		closeAstCache(cache);
+		return false;
+	}
+	memcpy(&header, cache->file.data, sizeof header);
+
+	const bool matches = memcmp(header.magic, astCacheMagic, sizeof astCacheMagic) == 0
+		&& header.version == AST_CACHE_VERSION
+		&& header.nodeSize == sizeof(struct CompactNode)
+		&& header.byteOrder == AST_CACHE_BYTE_ORDER
+		&& header.sourceHash == sourceHash
+		&& header.sourceSize == sourceSize;
+
+	const uint64_t payloadSize = (uint64_t)header.nodesLen * sizeof(struct CompactNode) + (uint64_t)header.listsLen * sizeof(uint32_t) + header.textLen;
+	if (!matches || payloadSize != cache->file.size - sizeof header) {
+		closeAstCache(cache);
+		return false;
+	}
+
+	const char* payload = cache->file.data + sizeof header;
+	struct CompactAst* ast = &cache->ast;
+	ast->nodes = (struct CompactNode*)payload;
+	ast->nodesLen = header.nodesLen;
+	ast->lists = (uint32_t*)(payload + (size_t)header.nodesLen * sizeof(struct CompactNode));
+	ast->listsLen = header.listsLen;
+	ast->text = (char*)(payload + (size_t)header.nodesLen * sizeof(struct CompactNode) + (size_t)header.listsLen * sizeof(uint32_t));
+	ast->textLen = header.textLen;
+	ast->root = header.root;
+	ast->constantsLen = header.constantsLen;
+	ast->treeBytes = (size_t)header.treeBytes;
+
+	if (payloadHash(ast) != header.payloadHash || !validCompactAst(ast)) {
+		closeAstCache(cache);
+		return false;
+	}
+	return true;
+}
+
+void closeAstCache(struct AstCache* cache) {
+	unmapFile(&cache->file);
+	memset(&cache->ast, 0, sizeof cache->ast);
+}
+
+bool writeAstCache(const char* path, const struct CompactAst* ast, uint64_t sourceHash, size_t sourceSize) {
+	struct AstCacheHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, astCacheMagic, sizeof astCacheMagic);
+	header.version = AST_CACHE_VERSION;
+	header.nodeSize = sizeof(struct CompactNode);
+	header.byteOrder = AST_CACHE_BYTE_ORDER;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.payloadHash = payloadHash(ast);
+	header.treeBytes = ast->treeBytes;
+	header.nodesLen = ast->nodesLen;
+	header.listsLen = ast->listsLen;
+	header.textLen = ast->textLen;
+	header.root = ast->root;
+	header.constantsLen = ast->constantsLen;
+
+	char tempPath[AST_CACHE_MAX_PATH + 32];
+#ifdef _WIN32
+	snprintf(tempPath, sizeof tempPath, "%s.%d.tmp", path, _getpid());
+#else
+	snprintf(tempPath, sizeof tempPath, "%s.%d.tmp", path, (int)getpid());
+#endif
+
+	FILE* file = openFile(tempPath, "wb");
+	if (!file) {
+		return false;
+	}
+
+	bool written = fwrite(&header, sizeof header, 1, file) == 1
+		&& fwrite(ast->nodes, sizeof *ast->nodes, ast->nodesLen, file) == ast->nodesLen
+		&& fwrite(ast->lists, sizeof *ast->lists, ast->listsLen, file) == ast->listsLen
+		&& fwrite(ast->text, 1, ast->textLen, file) == ast->textLen;
+	written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+	written = written && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING);
+#else
+	written = written && rename(tempPath, path) == 0;
+#endif
+
+	if (!written) {
+		remove(tempPath);
+	}
+	return written;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "compact_ast.h"
+#include "../util/mapped_file.h"
+
+//Bump whenever the node layout or anything that builds the compact AST changes
+#define AST_CACHE_VERSION 4
+#define AST_CACHE_MAX_PATH 1024
+
+//File layout: header, nodes, lists, text. Pools are addressed by index only,
+//so a mapped file is used as is without deserializing
+struct AstCacheHeader {
+	char magic[8];
+	uint32_t version;
+	//Rejects files of builds with another node layout
+	uint32_t nodeSize;
+	//Written as AST_CACHE_BYTE_ORDER, reads back different on the other endianness
+	uint64_t byteOrder;
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	//Hash of everything after the header
+	uint64_t payloadHash;
+	uint64_t treeBytes;
+	uint32_t nodesLen;
+	uint32_t listsLen;
+	uint32_t textLen;
+	NodeRef root;
+	uint32_t constantsLen;
+	uint32_t reserved;
+};
+
+struct AstCache {
+	//Pools point into file
+	struct CompactAst ast;
+	struct MappedFile file;
+};
+
+uint64_t astCacheHash(const void* data, size_t len);
+//Directory from MONKEY_CACHE_DIR or below the temp directory
+bool defaultAstCacheDir(char* dir, size_t cap);
+bool createAstCacheDir(const char* dir);
+//<dir>/<source hash>-v<version>.mast
+bool astCachePath(const char* dir, uint64_t sourceHash, char* path, size_t cap);
+//Maps path and checks header, checksum and every index. Fails quietly when the file is missing, stale or corrupt
+bool openAstCache(const char* path, uint64_t sourceHash, size_t sourceSize, struct AstCache* cache);
+void closeAstCache(struct AstCache* cache);
+//Writes a temp file next to path and renames it over, concurrent runs never see half a file
+bool writeAstCache(const char* path, const struct CompactAst* ast, uint64_t sourceHash, size_t sourceSize);
@@ -0,0 +1,576 @@
+#include "compact_ast.h"
+#include <stdio.h>
+#include <string.h>
+
+struct ConstantSlot {
+	//Integer value or text offset
+	uint64_t key;
+	uint8_t type;
+	//Constant + 1, 0 marks a free slot
+	uint32_t constant;
+};
+
+struct CompactBuilder {
+	struct CompactAst* ast;
+	//Open addressing set of text offsets + 1, 0 marks a free slot
+	uint32_t* slots;
+	uint32_t slotsCap;
+	uint32_t textCount;
+	//Open addressing map from literal to constant slot
+	struct ConstantSlot* constantSlots;
+	uint32_t constantSlotsCap;
+};
+
+static NodeRef compactExpression(struct CompactBuilder* builder, const struct Expression* expr);
+static NodeRef compactBlock(struct CompactBuilder* builder, const struct Statement* statements, size_t size);
+
+static void* growPool(void* pool, uint32_t* cap, uint32_t needed, size_t elemSize) {
+	if (needed <= *cap) {
+		return pool;
+	}
+
+	uint32_t newCap = *cap ? *cap : 64;
+	while (newCap < needed) {
+		newCap *= 2;
+	}
+
+	void* tmp = realloc(pool, (size_t)newCap * elemSize);
+	if (!tmp) {
+		perror("realloc (compact ast pool) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	*cap = newCap;
+	return tmp;
+}
+
+static NodeRef addNode(struct CompactBuilder* builder, uint8_t type) {
+	struct CompactAst* ast = builder->ast;
+	ast->nodes = (struct CompactNode*)growPool(ast->nodes, &ast->nodesCap, ast->nodesLen + 1, sizeof *ast->nodes);
+
+	struct CompactNode* node = &ast->nodes[ast->nodesLen];
+	node->type = type;
+	node->op = OP_UNKNOWN;
+	node->opcode = 0;
+	node->a = NODE_NONE;
+	node->b = NODE_NONE;
+	node->c = NODE_NONE;
+	return ast->nodesLen++;
+}
+
+//Reserves the count and entries up front, children are compacted later and may add lists of their own
+static uint32_t addList(struct CompactBuilder* builder, size_t count) {
+	struct CompactAst* ast = builder->ast;
+	ast->lists = (uint32_t*)growPool(ast->lists, &ast->listsCap, ast->listsLen + (uint32_t)count + 1, sizeof *ast->lists);
+
+	const uint32_t list = ast->listsLen;
+	ast->lists[list] = (uint32_t)count;
+	ast->listsLen += (uint32_t)count + 1;
+	return list;
+}
+
+static uint32_t hashText(const char* str, size_t len) {
+	//FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static void rehashText(struct CompactBuilder* builder) {
+	const uint32_t oldCap = builder->slotsCap;
+	uint32_t* oldSlots = builder->slots;
+
+	builder->slotsCap = oldCap ? oldCap * 2 : 256;
+	builder->slots = (uint32_t*)calloc(builder->slotsCap, sizeof *builder->slots);
+	if (!builder->slots) {
+		perror("calloc (compact ast text slots) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < oldCap; i++) {
+		if (!oldSlots[i]) {
+			continue;
+		}
+
+		const char* str = compactText(builder->ast, oldSlots[i] - 1);
+		uint32_t slot = hashText(str, strlen(str)) & (builder->slotsCap - 1);
+		while (builder->slots[slot]) {
+			slot = (slot + 1) & (builder->slotsCap - 1);
+		}
+		builder->slots[slot] = oldSlots[i];
+	}
+	free(oldSlots);
+}
+
+static uint32_t internText(struct CompactBuilder* builder, const char* str) {
+	if ((builder->textCount + 1) * 2 > builder->slotsCap) {
+		rehashText(builder);
+	}
+
+	struct CompactAst* ast = builder->ast;
+	const size_t len = strlen(str);
+	uint32_t slot = hashText(str, len) & (builder->slotsCap - 1);
+	while (builder->slots[slot]) {
+		const char* existing = compactText(ast, builder->slots[slot] - 1);
+		if (strcmp(existing, str) == 0) {
+			return builder->slots[slot] - 1;
+		}
+		slot = (slot + 1) & (builder->slotsCap - 1);
+	}
+
+	ast->text = (char*)growPool(ast->text, &ast->textCap, ast->textLen + (uint32_t)len + 1, 1);
+	const uint32_t offset = ast->textLen;
+	memcpy(ast->text + offset, str, len + 1);
+	ast->textLen += (uint32_t)len + 1;
+
+	builder->slots[slot] = offset + 1;
+	builder->textCount++;
+	return offset;
+}
+
+static uint32_t hashConstant(uint8_t type, uint64_t key) {
+	//Fibonacci hashing, the high bits are the well mixed ones
+	return (uint32_t)(((key ^ type) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static void rehashConstants(struct CompactBuilder* builder) {
+	const uint32_t oldCap = builder->constantSlotsCap;
+	struct ConstantSlot* oldSlots = builder->constantSlots;
+
+	builder->constantSlotsCap = oldCap ? oldCap * 2 : 64;
+	builder->constantSlots = (struct ConstantSlot*)calloc(builder->constantSlotsCap, sizeof *builder->constantSlots);
+	if (!builder->constantSlots) {
+		perror("calloc (compact ast constant slots) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < oldCap; i++) {
+		if (!oldSlots[i].constant) {
+			continue;
+		}
+
+		uint32_t slot = hashConstant(oldSlots[i].type, oldSlots[i].key) & (builder->constantSlotsCap - 1);
+		while (builder->constantSlots[slot].constant) {
+			slot = (slot + 1) & (builder->constantSlotsCap - 1);
+		}
+		builder->constantSlots[slot] = oldSlots[i];
+	}
+	free(oldSlots);
+}
+
+//Slot of the integer or string literal, every occurrence of a value shares the same one
+static uint32_t internConstant(struct CompactBuilder* builder, uint8_t type, uint64_t key) {
+	struct CompactAst* ast = builder->ast;
+	if ((ast->constantsLen + 1) * 2 > builder->constantSlotsCap) {
+		rehashConstants(builder);
+	}
+
+	uint32_t slot = hashConstant(type, key) & (builder->constantSlotsCap - 1);
+	while (builder->constantSlots[slot].constant) {
+		if (builder->constantSlots[slot].type == type && builder->constantSlots[slot].key == key) {
+			return builder->constantSlots[slot].constant - 1;
+		}
+		slot = (slot + 1) & (builder->constantSlotsCap - 1);
+	}
+
+	builder->constantSlots[slot].key = key;
+	builder->constantSlots[slot].type = type;
+	builder->constantSlots[slot].constant = ast->constantsLen + 1;
+	return ast->constantsLen++;
+}
+
+//Arrays of literals only are built once, like the literals themselves
+static bool constantElements(const struct CompactAst* ast, uint32_t list) {
+	size_t count = 0;
+	const uint32_t* elements = compactList(ast, list, &count);
+	for (size_t i = 0; i < count; i++) {
+		const struct CompactNode* element = &ast->nodes[elements[i]];
+		if (element->type != CNODE_BOOL && !compactHasConstant(element)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t compactExpressionList(struct CompactBuilder* builder, const struct ExpressionList* expressions) {
+	const uint32_t list = addList(builder, expressions->size);
+	builder->ast->treeBytes += expressions->size * sizeof *expressions->values;
+
+	for (size_t i = 0; i < expressions->size; i++) {
+		const NodeRef element = compactExpression(builder, expressions->values[i]);
+		builder->ast->lists[list + 1 + i] = element;
+	}
+	return list;
+}
+
+static NodeRef compactExpression(struct CompactBuilder* builder, const struct Expression* expr) {
+	if (!expr) {
+		return NODE_NONE;
+	}
+
+	builder->ast->treeBytes += sizeof *expr;
+
+	//Children are added after their parent, write operands through the index since the pool may move
+	NodeRef ref = NODE_NONE;
+	switch (expr->type) {
+		case EXPR_INT: {
+			ref = addNode(builder, CNODE_INT);
+			const uint64_t value = (uint64_t)expr->integer;
+			builder->ast->nodes[ref].a = (uint32_t)value;
+			builder->ast->nodes[ref].b = (uint32_t)(value >> 32);
+			builder->ast->nodes[ref].c = internConstant(builder, CNODE_INT, value);
+			break;
+		}
+
+		case EXPR_BOOL:
+			ref = addNode(builder, CNODE_BOOL);
+			builder->ast->nodes[ref].a = expr->boolean;
+			break;
+
+		case EXPR_STRING: {
+			ref = addNode(builder, CNODE_STRING);
+			const uint32_t text = internText(builder, expr->string);
+			builder->ast->nodes[ref].a = text;
+			builder->ast->nodes[ref].c = internConstant(builder, CNODE_STRING, text);
+			break;
+		}
+
+		case EXPR_IDENT: {
+			ref = addNode(builder, CNODE_IDENT);
+			const uint32_t text = internText(builder, expr->ident.value);
+			builder->ast->nodes[ref].a = text;
+			break;
+		}
+
+		case EXPR_PREFIX: {
+			ref = addNode(builder, CNODE_PREFIX);
+			builder->ast->nodes[ref].op = (uint8_t)expr->prefix.operatorType;
+			const NodeRef right = compactExpression(builder, expr->prefix.right);
+			builder->ast->nodes[ref].a = right;
+			break;
+		}
+
+		case EXPR_INFIX: {
+			ref = addNode(builder, CNODE_INFIX);
+			builder->ast->nodes[ref].op = (uint8_t)expr->infix.operatorType;
+			const NodeRef left = compactExpression(builder, expr->infix.left);
+			builder->ast->nodes[ref].a = left;
+			const NodeRef right = compactExpression(builder, expr->infix.right);
+			builder->ast->nodes[ref].b = right;
+			break;
+		}
+
+		case EXPR_IF: {
+			ref = addNode(builder, CNODE_IF);
+			const NodeRef condition = compactExpression(builder, expr->ifelse.condition);
+			builder->ast->nodes[ref].a = condition;
+			const NodeRef consequence = compactBlock(builder, expr->ifelse.consequence->statements, expr->ifelse.consequence->size);
+			builder->ast->nodes[ref].b = consequence;
+			if (expr->ifelse.alternative) {
+				const NodeRef alternative = compactBlock(builder, expr->ifelse.alternative->statements, expr->ifelse.alternative->size);
+				builder->ast->nodes[ref].c = alternative;
+			}
+			break;
+		}
+
+		case EXPR_FUNCTION: {
+			ref = addNode(builder, CNODE_FUNCTION);
+			const struct IdentifierList* parameters = &expr->function.parameters;
+			const uint32_t list = addList(builder, parameters->size);
+			builder->ast->treeBytes += parameters->size * sizeof *parameters->values;
+			for (size_t i = 0; i < parameters->size; i++) {
+				const uint32_t text = internText(builder, parameters->values[i].value);
+				builder->ast->lists[list + 1 + i] = text;
+			}
+			builder->ast->nodes[ref].a = list;
+			const NodeRef body = compactBlock(builder, expr->function.body->statements, expr->function.body->size);
+			builder->ast->nodes[ref].b = body;
+			break;
+		}
+
+		case EXPR_CALL: {
+			ref = addNode(builder, CNODE_CALL);
+			const NodeRef function = compactExpression(builder, expr->call.function);
+			builder->ast->nodes[ref].a = function;
+			const uint32_t arguments = compactExpressionList(builder, &expr->call.arguments);
+			builder->ast->nodes[ref].b = arguments;
+			break;
+		}
+
+		case EXPR_ARRAY: {
+			ref = addNode(builder, CNODE_ARRAY);
+			const uint32_t elements = compactExpressionList(builder, &expr->array.elements);
+			builder->ast->nodes[ref].a = elements;
+			if (constantElements(builder->ast, elements)) {
+				builder->ast->nodes[ref].c = builder->ast->constantsLen++;
+			}
+			break;
+		}
+
+		case EXPR_INDEX: {
+			ref = addNode(builder, CNODE_INDEX);
+			const NodeRef left = compactExpression(builder, expr->indexExpr.left);
+			builder->ast->nodes[ref].a = left;
+			const NodeRef index = compactExpression(builder, expr->indexExpr.index);
+			builder->ast->nodes[ref].b = index;
+			break;
+		}
+	}
+
+	return ref;
+}
+
+static NodeRef compactStatement(struct CompactBuilder* builder, const struct Statement* stmt) {
+	NodeRef ref = NODE_NONE;
+
+	switch (stmt->type) {
+		case STMT_LET: {
+			ref = addNode(builder, CNODE_LET);
+			const uint32_t text = internText(builder, stmt->identifier.value);
+			builder->ast->nodes[ref].a = text;
+			const NodeRef value = compactExpression(builder, stmt->expr);
+			builder->ast->nodes[ref].b = value;
+			break;
+		}
+
+		case STMT_RETURN: {
+			ref = addNode(builder, CNODE_RETURN);
+			const NodeRef value = compactExpression(builder, stmt->expr);
+			builder->ast->nodes[ref].a = value;
+			break;
+		}
+
+		case STMT_EXPR:
+			ref = compactExpression(builder, stmt->expr);
+			break;
+	}
+
+	return ref;
+}
+
+static NodeRef compactBlock(struct CompactBuilder* builder, const struct Statement* statements, size_t size) {
+	builder->ast->treeBytes += sizeof(struct BlockStatement) + size * sizeof *statements;
+
+	const NodeRef ref = addNode(builder, CNODE_BLOCK);
+	const uint32_t list = addList(builder, size);
+	builder->ast->nodes[ref].a = list;
+
+	for (size_t i = 0; i < size; i++) {
+		const NodeRef stmt = compactStatement(builder, &statements[i]);
+		builder->ast->lists[list + 1 + i] = stmt;
+	}
+	return ref;
+}
+
+uint16_t compactOpcode(const struct CompactNode* node) {
+	switch (node->type) {
+		case CNODE_INT: return CODE_INT;
+		case CNODE_BOOL: return CODE_BOOL;
+		case CNODE_STRING: return CODE_STRING;
+		case CNODE_IDENT: return CODE_IDENT;
+
+		case CNODE_PREFIX:
+			switch (node->op) {
+				case OP_NEGATE: return CODE_NEGATE;
+				case OP_SUBTRACT: return CODE_MINUS;
+				default: return CODE_PREFIX;
+			}
+
+		case CNODE_INFIX:
+			switch (node->op) {
+				case OP_ADD: return CODE_ADD;
+				case OP_SUBTRACT: return CODE_SUBTRACT;
+				case OP_MULTIPLY: return CODE_MULTIPLY;
+				case OP_DIVIDE: return CODE_DIVIDE;
+				case OP_LT: return CODE_LT;
+				case OP_GT: return CODE_GT;
+				case OP_EQ: return CODE_EQ;
+				case OP_NOT_EQ: return CODE_NOT_EQ;
+				default: return CODE_INFIX;
+			}
+
+		case CNODE_IF: return CODE_IF;
+		case CNODE_FUNCTION: return CODE_FUNCTION;
+		case CNODE_CALL: return CODE_CALL;
+		case CNODE_ARRAY: return CODE_ARRAY;
+		case CNODE_INDEX: return CODE_INDEX;
+		case CNODE_LET: return CODE_LET;
+		case CNODE_RETURN: return CODE_RETURN;
+		case CNODE_BLOCK: return CODE_BLOCK;
+		default: return CODE_COUNT;
+	}
+}
+
+struct CompactAst* compactProgram(const Program* program) {
+	struct CompactAst* ast = (struct CompactAst*)calloc(1, sizeof *ast);
+	if (!ast) {
+		perror("calloc (compact ast) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct CompactBuilder builder = { ast, NULL, 0, 0, NULL, 0 };
+	ast->root = compactBlock(&builder, program->statements, program->size);
+	//Program has no block of its own
+	ast->treeBytes += sizeof *program - sizeof(struct BlockStatement);
+
+	free(builder.slots);
+	free(builder.constantSlots);
+
+	//Decoded in one pass once every node is complete
+	for (NodeRef i = 0; i < ast->nodesLen; i++) {
+		ast->nodes[i].opcode = compactOpcode(&ast->nodes[i]);
+	}
+	return ast;
+}
+
+void freeCompactAst(struct CompactAst* ast) {
+	if (!ast) {
+		return;
+	}
+
+	free(ast->nodes);
+	free(ast->lists);
+	free(ast->text);
+	free(ast);
+}
+
+size_t compactAstBytes(const struct CompactAst* ast) {
+	return (size_t)ast->nodesLen * sizeof *ast->nodes + (size_t)ast->listsLen * sizeof *ast->lists + ast->textLen;
+}
+
+static const char* compactOperatorToStr(uint8_t op) {
+	switch (op) {
+		case OP_ADD: return "+";
+		case OP_SUBTRACT: return "-";
+		case OP_MULTIPLY: return "*";
+		case OP_DIVIDE: return "/";
+		case OP_GT: return ">";
+		case OP_LT: return "<";
+		case OP_EQ: return "==";
+		case OP_NOT_EQ: return "!=";
+		case OP_NEGATE: return "!";
+		default: return "";
+	}
+}
+
+static void writeCompactList(struct Writer* writer, const struct CompactAst* ast, uint32_t list) {
+	size_t count = 0;
+	const uint32_t* values = compactList(ast, list, &count);
+	for (size_t i = 0; i < count; i++) {
+		if (i > 0) {
+			writeStr(writer, ", ");
+		}
+		writeCompactNode(writer, ast, values[i]);
+	}
+}
+
+void writeCompactNode(struct Writer* writer, const struct CompactAst* ast, NodeRef ref) {
+	if (ref == NODE_NONE) {
+		return;
+	}
+
+	const struct CompactNode* node = &ast->nodes[ref];
+	switch (node->type) {
+		case CNODE_INT:
+			writeInt(writer, compactInteger(node));
+			break;
+
+		case CNODE_BOOL:
+			writeStr(writer, node->a ? "true" : "false");
+			break;
+
+		case CNODE_STRING:
+		case CNODE_IDENT:
+			writeStr(writer, compactText(ast, node->a));
+			break;
+
+		case CNODE_PREFIX:
+			writeChar(writer, '(');
+			writeStr(writer, compactOperatorToStr(node->op));
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, ')');
+			break;
+
+		case CNODE_INFIX:
+			writeChar(writer, '(');
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, ' ');
+			writeStr(writer, compactOperatorToStr(node->op));
+			writeChar(writer, ' ');
+			writeCompactNode(writer, ast, node->b);
+			writeChar(writer, ')');
+			break;
+
+		case CNODE_IF:
+			writeStr(writer, "if");
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, ' ');
+			writeCompactNode(writer, ast, node->b);
+			if (node->c != NODE_NONE) {
+				writeStr(writer, "else");
+				writeCompactNode(writer, ast, node->c);
+			}
+			break;
+
+		case CNODE_FUNCTION: {
+			size_t count = 0;
+			const uint32_t* parameters = compactList(ast, node->a, &count);
+			writeStr(writer, "fn(");
+			for (size_t i = 0; i < count; i++) {
+				if (i > 0) {
+					writeStr(writer, ", ");
+				}
+				writeStr(writer, compactText(ast, parameters[i]));
+			}
+			writeStr(writer, "){\n");
+			writeCompactNode(writer, ast, node->b);
+			writeStr(writer, "\n}");
+			break;
+		}
+
+		case CNODE_CALL:
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, '(');
+			writeCompactList(writer, ast, node->b);
+			writeChar(writer, ')');
+			break;
+
+		case CNODE_ARRAY:
+			writeChar(writer, '[');
+			writeCompactList(writer, ast, node->a);
+			writeChar(writer, ']');
+			break;
+
+		case CNODE_INDEX:
+			writeChar(writer, '(');
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, '[');
+			writeCompactNode(writer, ast, node->b);
+			writeStr(writer, "])");
+			break;
+
+		case CNODE_LET:
+			writeStr(writer, "let ");
+			writeStr(writer, compactText(ast, node->a));
+			writeStr(writer, " = ");
+			writeCompactNode(writer, ast, node->b);
+			writeChar(writer, ';');
+			break;
+
+		case CNODE_RETURN:
+			writeStr(writer, "return ");
+			writeCompactNode(writer, ast, node->a);
+			writeChar(writer, ';');
+			break;
+
+		case CNODE_BLOCK: {
+			size_t count = 0;
+			const uint32_t* statements = compactList(ast, node->a, &count);
+			for (size_t i = 0; i < count; i++) {
+				writeCompactNode(writer, ast, statements[i]);
+			}
+			break;
+		}
+	}
+}
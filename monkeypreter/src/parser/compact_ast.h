@@ -0,0 +1,160 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "../util/writer.h"
+
+struct Object;
+
+//Flattened AST: fixed size records in one pool that link by 32-bit index instead of pointer.
+//Everything variable sized lives in side tables (lists and text)
+typedef uint32_t NodeRef;
+#define NODE_NONE UINT32_MAX
+
+enum CompactNodeType {
+	CNODE_INT = 1,
+	CNODE_BOOL,
+	CNODE_STRING,
+	CNODE_IDENT,
+	CNODE_PREFIX,
+	CNODE_INFIX,
+	CNODE_IF,
+	CNODE_FUNCTION,
+	CNODE_CALL,
+	CNODE_ARRAY,
+	CNODE_INDEX,
+	CNODE_LET,
+	CNODE_RETURN,
+	//Expression statements are stored as their expression
+	CNODE_BLOCK,
+};
+
+//Operands by type:
+//INT      a = low, b = high 32 bits of the value, c = constant
+//BOOL     a = value
+//STRING   a = text, c = constant
+//IDENT    a = text
+//PREFIX   a = right
+//INFIX    a = left, b = right
+//IF       a = condition, b = consequence, c = alternative or NODE_NONE
+//FUNCTION a = list of parameter texts, b = body
+//CALL     a = function, b = list of arguments
+//ARRAY    a = list of elements, c = constant or NODE_NONE if an element is not constant
+//INDEX    a = left, b = index
+//LET      a = text of the name, b = value
+//RETURN   a = value
+//BLOCK    a = list of statements
+//Node type and operator decoded into the single value the evaluator dispatches on.
+//Same order as its dispatch table. Infix, minus and index nodes start out with the decoded
+//opcode and are quickened in place on their first execution, to the variant for the operand
+//types they saw or to the generic one. A variant whose guard fails falls back to generic for good
+#define COMPACT_OPCODES(X) \
+	X(CODE_INT) \
+	X(CODE_BOOL) \
+	X(CODE_STRING) \
+	X(CODE_IDENT) \
+	X(CODE_NEGATE) \
+	X(CODE_MINUS) \
+	X(CODE_PREFIX) \
+	X(CODE_ADD) \
+	X(CODE_SUBTRACT) \
+	X(CODE_MULTIPLY) \
+	X(CODE_DIVIDE) \
+	X(CODE_LT) \
+	X(CODE_GT) \
+	X(CODE_EQ) \
+	X(CODE_NOT_EQ) \
+	X(CODE_INFIX) \
+	X(CODE_IF) \
+	X(CODE_FUNCTION) \
+	X(CODE_CALL) \
+	X(CODE_ARRAY) \
+	X(CODE_INDEX) \
+	X(CODE_LET) \
+	X(CODE_RETURN) \
+	X(CODE_BLOCK) \
+	X(CODE_MINUS_INT) \
+	X(CODE_ADD_INT) \
+	X(CODE_SUBTRACT_INT) \
+	X(CODE_MULTIPLY_INT) \
+	X(CODE_DIVIDE_INT) \
+	X(CODE_LT_INT) \
+	X(CODE_GT_INT) \
+	X(CODE_EQ_INT) \
+	X(CODE_NOT_EQ_INT) \
+	X(CODE_ADD_STRING) \
+	X(CODE_EQ_BOOL) \
+	X(CODE_NOT_EQ_BOOL) \
+	X(CODE_INDEX_ARRAY) \
+	X(CODE_INDEX_ANY)
+
+#define COMPACT_OPCODE_ENUM(code) code,
+enum CompactOpcode {
+	COMPACT_OPCODES(COMPACT_OPCODE_ENUM)
+	CODE_COUNT
+};
+#undef COMPACT_OPCODE_ENUM
+
+struct CompactNode {
+	uint8_t type;
+	//enum OperatorType of PREFIX and INFIX
+	uint8_t op;
+	//enum CompactOpcode, PREFIX and INFIX get one per operator. Rewritten by the evaluator
+	uint16_t opcode;
+	uint32_t a;
+	uint32_t b;
+	uint32_t c;
+};
+
+struct CompactAst {
+	struct CompactNode* nodes;
+	uint32_t nodesLen;
+	uint32_t nodesCap;
+
+	//Lists are a count followed by that many entries
+	uint32_t* lists;
+	uint32_t listsLen;
+	uint32_t listsCap;
+
+	//Interned NTC strings, identifiers with the same name share one offset
+	char* text;
+	uint32_t textLen;
+	uint32_t textCap;
+
+	//Top level BLOCK
+	NodeRef root;
+	//Bytes the pointer AST needed for the same program
+	size_t treeBytes;
+
+	//Slots of the constant pool, equal integers and strings share one
+	uint32_t constantsLen;
+	//Immortal objects by slot, NULL until bindCompactConstants
+	struct Object** constants;
+};
+
+struct CompactAst* compactProgram(const Program* program);
+void freeCompactAst(struct CompactAst* ast);
+//Decoded opcode of the node's type and operator, before any quickening
+uint16_t compactOpcode(const struct CompactNode* node);
+//Heap bytes of all pools
+size_t compactAstBytes(const struct CompactAst* ast);
+//Same format as programToStr
+void writeCompactNode(struct Writer* writer, const struct CompactAst* ast, NodeRef ref);
+
+static inline const char* compactText(const struct CompactAst* ast, uint32_t offset) {
+	return ast->text + offset;
+}
+
+static inline const uint32_t* compactList(const struct CompactAst* ast, uint32_t list, size_t* count) {
+	*count = ast->lists[list];
+	return ast->lists + list + 1;
+}
+
+static inline int64_t compactInteger(const struct CompactNode* node) {
+	return (int64_t)((uint64_t)node->a | (uint64_t)node->b << 32);
+}
+
+//INT, STRING and ARRAY nodes with a slot in the constant pool
+static inline bool compactHasConstant(const struct CompactNode* node) {
+	return (node->type == CNODE_INT || node->type == CNODE_STRING || node->type == CNODE_ARRAY) && node->c != NODE_NONE;
+}
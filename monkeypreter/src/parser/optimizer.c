@@ -0,0 +1,471 @@
+#include "optimizer.h"
+#include <stdio.h>
+#include <string.h>
+
+//Internal to ast.c
+void freeExpression(struct Expression* expr);
+
+struct StatementList {
+	struct Statement* statements;
+	size_t size;
+	size_t cap;
+};
+
+struct NameList {
+	const char** names;
+	size_t size;
+	size_t cap;
+};
+
+static void foldExpression(struct Expression* expr);
+static void optimizeStatements(struct Statement** statements, size_t* size, size_t* cap);
+static void collectNames(struct NameList* names, const struct Expression* expr);
+
+static void appendStatement(struct StatementList* list, struct Statement stmt) {
+	if (list->size >= list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 8;
+		struct Statement* tmp = (struct Statement*)realloc(list->statements, list->cap * sizeof *tmp);
+		if (!tmp) {
+			perror("realloc (optimizer statements) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+		list->statements = tmp;
+	}
+	list->statements[list->size++] = stmt;
+}
+
+static bool isLiteral(const struct Expression* expr) {
+	return expr && (expr->type == EXPR_INT || expr->type == EXPR_BOOL || expr->type == EXPR_STRING);
+}
+
+//Same as isTruthy on the evaluated literal
+static bool isTruthyLiteral(const struct Expression* expr) {
+	switch (expr->type) {
+		case EXPR_BOOL: return expr->boolean;
+		case EXPR_INT: return expr->integer != 0;
+		default: return false;
+	}
+}
+
+//The children of expr must already be freed or moved
+static void setInteger(struct Expression* expr, int64_t value) {
+	expr->type = EXPR_INT;
+	expr->integer = value;
+	expr->token.type = TokenTypeInt;
+	snprintf(expr->token.literal, MAX_IDENT_LENGTH, "%lld", (long long)value);
+}
+
+static void setBoolean(struct Expression* expr, bool value) {
+	expr->type = EXPR_BOOL;
+	expr->boolean = value;
+	expr->token.type = value ? TokenTypeTrue : TokenTypeFalse;
+	strcpy_s(expr->token.literal, MAX_IDENT_LENGTH, value ? "true" : "false");
+}
+
+static void setString(struct Expression* expr, const char* left, const char* right) {
+	//Operands may live in the union that is overwritten here
+	char value[MAX_IDENT_LENGTH];
+	strcpy_s(value, MAX_IDENT_LENGTH, left);
+	strcat_s(value, MAX_IDENT_LENGTH, right);
+
+	expr->type = EXPR_STRING;
+	strcpy_s(expr->string, MAX_IDENT_LENGTH, value);
+	expr->token.type = TokenTypeString;
+	strcpy_s(expr->token.literal, MAX_IDENT_LENGTH, value);
+}
+
+//Mirrors evalPrefixExpression, returns false where it would be an error
+static bool foldPrefix(struct Expression* expr) {
+	const struct Expression* right = expr->prefix.right;
+	if (!isLiteral(right)) {
+		return false;
+	}
+
+	switch (expr->prefix.operatorType) {
+		case OP_NEGATE: {
+			//Only false is falsy for `!`, every other literal negates to false
+			const bool value = right->type == EXPR_BOOL && !right->boolean;
+			freeExpression(expr->prefix.right);
+			setBoolean(expr, value);
+			return true;
+		}
+
+		case OP_SUBTRACT: {
+			if (right->type != EXPR_INT) {
+				return false;
+			}
+			//Wraps like the evaluator does on INT64_MIN
+			const int64_t value = (int64_t)(0 - (uint64_t)right->integer);
+			freeExpression(expr->prefix.right);
+			setInteger(expr, value);
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+//Mirrors evalInfixExpression, returns false where it would be an error or trap
+static bool foldInfix(struct Expression* expr) {
+	const struct Expression* left = expr->infix.left;
+	const struct Expression* right = expr->infix.right;
+	if (!isLiteral(left) || !isLiteral(right) || left->type != right->type) {
+		return false;
+	}
+
+	const enum OperatorType op = expr->infix.operatorType;
+
+	if (left->type == EXPR_INT) {
+		const int64_t leftVal = left->integer;
+		const int64_t rightVal = right->integer;
+		int64_t value = 0;
+		bool isBool = false;
+
+		switch (op) {
+			case OP_ADD: value = (int64_t)((uint64_t)leftVal + (uint64_t)rightVal); break;
+			case OP_SUBTRACT: value = (int64_t)((uint64_t)leftVal - (uint64_t)rightVal); break;
+			case OP_MULTIPLY: value = (int64_t)((uint64_t)leftVal * (uint64_t)rightVal); break;
+			case OP_DIVIDE:
+				//Left for the runtime to trap on
+				if (rightVal == 0 || (leftVal == INT64_MIN && rightVal == -1)) {
+					return false;
+				}
+				value = leftVal / rightVal;
+				break;
+			case OP_LT: value = leftVal < rightVal; isBool = true; break;
+			case OP_GT: value = leftVal > rightVal; isBool = true; break;
+			case OP_EQ: value = leftVal == rightVal; isBool = true; break;
+			case OP_NOT_EQ: value = leftVal != rightVal; isBool = true; break;
+			default: return false;
+		}
+
+		freeExpression(expr->infix.left);
+		freeExpression(expr->infix.right);
+		if (isBool) {
+			setBoolean(expr, value != 0);
+		}
+		else {
+			setInteger(expr, value);
+		}
+		return true;
+	}
+
+	if (left->type == EXPR_BOOL && (op == OP_EQ || op == OP_NOT_EQ)) {
+		const bool value = op == OP_EQ ? left->boolean == right->boolean : left->boolean != right->boolean;
+		freeExpression(expr->infix.left);
+		freeExpression(expr->infix.right);
+		setBoolean(expr, value);
+		return true;
+	}
+
+	//Concatenations that would not fit are left to the runtime
+	if (left->type == EXPR_STRING && op == OP_ADD && strlen(left->string) + strlen(right->string) < MAX_IDENT_LENGTH) {
+		struct Expression* leftExpr = expr->infix.left;
+		struct Expression* rightExpr = expr->infix.right;
+		setString(expr, leftExpr->string, rightExpr->string);
+		freeExpression(leftExpr);
+		freeExpression(rightExpr);
+		return true;
+	}
+
+	return false;
+}
+
+//Branch an `if` with a literal condition takes, NULL if it takes none
+static struct BlockStatement* takenBranch(const struct Expression* expr) {
+	return isTruthyLiteral(expr->ifelse.condition) ? expr->ifelse.consequence : expr->ifelse.alternative;
+}
+
+static void freeIfExceptBranch(struct Expression* expr, const struct BlockStatement* kept) {
+	freeExpression(expr->ifelse.condition);
+	if (expr->ifelse.consequence != kept) {
+		freeBlockStatement(expr->ifelse.consequence);
+	}
+	if (expr->ifelse.alternative != kept) {
+		freeBlockStatement(expr->ifelse.alternative);
+	}
+}
+
+static void foldIf(struct Expression* expr) {
+	foldExpression(expr->ifelse.condition);
+	optimizeStatements(&expr->ifelse.consequence->statements, &expr->ifelse.consequence->size, &expr->ifelse.consequence->cap);
+	if (expr->ifelse.alternative) {
+		optimizeStatements(&expr->ifelse.alternative->statements, &expr->ifelse.alternative->size, &expr->ifelse.alternative->cap);
+	}
+
+	if (!isLiteral(expr->ifelse.condition)) {
+		return;
+	}
+
+	//A branch with a single expression has the value of that expression, other branches need
+	//a statement list to be spliced into (see optimizeStatements)
+	struct BlockStatement* branch = takenBranch(expr);
+	if (!branch || branch->size != 1 || branch->statements[0].type != STMT_EXPR) {
+		return;
+	}
+
+	struct Expression* value = branch->statements[0].expr;
+	freeIfExceptBranch(expr, branch);
+	free(branch->statements);
+	free(branch);
+
+	*expr = *value;
+	free(value);
+}
+
+static bool isPure(const struct Expression* expr) {
+	if (!expr) {
+		return true;
+	}
+
+	switch (expr->type) {
+		case EXPR_INT:
+		case EXPR_BOOL:
+		case EXPR_STRING:
+		case EXPR_FUNCTION:
+			return true;
+
+		case EXPR_ARRAY:
+			for (size_t i = 0; i < expr->array.elements.size; i++) {
+				if (!isPure(expr->array.elements.values[i])) {
+					return false;
+				}
+			}
+			return true;
+
+		//Identifiers may be undefined, operators may raise type errors
+		default:
+			return false;
+	}
+}
+
+static void addName(struct NameList* names, const char* name) {
+	if (names->size >= names->cap) {
+		names->cap = names->cap ? names->cap * 2 : 16;
+		const char** tmp = (const char**)realloc(names->names, names->cap * sizeof *tmp);
+		if (!tmp) {
+			perror("realloc (optimizer names) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+		names->names = tmp;
+	}
+	names->names[names->size++] = name;
+}
+
+static bool containsName(const struct NameList* names, const char* name) {
+	for (size_t i = 0; i < names->size; i++) {
+		if (strcmp(names->names[i], name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void collectBlockNames(struct NameList* names, const struct BlockStatement* bs) {
+	for (size_t i = 0; bs && i < bs->size; i++) {
+		collectNames(names, bs->statements[i].expr);
+	}
+}
+
+//Every identifier read anywhere below expr, nested functions included
+static void collectNames(struct NameList* names, const struct Expression* expr) {
+	if (!expr) {
+		return;
+	}
+
+	switch (expr->type) {
+		case EXPR_IDENT:
+			addName(names, expr->ident.value);
+			break;
+
+		case EXPR_PREFIX:
+			collectNames(names, expr->prefix.right);
+			break;
+
+		case EXPR_INFIX:
+			collectNames(names, expr->infix.left);
+			collectNames(names, expr->infix.right);
+			break;
+
+		case EXPR_IF:
+			collectNames(names, expr->ifelse.condition);
+			collectBlockNames(names, expr->ifelse.consequence);
+			collectBlockNames(names, expr->ifelse.alternative);
+			break;
+
+		case EXPR_FUNCTION:
+			collectBlockNames(names, expr->function.body);
+			break;
+
+		case EXPR_CALL:
+			collectNames(names, expr->call.function);
+			for (size_t i = 0; i < expr->call.arguments.size; i++) {
+				collectNames(names, expr->call.arguments.values[i]);
+			}
+			break;
+
+		case EXPR_ARRAY:
+			for (size_t i = 0; i < expr->array.elements.size; i++) {
+				collectNames(names, expr->array.elements.values[i]);
+			}
+			break;
+
+		case EXPR_INDEX:
+			collectNames(names, expr->indexExpr.left);
+			collectNames(names, expr->indexExpr.index);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void addDropped(struct ExpressionList* dropped, struct Expression* expr) {
+	if (dropped->size >= dropped->cap) {
+		dropped->cap = dropped->cap ? dropped->cap * 2 : 16;
+		struct Expression** tmp = (struct Expression**)realloc(dropped->values, dropped->cap * sizeof *tmp);
+		if (!tmp) {
+			perror("realloc (optimizer dropped) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+		dropped->values = tmp;
+	}
+	dropped->values[dropped->size++] = expr;
+}
+
+//Blocks share the environment of their function, so a binding inside an `if` is visible to the
+//whole function body. names holds every identifier read in that body and may point into the
+//dropped values, those are freed once the whole body is done
+static void dropUnusedLets(struct BlockStatement* bs, const struct NameList* names, struct ExpressionList* dropped) {
+	size_t kept = 0;
+	for (size_t i = 0; i < bs->size; i++) {
+		struct Statement* stmt = &bs->statements[i];
+
+		//A let as the last statement is the value of the block
+		const bool last = i == bs->size - 1;
+		if (!last && stmt->type == STMT_LET && isPure(stmt->expr) && !containsName(names, stmt->identifier.value)) {
+			addDropped(dropped, stmt->expr);
+			continue;
+		}
+
+		if (stmt->expr && stmt->expr->type == EXPR_IF) {
+			dropUnusedLets(stmt->expr->ifelse.consequence, names, dropped);
+			if (stmt->expr->ifelse.alternative) {
+				dropUnusedLets(stmt->expr->ifelse.alternative, names, dropped);
+			}
+		}
+		bs->statements[kept++] = *stmt;
+	}
+	bs->size = kept;
+}
+
+static void optimizeFunction(struct Expression* expr) {
+	struct BlockStatement* body = expr->function.body;
+	optimizeStatements(&body->statements, &body->size, &body->cap);
+
+	struct NameList names = { NULL, 0, 0 };
+	struct ExpressionList dropped = { NULL, 0, 0 };
+	collectBlockNames(&names, body);
+	dropUnusedLets(body, &names, &dropped);
+	free(names.names);
+
+	for (size_t i = 0; i < dropped.size; i++) {
+		freeExpression(dropped.values[i]);
+	}
+	free(dropped.values);
+}
+
+static void foldExpression(struct Expression* expr) {
+	if (!expr) {
+		return;
+	}
+
+	switch (expr->type) {
+		case EXPR_PREFIX:
+			foldExpression(expr->prefix.right);
+			foldPrefix(expr);
+			break;
+
+		case EXPR_INFIX:
+			foldExpression(expr->infix.left);
+			foldExpression(expr->infix.right);
+			foldInfix(expr);
+			break;
+
+		case EXPR_IF:
+			foldIf(expr);
+			break;
+
+		case EXPR_FUNCTION:
+			optimizeFunction(expr);
+			break;
+
+		case EXPR_CALL:
+			foldExpression(expr->call.function);
+			for (size_t i = 0; i < expr->call.arguments.size; i++) {
+				foldExpression(expr->call.arguments.values[i]);
+			}
+			break;
+
+		case EXPR_ARRAY:
+			for (size_t i = 0; i < expr->array.elements.size; i++) {
+				foldExpression(expr->array.elements.values[i]);
+			}
+			break;
+
+		case EXPR_INDEX:
+			foldExpression(expr->indexExpr.left);
+			foldExpression(expr->indexExpr.index);
+			break;
+
+		default:
+			break;
+	}
+}
+
+//Folds every statement and splices `if` statements with a literal condition into the list.
+//Blocks run in the environment of their parent, so the statements behave the same after splicing
+static void optimizeStatements(struct Statement** statements, size_t* size, size_t* cap) {
+	struct StatementList list = { NULL, 0, 0 };
+
+	for (size_t i = 0; i < *size; i++) {
+		struct Statement stmt = (*statements)[i];
+		foldExpression(stmt.expr);
+
+		struct Expression* expr = stmt.expr;
+		if (stmt.type != STMT_EXPR || !expr || expr->type != EXPR_IF || !isLiteral(expr->ifelse.condition)) {
+			appendStatement(&list, stmt);
+			continue;
+		}
+
+		//An empty branch as the last statement still has to produce null
+		struct BlockStatement* branch = takenBranch(expr);
+		const bool last = i == *size - 1;
+		if (last && (!branch || branch->size == 0)) {
+			appendStatement(&list, stmt);
+			continue;
+		}
+
+		for (size_t j = 0; branch && j < branch->size; j++) {
+			appendStatement(&list, branch->statements[j]);
+		}
+
+		freeIfExceptBranch(expr, branch);
+		if (branch) {
+			free(branch->statements);
+			free(branch);
+		}
+		free(expr);
+	}
+
+	free(*statements);
+	*statements = list.statements;
+	*size = list.size;
+	*cap = list.cap;
+}
+
+void optimizeProgram(Program* program) {
+	//Top level lets are globals, they are never dropped
+	optimizeStatements(&program->statements, &program->size, &program->cap);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "ast.h"
+
+//Rewrites the AST in place before evaluation:
+// - folds prefix and infix operators on literals, with the evaluator's semantics
+// - replaces `if` with a literal condition by the branch it takes
+// - drops `let` bindings of pure values that nothing in the function reads
+//Anything that would raise an error at runtime is left alone
+void optimizeProgram(Program* program);
@@ -0,0 +1,181 @@
+#include "parallel_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include "../util/thread.h"
+
+struct ParseChunk {
+	Lexer lexer;
+	Program* program;
+	size_t errorsLen;
+	char** errors;
+	struct Thread thread;
+};
+
+size_t splitTopLevelStatements(const char* input, size_t inputLength, size_t maxChunks, size_t* chunkEnds) {
+	if (maxChunks <= 1 || inputLength == 0) {
+		chunkEnds[0] = inputLength;
+		return 1;
+	}
+
+	const size_t target = inputLength / maxChunks;
+	size_t chunks = 0;
+	size_t nextSplit = target;
+	size_t depth = 0;
+	bool inString = false;
+
+	for (size_t i = 0; i < inputLength && chunks < maxChunks - 1; i++) {
+		const char ch = input[i];
+
+		//Strings have no escapes, the next quote always closes them
+		if (inString) {
+			inString = ch != '"';
+			continue;
+		}
+
+		switch (ch) {
+			case '"':
+				inString = true;
+				break;
+
+			case '(':
+			case '[':
+			case '{':
+				depth++;
+				break;
+
+			case ')':
+			case ']':
+			case '}':
+				//Unbalanced input still has to split somewhere, the parser reports the error
+				depth = depth > 0 ? depth - 1 : 0;
+				break;
+
+			case ';':
+				if (depth == 0 && i + 1 >= nextSplit) {
+					chunkEnds[chunks++] = i + 1;
+					nextSplit = i + 1 + target;
+				}
+				break;
+		}
+	}
+
+	//Input ending in a split `;` needs no empty last chunk
+	if (chunks == 0 || chunkEnds[chunks - 1] < inputLength) {
+		chunkEnds[chunks++] = inputLength;
+	}
+	return chunks;
+}
+
+static void parseChunk(void* arg) {
+	struct ParseChunk* chunk = (struct ParseChunk*)arg;
+	Parser parser = createParser(&chunk->lexer);
+	chunk->program = parseProgram(&parser);
+
+	//Keep the messages, freeParser only drops the array then
+	chunk->errorsLen = parser.errorsLen;
+	chunk->errors = (char**)malloc((parser.errorsLen + 1) * sizeof *chunk->errors);
+	if (!chunk->errors) {
+		perror("malloc (parse chunk errors) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(chunk->errors, parser.errors, parser.errorsLen * sizeof *parser.errors);
+	parser.errorsLen = 0;
+	freeParser(&parser);
+}
+
+struct ParallelParse parseProgramParallel(const char* input, size_t inputLength, size_t threadCount) {
+	const size_t maxByLength = inputLength / PARALLEL_PARSE_MIN_CHUNK + 1;
+	const size_t maxChunks = threadCount < maxByLength ? threadCount : maxByLength;
+
+	size_t* chunkEnds = (size_t*)malloc((maxChunks > 0 ? maxChunks : 1) * sizeof *chunkEnds);
+	if (!chunkEnds) {
+		perror("malloc (parallel parse chunk ends) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	const size_t chunkCount = splitTopLevelStatements(input, inputLength, maxChunks, chunkEnds);
+
+	struct ParseChunk* chunks = (struct ParseChunk*)malloc(chunkCount * sizeof *chunks);
+	if (!chunks) {
+		perror("malloc (parallel parse chunks) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	//Lexers are created up front so shared lexer state is set up before any thread runs
+	size_t chunkStart = 0;
+	for (size_t i = 0; i < chunkCount; i++) {
+		chunks[i].lexer = createLexerWithLength(input + chunkStart, chunkEnds[i] - chunkStart);
+		chunkStart = chunkEnds[i];
+	}
+
+	//The calling thread takes the first chunk, also the fallback if a thread can not be started
+	bool* started = (bool*)calloc(chunkCount, sizeof *started);
+	if (!started) {
+		perror("calloc (parallel parse threads) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 1; i < chunkCount; i++) {
+		started[i] = startThread(&chunks[i].thread, parseChunk, &chunks[i]);
+	}
+
+	for (size_t i = 0; i < chunkCount; i++) {
+		if (started[i]) {
+			joinThread(&chunks[i].thread);
+		}
+		else {
+			parseChunk(&chunks[i]);
+		}
+	}
+
+	//Concatenate in source order
+	size_t statementCount = 0;
+	size_t errorCount = 0;
+	for (size_t i = 0; i < chunkCount; i++) {
+		statementCount += chunks[i].program->size;
+		errorCount += chunks[i].errorsLen;
+	}
+
+	struct ParallelParse parse;
+	parse.program = (Program*)malloc(sizeof *parse.program);
+	parse.errors = (char**)malloc((errorCount + 1) * sizeof *parse.errors);
+	if (!parse.program || !parse.errors) {
+		perror("malloc (parallel parse result) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	parse.program->size = 0;
+	parse.program->cap = statementCount > 0 ? statementCount : 1;
+	parse.program->statements = (struct Statement*)malloc(parse.program->cap * sizeof *parse.program->statements);
+	if (!parse.program->statements) {
+		perror("malloc (parallel parse statements) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	parse.errorsLen = 0;
+
+	for (size_t i = 0; i < chunkCount; i++) {
+		Program* program = chunks[i].program;
+		memcpy(parse.program->statements + parse.program->size, program->statements, program->size * sizeof *program->statements);
+		parse.program->size += program->size;
+		//Statements moved over, only drop the chunk's array
+		free(program->statements);
+		free(program);
+
+		memcpy(parse.errors + parse.errorsLen, chunks[i].errors, chunks[i].errorsLen * sizeof *chunks[i].errors);
+		parse.errorsLen += chunks[i].errorsLen;
+		free(chunks[i].errors);
+	}
+
+	free(started);
+	free(chunks);
+	free(chunkEnds);
+	return parse;
+}
+
+void freeParallelParseErrors(struct ParallelParse* parse) {
+	for (size_t i = 0; i < parse->errorsLen; i++) {
+		free(parse->errors[i]);
+	}
+	free(parse->errors);
+	parse->errors = NULL;
+	parse->errorsLen = 0;
+}
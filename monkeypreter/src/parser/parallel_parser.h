@@ -0,0 +1,20 @@
+#pragma once
+#include "parser.h"
+
+//Inputs smaller than this are not worth splitting
+#define PARALLEL_PARSE_MIN_CHUNK (256 * 1024)
+
+struct ParallelParse {
+	Program* program;
+	//Errors of all chunks, in source order
+	size_t errorsLen;
+	char** errors;
+};
+
+//Splits input at top level `;` and lexes + parses the pieces on up to threadCount threads.
+//Statements end up in the same order as a serial parse
+struct ParallelParse parseProgramParallel(const char* input, size_t inputLength, size_t threadCount);
+void freeParallelParseErrors(struct ParallelParse* parse);
+//Chunk ends (exclusive) for at most maxChunks chunks, every chunk but the last ends right after a top level `;`.
+//Returns the number of chunks
+size_t splitTopLevelStatements(const char* input, size_t inputLength, size_t maxChunks, size_t* chunkEnds);
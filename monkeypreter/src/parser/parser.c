@@ -1,6 +1,7 @@
 #include "parser.h"
 #include <stdio.h>
 #include <string.h>
+#include "../evaluator/builtins.h"
 
 //Internal declarations
 void setParserNextToken(Parser* parser);
@@ -60,9 +61,11 @@ enum Precedence getTokenPrecedence(Token token) {
 	}
 }
 
-Parser createParser(Lexer* lexer) {
+static Parser initParser(Lexer* lexer, const TokenBuffer* tokens) {
 	Parser parser;
 	parser.lexer = lexer;
+	parser.tokens = tokens;
+	parser.tokenIndex = 0;
 	parser.errorsLen = 0;
 	//Init with space for 5 strings
 	parser.errorsCap = 5;
@@ -80,6 +83,31 @@ Parser createParser(Lexer* lexer) {
 	return parser;
 }
 
+Parser createParser(Lexer* lexer) {
+	return initParser(lexer, NULL);
+}
+
+Parser createParserFromTokens(const TokenBuffer* tokens) {
+	return initParser(NULL, tokens);
+}
+
+TokenType parserTokenAhead(const Parser* parser, size_t distance) {
+	if (distance == 0) {
+		return parser->curToken.type;
+	}
+
+	if (distance == 1) {
+		return parser->peekToken.type;
+	}
+
+	if (!parser->tokens) {
+		return TokenTypeIllegal;
+	}
+
+	const size_t index = parser->tokenIndex + distance - 2;
+	return index < parser->tokens->size ? (TokenType)parser->tokens->types[index] : TokenTypeEof;
+}
+
 void freeParser(Parser* parser) {
 
 	if (parser->errorsLen <= 0) {
@@ -103,6 +131,7 @@ struct Expression* createExpression(enum ExpressionType type, Token token) {
 
 	expr->type = type;
 	expr->token = token;
+	expr->constant = NULL;
 	return expr;
 }
 
@@ -128,7 +157,13 @@ struct BlockStatement* createBlockStatement(Token token) {
 
 void setParserNextToken(Parser* parser) {
 	parser->curToken = parser->peekToken;
-	parser->peekToken = nextToken(parser->lexer);
+
+	if (parser->tokens) {
+		parser->peekToken = getBufferedToken(parser->tokens, parser->tokenIndex++);
+	}
+	else {
+		parser->peekToken = nextToken(parser->lexer);
+	}
 }
 
 Program* parseProgram(Parser* parser) {
@@ -195,6 +230,7 @@ struct Statement parseLetStatement(Parser* parser) {
 	struct Identifier ident;
 	ident.token = parser->curToken;
 	strcpy_s(ident.value, MAX_IDENT_LENGTH, parser->curToken.literal);
+	ident.builtin = NULL;
 	stmt.identifier = ident;
 
 	if(!expectPeek(parser, TokenTypeAssign)) {
@@ -321,6 +357,7 @@ struct Expression* parseIdentExpr(Parser* parser) {
 	struct Expression* expr = createExpression(EXPR_IDENT, parser->curToken);
 	expr->ident.token = expr->token;
 	strcpy_s(expr->ident.value, MAX_IDENT_LENGTH, parser->curToken.literal);
+	expr->ident.builtin = resolveBuiltin(expr->ident.value);
 	return expr;
 }
 
@@ -458,6 +495,10 @@ struct Expression* parseFunctionLiteralExpr(Parser* parser) {
 	}
 
 	expr->function.body = parseBlockStatement(parser);
+	expr->function.captures = NULL;
+	expr->function.capturesLen = 0;
+	expr->function.flat = false;
+	expr->function.freesFrame = false;
 
 	return expr;
 }
@@ -475,6 +516,7 @@ struct IdentifierList parseFunctionParameters(Parser* parser) {
 	struct Identifier ident;
 	ident.token = parser->curToken;
 	strcpy_s(ident.value, MAX_IDENT_LENGTH, parser->curToken.literal);
+	ident.builtin = NULL;
 
 	params.values = (struct Identifier*) malloc(params.cap * sizeof *params.values);
 
@@ -492,6 +534,7 @@ struct IdentifierList parseFunctionParameters(Parser* parser) {
 
 		ident.token = parser->curToken;
 		strcpy_s(ident.value, MAX_IDENT_LENGTH, parser->curToken.literal);
+		ident.builtin = NULL;
 
 		if(params.size >= params.cap) {
 			params.cap *= 2;
@@ -519,6 +562,7 @@ struct Expression* parseCallExpression(Parser* parser, struct Expression* left)
 	expr->call.token = parser->curToken;
 	expr->call.function = left;
 	expr->call.arguments = parseExpressionList(parser, TokenTypeRParen);
+	memset(&expr->call.cache, 0, sizeof expr->call.cache);
 	return expr;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "../lexer/lexer.h"
+#include "../lexer/token_buffer.h"
 #include "ast.h"
 
 enum Precedence {
@@ -15,6 +16,10 @@ enum Precedence {
 
 typedef struct SParser {
 	Lexer* lexer;
+	//Set when walking pre-lexed tokens instead of pulling them from lexer
+	const TokenBuffer* tokens;
+	//Index of the token after peekToken
+	size_t tokenIndex;
 	Token curToken;
 	Token peekToken;
 
@@ -26,6 +31,10 @@ typedef struct SParser {
 } Parser;
 
 Parser createParser(Lexer* lexer);
+//The same buffer can be parsed any number of times without lexing again
+Parser createParserFromTokens(const TokenBuffer* tokens);
+//Type of the token `distance` tokens after curToken, more than one ahead needs a token buffer
+TokenType parserTokenAhead(const Parser* parser, size_t distance);
 //Constructs AST, returns head for eval phase 
 Program* parseProgram(Parser* parser);
 void freeParser(Parser* parser);
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include <string.h>
 #include "lexer/lexer.h"
 #include "parser/parser.h"
+#include "parser/optimizer.h"
 #include "evaluator/object.h"
+#include "evaluator/constants.h"
 #include "evaluator/environment.h"
 #include "evaluator/evaluator.h"
 #include "evaluator/gc.h"
@@ -35,6 +37,11 @@ inline void repl(void) {
 	struct MonkeyGC* gc = createMonkeyGC();
 	struct ObjectEnvironment* env = newEnvironment(gc);
 
+	//Functions and constants point into the AST of the line that created them, every program lives until exit
+	Program** programs = NULL;
+	size_t programsLen = 0;
+	size_t programsCap = 0;
+
 	while (true) {
 		char inputBuffer[1024];
 		printf(">> ");
@@ -60,6 +67,8 @@ inline void repl(void) {
 		}
 
 
+		optimizeProgram(program);
+		bindConstants(program);
 		struct Object* evaluated = evalProgram(program, env);
 
 
@@ -70,11 +79,26 @@ inline void repl(void) {
 		}
 		
 
+		if (programsLen >= programsCap) {
+			programsCap = programsCap ? programsCap * 2 : 16;
+			Program** tmp = (Program**)realloc(programs, programsCap * sizeof *programs);
+			if (!tmp) {
+				perror("realloc (repl programs) returned `NULL`\n");
+				exit(EXIT_FAILURE);
+			}
+			programs = tmp;
+		}
+		programs[programsLen++] = program;
+
 		//Clean up memory
-		freeProgram(program);
 		freeParser(&parser);
 	}
 
 	deleteEnvironment(env);
 	deleteMonkeyGC(gc);
+
+	for (size_t i = 0; i < programsLen; i++) {
+		freeProgram(programs[i]);
+	}
+	free(programs);
 }
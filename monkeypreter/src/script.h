@@ -0,0 +1,256 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include "lexer/lexer.h"
+#include "lexer/token_buffer.h"
+#include "parser/parser.h"
+#include "parser/parallel_parser.h"
+#include "parser/optimizer.h"
+#include "parser/compact_ast.h"
+#include "parser/ast_cache.h"
+#include "evaluator/object.h"
+#include "evaluator/environment.h"
+#include "evaluator/evaluator.h"
+#include "evaluator/compact_evaluator.h"
+#include "evaluator/closure_compiler.h"
+#include "evaluator/constants.h"
+#include "evaluator/gc.h"
+#include "vm/vm_compiler.h"
+#include "vm/vm.h"
+#include "vm/disassembler.h"
+#include "transpiler/transpiler.h"
+#include "util/mapped_file.h"
+#include "util/thread.h"
+
+inline double elapsedMs(const struct timespec* start, const struct timespec* end) {
+	return (double)(end->tv_sec - start->tv_sec) * 1000.0 + (double)(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+inline void printScriptErrors(char** errors, size_t errorsLen) {
+	printf("Oopsie daisy! We ran into some monkey business!\n");
+	printf("Parser errors\n");
+	for (size_t i = 0; i < errorsLen; i++) {
+		printf("\t - Parser error %llu: %s\n", (unsigned long long)(i + 1), errors[i]);
+	}
+}
+
+struct ScriptOptions {
+	//Store the compact AST per source hash and map it back in on the next run
+	bool useCache;
+	//Print the bytecode to stdout instead of running it
+	bool disassemble;
+	//Keep hot functions in the interpreter instead of compiling them to native code
+	bool noJit;
+	//Walk the compact AST with the quickening interpreter instead of compiling it
+	bool interpret;
+};
+
+//Runs a whole source file straight from a read only mapping, timings go to stderr.
+//Large files are split at top level statements and parsed on all cores,
+//the program is then optimized, flattened into a compact AST and compiled into register VM bytecode,
+//with every literal built once up front.
+//Programs the VM can not hold (more than 65535 registers in one function) run as C function pointers instead.
+//On Linux x86-64 functions called often enough are compiled to native code.
+//The register VM is the engine scripts run on, the others have to print the same.
+//With options.interpret nothing is compiled, the compact AST (the cache mapping on a hit) is evaluated
+//directly and quickened in place, for scripts too short to pay for compiling them
+inline int runScript(const char* path, struct ScriptOptions options) {
+	bool useCache = options.useCache;
+	struct timespec loadStart, cacheStart, lexStart, parseStart, evalStart, evalEnd;
+
+	timespec_get(&loadStart, TIME_UTC);
+	struct MappedFile source;
+	if (!mapFile(path, &source)) {
+		return EXIT_FAILURE;
+	}
+
+	const char* input = source.data ? source.data : "";
+	const size_t threadCount = hardwareThreadCount();
+	const bool parallel = threadCount > 1 && source.size >= 2 * PARALLEL_PARSE_MIN_CHUNK;
+
+	timespec_get(&cacheStart, TIME_UTC);
+	char cacheDir[AST_CACHE_MAX_PATH];
+	char cachePath[AST_CACHE_MAX_PATH];
+	uint64_t sourceHash = 0;
+	struct AstCache cache = { 0 };
+	bool cached = false;
+	bool cacheWritten = false;
+	if (useCache) {
+		sourceHash = astCacheHash(input, source.size);
+		useCache = defaultAstCacheDir(cacheDir, sizeof cacheDir) && astCachePath(cacheDir, sourceHash, cachePath, sizeof cachePath);
+		cached = useCache && openAstCache(cachePath, sourceHash, source.size, &cache);
+	}
+
+	Program* program = NULL;
+	char** errors = NULL;
+	size_t errorsLen = 0;
+	TokenBuffer tokens = { 0 };
+	Parser parser = { 0 };
+	struct ParallelParse parallelParse = { 0 };
+
+	timespec_get(&lexStart, TIME_UTC);
+	if (cached) {
+		parseStart = lexStart;
+	}
+	else if (parallel) {
+		//Every chunk is lexed and parsed in one go, so there is no separate lex time
+		parseStart = lexStart;
+		parallelParse = parseProgramParallel(input, source.size, threadCount);
+		program = parallelParse.program;
+		errors = parallelParse.errors;
+		errorsLen = parallelParse.errorsLen;
+	}
+	else {
+		Lexer lexer = createLexerWithLength(input, source.size);
+		tokens = createTokenBuffer(&lexer);
+
+		timespec_get(&parseStart, TIME_UTC);
+		parser = createParserFromTokens(&tokens);
+		program = parseProgram(&parser);
+		errors = parser.errors;
+		errorsLen = parser.errorsLen;
+	}
+
+	struct CompactAst* ast = cached ? &cache.ast : NULL;
+	struct MonkeyGC* gc = NULL;
+	struct ObjectEnvironment* env = NULL;
+	struct CompiledProgram* compiled = NULL;
+	struct VmProgram* vmProgram = NULL;
+	bool failed = errorsLen != 0;
+	if (!cached && !failed) {
+		optimizeProgram(program);
+		//Nothing points into the pointer tree after this
+		ast = compactProgram(program);
+		freeProgram(program);
+		program = NULL;
+
+		//Programs with errors are never cached, they are parsed again to report them
+		if (useCache) {
+			cacheWritten = createAstCacheDir(cacheDir) && writeAstCache(cachePath, ast, sourceHash, source.size);
+		}
+	}
+
+	timespec_get(&evalStart, TIME_UTC);
+	if (failed) {
+		printScriptErrors(errors, errorsLen);
+		evalEnd = evalStart;
+	}
+	else {
+		bindCompactConstants(ast);
+		if (!options.interpret) {
+			vmProgram = compileVmProgram(ast);
+			if (!vmProgram) {
+				compiled = compileProgram(ast);
+			}
+			else if (options.noJit) {
+				vmProgram->jitThreshold = 0;
+			}
+		}
+		if (options.disassemble) {
+			if (vmProgram) {
+				printVmProgram(stdout, vmProgram);
+			}
+			else if (options.interpret) {
+				printf("The program is interpreted from the compact AST, there is no bytecode\n");
+			}
+			else {
+				printf("The program does not fit the register VM, it runs as C function pointers\n");
+			}
+			fflush(stdout);
+			timespec_get(&evalEnd, TIME_UTC);
+		}
+		else {
+			gc = createMonkeyGC();
+			env = newEnvironment(gc);
+			struct Object* evaluated = vmProgram ? evalVmProgram(vmProgram, env)
+				: compiled ? evalCompiledProgram(compiled, env) : evalCompactProgram(ast, env);
+			fflush(stdout);
+			timespec_get(&evalEnd, TIME_UTC);
+
+			failed = evaluated->type == OBJ_ERROR;
+			if (failed) {
+				char* objStr = inspectObject(evaluated);
+				printf("%s\n", objStr);
+				free(objStr);
+			}
+		}
+	}
+
+	fprintf(stderr, "%s: %llu bytes\n", path, (unsigned long long)source.size);
+	fprintf(stderr, "\t - load:  %.3f ms\n", elapsedMs(&loadStart, &cacheStart));
+	if (useCache) {
+		fprintf(stderr, "\t - cache: %.3f ms (%s)\n", elapsedMs(&cacheStart, &lexStart), cached ? "hit" : cacheWritten ? "miss, written" : "miss");
+	}
+	if (!cached && parallel) {
+		fprintf(stderr, "\t - lex + parse: %.3f ms (%llu threads)\n", elapsedMs(&parseStart, &evalStart), (unsigned long long)threadCount);
+	}
+	else if (!cached) {
+		fprintf(stderr, "\t - lex:   %.3f ms (%llu tokens)\n", elapsedMs(&lexStart, &parseStart), (unsigned long long)tokens.size);
+		fprintf(stderr, "\t - parse: %.3f ms\n", elapsedMs(&parseStart, &evalStart));
+	}
+	if (ast) {
+		fprintf(stderr, "\t - ast:   %llu nodes, %llu bytes (pointer tree %llu bytes), %llu constants\n", (unsigned long long)ast->nodesLen,
+			(unsigned long long)compactAstBytes(ast), (unsigned long long)ast->treeBytes, (unsigned long long)ast->constantsLen);
+	}
+	fprintf(stderr, "\t - eval:  %.3f ms\n", elapsedMs(&evalStart, &evalEnd));
+
+	if (env) {
+		deleteEnvironment(env);
+		deleteMonkeyGC(gc);
+	}
+
+	freeVmProgram(vmProgram);
+	freeCompiledProgram(compiled);
+	if (program) {
+		freeProgram(program);
+	}
+	if (ast) {
+		freeCompactConstants(ast);
+	}
+	if (cached) {
+		closeAstCache(&cache);
+	}
+	else {
+		freeCompactAst(ast);
+	}
+	if (parallel) {
+		freeParallelParseErrors(&parallelParse);
+	}
+	else {
+		freeParser(&parser);
+		freeTokenBuffer(&tokens);
+	}
+	unmapFile(&source);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//Writes the program as C to stdout instead of running it, see transpiler.h.
+//The C is generated from the optimized AST, so it prints the same as the interpreter would
+inline int emitCScript(const char* path) {
+	struct MappedFile source;
+	if (!mapFile(path, &source)) {
+		return EXIT_FAILURE;
+	}
+
+	Lexer lexer = createLexerWithLength(source.data ? source.data : "", source.size);
+	TokenBuffer tokens = createTokenBuffer(&lexer);
+	Parser parser = createParserFromTokens(&tokens);
+	Program* program = parseProgram(&parser);
+
+	const bool failed = parser.errorsLen != 0;
+	if (failed) {
+		printScriptErrors(parser.errors, parser.errorsLen);
+	}
+	else {
+		optimizeProgram(program);
+		printCProgram(stdout, program);
+		fflush(stdout);
+	}
+
+	freeProgram(program);
+	freeParser(&parser);
+	freeTokenBuffer(&tokens);
+	unmapFile(&source);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#pragma once
+//Included by the C the transpiler writes, never by the interpreter itself.
+//Operators take the integer fast path inline and leave everything else to the evaluator,
+//so a compiled program fails with the same errors the interpreter reports
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/array.h"
+#include "../evaluator/builtins.h"
+#include "../evaluator/environment.h"
+#include "../evaluator/evaluator.h"
+#include "../evaluator/gc.h"
+#include "../evaluator/object.h"
+
+typedef struct Object* (*MonkeyStatement)(struct ObjectEnvironment* env, struct MonkeyGC* gc);
+
+static inline bool monkeyIsError(const struct Object* obj) {
+	return obj->type == OBJ_ERROR;
+}
+
+static inline bool monkeyTruthy(struct Object* obj) {
+	return obj == &TrueObj || (obj != &FalseObj && isTruthy(obj));
+}
+
+static inline struct Object* monkeyInteger(struct MonkeyGC* gc, int64_t value) {
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = value;
+	return obj;
+}
+
+//Literals are created once before the first statement runs
+static inline struct Object* monkeyIntegerConstant(int64_t value) {
+	struct Object* obj = createImmortalObject(OBJ_INT);
+	obj->value.integer = value;
+	return obj;
+}
+
+//Literals are shorter than MAX_IDENT_LENGTH
+static inline struct Object* monkeyStringConstant(const char* value) {
+	struct Object* obj = createImmortalObject(OBJ_STRING);
+	memcpy(obj->value.string, value, strlen(value) + 1);
+	return obj;
+}
+
+//Names that are no local of the function, same lookup as evalIdentifier
+static inline struct Object* monkeyLookup(struct ObjectEnvironment* env, const char* name, uint32_t hash) {
+	struct Object* obj = environmentGetHashed(env, name, hash);
+	if (obj->type != OBJ_NULL) {
+		return obj;
+	}
+
+	obj = getBuiltin(name);
+	if (obj->type != OBJ_NULL) {
+		return obj;
+	}
+
+	return newEvalError(env->gc, "identifier not found: %s", name);
+}
+
+//Names of builtins, bound to the builtin when the program was transpiled
+static inline struct Object* monkeyLookupBuiltin(struct ObjectEnvironment* env, const char* name, uint32_t hash, struct Object* builtin) {
+	if (!isBuiltinShadowed(builtin)) {
+		return builtin;
+	}
+
+	struct Object* obj = environmentGetHashed(env, name, hash);
+	return obj->type != OBJ_NULL ? obj : builtin;
+}
+
+//Integer operators wrap around like in the VM, division leaves 0 and INT64_MIN / -1 to evalInfixExpression
+#define MONKEY_INT_OPERATOR(name, operatorType, guard, result) \
+	static inline struct Object* name(struct Object* left, struct Object* right, struct MonkeyGC* gc) { \
+		if (left->type == OBJ_INT && right->type == OBJ_INT) { \
+			const int64_t l = left->value.integer; \
+			const int64_t r = right->value.integer; \
+			if (guard) { \
+				return result; \
+			} \
+		} \
+		return evalInfixExpression(operatorType, left, right, gc); \
+	}
+
+MONKEY_INT_OPERATOR(monkeyAdd, OP_ADD, true, monkeyInteger(gc, (int64_t)((uint64_t)l + (uint64_t)r)))
+MONKEY_INT_OPERATOR(monkeySubtract, OP_SUBTRACT, true, monkeyInteger(gc, (int64_t)((uint64_t)l - (uint64_t)r)))
+MONKEY_INT_OPERATOR(monkeyMultiply, OP_MULTIPLY, true, monkeyInteger(gc, (int64_t)((uint64_t)l * (uint64_t)r)))
+MONKEY_INT_OPERATOR(monkeyDivide, OP_DIVIDE, r != 0 && (r != -1 || l != INT64_MIN), monkeyInteger(gc, l / r))
+MONKEY_INT_OPERATOR(monkeyLess, OP_LT, true, nativeBoolToBoolObj(l < r))
+MONKEY_INT_OPERATOR(monkeyGreater, OP_GT, true, nativeBoolToBoolObj(l > r))
+MONKEY_INT_OPERATOR(monkeyEqual, OP_EQ, true, nativeBoolToBoolObj(l == r))
+MONKEY_INT_OPERATOR(monkeyNotEqual, OP_NOT_EQ, true, nativeBoolToBoolObj(l != r))
+
+#undef MONKEY_INT_OPERATOR
+
+static inline struct Object* monkeyNegate(struct Object* right, struct MonkeyGC* gc) {
+	if (right->type == OBJ_INT) {
+		return monkeyInteger(gc, (int64_t)(0 - (uint64_t)right->value.integer));
+	}
+	return evalPrefixExpression(OP_SUBTRACT, right, gc);
+}
+
+static inline struct Object* monkeyNot(struct Object* right) {
+	return nativeBoolToBoolObj(right->type == OBJ_BOOL ? !right->value.boolean : right->type == OBJ_NULL);
+}
+
+static inline struct Object* monkeyIndex(struct Object* left, struct Object* index, struct MonkeyGC* gc) {
+	if (left->type == OBJ_ARRAY && index->type == OBJ_INT) {
+		const int64_t i = index->value.integer;
+		return i < 0 || (size_t)i >= arrayLength(left) ? &NullObj : arrayGet(gc, left, (size_t)i);
+	}
+	return evalIndexExpression(left, index, gc);
+}
+
+static inline struct Object* monkeyArray(struct Object** elements, size_t count, struct MonkeyGC* gc) {
+	struct ObjectList list = { count, count, elements };
+	return arrayFromList(gc, &list);
+}
+
+//Calls of anything but a known function, through applyFunction like in the evaluator
+static inline struct Object* monkeyCall(struct Object* callee, struct Object** args, size_t count, struct MonkeyGC* gc) {
+	struct ObjectList list = { count, count, args };
+	return applyFunction(callee, &list, gc);
+}
+
+//Missing arguments are NULL, their parameters stay unbound
+static inline struct Object* monkeyArgument(const struct ObjectList* args, size_t index) {
+	return index < args->size ? args->objects[index] : NULL;
+}
+
+static inline struct Object* monkeyClosure(struct MonkeyGC* gc, struct ObjectEnvironment* env, const struct NativeFunction* native) {
+	struct Object* obj = createObject(gc, OBJ_FUNCTION);
+	memset(&obj->value.function, 0, sizeof obj->value.function);
+	obj->value.function.env = env;
+	obj->value.function.native = native;
+	return obj;
+}
+
+//A top level return stops the program
+static inline struct Object* monkeyReturn(struct MonkeyGC* gc, struct Object* value) {
+	struct Object* obj = createObject(gc, OBJ_RETURN);
+	obj->value.retObj = value;
+	return obj;
+}
+
+//Same loop as evalProgram, then an error is printed like runScript does
+static inline int monkeyRun(const MonkeyStatement* statements, size_t count) {
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+
+	struct Object* obj = &NullObj;
+	for (size_t i = 0; i < count; i++) {
+		obj = statements[i](env, gc);
+		markMonkeyObject(obj);
+		if (gc->size >= gc->maxSize) {
+			collectMonkeyGarbage(gc, env);
+		}
+
+		if (obj->type == OBJ_RETURN || monkeyIsError(obj)) {
+			break;
+		}
+	}
+	fflush(stdout);
+
+	const bool failed = monkeyIsError(obj);
+	if (failed) {
+		char* objStr = inspectObject(obj);
+		printf("%s\n", objStr);
+		free(objStr);
+	}
+
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,970 @@
+#include "transpiler.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/builtins.h"
+#include "../evaluator/hash_map.h"
+
+//No temporary, the value is NullObj
+#define C_NO_TEMP UINT32_MAX
+
+struct CNameList {
+	const char** names;
+	size_t len;
+	size_t cap;
+};
+
+//Parameter or `let` binding of the function being written. Both start out unbound,
+//a missing argument leaves its parameter that way
+struct CLocal {
+	const char* name;
+	//Read by a nested function, lives in the environment of the call like in the VM
+	bool captured;
+};
+
+//Top level function bound by exactly one `let`. Calls through its name that no function shadows
+//compare the callee with it and call the C function directly
+struct KnownFunction {
+	const char* name;
+	const struct Expression* literal;
+	uint32_t index;
+};
+
+struct Transpiler {
+	//Prototypes and the statics holding literals and known functions
+	struct Writer declarations;
+	//Nested functions come before the function they appear in
+	struct Writer definitions;
+	//Creates the literals at the start of main
+	struct Writer initializers;
+	struct KnownFunction* known;
+	size_t knownLen;
+	uint32_t functionsLen;
+	uint32_t constantsLen;
+	uint32_t statementsLen;
+};
+
+//C function being written, a function literal or a top level statement
+struct CFunction {
+	struct Transpiler* transpiler;
+	struct Writer out;
+	const struct CFunction* outer;
+	struct CLocal* locals;
+	size_t localsLen;
+	size_t localsCap;
+	uint32_t temps;
+	uint32_t depth;
+	//Binds into the global environment and wraps its `return`
+	bool topLevel;
+};
+
+static const char* const cOperatorNames[] = {
+	"OP_UNKNOWN", "OP_ADD", "OP_SUBTRACT", "OP_MULTIPLY", "OP_DIVIDE", "OP_GT", "OP_LT", "OP_EQ", "OP_NOT_EQ", "OP_NEGATE",
+};
+
+//Runtime helper of every infix operator, NULL where evalInfixExpression reports the error
+static const char* const cInfixHelpers[] = {
+	NULL, "monkeyAdd", "monkeySubtract", "monkeyMultiply", "monkeyDivide", "monkeyGreater", "monkeyLess", "monkeyEqual", "monkeyNotEqual", NULL,
+};
+
+static uint32_t writeCExpression(struct CFunction* f, const struct Expression* expr);
+static uint32_t writeCStatements(struct CFunction* f, const struct BlockStatement* bs);
+
+static void addCName(struct CNameList* list, const char* name) {
+	if (list->len == list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 8;
+		list->names = (const char**)realloc((void*)list->names, list->cap * sizeof *list->names);
+		if (!list->names) {
+			perror("realloc (transpiler names) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	list->names[list->len++] = name;
+}
+
+static size_t countCName(const struct CNameList* list, const char* name) {
+	size_t count = 0;
+	for (size_t i = 0; i < list->len; i++) {
+		count += strcmp(list->names[i], name) == 0;
+	}
+	return count;
+}
+
+static void collectCLets(struct CNameList* lets, const struct Expression* expr);
+
+//Every `let` of the block, nested functions bind into their own environment
+static void collectCBlockLets(struct CNameList* lets, const struct BlockStatement* bs) {
+	if (!bs) {
+		return;
+	}
+
+	for (size_t i = 0; i < bs->size; i++) {
+		const struct Statement* stmt = &bs->statements[i];
+		if (stmt->type == STMT_LET) {
+			addCName(lets, stmt->identifier.value);
+		}
+		if (stmt->expr) {
+			collectCLets(lets, stmt->expr);
+		}
+	}
+}
+
+static void collectCListLets(struct CNameList* lets, const struct ExpressionList* list) {
+	for (size_t i = 0; i < list->size; i++) {
+		collectCLets(lets, list->values[i]);
+	}
+}
+
+static void collectCLets(struct CNameList* lets, const struct Expression* expr) {
+	switch (expr->type) {
+		case EXPR_PREFIX:
+			collectCLets(lets, expr->prefix.right);
+			break;
+
+		case EXPR_INFIX:
+			collectCLets(lets, expr->infix.left);
+			collectCLets(lets, expr->infix.right);
+			break;
+
+		case EXPR_IF:
+			collectCLets(lets, expr->ifelse.condition);
+			collectCBlockLets(lets, expr->ifelse.consequence);
+			collectCBlockLets(lets, expr->ifelse.alternative);
+			break;
+
+		case EXPR_CALL:
+			collectCLets(lets, expr->call.function);
+			collectCListLets(lets, &expr->call.arguments);
+			break;
+
+		case EXPR_ARRAY:
+			collectCListLets(lets, &expr->array.elements);
+			break;
+
+		case EXPR_INDEX:
+			collectCLets(lets, expr->indexExpr.left);
+			collectCLets(lets, expr->indexExpr.index);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static struct CLocal* findCLocal(const struct CFunction* f, const char* name) {
+	for (size_t i = 0; i < f->localsLen; i++) {
+		if (strcmp(f->locals[i].name, name) == 0) {
+			return &f->locals[i];
+		}
+	}
+	return NULL;
+}
+
+//Equal parameter names share one local, the last argument is assigned last like in environmentSet
+static void addCLocal(struct CFunction* f, const char* name) {
+	if (findCLocal(f, name)) {
+		return;
+	}
+
+	if (f->localsLen == f->localsCap) {
+		f->localsCap = f->localsCap ? f->localsCap * 2 : 8;
+		f->locals = (struct CLocal*)realloc(f->locals, f->localsCap * sizeof *f->locals);
+		if (!f->locals) {
+			perror("realloc (transpiler locals) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	f->locals[f->localsLen].name = name;
+	f->locals[f->localsLen].captured = false;
+	f->localsLen++;
+}
+
+static void markCCaptured(struct CFunction* f, const struct Expression* expr, bool nested);
+
+static void markCBlockCaptured(struct CFunction* f, const struct BlockStatement* bs, bool nested) {
+	if (!bs) {
+		return;
+	}
+
+	for (size_t i = 0; i < bs->size; i++) {
+		if (bs->statements[i].expr) {
+			markCCaptured(f, bs->statements[i].expr, nested);
+		}
+	}
+}
+
+static void markCListCaptured(struct CFunction* f, const struct ExpressionList* list, bool nested) {
+	for (size_t i = 0; i < list->size; i++) {
+		markCCaptured(f, list->values[i], nested);
+	}
+}
+
+//Same rule as the VM compiler: every local a nested function names, even one it binds itself
+static void markCCaptured(struct CFunction* f, const struct Expression* expr, bool nested) {
+	switch (expr->type) {
+		case EXPR_IDENT: {
+			struct CLocal* local = nested ? findCLocal(f, expr->ident.value) : NULL;
+			if (local) {
+				local->captured = true;
+			}
+			break;
+		}
+
+		case EXPR_FUNCTION:
+			markCBlockCaptured(f, expr->function.body, true);
+			break;
+
+		case EXPR_PREFIX:
+			markCCaptured(f, expr->prefix.right, nested);
+			break;
+
+		case EXPR_INFIX:
+			markCCaptured(f, expr->infix.left, nested);
+			markCCaptured(f, expr->infix.right, nested);
+			break;
+
+		case EXPR_IF:
+			markCCaptured(f, expr->ifelse.condition, nested);
+			markCBlockCaptured(f, expr->ifelse.consequence, nested);
+			markCBlockCaptured(f, expr->ifelse.alternative, nested);
+			break;
+
+		case EXPR_CALL:
+			markCCaptured(f, expr->call.function, nested);
+			markCListCaptured(f, &expr->call.arguments, nested);
+			break;
+
+		case EXPR_ARRAY:
+			markCListCaptured(f, &expr->array.elements, nested);
+			break;
+
+		case EXPR_INDEX:
+			markCCaptured(f, expr->indexExpr.left, nested);
+			markCCaptured(f, expr->indexExpr.index, nested);
+			break;
+
+		default:
+			break;
+	}
+}
+
+//Known function a name refers to, unless a local of this or an enclosing function shadows it
+static const struct KnownFunction* resolveCKnown(const struct CFunction* f, const char* name) {
+	for (const struct CFunction* scope = f; scope; scope = scope->outer) {
+		if (findCLocal(scope, name)) {
+			return NULL;
+		}
+	}
+
+	const struct Transpiler* t = f->transpiler;
+	for (size_t i = 0; i < t->knownLen; i++) {
+		if (strcmp(t->known[i].name, name) == 0) {
+			return &t->known[i];
+		}
+	}
+	return NULL;
+}
+
+//Escaped C string literal. Split pieces start a new line after every newline of the text
+static void writeCString(struct Writer* writer, const char* text, bool split) {
+	writeChar(writer, '"');
+	for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+		switch (*c) {
+			case '\\': writeStr(writer, "\\\\"); break;
+			case '"': writeStr(writer, "\\\""); break;
+			case '\r': writeStr(writer, "\\r"); break;
+			case '\t': writeStr(writer, "\\t"); break;
+			//No trigraphs
+			case '?': writeStr(writer, "\\?"); break;
+
+			case '\n':
+				writeStr(writer, "\\n");
+				if (split && c[1]) {
+					writeStr(writer, "\"\n\t\"");
+				}
+				break;
+
+			default:
+				if (*c < 0x20 || *c >= 0x7f) {
+					char octal[8];
+					snprintf(octal, sizeof octal, "\\%03o", *c);
+					writeStr(writer, octal);
+				}
+				else {
+					writeChar(writer, (char)*c);
+				}
+				break;
+		}
+	}
+	writeChar(writer, '"');
+}
+
+static void writeCIndent(struct CFunction* f) {
+	for (uint32_t i = 0; i < f->depth; i++) {
+		writeChar(&f->out, '\t');
+	}
+}
+
+static void writeCValue(struct Writer* writer, char prefix, uint32_t number) {
+	if (number == C_NO_TEMP) {
+		writeStr(writer, "&NullObj");
+		return;
+	}
+	writeChar(writer, prefix);
+	writeInt(writer, number);
+}
+
+//Starts `struct Object* tN = `, the caller writes the value and ends the line
+static uint32_t beginCTemp(struct CFunction* f) {
+	const uint32_t temp = f->temps++;
+	writeCIndent(f);
+	writeStr(&f->out, "struct Object* t");
+	writeInt(&f->out, temp);
+	writeStr(&f->out, " = ");
+	return temp;
+}
+
+static void writeCErrorCheck(struct CFunction* f, uint32_t temp) {
+	writeCIndent(f);
+	writeStr(&f->out, "if (monkeyIsError(t");
+	writeInt(&f->out, temp);
+	writeStr(&f->out, ")) return t");
+	writeInt(&f->out, temp);
+	writeStr(&f->out, ";\n");
+}
+
+static void writeCNameArguments(struct Writer* writer, const char* name) {
+	writeChar(writer, '"');
+	writeStr(writer, name);
+	writeStr(writer, "\", UINT32_C(");
+	writeInt(writer, hashString(name));
+	writeChar(writer, ')');
+}
+
+static void writeCLookup(struct Writer* writer, const char* name) {
+	const struct Object* builtin = resolveBuiltin(name);
+	if (builtin) {
+		writeStr(writer, "monkeyLookupBuiltin(env, ");
+		writeCNameArguments(writer, name);
+		writeStr(writer, ", &builtinFunctionsObjects[");
+		writeInt(writer, builtin - builtinFunctionsObjects);
+		writeStr(writer, "])");
+		return;
+	}
+
+	writeStr(writer, "monkeyLookup(env, ");
+	writeCNameArguments(writer, name);
+	writeChar(writer, ')');
+}
+
+static uint32_t addCConstant(struct Transpiler* t, const struct Expression* expr) {
+	const uint32_t index = t->constantsLen++;
+	writeStr(&t->declarations, "static struct Object* constant");
+	writeInt(&t->declarations, index);
+	writeStr(&t->declarations, ";\n");
+
+	writeStr(&t->initializers, "\tconstant");
+	writeInt(&t->initializers, index);
+	if (expr->type == EXPR_INT) {
+		writeStr(&t->initializers, " = monkeyIntegerConstant(");
+		if (expr->integer == INT64_MIN) {
+			writeStr(&t->initializers, "INT64_MIN");
+		}
+		else {
+			writeStr(&t->initializers, "INT64_C(");
+			writeInt(&t->initializers, expr->integer);
+			writeChar(&t->initializers, ')');
+		}
+	}
+	else {
+		writeStr(&t->initializers, " = monkeyStringConstant(");
+		writeCString(&t->initializers, expr->string, false);
+	}
+	writeStr(&t->initializers, ");\n");
+	return index;
+}
+
+static uint32_t writeCIdentifier(struct CFunction* f, const char* name) {
+	const struct CLocal* local = findCLocal(f, name);
+	const struct KnownFunction* known = local ? NULL : resolveCKnown(f, name);
+	const uint32_t temp = beginCTemp(f);
+
+	if (local && !local->captured) {
+		writeStr(&f->out, "m_");
+		writeStr(&f->out, name);
+		//Not bound yet, the name still means whatever it means outside
+		writeStr(&f->out, " ? m_");
+		writeStr(&f->out, name);
+		writeStr(&f->out, " : ");
+	}
+	else if (known) {
+		writeStr(&f->out, "known");
+		writeInt(&f->out, known->index);
+		writeStr(&f->out, " ? known");
+		writeInt(&f->out, known->index);
+		writeStr(&f->out, " : ");
+	}
+	writeCLookup(&f->out, name);
+	writeStr(&f->out, ";\n");
+	writeCErrorCheck(f, temp);
+	return temp;
+}
+
+//Binds the value to name in the function's local or the environment
+static void writeCBinding(struct CFunction* f, const char* name, char prefix, uint32_t value) {
+	const struct CLocal* local = findCLocal(f, name);
+	writeCIndent(f);
+	if (local && !local->captured) {
+		writeStr(&f->out, "m_");
+		writeStr(&f->out, name);
+		writeStr(&f->out, " = ");
+		writeCValue(&f->out, prefix, value);
+		writeStr(&f->out, ";\n");
+		return;
+	}
+
+	writeStr(&f->out, "environmentSetHashed(env, ");
+	writeCNameArguments(&f->out, name);
+	writeStr(&f->out, ", ");
+	writeCValue(&f->out, prefix, value);
+	writeStr(&f->out, ");\n");
+
+	const struct KnownFunction* known = f->topLevel ? resolveCKnown(f, name) : NULL;
+	if (known) {
+		writeCIndent(f);
+		writeStr(&f->out, "known");
+		writeInt(&f->out, known->index);
+		writeStr(&f->out, " = ");
+		writeCValue(&f->out, prefix, value);
+		writeStr(&f->out, ";\n");
+	}
+}
+
+static void writeCBranch(struct CFunction* f, const struct BlockStatement* bs, uint32_t result) {
+	f->depth++;
+	const uint32_t value = writeCStatements(f, bs);
+	if (value != C_NO_TEMP) {
+		writeCIndent(f);
+		writeChar(&f->out, 't');
+		writeInt(&f->out, result);
+		writeStr(&f->out, " = t");
+		writeInt(&f->out, value);
+		writeStr(&f->out, ";\n");
+	}
+	f->depth--;
+	writeCIndent(f);
+	writeStr(&f->out, "}\n");
+}
+
+static uint32_t writeCIf(struct CFunction* f, const struct IfExpression* ifelse) {
+	const uint32_t condition = writeCExpression(f, ifelse->condition);
+	const uint32_t result = beginCTemp(f);
+	writeStr(&f->out, "&NullObj;\n");
+
+	writeCIndent(f);
+	writeStr(&f->out, "if (monkeyTruthy(t");
+	writeInt(&f->out, condition);
+	writeStr(&f->out, ")) {\n");
+	writeCBranch(f, ifelse->consequence, result);
+	if (ifelse->alternative) {
+		writeCIndent(f);
+		writeStr(&f->out, "else {\n");
+		writeCBranch(f, ifelse->alternative, result);
+	}
+	return result;
+}
+
+//Evaluates every element in order, the temporaries are returned in a new array
+static uint32_t* writeCExpressionList(struct CFunction* f, const struct ExpressionList* list) {
+	uint32_t* temps = (uint32_t*)malloc((list->size + 1) * sizeof *temps);
+	if (!temps) {
+		perror("malloc (transpiler temporaries) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < list->size; i++) {
+		temps[i] = writeCExpression(f, list->values[i]);
+	}
+	return temps;
+}
+
+//Declares `struct Object* aN[] = { ... };` for a non empty list
+static void writeCArgumentArray(struct CFunction* f, uint32_t number, const uint32_t* temps, size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	writeCIndent(f);
+	writeStr(&f->out, "struct Object* a");
+	writeInt(&f->out, number);
+	writeStr(&f->out, "[] = { ");
+	for (size_t i = 0; i < count; i++) {
+		if (i > 0) {
+			writeStr(&f->out, ", ");
+		}
+		writeCValue(&f->out, 't', temps[i]);
+	}
+	writeStr(&f->out, " };\n");
+}
+
+static void writeCArgumentArrayName(struct CFunction* f, uint32_t number, size_t count) {
+	if (count == 0) {
+		writeStr(&f->out, "NULL, 0");
+		return;
+	}
+
+	writeChar(&f->out, 'a');
+	writeInt(&f->out, number);
+	writeStr(&f->out, ", ");
+	writeInt(&f->out, (int64_t)count);
+}
+
+static uint32_t writeCCall(struct CFunction* f, const struct CallExpression* call) {
+	const uint32_t callee = writeCExpression(f, call->function);
+	uint32_t* args = writeCExpressionList(f, &call->arguments);
+	const size_t count = call->arguments.size;
+	const struct KnownFunction* known = call->function->type == EXPR_IDENT ? resolveCKnown(f, call->function->ident.value) : NULL;
+
+	const uint32_t result = f->temps++;
+	writeCIndent(f);
+	writeStr(&f->out, "struct Object* t");
+	writeInt(&f->out, result);
+	writeStr(&f->out, ";\n");
+
+	if (known) {
+		//Missing arguments are NULL, extra ones are evaluated and dropped
+		writeCIndent(f);
+		writeStr(&f->out, "if (t");
+		writeInt(&f->out, callee);
+		writeStr(&f->out, " == known");
+		writeInt(&f->out, known->index);
+		writeStr(&f->out, ") {\n");
+		f->depth++;
+		writeCIndent(f);
+		writeChar(&f->out, 't');
+		writeInt(&f->out, result);
+		writeStr(&f->out, " = fn");
+		writeInt(&f->out, known->index);
+		writeStr(&f->out, "(t");
+		writeInt(&f->out, callee);
+		writeStr(&f->out, "->value.function.env, gc");
+		for (size_t i = 0; i < known->literal->function.parameters.size; i++) {
+			writeStr(&f->out, ", ");
+			if (i < count) {
+				writeCValue(&f->out, 't', args[i]);
+			}
+			else {
+				writeStr(&f->out, "NULL");
+			}
+		}
+		writeStr(&f->out, ");\n");
+		f->depth--;
+		writeCIndent(f);
+		writeStr(&f->out, "}\n");
+		writeCIndent(f);
+		writeStr(&f->out, "else {\n");
+		f->depth++;
+	}
+
+	writeCArgumentArray(f, result, args, count);
+	writeCIndent(f);
+	writeChar(&f->out, 't');
+	writeInt(&f->out, result);
+	writeStr(&f->out, " = monkeyCall(t");
+	writeInt(&f->out, callee);
+	writeStr(&f->out, ", ");
+	writeCArgumentArrayName(f, result, count);
+	writeStr(&f->out, ", gc);\n");
+
+	if (known) {
+		f->depth--;
+		writeCIndent(f);
+		writeStr(&f->out, "}\n");
+	}
+	writeCErrorCheck(f, result);
+	free(args);
+	return result;
+}
+
+static uint32_t writeCArray(struct CFunction* f, const struct ArrayLiteral* array) {
+	uint32_t* elements = writeCExpressionList(f, &array->elements);
+	const size_t count = array->elements.size;
+	const uint32_t number = f->temps;
+	writeCArgumentArray(f, number, elements, count);
+	free(elements);
+
+	beginCTemp(f);
+	writeStr(&f->out, "monkeyArray(");
+	writeCArgumentArrayName(f, number, count);
+	writeStr(&f->out, ", gc);\n");
+	return number;
+}
+
+static uint32_t writeCFunction(struct Transpiler* t, const struct CFunction* outer, const struct Expression* expr);
+
+static uint32_t writeCExpression(struct CFunction* f, const struct Expression* expr) {
+	uint32_t temp = C_NO_TEMP;
+
+	switch (expr->type) {
+		case EXPR_INT:
+		case EXPR_STRING: {
+			const uint32_t constant = addCConstant(f->transpiler, expr);
+			temp = beginCTemp(f);
+			writeStr(&f->out, "constant");
+			writeInt(&f->out, constant);
+			writeStr(&f->out, ";\n");
+			break;
+		}
+
+		case EXPR_BOOL:
+			temp = beginCTemp(f);
+			writeStr(&f->out, expr->boolean ? "&TrueObj;\n" : "&FalseObj;\n");
+			break;
+
+		case EXPR_IDENT:
+			temp = writeCIdentifier(f, expr->ident.value);
+			break;
+
+		case EXPR_PREFIX: {
+			const uint32_t right = writeCExpression(f, expr->prefix.right);
+			temp = beginCTemp(f);
+			if (expr->prefix.operatorType == OP_NEGATE) {
+				writeStr(&f->out, "monkeyNot(t");
+				writeInt(&f->out, right);
+				writeStr(&f->out, ");\n");
+				break;
+			}
+
+			if (expr->prefix.operatorType == OP_SUBTRACT) {
+				writeStr(&f->out, "monkeyNegate(t");
+			}
+			else {
+				writeStr(&f->out, "evalPrefixExpression(");
+				writeStr(&f->out, cOperatorNames[expr->prefix.operatorType]);
+				writeStr(&f->out, ", t");
+			}
+			writeInt(&f->out, right);
+			writeStr(&f->out, ", gc);\n");
+			writeCErrorCheck(f, temp);
+			break;
+		}
+
+		case EXPR_INFIX: {
+			//Right before left like the evaluator
+			const uint32_t right = writeCExpression(f, expr->infix.right);
+			const uint32_t left = writeCExpression(f, expr->infix.left);
+			const char* helper = cInfixHelpers[expr->infix.operatorType];
+			temp = beginCTemp(f);
+			if (helper) {
+				writeStr(&f->out, helper);
+				writeStr(&f->out, "(t");
+			}
+			else {
+				writeStr(&f->out, "evalInfixExpression(");
+				writeStr(&f->out, cOperatorNames[expr->infix.operatorType]);
+				writeStr(&f->out, ", t");
+			}
+			writeInt(&f->out, left);
+			writeStr(&f->out, ", t");
+			writeInt(&f->out, right);
+			writeStr(&f->out, ", gc);\n");
+			writeCErrorCheck(f, temp);
+			break;
+		}
+
+		case EXPR_IF:
+			temp = writeCIf(f, &expr->ifelse);
+			break;
+
+		case EXPR_FUNCTION: {
+			const uint32_t index = writeCFunction(f->transpiler, f, expr);
+			temp = beginCTemp(f);
+			writeStr(&f->out, "monkeyClosure(gc, env, &fn");
+			writeInt(&f->out, index);
+			writeStr(&f->out, "Native);\n");
+			break;
+		}
+
+		case EXPR_CALL:
+			temp = writeCCall(f, &expr->call);
+			break;
+
+		case EXPR_ARRAY:
+			temp = writeCArray(f, &expr->array);
+			break;
+
+		case EXPR_INDEX: {
+			const uint32_t left = writeCExpression(f, expr->indexExpr.left);
+			const uint32_t index = writeCExpression(f, expr->indexExpr.index);
+			temp = beginCTemp(f);
+			writeStr(&f->out, "monkeyIndex(t");
+			writeInt(&f->out, left);
+			writeStr(&f->out, ", t");
+			writeInt(&f->out, index);
+			writeStr(&f->out, ", gc);\n");
+			writeCErrorCheck(f, temp);
+			break;
+		}
+	}
+
+	return temp;
+}
+
+//Temporary holding the value of the statement
+static uint32_t writeCStatement(struct CFunction* f, const struct Statement* stmt) {
+	if (!stmt->expr || (stmt->type != STMT_EXPR && stmt->type != STMT_RETURN && stmt->type != STMT_LET)) {
+		return C_NO_TEMP;
+	}
+
+	const uint32_t value = writeCExpression(f, stmt->expr);
+	if (stmt->type == STMT_LET) {
+		writeCBinding(f, stmt->identifier.value, 't', value);
+	}
+	else if (stmt->type == STMT_RETURN) {
+		writeCIndent(f);
+		writeStr(&f->out, f->topLevel ? "return monkeyReturn(gc, t" : "return t");
+		writeInt(&f->out, value);
+		writeStr(&f->out, f->topLevel ? ");\n" : ";\n");
+	}
+	return value;
+}
+
+//Value of the last statement, the block shares the environment of its function
+static uint32_t writeCStatements(struct CFunction* f, const struct BlockStatement* bs) {
+	uint32_t value = C_NO_TEMP;
+	for (size_t i = 0; bs && i < bs->size; i++) {
+		value = writeCStatement(f, &bs->statements[i]);
+		if (bs->statements[i].type == STMT_RETURN) {
+			break;
+		}
+	}
+	return value;
+}
+
+static void writeCParameterList(struct Writer* writer, const struct FunctionLiteral* literal) {
+	writeStr(writer, "(struct ObjectEnvironment* closure, struct MonkeyGC* gc");
+	for (size_t i = 0; i < literal->parameters.size; i++) {
+		writeStr(writer, ", struct Object* p");
+		writeInt(writer, (int64_t)i);
+	}
+	writeChar(writer, ')');
+}
+
+//Text writeObject prints for a function object of the literal
+static void writeCNativeText(struct Writer* writer, const struct FunctionLiteral* literal) {
+	struct Writer text = createStringWriter(256);
+	writeStr(&text, "fn(");
+	for (size_t i = 0; i < literal->parameters.size; i++) {
+		if (i > 0) {
+			writeStr(&text, ", ");
+		}
+		writeStr(&text, literal->parameters.values[i].value);
+	}
+	writeStr(&text, ") {\n");
+	writeBlockStatement(&text, literal->body);
+	writeStr(&text, "\n}");
+
+	char* str = takeWriterString(&text);
+	writeCString(writer, str, true);
+	free(str);
+}
+
+//fnN itself, fnNEntry for applyFunction and fnNNative for the function objects. Returns N
+static uint32_t writeCFunction(struct Transpiler* t, const struct CFunction* outer, const struct Expression* expr) {
+	const struct FunctionLiteral* literal = &expr->function;
+	uint32_t index = UINT32_MAX;
+	for (size_t i = 0; i < t->knownLen && index == UINT32_MAX; i++) {
+		if (t->known[i].literal == expr) {
+			index = t->known[i].index;
+		}
+	}
+	if (index == UINT32_MAX) {
+		index = t->functionsLen++;
+		writeStr(&t->declarations, "static struct Object* fn");
+		writeInt(&t->declarations, index);
+		writeCParameterList(&t->declarations, literal);
+		writeStr(&t->declarations, ";\n");
+	}
+
+	struct CFunction f = { 0 };
+	f.transpiler = t;
+	f.out = createStringWriter(1024);
+	f.outer = outer;
+	f.depth = 1;
+	for (size_t i = 0; i < literal->parameters.size; i++) {
+		addCLocal(&f, literal->parameters.values[i].value);
+	}
+	struct CNameList lets = { 0 };
+	collectCBlockLets(&lets, literal->body);
+	for (size_t i = 0; i < lets.len; i++) {
+		addCLocal(&f, lets.names[i]);
+	}
+	free((void*)lets.names);
+	markCBlockCaptured(&f, literal->body, false);
+
+	writeStr(&f.out, "static struct Object* fn");
+	writeInt(&f.out, index);
+	writeCParameterList(&f.out, literal);
+	writeStr(&f.out, " {\n");
+
+	bool ownEnv = false;
+	for (size_t i = 0; i < f.localsLen; i++) {
+		ownEnv = ownEnv || f.locals[i].captured;
+		if (!f.locals[i].captured) {
+			writeStr(&f.out, "\tstruct Object* m_");
+			writeStr(&f.out, f.locals[i].name);
+			writeStr(&f.out, " = NULL;\n");
+		}
+	}
+	writeStr(&f.out, ownEnv ? "\tstruct ObjectEnvironment* env = newEnclosedEnvironment(closure);\n" : "\tstruct ObjectEnvironment* env = closure;\n");
+	//A missing argument is NULL and leaves the parameter unbound
+	for (size_t i = 0; i < literal->parameters.size; i++) {
+		writeStr(&f.out, "\tif (p");
+		writeInt(&f.out, (int64_t)i);
+		writeStr(&f.out, ") {\n");
+		f.depth++;
+		writeCBinding(&f, literal->parameters.values[i].value, 'p', (uint32_t)i);
+		f.depth--;
+		writeStr(&f.out, "\t}\n");
+	}
+
+	const uint32_t value = writeCStatements(&f, literal->body);
+	writeStr(&f.out, "\treturn ");
+	writeCValue(&f.out, 't', value);
+	writeStr(&f.out, ";\n}\n\n");
+
+	writeStr(&f.out, "static struct Object* fn");
+	writeInt(&f.out, index);
+	writeStr(&f.out, "Entry(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {\n\treturn fn");
+	writeInt(&f.out, index);
+	writeStr(&f.out, "(fn->value.function.env, gc");
+	for (size_t i = 0; i < literal->parameters.size; i++) {
+		writeStr(&f.out, ", monkeyArgument(args, ");
+		writeInt(&f.out, (int64_t)i);
+		writeChar(&f.out, ')');
+	}
+	writeStr(&f.out, ");\n}\n\n");
+
+	writeStr(&f.out, "static const struct NativeFunction fn");
+	writeInt(&f.out, index);
+	writeStr(&f.out, "Native = { fn");
+	writeInt(&f.out, index);
+	writeStr(&f.out, "Entry,\n\t");
+	writeCNativeText(&f.out, literal);
+	writeStr(&f.out, ",\n\t");
+	writeInt(&f.out, (int64_t)literal->parameters.size);
+	writeStr(&f.out, " };\n\n");
+
+	writeBytes(&t->definitions, f.out.buffer, f.out.len);
+	freeWriter(&f.out);
+	free(f.locals);
+	return index;
+}
+
+static void writeCTopLevelStatement(struct Transpiler* t, const struct Statement* stmt) {
+	struct CFunction f = { 0 };
+	f.transpiler = t;
+	f.out = createStringWriter(256);
+	f.depth = 1;
+	f.topLevel = true;
+
+	writeStr(&f.out, "static struct Object* statement");
+	writeInt(&f.out, t->statementsLen++);
+	writeStr(&f.out, "(struct ObjectEnvironment* env, struct MonkeyGC* gc) {\n");
+	const uint32_t value = writeCStatement(&f, stmt);
+	if (stmt->type != STMT_RETURN) {
+		writeStr(&f.out, "\treturn ");
+		writeCValue(&f.out, 't', value);
+		writeStr(&f.out, ";\n");
+	}
+	writeStr(&f.out, "}\n\n");
+
+	writeBytes(&t->definitions, f.out.buffer, f.out.len);
+	freeWriter(&f.out);
+}
+
+//Top level functions bound by exactly one `let` of the top level, including the ones inside top level `if` blocks
+static void findCKnownFunctions(struct Transpiler* t, const Program* program) {
+	struct CNameList lets = { 0 };
+	struct BlockStatement topLevel = { 0 };
+	topLevel.statements = program->statements;
+	topLevel.size = program->size;
+	collectCBlockLets(&lets, &topLevel);
+
+	t->known = (struct KnownFunction*)malloc((program->size + 1) * sizeof *t->known);
+	if (!t->known) {
+		perror("malloc (transpiler known functions) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < program->size; i++) {
+		const struct Statement* stmt = &program->statements[i];
+		if (stmt->type != STMT_LET || !stmt->expr || stmt->expr->type != EXPR_FUNCTION || countCName(&lets, stmt->identifier.value) != 1) {
+			continue;
+		}
+
+		struct KnownFunction* known = &t->known[t->knownLen++];
+		known->name = stmt->identifier.value;
+		known->literal = stmt->expr;
+		known->index = t->functionsLen++;
+
+		writeStr(&t->declarations, "static struct Object* fn");
+		writeInt(&t->declarations, known->index);
+		writeCParameterList(&t->declarations, &stmt->expr->function);
+		writeStr(&t->declarations, ";\n");
+		writeStr(&t->declarations, "static struct Object* known");
+		writeInt(&t->declarations, known->index);
+		writeStr(&t->declarations, ";\n");
+	}
+	free((void*)lets.names);
+}
+
+void writeCProgram(struct Writer* writer, const Program* program) {
+	struct Transpiler t = { 0 };
+	t.declarations = createStringWriter(1024);
+	t.definitions = createStringWriter(4096);
+	t.initializers = createStringWriter(1024);
+
+	findCKnownFunctions(&t, program);
+	for (size_t i = 0; i < program->size; i++) {
+		writeCTopLevelStatement(&t, &program->statements[i]);
+	}
+
+	writeStr(writer, "//Generated by monkeypreter --emit-c, build it together with the interpreter sources\n");
+	writeStr(writer, "#include \"transpiler/monkey_runtime.h\"\n\n");
+	writeBytes(writer, t.declarations.buffer, t.declarations.len);
+	writeChar(writer, '\n');
+	writeBytes(writer, t.definitions.buffer, t.definitions.len);
+
+	writeStr(writer, "int main(void) {\n");
+	writeBytes(writer, t.initializers.buffer, t.initializers.len);
+	if (t.statementsLen == 0) {
+		writeStr(writer, "\treturn monkeyRun(NULL, 0);\n}\n");
+	}
+	else {
+		writeStr(writer, "\tstatic const MonkeyStatement statements[] = {\n");
+		for (uint32_t i = 0; i < t.statementsLen; i++) {
+			writeStr(writer, "\t\tstatement");
+			writeInt(writer, i);
+			writeStr(writer, ",\n");
+		}
+		writeStr(writer, "\t};\n\treturn monkeyRun(statements, sizeof statements / sizeof *statements);\n}\n");
+	}
+
+	freeWriter(&t.declarations);
+	freeWriter(&t.definitions);
+	freeWriter(&t.initializers);
+	free(t.known);
+}
+
+char* transpileProgram(const Program* program) {
+	struct Writer writer = createStringWriter(4096);
+	writeCProgram(&writer, program);
+	return takeWriterString(&writer);
+}
+
+void printCProgram(FILE* stream, const Program* program) {
+	char buffer[WRITER_CHUNK_SIZE];
+	struct Writer writer = createStreamWriter(stream, buffer, sizeof(buffer));
+	writeCProgram(&writer, program);
+	freeWriter(&writer);
+}
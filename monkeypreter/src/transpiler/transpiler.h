@@ -0,0 +1,13 @@
+#pragma once
+#include <stdio.h>
+#include "../parser/ast.h"
+#include "../util/writer.h"
+
+//Translates a parsed program into a C program that runs it without an interpreter loop.
+//Every function literal becomes a C function, parameters and `let` bindings become C locals unless a
+//nested function reads them, and calls of a top level function bound by a single `let` are direct C calls.
+//The result includes transpiler/monkey_runtime.h and links against the evaluator, lexer, parser and util sources
+void writeCProgram(struct Writer* writer, const Program* program);
+//Caller frees the returned string
+char* transpileProgram(const Program* program);
+void printCProgram(FILE* stream, const Program* program);
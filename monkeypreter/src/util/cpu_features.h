@@ -0,0 +1,31 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MONKEY_X64
+#endif
+
+//GCC and Clang only emit AVX2 instructions in functions that opt in, MSVC allows the intrinsics anywhere
+#if defined(MONKEY_X64) && (defined(__GNUC__) || defined(__clang__))
+#define MONKEY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MONKEY_TARGET_AVX2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+bool cpuHasAVX2(void);
+
+//Index of the lowest set bit, mask must not be 0
+static inline unsigned countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctz(mask);
+#endif
+}
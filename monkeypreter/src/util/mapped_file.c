@@ -0,0 +1,134 @@
+#include "mapped_file.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static bool mapFileView(const char* path, struct MappedFile* mapped, bool copyOnWrite) {
+	mapped->data = NULL;
+	mapped->size = 0;
+	mapped->file = INVALID_HANDLE_VALUE;
+	mapped->mapping = NULL;
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		fprintf(stderr, "Could not get the size of %s\n", path);
+		CloseHandle(file);
+		return false;
+	}
+	mapped->file = file;
+
+	//Empty files can not be mapped
+	if (size.QuadPart == 0) {
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		fprintf(stderr, "Could not map %s\n", path);
+		unmapFile(mapped);
+		return false;
+	}
+	mapped->mapping = mapping;
+
+	mapped->data = (const char*)MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (!mapped->data) {
+		fprintf(stderr, "Could not map a view of %s\n", path);
+		unmapFile(mapped);
+		return false;
+	}
+
+	mapped->size = (size_t)size.QuadPart;
+	return true;
+}
+
+void unmapFile(struct MappedFile* mapped) {
+	if (mapped->data) {
+		UnmapViewOfFile(mapped->data);
+	}
+
+	if (mapped->mapping) {
+		CloseHandle(mapped->mapping);
+	}
+
+	if (mapped->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mapped->file);
+	}
+
+	mapped->data = NULL;
+	mapped->size = 0;
+	mapped->mapping = NULL;
+	mapped->file = INVALID_HANDLE_VALUE;
+}
+#else
+static bool mapFileView(const char* path, struct MappedFile* mapped, bool copyOnWrite) {
+	mapped->data = NULL;
+	mapped->size = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		fprintf(stderr, "Could not get the size of %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	//Empty files can not be mapped
+	if (info.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	void* data = mmap(NULL, (size_t)info.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	//The mapping keeps the file alive
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s\n", path);
+		return false;
+	}
+
+	//Lexing reads front to back once
+	madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+	mapped->data = (const char*)data;
+	mapped->size = (size_t)info.st_size;
+	return true;
+}
+
+void unmapFile(struct MappedFile* mapped) {
+	if (mapped->data) {
+		munmap((void*)mapped->data, mapped->size);
+	}
+
+	mapped->data = NULL;
+	mapped->size = 0;
+}
+#endif
+
+bool mapFile(const char* path, struct MappedFile* mapped) {
+	return mapFileView(path, mapped, false);
+}
+
+bool mapFilePrivate(const char* path, struct MappedFile* mapped) {
+	return mapFileView(path, mapped, true);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+//View of a whole file, not NUL terminated. Read only unless mapped with mapFilePrivate
+struct MappedFile {
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
+
+bool mapFile(const char* path, struct MappedFile* mapped);
+//Copy on write view, pages written to become private to the process and never reach the file
+bool mapFilePrivate(const char* path, struct MappedFile* mapped);
+void unmapFile(struct MappedFile* mapped);
@@ -0,0 +1,57 @@
+#include "thread.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static unsigned __stdcall threadMain(void* arg) {
+	struct Thread* thread = (struct Thread*)arg;
+	thread->fn(thread->arg);
+	return 0;
+}
+
+bool startThread(struct Thread* thread, ThreadFn fn, void* arg) {
+	thread->fn = fn;
+	thread->arg = arg;
+	thread->handle = (void*)_beginthreadex(NULL, 0, threadMain, thread, 0, NULL);
+	return thread->handle != NULL;
+}
+
+void joinThread(struct Thread* thread) {
+	WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+	CloseHandle((HANDLE)thread->handle);
+	thread->handle = NULL;
+}
+
+size_t hardwareThreadCount(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+#else
+static void* threadMain(void* arg) {
+	struct Thread* thread = (struct Thread*)arg;
+	thread->fn(thread->arg);
+	return NULL;
+}
+
+bool startThread(struct Thread* thread, ThreadFn fn, void* arg) {
+	thread->fn = fn;
+	thread->arg = arg;
+	return pthread_create(&thread->handle, NULL, threadMain, thread) == 0;
+}
+
+void joinThread(struct Thread* thread) {
+	pthread_join(thread->handle, NULL);
+}
+
+size_t hardwareThreadCount(void) {
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (size_t)count : 1;
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef void (*ThreadFn) (void* arg);
+
+struct Thread {
+#ifdef _WIN32
+	void* handle;
+#else
+	pthread_t handle;
+#endif
+	ThreadFn fn;
+	void* arg;
+};
+
+//thread has to stay alive until it is joined
+bool startThread(struct Thread* thread, ThreadFn fn, void* arg);
+void joinThread(struct Thread* thread);
+size_t hardwareThreadCount(void);
@@ -0,0 +1,110 @@
+#include "writer.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct Writer createStringWriter(size_t initialCap) {
+	struct Writer writer = { NULL, 0, initialCap > 0 ? initialCap : 64, NULL };
+	writer.buffer = (char*)malloc(writer.cap);
+	if (!writer.buffer) {
+		perror("malloc (create string writer) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	return writer;
+}
+
+struct Writer createStreamWriter(FILE* stream, char* buffer, size_t cap) {
+	struct Writer writer = { buffer, 0, cap, stream };
+	return writer;
+}
+
+void flushWriter(struct Writer* writer) {
+	if (writer->stream && writer->len > 0) {
+		fwrite(writer->buffer, 1, writer->len, writer->stream);
+		writer->len = 0;
+	}
+}
+
+//Makes room for at least `needed` more bytes (+1 for the terminator of string writers)
+static void reserveWriter(struct Writer* writer, size_t needed) {
+	if (writer->stream) {
+		flushWriter(writer);
+		return;
+	}
+
+	size_t cap = writer->cap > 0 ? writer->cap : 64;
+	while (cap - writer->len < needed + 1) {
+		cap *= 2;
+	}
+
+	char* grown = (char*)realloc(writer->buffer, cap);
+	if (!grown) {
+		perror("realloc (grow string writer) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	writer->buffer = grown;
+	writer->cap = cap;
+}
+
+void writeBytes(struct Writer* writer, const char* bytes, size_t len) {
+	if (writer->cap - writer->len < len + 1) {
+		reserveWriter(writer, len);
+
+		//Larger than the whole stream buffer, nothing to gain from copying it first
+		if (writer->stream && len >= writer->cap) {
+			fwrite(bytes, 1, len, writer->stream);
+			return;
+		}
+	}
+
+	memcpy(writer->buffer + writer->len, bytes, len);
+	writer->len += len;
+}
+
+void writeStr(struct Writer* writer, const char* str) {
+	writeBytes(writer, str, strlen(str));
+}
+
+void writeChar(struct Writer* writer, char c) {
+	if (writer->cap - writer->len < 2) {
+		reserveWriter(writer, 1);
+	}
+	writer->buffer[writer->len++] = c;
+}
+
+void writeInt(struct Writer* writer, int64_t value) {
+	//Digits are produced backwards, unsigned so INT64_MIN can be negated
+	char digits[24];
+	size_t pos = sizeof(digits);
+	uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+	do {
+		digits[--pos] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	if (value < 0) {
+		digits[--pos] = '-';
+	}
+
+	writeBytes(writer, digits + pos, sizeof(digits) - pos);
+}
+
+char* takeWriterString(struct Writer* writer) {
+	//Writes always leave room for the terminator
+	writer->buffer[writer->len] = '\0';
+	char* str = writer->buffer;
+	writer->buffer = NULL;
+	writer->len = 0;
+	writer->cap = 0;
+	return str;
+}
+
+void freeWriter(struct Writer* writer) {
+	if (writer->stream) {
+		flushWriter(writer);
+		return;
+	}
+
+	free(writer->buffer);
+	writer->buffer = NULL;
+}
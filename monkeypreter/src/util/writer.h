@@ -0,0 +1,29 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+//Chunk size for writers flushed to a stream
+#define WRITER_CHUNK_SIZE (64 * 1024)
+
+//Buffered text output. String writers grow their buffer,
+//stream writers write the caller's buffer out every time it fills up
+struct Writer {
+	char* buffer;
+	size_t len;
+	size_t cap;
+	//NULL for string writers
+	FILE* stream;
+};
+
+struct Writer createStringWriter(size_t initialCap);
+struct Writer createStreamWriter(FILE* stream, char* buffer, size_t cap);
+void writeBytes(struct Writer* writer, const char* bytes, size_t len);
+void writeStr(struct Writer* writer, const char* str);
+void writeChar(struct Writer* writer, char c);
+void writeInt(struct Writer* writer, int64_t value);
+void flushWriter(struct Writer* writer);
+//NUL terminated contents of a string writer, the caller owns them afterwards
+char* takeWriterString(struct Writer* writer);
+//Flushes stream writers, frees the buffer of string writers
+void freeWriter(struct Writer* writer);
@@ -0,0 +1,156 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "../parser/compact_ast.h"
+#include "../evaluator/environment.h"
+
+//Register bytecode, every instruction names its destination register a and its operands b and c.
+//bx is b and c taken together as one 32-bit operand
+//LOADK        a = constant bx
+//MOVE         a = b
+//GET_LOCAL    a = b, or the binding of name c while the local b is still unbound
+//GET_NAME     a = binding of name bx, builtin or error
+//SET_NAME     binds name bx to a
+//NEG, NOT     a = -b, a = !b
+//ADD .. NOT_EQ      a = b op c
+//ADDK .. NOT_EQK    a = b op constant c, for an integer literal on the right
+//JUMP         to bx
+//JUMP_FALSE   to bx unless a is truthy
+//FUNCTION     a = closure of function bx
+//CALL         a = b(b + 1, ..., b + c), the arguments become the first registers of the callee
+//ARRAY        a = [b, ..., b + c - 1]
+//INDEX        a = b[c]
+//WRAP_RETURN  a = return object of b, a top level return stops the program
+//RETURN       returns a
+#define VM_OPCODES(X) \
+	X(VM_LOADK) \
+	X(VM_MOVE) \
+	X(VM_GET_LOCAL) \
+	X(VM_GET_NAME) \
+	X(VM_SET_NAME) \
+	X(VM_NEG) \
+	X(VM_NOT) \
+	X(VM_ADD) \
+	X(VM_SUB) \
+	X(VM_MUL) \
+	X(VM_DIV) \
+	X(VM_LT) \
+	X(VM_GT) \
+	X(VM_EQ) \
+	X(VM_NOT_EQ) \
+	X(VM_ADDK) \
+	X(VM_SUBK) \
+	X(VM_MULK) \
+	X(VM_DIVK) \
+	X(VM_LTK) \
+	X(VM_GTK) \
+	X(VM_EQK) \
+	X(VM_NOT_EQK) \
+	X(VM_JUMP) \
+	X(VM_JUMP_FALSE) \
+	X(VM_FUNCTION) \
+	X(VM_CALL) \
+	X(VM_ARRAY) \
+	X(VM_INDEX) \
+	X(VM_WRAP_RETURN) \
+	X(VM_RETURN)
+
+#define VM_OPCODE_ENUM(code) code,
+enum VmOpcode {
+	VM_OPCODES(VM_OPCODE_ENUM)
+	VM_OPCODE_COUNT
+};
+#undef VM_OPCODE_ENUM
+
+struct VmInstruction {
+	uint16_t op;
+	uint16_t a;
+	uint16_t b;
+	uint16_t c;
+};
+
+static inline uint32_t vmWide(const struct VmInstruction* in) {
+	return in->b | (uint32_t)in->c << 16;
+}
+
+struct VmName {
+	const char* text;
+	uint32_t hash;
+	//Builtin of the same name or NULL
+	struct Object* builtin;
+	//Last lookup, valid while the binding version of the name is unchanged (see environment.h)
+	const struct ObjectEnvironment* cachedEnv;
+	uint32_t cachedVersion;
+	struct Object* cached;
+};
+
+struct VmJitCode;
+
+//Native code of a function, see jit.h
+struct VmJitState {
+	uint32_t calls;
+	//Guard failures that handed a call back to the interpreter
+	uint32_t deopts;
+	struct VmJitCode* code;
+	//Could not be compiled, or fails its guards too often to be worth entering
+	bool disabled;
+};
+
+struct VmFunction {
+	struct VmInstruction* code;
+	uint32_t codeLen;
+	uint32_t codeCap;
+	//Shared literals of the compact AST, not owned
+	struct Object** constants;
+	uint32_t constantsLen;
+	uint32_t constantsCap;
+	//Names resolved through the environment at runtime
+	struct VmName* names;
+	uint32_t namesLen;
+	uint32_t namesCap;
+
+	//Parameters come first, then the other locals, then temporaries
+	uint16_t paramCount;
+	uint16_t localCount;
+	uint16_t registerCount;
+	//A nested function reads some local, calls give it an environment that holds those
+	bool ownEnv;
+	//FUNCTION node, or the statement of a top level chunk
+	NodeRef node;
+	struct VmProgram* program;
+	//Changes while the function runs, unlike the rest of it
+	struct VmJitState* jit;
+};
+
+struct VmFrame {
+	const struct VmFunction* fn;
+	const struct VmInstruction* pc;
+	size_t base;
+	struct ObjectEnvironment* env;
+	//Register of the caller that gets the result
+	uint16_t result;
+};
+
+struct VmProgram {
+	const struct CompactAst* ast;
+	//Every function literal, VM_FUNCTION refers to them by index
+	struct VmFunction** functions;
+	uint32_t functionsLen;
+	uint32_t functionsCap;
+	//One chunk per top level statement, run one after the other so the GC can run in between like in evalProgram
+	struct VmFunction** statements;
+	size_t statementsLen;
+
+	//Registers of every active frame, a nested run started by a builtin begins at stackTop
+	struct Object** stack;
+	size_t stackCap;
+	size_t stackTop;
+	struct VmFrame* frames;
+	size_t framesLen;
+	size_t framesCap;
+
+	//Calls before a function is compiled to native code, 0 never compiles any
+	uint32_t jitThreshold;
+	//Native calls nest on the C stack, unlike interpreted ones
+	uint32_t jitDepth;
+};
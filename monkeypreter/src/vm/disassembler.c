@@ -0,0 +1,208 @@
+#include "disassembler.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/object.h"
+
+#define VM_OPCODE_NAME(code) #code,
+static const char* const vmOpcodeNames[VM_OPCODE_COUNT] = { VM_OPCODES(VM_OPCODE_NAME) };
+#undef VM_OPCODE_NAME
+
+//Mnemonics are padded to the longest one
+#define VM_MNEMONIC_WIDTH 12
+
+static void writeRegister(struct Writer* writer, uint16_t reg) {
+	writeChar(writer, 'r');
+	writeInt(writer, reg);
+}
+
+//Strings are quoted, writeObject would end them with a newline
+static void writeConstant(struct Writer* writer, const struct Object* obj) {
+	if (obj->type == OBJ_STRING) {
+		writeChar(writer, '"');
+		writeStr(writer, obj->value.string);
+		writeChar(writer, '"');
+		return;
+	}
+	writeObject(writer, obj);
+}
+
+static void writeInstruction(struct Writer* writer, const struct VmFunction* fn, uint32_t offset) {
+	const struct VmInstruction* in = &fn->code[offset];
+	const char* mnemonic = vmOpcodeNames[in->op] + 3;
+
+	writeStr(writer, "  ");
+	char number[16];
+	snprintf(number, sizeof number, "%4u", offset);
+	writeStr(writer, number);
+	writeStr(writer, "  ");
+	writeStr(writer, mnemonic);
+	for (size_t i = strlen(mnemonic); i < VM_MNEMONIC_WIDTH; i++) {
+		writeChar(writer, ' ');
+	}
+
+	switch ((enum VmOpcode)in->op) {
+		case VM_LOADK:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeConstant(writer, fn->constants[vmWide(in)]);
+			break;
+
+		case VM_MOVE:
+		case VM_NEG:
+		case VM_NOT:
+		case VM_WRAP_RETURN:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->b);
+			break;
+
+		case VM_GET_LOCAL:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->b);
+			writeStr(writer, " or ");
+			writeStr(writer, fn->names[in->c].text);
+			break;
+
+		case VM_GET_NAME:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeStr(writer, fn->names[vmWide(in)].text);
+			break;
+
+		case VM_SET_NAME:
+			writeStr(writer, fn->names[vmWide(in)].text);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->a);
+			break;
+
+		case VM_ADD:
+		case VM_SUB:
+		case VM_MUL:
+		case VM_DIV:
+		case VM_LT:
+		case VM_GT:
+		case VM_EQ:
+		case VM_NOT_EQ:
+		case VM_INDEX:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->b);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->c);
+			break;
+
+		case VM_ADDK:
+		case VM_SUBK:
+		case VM_MULK:
+		case VM_DIVK:
+		case VM_LTK:
+		case VM_GTK:
+		case VM_EQK:
+		case VM_NOT_EQK:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			writeRegister(writer, in->b);
+			writeStr(writer, ", ");
+			writeConstant(writer, fn->constants[in->c]);
+			break;
+
+		case VM_JUMP:
+			writeStr(writer, "-> ");
+			writeInt(writer, vmWide(in));
+			break;
+
+		case VM_JUMP_FALSE:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", -> ");
+			writeInt(writer, vmWide(in));
+			break;
+
+		case VM_FUNCTION:
+			writeRegister(writer, in->a);
+			writeStr(writer, ", function ");
+			writeInt(writer, vmWide(in));
+			break;
+
+		case VM_CALL:
+		case VM_ARRAY:
+			//Window of c registers from b, or from b + 1 for the arguments of a call
+			writeRegister(writer, in->a);
+			writeStr(writer, ", ");
+			if (in->op == VM_CALL) {
+				writeRegister(writer, in->b);
+			}
+			writeStr(writer, in->op == VM_CALL ? "(" : "[");
+			for (uint16_t i = 0; i < in->c; i++) {
+				if (i > 0) {
+					writeStr(writer, ", ");
+				}
+				writeRegister(writer, (uint16_t)(in->b + (in->op == VM_CALL ? 1 : 0) + i));
+			}
+			writeStr(writer, in->op == VM_CALL ? ")" : "]");
+			break;
+
+		case VM_RETURN:
+			writeRegister(writer, in->a);
+			break;
+
+		case VM_OPCODE_COUNT:
+			break;
+	}
+	writeChar(writer, '\n');
+}
+
+void writeVmFunction(struct Writer* writer, const struct VmFunction* fn) {
+	for (uint32_t i = 0; i < fn->codeLen; i++) {
+		writeInstruction(writer, fn, i);
+	}
+}
+
+static void writeFunctionHeader(struct Writer* writer, const struct VmProgram* program, uint32_t index) {
+	const struct VmFunction* fn = program->functions[index];
+	const struct CompactAst* ast = program->ast;
+
+	writeStr(writer, "function ");
+	writeInt(writer, index);
+	writeStr(writer, " fn(");
+	size_t count = 0;
+	const uint32_t* parameters = compactList(ast, ast->nodes[fn->node].a, &count);
+	for (size_t i = 0; i < count; i++) {
+		if (i > 0) {
+			writeStr(writer, ", ");
+		}
+		writeStr(writer, compactText(ast, parameters[i]));
+	}
+	writeStr(writer, "), ");
+	writeInt(writer, fn->registerCount);
+	writeStr(writer, fn->ownEnv ? " registers, environment\n" : " registers\n");
+}
+
+void writeVmProgram(struct Writer* writer, const struct VmProgram* program) {
+	for (size_t i = 0; i < program->statementsLen; i++) {
+		writeStr(writer, "statement ");
+		writeInt(writer, (int64_t)i);
+		writeStr(writer, ", ");
+		writeInt(writer, program->statements[i]->registerCount);
+		writeStr(writer, " registers\n");
+		writeVmFunction(writer, program->statements[i]);
+	}
+
+	for (uint32_t i = 0; i < program->functionsLen; i++) {
+		writeFunctionHeader(writer, program, i);
+		writeVmFunction(writer, program->functions[i]);
+	}
+}
+
+char* disassembleVmProgram(const struct VmProgram* program) {
+	struct Writer writer = createStringWriter(256);
+	writeVmProgram(&writer, program);
+	return takeWriterString(&writer);
+}
+
+void printVmProgram(FILE* stream, const struct VmProgram* program) {
+	char buffer[WRITER_CHUNK_SIZE];
+	struct Writer writer = createStreamWriter(stream, buffer, sizeof(buffer));
+	writeVmProgram(&writer, program);
+	freeWriter(&writer);
+}
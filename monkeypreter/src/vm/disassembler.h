@@ -0,0 +1,11 @@
+#pragma once
+#include <stdio.h>
+#include "bytecode.h"
+#include "../util/writer.h"
+
+//One line per instruction, every top level chunk first and then every function by index
+void writeVmProgram(struct Writer* writer, const struct VmProgram* program);
+void writeVmFunction(struct Writer* writer, const struct VmFunction* fn);
+//Caller frees the returned string
+char* disassembleVmProgram(const struct VmProgram* program);
+void printVmProgram(FILE* stream, const struct VmProgram* program);
@@ -0,0 +1,506 @@
+#include "jit.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/object.h"
+
+#ifdef VM_JIT
+#include <sys/mman.h>
+
+typedef struct Object* (*VmJitEntry)(struct VmJitContext* context);
+
+struct VmJitCode {
+	void* memory;
+	size_t size;
+};
+
+//Encodings of the x86-64 registers the templates use.
+//rbx holds the registers of the frame, r12 the context and r13 the GC, r14 keeps a value across calls, the rest is scratch
+enum JitRegister {
+	JIT_RAX = 0,
+	JIT_RCX = 1,
+	JIT_RDX = 2,
+	JIT_RBX = 3,
+	JIT_RSI = 6,
+	JIT_RDI = 7,
+	JIT_R12 = 12,
+	JIT_R13 = 13,
+	JIT_R14 = 14,
+};
+
+//Condition codes of jcc and cmovcc
+enum JitCondition {
+	JIT_OVERFLOW = 0x0,
+	JIT_EQUAL = 0x4,
+	JIT_NOT_EQUAL = 0x5,
+	JIT_LESS = 0xC,
+	JIT_GREATER = 0xF,
+};
+
+//A rel32 jump to patch once every address is known
+enum JitFixupKind {
+	//To the first byte of bytecode instruction target
+	JIT_FIXUP_INSTRUCTION,
+	//To the stub that hands instruction target back to the interpreter
+	JIT_FIXUP_DEOPT,
+	//To the exit returning context->error
+	JIT_FIXUP_ERROR,
+	//To the epilogue, returning rax
+	JIT_FIXUP_EXIT,
+};
+
+struct JitFixup {
+	uint32_t at;
+	enum JitFixupKind kind;
+	uint32_t target;
+};
+
+struct JitAssembler {
+	uint8_t* code;
+	size_t len;
+	size_t cap;
+	struct JitFixup* fixups;
+	size_t fixupsLen;
+	size_t fixupsCap;
+};
+
+static void emitByte(struct JitAssembler* a, uint8_t byte) {
+	if (a->len == a->cap) {
+		a->cap = a->cap ? a->cap * 2 : 1024;
+		a->code = (uint8_t*)realloc(a->code, a->cap);
+		if (!a->code) {
+			perror("realloc (jit code) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	a->code[a->len++] = byte;
+}
+
+static void emit32(struct JitAssembler* a, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		emitByte(a, (uint8_t)(value >> (8 * i)));
+	}
+}
+
+static void emit64(struct JitAssembler* a, uint64_t value) {
+	for (int i = 0; i < 8; i++) {
+		emitByte(a, (uint8_t)(value >> (8 * i)));
+	}
+}
+
+static void patch32(struct JitAssembler* a, size_t at, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		a->code[at + i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static void addFixup(struct JitAssembler* a, enum JitFixupKind kind, uint32_t target) {
+	if (a->fixupsLen == a->fixupsCap) {
+		a->fixupsCap = a->fixupsCap ? a->fixupsCap * 2 : 64;
+		a->fixups = (struct JitFixup*)realloc(a->fixups, a->fixupsCap * sizeof *a->fixups);
+		if (!a->fixups) {
+			perror("realloc (jit fixups) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	struct JitFixup* fixup = &a->fixups[a->fixupsLen++];
+	fixup->at = (uint32_t)a->len;
+	fixup->kind = kind;
+	fixup->target = target;
+	emit32(a, 0);
+}
+
+//op reg, [base + disp32]
+static void emitRegMem(struct JitAssembler* a, uint8_t opcode, bool wide, int reg, int base, int32_t disp) {
+	const uint8_t rex = (uint8_t)((wide ? 0x48 : 0x40) | (reg & 8 ? 0x04 : 0) | (base & 8 ? 0x01 : 0));
+	if (rex != 0x40) {
+		emitByte(a, rex);
+	}
+	emitByte(a, opcode);
+	emitByte(a, (uint8_t)(0x80 | (reg & 7) << 3 | (base & 7)));
+	//rsp and r12 as base need a SIB byte
+	if ((base & 7) == 4) {
+		emitByte(a, 0x24);
+	}
+	emit32(a, (uint32_t)disp);
+}
+
+//op rm, reg on 64-bit registers, opcodes of two bytes start with 0x0F
+static void emitRegReg(struct JitAssembler* a, uint16_t opcode, int reg, int rm) {
+	emitByte(a, (uint8_t)(0x48 | (reg & 8 ? 0x04 : 0) | (rm & 8 ? 0x01 : 0)));
+	if (opcode > 0xFF) {
+		emitByte(a, (uint8_t)(opcode >> 8));
+	}
+	emitByte(a, (uint8_t)opcode);
+	emitByte(a, (uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+static void emitLoad(struct JitAssembler* a, int reg, int base, int32_t disp) {
+	emitRegMem(a, 0x8B, true, reg, base, disp);
+}
+
+static void emitStore(struct JitAssembler* a, int base, int32_t disp, int reg) {
+	emitRegMem(a, 0x89, true, reg, base, disp);
+}
+
+static void emitMoveImmediate(struct JitAssembler* a, int reg, uint64_t value) {
+	emitByte(a, (uint8_t)(0x48 | (reg & 8 ? 0x01 : 0)));
+	emitByte(a, (uint8_t)(0xB8 + (reg & 7)));
+	emit64(a, value);
+}
+
+static void emitCall(struct JitAssembler* a, uint64_t function) {
+	emitMoveImmediate(a, JIT_RAX, function);
+	//call rax
+	emitByte(a, 0xFF);
+	emitByte(a, 0xD0);
+}
+
+static void emitJump(struct JitAssembler* a, enum JitFixupKind kind, uint32_t target) {
+	emitByte(a, 0xE9);
+	addFixup(a, kind, target);
+}
+
+static void emitJumpIf(struct JitAssembler* a, enum JitCondition condition, enum JitFixupKind kind, uint32_t target) {
+	emitByte(a, 0x0F);
+	emitByte(a, (uint8_t)(0x80 | condition));
+	addFixup(a, kind, target);
+}
+
+static int32_t registerOffset(uint16_t reg) {
+	return (int32_t)(reg * sizeof(struct Object*));
+}
+
+//Leaves the object in register b in reg, or the guard fails when it is no integer
+static void emitIntegerGuard(struct JitAssembler* a, int reg, uint16_t b, uint32_t index) {
+	emitLoad(a, reg, JIT_RBX, registerOffset(b));
+	//cmp dword [reg + type], OBJ_INT
+	emitRegMem(a, 0x81, false, 7, reg, (int32_t)offsetof(struct Object, type));
+	emit32(a, OBJ_INT);
+	emitJumpIf(a, JIT_NOT_EQUAL, JIT_FIXUP_DEOPT, index);
+}
+
+//Integer values of both operands in rax and rcx
+static bool emitIntegerOperands(struct JitAssembler* a, const struct VmFunction* fn, uint32_t index, bool constant) {
+	const struct VmInstruction* in = &fn->code[index];
+	const int32_t valueOffset = (int32_t)offsetof(struct Object, value.integer);
+
+	emitIntegerGuard(a, JIT_RAX, in->b, index);
+	if (constant) {
+		const struct Object* obj = fn->constants[in->c];
+		if (obj->type != OBJ_INT) {
+			return false;
+		}
+		emitMoveImmediate(a, JIT_RCX, (uint64_t)obj->value.integer);
+	}
+	else {
+		emitIntegerGuard(a, JIT_RCX, in->c, index);
+		emitLoad(a, JIT_RCX, JIT_RCX, valueOffset);
+	}
+	emitLoad(a, JIT_RAX, JIT_RAX, valueOffset);
+	return true;
+}
+
+//Register a = new integer holding rax
+static void emitBoxInteger(struct JitAssembler* a, uint16_t reg) {
+	emitRegReg(a, 0x89, JIT_RAX, JIT_R14);
+	emitRegReg(a, 0x89, JIT_R13, JIT_RDI);
+	emitMoveImmediate(a, JIT_RSI, OBJ_INT);
+	emitCall(a, (uint64_t)(uintptr_t)&createObject);
+	emitStore(a, JIT_RAX, (int32_t)offsetof(struct Object, value.integer), JIT_R14);
+	emitStore(a, JIT_RBX, registerOffset(reg), JIT_RAX);
+}
+
+static void emitArithmetic(struct JitAssembler* a, enum VmOpcode op, uint16_t reg, uint32_t index) {
+	switch (op) {
+		case VM_ADD:
+			emitRegReg(a, 0x01, JIT_RCX, JIT_RAX);
+			emitJumpIf(a, JIT_OVERFLOW, JIT_FIXUP_DEOPT, index);
+			break;
+
+		case VM_SUB:
+			emitRegReg(a, 0x29, JIT_RCX, JIT_RAX);
+			emitJumpIf(a, JIT_OVERFLOW, JIT_FIXUP_DEOPT, index);
+			break;
+
+		case VM_MUL:
+			emitRegReg(a, 0x0FAF, JIT_RAX, JIT_RCX);
+			emitJumpIf(a, JIT_OVERFLOW, JIT_FIXUP_DEOPT, index);
+			break;
+
+		default:
+			//Division by zero and by -1 are left to the interpreter, idiv traps on INT64_MIN / -1
+			emitRegReg(a, 0x85, JIT_RCX, JIT_RCX);
+			emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_DEOPT, index);
+			//cmp rcx, -1
+			emitByte(a, 0x48);
+			emitByte(a, 0x83);
+			emitByte(a, 0xF9);
+			emitByte(a, 0xFF);
+			emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_DEOPT, index);
+			//cqo, idiv rcx
+			emitByte(a, 0x48);
+			emitByte(a, 0x99);
+			emitByte(a, 0x48);
+			emitByte(a, 0xF7);
+			emitByte(a, 0xF9);
+			break;
+	}
+	emitBoxInteger(a, reg);
+}
+
+static void emitComparison(struct JitAssembler* a, enum JitCondition condition, uint16_t reg) {
+	emitRegReg(a, 0x39, JIT_RCX, JIT_RAX);
+	emitMoveImmediate(a, JIT_RAX, (uint64_t)(uintptr_t)&FalseObj);
+	emitMoveImmediate(a, JIT_RDX, (uint64_t)(uintptr_t)&TrueObj);
+	emitRegReg(a, (uint16_t)(0x0F40 | condition), JIT_RAX, JIT_RDX);
+	emitStore(a, JIT_RBX, registerOffset(reg), JIT_RAX);
+}
+
+//Instructions without a template run in the VM, which may move the register stack
+static void emitExecute(struct JitAssembler* a, const struct VmInstruction* in) {
+	emitRegReg(a, 0x89, JIT_R12, JIT_RDI);
+	emitMoveImmediate(a, JIT_RSI, (uint64_t)(uintptr_t)in);
+	emitCall(a, in->op == VM_CALL ? (uint64_t)(uintptr_t)&vmJitCall : (uint64_t)(uintptr_t)&vmJitExecute);
+	//test al, al
+	emitByte(a, 0x84);
+	emitByte(a, 0xC0);
+	emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_ERROR, 0);
+	emitLoad(a, JIT_RBX, JIT_R12, (int32_t)offsetof(struct VmJitContext, regs));
+}
+
+static bool emitInstruction(struct JitAssembler* a, const struct VmFunction* fn, uint32_t index) {
+	const struct VmInstruction* in = &fn->code[index];
+	switch ((enum VmOpcode)in->op) {
+		case VM_LOADK:
+			emitMoveImmediate(a, JIT_RAX, (uint64_t)(uintptr_t)fn->constants[vmWide(in)]);
+			emitStore(a, JIT_RBX, registerOffset(in->a), JIT_RAX);
+			return true;
+
+		case VM_MOVE:
+			emitLoad(a, JIT_RAX, JIT_RBX, registerOffset(in->b));
+			emitStore(a, JIT_RBX, registerOffset(in->a), JIT_RAX);
+			return true;
+
+		case VM_ADD:
+		case VM_SUB:
+		case VM_MUL:
+		case VM_DIV:
+			if (!emitIntegerOperands(a, fn, index, false)) {
+				return false;
+			}
+			emitArithmetic(a, (enum VmOpcode)in->op, in->a, index);
+			return true;
+
+		case VM_ADDK:
+		case VM_SUBK:
+		case VM_MULK:
+		case VM_DIVK:
+			if (!emitIntegerOperands(a, fn, index, true)) {
+				return false;
+			}
+			emitArithmetic(a, (enum VmOpcode)(in->op - VM_ADDK + VM_ADD), in->a, index);
+			return true;
+
+		case VM_LT:
+		case VM_GT:
+		case VM_EQ:
+		case VM_NOT_EQ:
+		case VM_LTK:
+		case VM_GTK:
+		case VM_EQK:
+		case VM_NOT_EQK: {
+			const bool constant = in->op >= VM_LTK;
+			if (!emitIntegerOperands(a, fn, index, constant)) {
+				return false;
+			}
+			static const enum JitCondition conditions[] = { JIT_LESS, JIT_GREATER, JIT_EQUAL, JIT_NOT_EQUAL };
+			emitComparison(a, conditions[in->op - (constant ? VM_LTK : VM_LT)], in->a);
+			return true;
+		}
+
+		case VM_JUMP:
+			emitJump(a, JIT_FIXUP_INSTRUCTION, vmWide(in));
+			return true;
+
+		case VM_JUMP_FALSE:
+			//Booleans are compared by address, anything else asks isTruthy
+			emitLoad(a, JIT_RAX, JIT_RBX, registerOffset(in->a));
+			emitMoveImmediate(a, JIT_RCX, (uint64_t)(uintptr_t)&TrueObj);
+			emitRegReg(a, 0x39, JIT_RCX, JIT_RAX);
+			emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_INSTRUCTION, index + 1);
+			emitMoveImmediate(a, JIT_RCX, (uint64_t)(uintptr_t)&FalseObj);
+			emitRegReg(a, 0x39, JIT_RCX, JIT_RAX);
+			emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_INSTRUCTION, vmWide(in));
+			emitRegReg(a, 0x89, JIT_RAX, JIT_RDI);
+			emitCall(a, (uint64_t)(uintptr_t)&vmJitTruthy);
+			emitByte(a, 0x84);
+			emitByte(a, 0xC0);
+			emitJumpIf(a, JIT_EQUAL, JIT_FIXUP_INSTRUCTION, vmWide(in));
+			return true;
+
+		case VM_RETURN:
+			emitLoad(a, JIT_RAX, JIT_RBX, registerOffset(in->a));
+			emitJump(a, JIT_FIXUP_EXIT, 0);
+			return true;
+
+		case VM_OPCODE_COUNT:
+			return false;
+
+		default:
+			emitExecute(a, in);
+			return true;
+	}
+}
+
+static void freeAssembler(struct JitAssembler* a) {
+	free(a->code);
+	free(a->fixups);
+}
+
+struct VmJitCode* compileVmJit(const struct VmFunction* fn) {
+	struct JitAssembler a;
+	memset(&a, 0, sizeof a);
+	uint32_t* starts = (uint32_t*)malloc((fn->codeLen + 1) * sizeof *starts);
+	uint32_t* stubs = (uint32_t*)malloc((fn->codeLen + 1) * sizeof *stubs);
+	if (!starts || !stubs) {
+		perror("malloc (jit offsets) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	//push rbx, push r12, push r13, push r14 and one more slot keep the stack 16 byte aligned for calls
+	emitByte(&a, 0x53);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x54);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x55);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x56);
+	emitByte(&a, 0x50);
+	emitRegReg(&a, 0x89, JIT_RDI, JIT_R12);
+	emitLoad(&a, JIT_RBX, JIT_R12, (int32_t)offsetof(struct VmJitContext, regs));
+	emitLoad(&a, JIT_R13, JIT_R12, (int32_t)offsetof(struct VmJitContext, gc));
+
+	bool compiled = true;
+	for (uint32_t i = 0; i < fn->codeLen && compiled; i++) {
+		starts[i] = (uint32_t)a.len;
+		compiled = emitInstruction(&a, fn, i);
+	}
+	starts[fn->codeLen] = (uint32_t)a.len;
+	if (!compiled) {
+		free(starts);
+		free(stubs);
+		freeAssembler(&a);
+		return NULL;
+	}
+
+	const uint32_t errorExit = (uint32_t)a.len;
+	emitLoad(&a, JIT_RAX, JIT_R12, (int32_t)offsetof(struct VmJitContext, error));
+	const uint32_t epilogue = (uint32_t)a.len;
+	//pop rcx, pop r14, pop r13, pop r12, pop rbx, ret
+	emitByte(&a, 0x59);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x5E);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x5D);
+	emitByte(&a, 0x41);
+	emitByte(&a, 0x5C);
+	emitByte(&a, 0x5B);
+	emitByte(&a, 0xC3);
+
+	//One stub per instruction with a guard, it returns NULL with the instruction to resume at
+	for (uint32_t i = 0; i <= fn->codeLen; i++) {
+		stubs[i] = UINT32_MAX;
+	}
+	const size_t bodyFixups = a.fixupsLen;
+	for (size_t i = 0; i < bodyFixups; i++) {
+		const uint32_t target = a.fixups[i].target;
+		if (a.fixups[i].kind != JIT_FIXUP_DEOPT || stubs[target] != UINT32_MAX) {
+			continue;
+		}
+		stubs[target] = (uint32_t)a.len;
+		//mov dword [r12 + resume], target
+		emitRegMem(&a, 0xC7, false, 0, JIT_R12, (int32_t)offsetof(struct VmJitContext, resume));
+		emit32(&a, target);
+		//xor eax, eax
+		emitByte(&a, 0x31);
+		emitByte(&a, 0xC0);
+		emitJump(&a, JIT_FIXUP_EXIT, 0);
+	}
+
+	for (size_t i = 0; i < a.fixupsLen; i++) {
+		const struct JitFixup* fixup = &a.fixups[i];
+		uint32_t destination = epilogue;
+		switch (fixup->kind) {
+			case JIT_FIXUP_INSTRUCTION:
+				destination = starts[fixup->target];
+				break;
+			case JIT_FIXUP_DEOPT:
+				destination = stubs[fixup->target];
+				break;
+			case JIT_FIXUP_ERROR:
+				destination = errorExit;
+				break;
+			case JIT_FIXUP_EXIT:
+				break;
+		}
+		patch32(&a, fixup->at, destination - (fixup->at + 4));
+	}
+	free(starts);
+	free(stubs);
+
+	//Written first and made executable after, never both at once
+	void* memory = mmap(NULL, a.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		freeAssembler(&a);
+		return NULL;
+	}
+	memcpy(memory, a.code, a.len);
+	if (mprotect(memory, a.len, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, a.len);
+		freeAssembler(&a);
+		return NULL;
+	}
+
+	struct VmJitCode* code = (struct VmJitCode*)malloc(sizeof *code);
+	if (!code) {
+		perror("malloc (jit code) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	code->memory = memory;
+	code->size = a.len;
+	freeAssembler(&a);
+	return code;
+}
+
+struct Object* runVmJitCode(const struct VmJitCode* code, struct VmJitContext* context) {
+	return ((VmJitEntry)code->memory)(context);
+}
+
+void freeVmJitCode(struct VmJitCode* code) {
+	if (!code) {
+		return;
+	}
+	munmap(code->memory, code->size);
+	free(code);
+}
+
+#else
+
+struct VmJitCode* compileVmJit(const struct VmFunction* fn) {
+	(void)fn;
+	return NULL;
+}
+
+struct Object* runVmJitCode(const struct VmJitCode* code, struct VmJitContext* context) {
+	(void)code;
+	(void)context;
+	return NULL;
+}
+
+void freeVmJitCode(struct VmJitCode* code) {
+	(void)code;
+}
+
+#endif
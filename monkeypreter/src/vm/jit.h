@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "bytecode.h"
+#include "../util/cpu_features.h"
+
+//Baseline JIT for hot VM functions, every instruction is translated on its own from a fixed template.
+//Native code works on the same registers as the interpreter: integer operators are inlined behind type and
+//overflow guards, everything else calls back into the VM. A failing guard returns to the interpreter,
+//which carries on with the frame at the instruction that failed.
+//Only Linux x86-64 gets native code, everywhere else compileVmJit fails and functions stay interpreted
+#if defined(__linux__) && defined(MONKEY_X64)
+#define VM_JIT
+#define VM_JIT_THRESHOLD 1000
+#else
+#define VM_JIT_THRESHOLD 0
+#endif
+
+//Native code stops being entered after this many guard failures
+#define VM_JIT_MAX_DEOPTS 100
+//Deeper calls are interpreted, those do not use the C stack
+#define VM_JIT_MAX_DEPTH 2048
+
+//Frame of a native call, the generated code reads it at fixed offsets
+struct VmJitContext {
+	//Reloaded after every call back into the VM, it may move the register stack
+	struct Object** regs;
+	struct MonkeyGC* gc;
+	struct VmProgram* program;
+	size_t frameIndex;
+	//Set when a call back into the VM failed
+	struct Object* error;
+	//Instruction the interpreter picks up at after a guard failed
+	uint32_t resume;
+};
+
+//NULL when fn can not be compiled or there is no JIT on this platform
+struct VmJitCode* compileVmJit(const struct VmFunction* fn);
+//Result of the function, an error, or NULL after a guard failed
+struct Object* runVmJitCode(const struct VmJitCode* code, struct VmJitContext* context);
+void freeVmJitCode(struct VmJitCode* code);
+
+//Implemented by the VM, called from native code. Integers are allocated with createObject directly
+bool vmJitTruthy(struct Object* obj);
+//Both run one instruction that has no native template, false with context->error set on an error
+bool vmJitCall(struct VmJitContext* context, const struct VmInstruction* in);
+bool vmJitExecute(struct VmJitContext* context, const struct VmInstruction* in);
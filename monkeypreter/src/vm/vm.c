@@ -0,0 +1,581 @@
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/builtins.h"
+#include "../evaluator/compact_evaluator.h"
+#include "../evaluator/evaluator.h"
+#include "../evaluator/gc.h"
+#include "../evaluator/object.h"
+#include "jit.h"
+
+//Builtins get their arguments copied out of the registers, a callback into the program may move the stack.
+//Up to this many are copied to the C stack
+#define VM_BUILTIN_STACK_ARGS 8
+
+//GCC and Clang jump from one handler straight to the next through a table of label addresses,
+//other compilers go through the switch the handlers are written in
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO
+#define VM_TARGET(code) target_##code: case code
+#define VM_NEXT() in = pc++; goto *dispatchTable[in->op]
+#else
+#define VM_TARGET(code) case code
+#define VM_NEXT() continue
+#endif
+
+static void reserveVmStack(struct VmProgram* program, size_t size) {
+	if (size <= program->stackCap) {
+		return;
+	}
+
+	size_t cap = program->stackCap ? program->stackCap : 256;
+	while (cap < size) {
+		cap *= 2;
+	}
+	program->stack = (struct Object**)realloc(program->stack, cap * sizeof *program->stack);
+	if (!program->stack) {
+		perror("realloc (vm stack) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	program->stackCap = cap;
+}
+
+//Every parameter is already in place at base. Parameters are read in place, so a call missing arguments
+//never gets a frame: vmTakesCall sends it to the compact evaluator, which leaves those parameters unbound
+static void pushVmFrame(struct VmProgram* program, const struct VmFunction* fn, size_t base, struct ObjectEnvironment* closureEnv, uint16_t result) {
+	reserveVmStack(program, base + fn->registerCount);
+	if (program->framesLen == program->framesCap) {
+		program->framesCap = program->framesCap ? program->framesCap * 2 : 64;
+		program->frames = (struct VmFrame*)realloc(program->frames, program->framesCap * sizeof *program->frames);
+		if (!program->frames) {
+			perror("realloc (vm frames) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	struct Object** regs = program->stack + base;
+	//Locals start out unbound
+	for (size_t i = fn->paramCount; i < fn->localCount; i++) {
+		regs[i] = NULL;
+	}
+
+	struct VmFrame* frame = &program->frames[program->framesLen++];
+	frame->fn = fn;
+	frame->pc = fn->code;
+	frame->base = base;
+	frame->env = fn->ownEnv ? newEnclosedEnvironment(closureEnv) : closureEnv;
+	frame->result = result;
+}
+
+static struct Object* lookupVmName(struct ObjectEnvironment* env, struct VmName* name) {
+	if (name->builtin && !isBuiltinShadowed(name->builtin)) {
+		return name->builtin;
+	}
+
+	//Functions without an own environment look up from the same closure environment on every call
+	const uint32_t version = bindingVersion(name->hash);
+	if (name->cachedEnv == env && name->cachedVersion == version) {
+		return name->cached;
+	}
+
+	struct Object* obj = environmentGetHashed(env, name->text, name->hash);
+	if (obj->type != OBJ_NULL) {
+		name->cachedEnv = env;
+		name->cachedVersion = version;
+		name->cached = obj;
+		return obj;
+	}
+
+	if (name->builtin) {
+		return name->builtin;
+	}
+
+	return newEvalError(env->gc, "identifier not found: %s", name->text);
+}
+
+static struct Object* newVmInteger(struct MonkeyGC* gc, int64_t value) {
+	struct Object* obj = createObject(gc, OBJ_INT);
+	obj->value.integer = value;
+	return obj;
+}
+
+static struct Object* makeVmClosure(struct VmProgram* program, const struct VmFunction* proto, struct ObjectEnvironment* env, struct MonkeyGC* gc) {
+	struct Object* obj = createObject(gc, OBJ_FUNCTION);
+	obj->value.function.parameters.values = NULL;
+	obj->value.function.parameters.size = 0;
+	obj->value.function.parameters.cap = 0;
+	obj->value.function.body = NULL;
+	obj->value.function.env = env;
+	obj->value.function.compactAst = program->ast;
+	obj->value.function.compactNode = proto->node;
+	obj->value.function.compiled = NULL;
+	obj->value.function.vmFunction = proto;
+	obj->value.function.native = NULL;
+	obj->value.function.freesFrame = false;
+	obj->value.function.ownsEnv = false;
+	return obj;
+}
+
+static struct Object* indexVmObject(struct Object* left, struct Object* right, struct MonkeyGC* gc) {
+	if (left->type == OBJ_ARRAY && right->type == OBJ_INT) {
+		const int64_t index = right->value.integer;
+		return index < 0 || (size_t)index >= arrayLength(left) ? &NullObj : arrayGet(gc, left, (size_t)index);
+	}
+	return evalIndexExpression(left, right, gc);
+}
+
+//Native code of fn once it has been called often enough, NULL while it stays interpreted
+static const struct VmJitCode* hotVmCode(const struct VmProgram* program, const struct VmFunction* fn) {
+	struct VmJitState* jit = fn->jit;
+	if (jit->disabled || program->jitDepth >= VM_JIT_MAX_DEPTH) {
+		return NULL;
+	}
+	if (jit->code) {
+		return jit->code;
+	}
+	if (program->jitThreshold == 0 || ++jit->calls < program->jitThreshold) {
+		return NULL;
+	}
+
+	jit->code = compileVmJit(fn);
+	jit->disabled = !jit->code;
+	return jit->code;
+}
+
+//Runs the frame on top natively and pops it. NULL when a guard failed,
+//the frame is then left for the interpreter to carry on at the instruction that failed
+static struct Object* enterVmJit(struct VmProgram* program, const struct VmJitCode* code) {
+	const size_t frameIndex = program->framesLen - 1;
+	struct VmFrame* frame = &program->frames[frameIndex];
+	struct VmJitContext context = { program->stack + frame->base, frame->env->gc, program, frameIndex, NULL, 0 };
+	program->jitDepth++;
+	struct Object* obj = runVmJitCode(code, &context);
+	program->jitDepth--;
+	if (obj) {
+		program->framesLen = frameIndex;
+		return obj;
+	}
+
+	frame = &program->frames[frameIndex];
+	frame->pc = frame->fn->code + context.resume;
+	struct VmJitState* jit = frame->fn->jit;
+	jit->disabled = ++jit->deopts >= VM_JIT_MAX_DEOPTS;
+	return NULL;
+}
+
+//Anything but a function of this program, through applyFunction
+static struct Object* callVmForeign(struct Object* callee, struct Object** window, size_t argc, struct MonkeyGC* gc) {
+	struct Object* stackBuffer[VM_BUILTIN_STACK_ARGS];
+	struct ObjectList args = { argc, argc, stackBuffer };
+	if (argc > VM_BUILTIN_STACK_ARGS) {
+		args.objects = (struct Object**)malloc(argc * sizeof *args.objects);
+		if (!args.objects) {
+			perror("malloc (vm builtin args) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(args.objects, window, argc * sizeof *args.objects);
+
+	struct Object* result = applyFunction(callee, &args, gc);
+	if (args.objects != stackBuffer) {
+		free(args.objects);
+	}
+	return result;
+}
+
+//Callee of a CALL that runs in a frame of this program, extra arguments are dropped
+static const struct VmFunction* vmTakesCall(const struct VmProgram* program, const struct Object* callee, uint16_t argc) {
+	const struct VmFunction* target = callee->type == OBJ_FUNCTION ? callee->value.function.vmFunction : NULL;
+	return target && target->program == program && argc >= target->paramCount ? target : NULL;
+}
+
+//Runs frames until the one at entry returns, errors unwind every frame of this run
+static struct Object* runVm(struct VmProgram* program, size_t entry) {
+#ifdef VM_COMPUTED_GOTO
+#define VM_TARGET_ADDRESS(code) &&target_##code,
+	static void* const dispatchTable[VM_OPCODE_COUNT] = { VM_OPCODES(VM_TARGET_ADDRESS) };
+#undef VM_TARGET_ADDRESS
+#endif
+
+	size_t frameIndex = program->framesLen - 1;
+	struct VmFrame* frame = &program->frames[frameIndex];
+	const struct VmFunction* fn = frame->fn;
+	const struct VmInstruction* pc = frame->pc;
+	struct Object** regs = program->stack + frame->base;
+	struct ObjectEnvironment* env = frame->env;
+	struct MonkeyGC* gc = env->gc;
+
+	const struct VmInstruction* in;
+	struct Object* obj;
+	struct Object* left;
+	struct Object* right;
+
+	//Frames and stack may have moved after a push or a call out of the VM
+#define VM_LOAD_FRAME() \
+	frame = &program->frames[frameIndex]; \
+	fn = frame->fn; \
+	pc = frame->pc; \
+	regs = program->stack + frame->base; \
+	env = frame->env
+
+	for (;;) {
+		in = pc++;
+#ifdef VM_COMPUTED_GOTO
+		goto *dispatchTable[in->op];
+#endif
+
+		switch ((enum VmOpcode)in->op) {
+			VM_TARGET(VM_LOADK): {
+				regs[in->a] = fn->constants[vmWide(in)];
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_MOVE): {
+				regs[in->a] = regs[in->b];
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_GET_LOCAL): {
+				obj = regs[in->b];
+				if (!obj) {
+					//Not bound yet, the name still means whatever it means outside
+					obj = lookupVmName(env, &fn->names[in->c]);
+					if (isError(obj)) {
+						goto error;
+					}
+				}
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_GET_NAME): {
+				obj = lookupVmName(env, &fn->names[vmWide(in)]);
+				if (isError(obj)) {
+					goto error;
+				}
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_SET_NAME): {
+				const struct VmName* name = &fn->names[vmWide(in)];
+				environmentSetHashed(env, name->text, name->hash, regs[in->a]);
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_NEG): {
+				right = regs[in->b];
+				if (right->type == OBJ_INT) {
+					regs[in->a] = newVmInteger(gc, (int64_t)(0 - (uint64_t)right->value.integer));
+					VM_NEXT();
+				}
+				obj = evalPrefixExpression(OP_SUBTRACT, right, gc);
+				if (isError(obj)) {
+					goto error;
+				}
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_NOT): {
+				right = regs[in->b];
+				regs[in->a] = nativeBoolToBoolObj(right->type == OBJ_BOOL ? !right->value.boolean : right->type == OBJ_NULL);
+				VM_NEXT();
+			}
+
+			//Register and constant form share the body, operands guard fails on take the generic path
+#define VM_INT_OPERATOR(code, operatorType, guard, result) \
+			VM_TARGET(code): { \
+				left = regs[in->b]; \
+				right = regs[in->c]; \
+				goto code##_BODY; \
+			} \
+			VM_TARGET(code##K): { \
+				left = regs[in->b]; \
+				right = fn->constants[in->c]; \
+			} \
+			code##_BODY: { \
+				if (left->type == OBJ_INT && right->type == OBJ_INT && (guard)) { \
+					regs[in->a] = result; \
+					VM_NEXT(); \
+				} \
+				obj = evalInfixExpression(operatorType, left, right, gc); \
+				if (isError(obj)) { \
+					goto error; \
+				} \
+				regs[in->a] = obj; \
+				VM_NEXT(); \
+			}
+
+#define LEFT_INT left->value.integer
+#define RIGHT_INT right->value.integer
+
+			VM_INT_OPERATOR(VM_ADD, OP_ADD, true, newVmInteger(gc, (int64_t)((uint64_t)LEFT_INT + (uint64_t)RIGHT_INT)))
+			VM_INT_OPERATOR(VM_SUB, OP_SUBTRACT, true, newVmInteger(gc, (int64_t)((uint64_t)LEFT_INT - (uint64_t)RIGHT_INT)))
+			VM_INT_OPERATOR(VM_MUL, OP_MULTIPLY, true, newVmInteger(gc, (int64_t)((uint64_t)LEFT_INT * (uint64_t)RIGHT_INT)))
+			//Zero and INT64_MIN / -1 keep whatever evalInfixExpression does with them
+			VM_INT_OPERATOR(VM_DIV, OP_DIVIDE, RIGHT_INT != 0 && (RIGHT_INT != -1 || LEFT_INT != INT64_MIN), newVmInteger(gc, LEFT_INT / RIGHT_INT))
+			VM_INT_OPERATOR(VM_LT, OP_LT, true, nativeBoolToBoolObj(LEFT_INT < RIGHT_INT))
+			VM_INT_OPERATOR(VM_GT, OP_GT, true, nativeBoolToBoolObj(LEFT_INT > RIGHT_INT))
+			VM_INT_OPERATOR(VM_EQ, OP_EQ, true, nativeBoolToBoolObj(LEFT_INT == RIGHT_INT))
+			VM_INT_OPERATOR(VM_NOT_EQ, OP_NOT_EQ, true, nativeBoolToBoolObj(LEFT_INT != RIGHT_INT))
+
+#undef LEFT_INT
+#undef RIGHT_INT
+#undef VM_INT_OPERATOR
+
+			VM_TARGET(VM_JUMP): {
+				pc = fn->code + vmWide(in);
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_JUMP_FALSE): {
+				obj = regs[in->a];
+				if (obj != &TrueObj && !isTruthy(obj)) {
+					pc = fn->code + vmWide(in);
+				}
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_FUNCTION): {
+				regs[in->a] = makeVmClosure(program, program->functions[vmWide(in)], env, gc);
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_CALL): {
+				struct Object* callee = regs[in->b];
+				const struct VmFunction* target = vmTakesCall(program, callee, in->c);
+				if (target) {
+					//The arguments already are the first registers of the callee
+					frame->pc = pc;
+					pushVmFrame(program, target, frame->base + in->b + 1, callee->value.function.env, in->a);
+					const struct VmJitCode* code = hotVmCode(program, target);
+					if (code) {
+						obj = enterVmJit(program, code);
+						if (obj) {
+							VM_LOAD_FRAME();
+							if (isError(obj)) {
+								goto error;
+							}
+							regs[in->a] = obj;
+							VM_NEXT();
+						}
+					}
+					frameIndex++;
+					VM_LOAD_FRAME();
+					VM_NEXT();
+				}
+
+				frame->pc = pc;
+				program->stackTop = frame->base + fn->registerCount;
+				obj = callVmForeign(callee, regs + in->b + 1, in->c, gc);
+				VM_LOAD_FRAME();
+				if (isError(obj)) {
+					goto error;
+				}
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_ARRAY): {
+				struct ObjectList elements = { in->c, in->c, regs + in->b };
+				regs[in->a] = arrayFromList(gc, &elements);
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_INDEX): {
+				obj = indexVmObject(regs[in->b], regs[in->c], gc);
+				if (isError(obj)) {
+					goto error;
+				}
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_WRAP_RETURN): {
+				//Wrap instead of retagging, the value may still be bound to a name
+				obj = createObject(gc, OBJ_RETURN);
+				obj->value.retObj = regs[in->b];
+				regs[in->a] = obj;
+				VM_NEXT();
+			}
+
+			VM_TARGET(VM_RETURN): {
+				obj = regs[in->a];
+				if (frameIndex == entry) {
+					program->framesLen = entry;
+					return obj;
+				}
+
+				const uint16_t result = frame->result;
+				program->framesLen--;
+				frameIndex--;
+				VM_LOAD_FRAME();
+				regs[result] = obj;
+				VM_NEXT();
+			}
+
+			case VM_OPCODE_COUNT:
+				break;
+		}
+	}
+
+error:
+	program->framesLen = entry;
+	return obj;
+#undef VM_LOAD_FRAME
+}
+
+//Runs the frame just pushed until it returns, natively once its function is hot
+static struct Object* finishVmFrame(struct VmProgram* program, const struct VmFunction* fn) {
+	const struct VmJitCode* code = hotVmCode(program, fn);
+	if (code) {
+		struct Object* obj = enterVmJit(program, code);
+		if (obj) {
+			return obj;
+		}
+	}
+	return runVm(program, program->framesLen - 1);
+}
+
+bool vmJitTruthy(struct Object* obj) {
+	return isTruthy(obj);
+}
+
+//Calls finish before returning to the native code
+bool vmJitCall(struct VmJitContext* context, const struct VmInstruction* in) {
+	struct VmProgram* program = context->program;
+	const struct VmFrame* frame = &program->frames[context->frameIndex];
+	struct Object* callee = context->regs[in->b];
+	const struct VmFunction* target = vmTakesCall(program, callee, in->c);
+	struct Object* obj;
+	if (target) {
+		pushVmFrame(program, target, frame->base + in->b + 1, callee->value.function.env, in->a);
+		obj = finishVmFrame(program, target);
+	}
+	else {
+		program->stackTop = frame->base + frame->fn->registerCount;
+		obj = callVmForeign(callee, context->regs + in->b + 1, in->c, context->gc);
+	}
+
+	//Either may have grown the register stack
+	context->regs = program->stack + program->frames[context->frameIndex].base;
+	if (isError(obj)) {
+		context->error = obj;
+		return false;
+	}
+	context->regs[in->a] = obj;
+	return true;
+}
+
+//Same as the handlers of runVm
+bool vmJitExecute(struct VmJitContext* context, const struct VmInstruction* in) {
+	struct VmProgram* program = context->program;
+	const struct VmFrame* frame = &program->frames[context->frameIndex];
+	const struct VmFunction* fn = frame->fn;
+	struct ObjectEnvironment* env = frame->env;
+	struct MonkeyGC* gc = context->gc;
+	struct Object** regs = context->regs;
+	struct Object* obj = NULL;
+
+	switch ((enum VmOpcode)in->op) {
+		case VM_GET_LOCAL:
+			obj = regs[in->b] ? regs[in->b] : lookupVmName(env, &fn->names[in->c]);
+			break;
+
+		case VM_GET_NAME:
+			obj = lookupVmName(env, &fn->names[vmWide(in)]);
+			break;
+
+		case VM_SET_NAME: {
+			const struct VmName* name = &fn->names[vmWide(in)];
+			environmentSetHashed(env, name->text, name->hash, regs[in->a]);
+			return true;
+		}
+
+		case VM_NEG: {
+			struct Object* right = regs[in->b];
+			obj = right->type == OBJ_INT ? newVmInteger(gc, (int64_t)(0 - (uint64_t)right->value.integer)) : evalPrefixExpression(OP_SUBTRACT, right, gc);
+			break;
+		}
+
+		case VM_NOT: {
+			struct Object* right = regs[in->b];
+			obj = nativeBoolToBoolObj(right->type == OBJ_BOOL ? !right->value.boolean : right->type == OBJ_NULL);
+			break;
+		}
+
+		case VM_FUNCTION:
+			obj = makeVmClosure(program, program->functions[vmWide(in)], env, gc);
+			break;
+
+		case VM_ARRAY: {
+			struct ObjectList elements = { in->c, in->c, regs + in->b };
+			obj = arrayFromList(gc, &elements);
+			break;
+		}
+
+		case VM_INDEX:
+			obj = indexVmObject(regs[in->b], regs[in->c], gc);
+			break;
+
+		case VM_WRAP_RETURN:
+			obj = createObject(gc, OBJ_RETURN);
+			obj->value.retObj = regs[in->b];
+			break;
+
+		default:
+			//Every other instruction has a template or a helper of its own
+			context->error = newEvalError(gc, "no native fallback for instruction %d", (int)in->op);
+			return false;
+	}
+
+	if (isError(obj)) {
+		context->error = obj;
+		return false;
+	}
+	regs[in->a] = obj;
+	return true;
+}
+
+struct Object* evalVmProgram(struct VmProgram* program, struct ObjectEnvironment* env) {
+	struct Object* obj = &NullObj;
+	for (size_t i = 0; i < program->statementsLen; i++) {
+		program->stackTop = 0;
+		pushVmFrame(program, program->statements[i], 0, env, 0);
+		obj = runVm(program, program->framesLen - 1);
+		//Mark intermediate result
+		markMonkeyObject(obj);
+		if (env->gc->size >= env->gc->maxSize)
+			collectMonkeyGarbage(env->gc, env);
+
+		if (obj->type == OBJ_RETURN) {
+			return unwrapReturnValue(obj);
+		}
+
+		if (isError(obj)) {
+			return obj;
+		}
+	}
+	return obj;
+}
+
+struct Object* applyVmFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc) {
+	const struct VmFunction* target = fn->value.function.vmFunction;
+	struct VmProgram* program = target->program;
+
+	if (args->size < target->paramCount) {
+		return applyCompactFunction(fn, args, gc);
+	}
+
+	//Above every register of the frames still running
+	const size_t base = program->stackTop;
+	pushVmFrame(program, target, base, fn->value.function.env, 0);
+	memcpy(program->stack + base, args->objects, target->paramCount * sizeof *args->objects);
+
+	program->stackTop = base + target->registerCount;
+	struct Object* result = finishVmFrame(program, target);
+	program->stackTop = base;
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "bytecode.h"
+
+struct ObjectList;
+
+//Same semantics as evalProgram, runs the chunks of compileVmProgram one after the other
+struct Object* evalVmProgram(struct VmProgram* program, struct ObjectEnvironment* env);
+//Called by applyFunction, for builtins like map calling back into a function of the program
+struct Object* applyVmFunction(struct Object* fn, struct ObjectList* args, struct MonkeyGC* gc);
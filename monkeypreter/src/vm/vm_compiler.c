@@ -0,0 +1,801 @@
+#include "vm_compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../evaluator/builtins.h"
+#include "../evaluator/constants.h"
+#include "../evaluator/hash_map.h"
+#include "../evaluator/object.h"
+#include "jit.h"
+
+//Target of an expression whose register the compiler picks, a bound local is then read in place
+#define VM_ANY_REGISTER UINT32_MAX
+#define VM_MAX_REGISTERS UINT16_MAX
+
+struct VmNameList {
+	const char** names;
+	size_t len;
+	size_t cap;
+};
+
+struct VmLocal {
+	const char* name;
+	//Read by a nested function, lives in the environment of the call instead of its register
+	bool captured;
+	//Bound on every path to the instruction being compiled
+	bool bound;
+};
+
+struct VmCompiler {
+	struct VmProgram* program;
+	const struct CompactAst* ast;
+	struct VmFunction* fn;
+	//Local i lives in register i
+	struct VmLocal* locals;
+	size_t localsLen;
+	//Next free register, temporaries are released in stack order
+	uint32_t top;
+	bool topLevel;
+	bool failed;
+};
+
+static uint16_t compileExpression(struct VmCompiler* c, NodeRef ref, uint32_t target);
+static uint16_t compileStatement(struct VmCompiler* c, NodeRef ref, uint32_t target);
+static uint32_t compileFunction(struct VmProgram* program, NodeRef ref, bool* failed);
+
+static void* growBuffer(void* data, uint32_t* cap, size_t size) {
+	*cap = *cap ? *cap * 2 : 8;
+	data = realloc(data, (size_t)*cap * size);
+	if (!data) {
+		perror("realloc (vm buffer) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	return data;
+}
+
+static void addVmName(struct VmNameList* list, const char* name) {
+	if (list->len == list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 8;
+		list->names = (const char**)realloc((void*)list->names, list->cap * sizeof *list->names);
+		if (!list->names) {
+			perror("realloc (vm names) returned `NULL`\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	list->names[list->len++] = name;
+}
+
+static bool containsVmName(const struct VmNameList* list, const char* name) {
+	for (size_t i = 0; i < list->len; i++) {
+		if (strcmp(list->names[i], name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void addUniqueVmName(struct VmNameList* list, const char* name) {
+	if (!containsVmName(list, name)) {
+		addVmName(list, name);
+	}
+}
+
+//Names bound by `let` anywhere in the function, nested functions bind into their own environment
+static void collectLets(const struct CompactAst* ast, NodeRef ref, struct VmNameList* lets) {
+	if (ref == NODE_NONE) {
+		return;
+	}
+
+	const struct CompactNode* node = &ast->nodes[ref];
+	size_t count = 0;
+	const uint32_t* entries = NULL;
+	switch (node->type) {
+		case CNODE_LET:
+			addUniqueVmName(lets, compactText(ast, node->a));
+			collectLets(ast, node->b, lets);
+			break;
+
+		case CNODE_PREFIX:
+		case CNODE_RETURN:
+			collectLets(ast, node->a, lets);
+			break;
+
+		case CNODE_INFIX:
+		case CNODE_INDEX:
+			collectLets(ast, node->a, lets);
+			collectLets(ast, node->b, lets);
+			break;
+
+		case CNODE_IF:
+			collectLets(ast, node->a, lets);
+			collectLets(ast, node->b, lets);
+			collectLets(ast, node->c, lets);
+			break;
+
+		case CNODE_CALL:
+			collectLets(ast, node->a, lets);
+			entries = compactList(ast, node->b, &count);
+			break;
+
+		case CNODE_ARRAY:
+		case CNODE_BLOCK:
+			entries = compactList(ast, node->a, &count);
+			break;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		collectLets(ast, entries[i], lets);
+	}
+}
+
+//Parameters first, in order, then every other name the function binds
+static void collectFunctionLocals(const struct CompactAst* ast, const struct CompactNode* node, struct VmNameList* locals) {
+	size_t count = 0;
+	const uint32_t* parameters = compactList(ast, node->a, &count);
+	for (size_t i = 0; i < count; i++) {
+		addVmName(locals, compactText(ast, parameters[i]));
+	}
+	collectLets(ast, node->b, locals);
+}
+
+//Searched from the back, the last of two equal parameter names wins like in environmentSet
+static struct VmLocal* findLocal(struct VmCompiler* c, const char* name) {
+	for (size_t i = c->localsLen; i-- > 0;) {
+		if (strcmp(c->locals[i].name, name) == 0) {
+			return &c->locals[i];
+		}
+	}
+	return NULL;
+}
+
+//Marks the locals that nested functions name. A nested function binding the same name itself
+//may still read this one before its own `let` runs, so it counts as well
+static void markCaptured(struct VmCompiler* c, NodeRef ref, bool nested) {
+	if (ref == NODE_NONE) {
+		return;
+	}
+
+	const struct CompactAst* ast = c->ast;
+	const struct CompactNode* node = &ast->nodes[ref];
+	size_t count = 0;
+	const uint32_t* entries = NULL;
+	switch (node->type) {
+		case CNODE_IDENT: {
+			const char* name = compactText(ast, node->a);
+			struct VmLocal* local = nested ? findLocal(c, name) : NULL;
+			if (local) {
+				local->captured = true;
+			}
+			break;
+		}
+
+		case CNODE_FUNCTION:
+			markCaptured(c, node->b, true);
+			break;
+
+		case CNODE_PREFIX:
+		case CNODE_RETURN:
+			markCaptured(c, node->a, nested);
+			break;
+
+		case CNODE_LET:
+			markCaptured(c, node->b, nested);
+			break;
+
+		case CNODE_INFIX:
+		case CNODE_INDEX:
+			markCaptured(c, node->a, nested);
+			markCaptured(c, node->b, nested);
+			break;
+
+		case CNODE_IF:
+			markCaptured(c, node->a, nested);
+			markCaptured(c, node->b, nested);
+			markCaptured(c, node->c, nested);
+			break;
+
+		case CNODE_CALL:
+			markCaptured(c, node->a, nested);
+			entries = compactList(ast, node->b, &count);
+			break;
+
+		case CNODE_ARRAY:
+		case CNODE_BLOCK:
+			entries = compactList(ast, node->a, &count);
+			break;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		markCaptured(c, entries[i], nested);
+	}
+}
+
+//Whether evaluating ref can rebind a local, an operand read in place before it has to be copied first
+static bool mayBind(const struct CompactAst* ast, NodeRef ref) {
+	if (ref == NODE_NONE) {
+		return false;
+	}
+
+	const struct CompactNode* node = &ast->nodes[ref];
+	size_t count = 0;
+	const uint32_t* entries = NULL;
+	switch (node->type) {
+		case CNODE_LET:
+			return true;
+
+		case CNODE_PREFIX:
+		case CNODE_RETURN:
+			return mayBind(ast, node->a);
+
+		case CNODE_INFIX:
+		case CNODE_INDEX:
+			return mayBind(ast, node->a) || mayBind(ast, node->b);
+
+		case CNODE_IF:
+			return mayBind(ast, node->a) || mayBind(ast, node->b) || mayBind(ast, node->c);
+
+		case CNODE_CALL:
+			if (mayBind(ast, node->a)) {
+				return true;
+			}
+			entries = compactList(ast, node->b, &count);
+			break;
+
+		case CNODE_ARRAY:
+		case CNODE_BLOCK:
+			entries = compactList(ast, node->a, &count);
+			break;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (mayBind(ast, entries[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint32_t emit(struct VmCompiler* c, enum VmOpcode op, uint16_t a, uint16_t b, uint16_t cOperand) {
+	struct VmFunction* fn = c->fn;
+	if (fn->codeLen == fn->codeCap) {
+		fn->code = (struct VmInstruction*)growBuffer(fn->code, &fn->codeCap, sizeof *fn->code);
+	}
+
+	struct VmInstruction* in = &fn->code[fn->codeLen];
+	in->op = (uint16_t)op;
+	in->a = a;
+	in->b = b;
+	in->c = cOperand;
+	return fn->codeLen++;
+}
+
+static uint32_t emitWide(struct VmCompiler* c, enum VmOpcode op, uint16_t a, uint32_t bx) {
+	return emit(c, op, a, (uint16_t)(bx & 0xFFFF), (uint16_t)(bx >> 16));
+}
+
+//Points the jump at the next instruction
+static void patchJump(struct VmCompiler* c, uint32_t at) {
+	struct VmInstruction* in = &c->fn->code[at];
+	in->b = (uint16_t)(c->fn->codeLen & 0xFFFF);
+	in->c = (uint16_t)(c->fn->codeLen >> 16);
+}
+
+static uint32_t addConstant(struct VmCompiler* c, struct Object* obj) {
+	struct VmFunction* fn = c->fn;
+	if (fn->constantsLen == fn->constantsCap) {
+		fn->constants = (struct Object**)growBuffer(fn->constants, &fn->constantsCap, sizeof *fn->constants);
+	}
+	fn->constants[fn->constantsLen] = obj;
+	return fn->constantsLen++;
+}
+
+static uint32_t addNameConstant(struct VmCompiler* c, const char* text) {
+	struct VmFunction* fn = c->fn;
+	if (fn->namesLen == fn->namesCap) {
+		fn->names = (struct VmName*)growBuffer(fn->names, &fn->namesCap, sizeof *fn->names);
+	}
+	fn->names[fn->namesLen].text = text;
+	fn->names[fn->namesLen].hash = hashString(text);
+	fn->names[fn->namesLen].builtin = resolveBuiltin(text);
+	fn->names[fn->namesLen].cachedEnv = NULL;
+	return fn->namesLen++;
+}
+
+static uint16_t allocRegister(struct VmCompiler* c) {
+	if (c->top >= VM_MAX_REGISTERS) {
+		c->failed = true;
+		return 0;
+	}
+
+	const uint16_t reg = (uint16_t)c->top++;
+	if (c->top > c->fn->registerCount) {
+		c->fn->registerCount = (uint16_t)c->top;
+	}
+	return reg;
+}
+
+static uint16_t destination(struct VmCompiler* c, uint32_t target) {
+	return target == VM_ANY_REGISTER ? allocRegister(c) : (uint16_t)target;
+}
+
+//Releases the temporaries above saved, keeping the one destination allocated for target
+static void releaseRegisters(struct VmCompiler* c, uint32_t saved, uint32_t target) {
+	c->top = saved + (target == VM_ANY_REGISTER ? 1 : 0);
+}
+
+static bool isLocalRegister(const struct VmCompiler* c, uint16_t reg) {
+	return reg < c->localsLen;
+}
+
+//Copies a local read in place when evaluating later may rebind it
+static uint16_t protectOperand(struct VmCompiler* c, uint16_t reg, NodeRef later) {
+	if (!isLocalRegister(c, reg) || !mayBind(c->ast, later)) {
+		return reg;
+	}
+	const uint16_t copy = allocRegister(c);
+	emit(c, VM_MOVE, copy, reg, 0);
+	return copy;
+}
+
+static uint16_t loadConstant(struct VmCompiler* c, struct Object* obj, uint32_t target) {
+	const uint16_t dest = destination(c, target);
+	emitWide(c, VM_LOADK, dest, addConstant(c, obj));
+	return dest;
+}
+
+static uint16_t compileIdentifier(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const char* name = compactText(c->ast, node->a);
+	const struct VmLocal* local = findLocal(c, name);
+	if (!local || local->captured) {
+		const uint16_t dest = destination(c, target);
+		emitWide(c, VM_GET_NAME, dest, addNameConstant(c, name));
+		return dest;
+	}
+
+	const uint16_t reg = (uint16_t)(local - c->locals);
+	if (local->bound) {
+		if (target == VM_ANY_REGISTER) {
+			return reg;
+		}
+		if (target != reg) {
+			emit(c, VM_MOVE, (uint16_t)target, reg, 0);
+		}
+		return (uint16_t)target;
+	}
+
+	const uint32_t name16 = addNameConstant(c, name);
+	if (name16 > UINT16_MAX) {
+		c->failed = true;
+	}
+	const uint16_t dest = destination(c, target);
+	emit(c, VM_GET_LOCAL, dest, reg, (uint16_t)name16);
+	return dest;
+}
+
+static uint16_t compilePrefix(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	if (node->op != OP_NEGATE && node->op != OP_SUBTRACT) {
+		c->failed = true;
+		return 0;
+	}
+
+	const uint32_t saved = c->top;
+	const uint16_t dest = destination(c, target);
+	const uint16_t right = compileExpression(c, node->a, VM_ANY_REGISTER);
+	emit(c, node->op == OP_NEGATE ? VM_NOT : VM_NEG, dest, right, 0);
+	releaseRegisters(c, saved, target);
+	return dest;
+}
+
+static enum VmOpcode infixOpcode(enum OperatorType op) {
+	switch (op) {
+		case OP_ADD: return VM_ADD;
+		case OP_SUBTRACT: return VM_SUB;
+		case OP_MULTIPLY: return VM_MUL;
+		case OP_DIVIDE: return VM_DIV;
+		case OP_LT: return VM_LT;
+		case OP_GT: return VM_GT;
+		case OP_EQ: return VM_EQ;
+		case OP_NOT_EQ: return VM_NOT_EQ;
+		default: return VM_OPCODE_COUNT;
+	}
+}
+
+static uint16_t compileInfix(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const enum VmOpcode opcode = infixOpcode((enum OperatorType)node->op);
+	if (opcode == VM_OPCODE_COUNT) {
+		c->failed = true;
+		return 0;
+	}
+
+	const uint32_t saved = c->top;
+	const uint16_t dest = destination(c, target);
+
+	//An integer literal on the right is read straight from the constants
+	const struct CompactNode* right = &c->ast->nodes[node->b];
+	struct Object* constant = right->type == CNODE_INT ? compactConstant(c->ast, right) : NULL;
+	if (constant && c->fn->constantsLen <= UINT16_MAX) {
+		const uint16_t k = (uint16_t)addConstant(c, constant);
+		const uint16_t left = compileExpression(c, node->a, VM_ANY_REGISTER);
+		emit(c, (enum VmOpcode)(opcode + (VM_ADDK - VM_ADD)), dest, left, k);
+		releaseRegisters(c, saved, target);
+		return dest;
+	}
+
+	//Right before left like evalExpression
+	const uint16_t rightReg = protectOperand(c, compileExpression(c, node->b, VM_ANY_REGISTER), node->a);
+	const uint16_t leftReg = compileExpression(c, node->a, VM_ANY_REGISTER);
+	emit(c, opcode, dest, leftReg, rightReg);
+	releaseRegisters(c, saved, target);
+	return dest;
+}
+
+static bool* saveBound(const struct VmCompiler* c) {
+	bool* bound = (bool*)malloc(c->localsLen + 1);
+	if (!bound) {
+		perror("malloc (vm bound locals) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < c->localsLen; i++) {
+		bound[i] = c->locals[i].bound;
+	}
+	return bound;
+}
+
+//A branch may not run, what it binds is unknown afterwards
+static void restoreBound(struct VmCompiler* c, const bool* bound) {
+	for (size_t i = 0; i < c->localsLen; i++) {
+		c->locals[i].bound = bound[i];
+	}
+}
+
+static uint16_t compileBlock(struct VmCompiler* c, NodeRef ref, uint32_t target) {
+	size_t count = 0;
+	const uint32_t* statements = compactList(c->ast, c->ast->nodes[ref].a, &count);
+	if (count == 0) {
+		return loadConstant(c, &NullObj, target);
+	}
+
+	for (size_t i = 0; i + 1 < count; i++) {
+		const uint32_t saved = c->top;
+		compileStatement(c, statements[i], VM_ANY_REGISTER);
+		c->top = saved;
+	}
+	return compileStatement(c, statements[count - 1], target);
+}
+
+static uint16_t compileIf(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const uint32_t saved = c->top;
+	//Both branches write the same register
+	const uint16_t dest = destination(c, target);
+	const uint16_t condition = compileExpression(c, node->a, VM_ANY_REGISTER);
+	releaseRegisters(c, saved, target);
+	const uint32_t jumpFalse = emitWide(c, VM_JUMP_FALSE, condition, 0);
+
+	bool* bound = saveBound(c);
+	compileBlock(c, node->b, dest);
+	restoreBound(c, bound);
+	releaseRegisters(c, saved, target);
+
+	const uint32_t jumpEnd = emitWide(c, VM_JUMP, 0, 0);
+	patchJump(c, jumpFalse);
+	if (node->c != NODE_NONE) {
+		compileBlock(c, node->c, dest);
+		restoreBound(c, bound);
+		releaseRegisters(c, saved, target);
+	}
+	else {
+		loadConstant(c, &NullObj, dest);
+	}
+	patchJump(c, jumpEnd);
+
+	free(bound);
+	return dest;
+}
+
+//Evaluates the entries of a list into consecutive registers after the ones allocated so far. Returns the first
+static uint16_t compileWindow(struct VmCompiler* c, uint32_t list, size_t* count) {
+	const uint32_t* entries = compactList(c->ast, list, count);
+	const uint16_t first = (uint16_t)c->top;
+	if (*count > UINT16_MAX) {
+		c->failed = true;
+		return first;
+	}
+
+	for (size_t i = 0; i < *count; i++) {
+		const uint16_t reg = allocRegister(c);
+		compileExpression(c, entries[i], reg);
+		c->top = reg + 1u;
+	}
+	return first;
+}
+
+static uint16_t compileCall(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const uint32_t saved = c->top;
+	const uint16_t callee = allocRegister(c);
+	compileExpression(c, node->a, callee);
+	c->top = callee + 1u;
+
+	size_t count = 0;
+	compileWindow(c, node->b, &count);
+	c->top = saved;
+
+	//The callee register is free again once the call is made, it can take the result
+	const uint16_t dest = destination(c, target);
+	emit(c, VM_CALL, dest, callee, (uint16_t)count);
+	return dest;
+}
+
+static uint16_t compileArray(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	struct Object* constant = compactConstant(c->ast, node);
+	if (constant) {
+		return loadConstant(c, constant, target);
+	}
+
+	const uint32_t saved = c->top;
+	size_t count = 0;
+	const uint16_t first = compileWindow(c, node->a, &count);
+	c->top = saved;
+
+	const uint16_t dest = destination(c, target);
+	emit(c, VM_ARRAY, dest, first, (uint16_t)count);
+	return dest;
+}
+
+static uint16_t compileIndex(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const uint32_t saved = c->top;
+	const uint16_t dest = destination(c, target);
+	const uint16_t left = protectOperand(c, compileExpression(c, node->a, VM_ANY_REGISTER), node->b);
+	const uint16_t index = compileExpression(c, node->b, VM_ANY_REGISTER);
+	emit(c, VM_INDEX, dest, left, index);
+	releaseRegisters(c, saved, target);
+	return dest;
+}
+
+static uint16_t compileFunctionLiteral(struct VmCompiler* c, NodeRef ref, uint32_t target) {
+	const uint32_t index = compileFunction(c->program, ref, &c->failed);
+	const uint16_t dest = destination(c, target);
+	emitWide(c, VM_FUNCTION, dest, index);
+	return dest;
+}
+
+static uint16_t compileExpression(struct VmCompiler* c, NodeRef ref, uint32_t target) {
+	const struct CompactNode* node = &c->ast->nodes[ref];
+	switch (node->type) {
+		case CNODE_INT:
+		case CNODE_STRING: {
+			struct Object* constant = compactConstant(c->ast, node);
+			if (!constant) {
+				//Constants were not bound
+				c->failed = true;
+				return 0;
+			}
+			return loadConstant(c, constant, target);
+		}
+
+		case CNODE_BOOL:
+			return loadConstant(c, nativeBoolToBoolObj(node->a), target);
+
+		case CNODE_IDENT:
+			return compileIdentifier(c, node, target);
+
+		case CNODE_PREFIX:
+			return compilePrefix(c, node, target);
+
+		case CNODE_INFIX:
+			return compileInfix(c, node, target);
+
+		case CNODE_IF:
+			return compileIf(c, node, target);
+
+		case CNODE_FUNCTION:
+			return compileFunctionLiteral(c, ref, target);
+
+		case CNODE_CALL:
+			return compileCall(c, node, target);
+
+		case CNODE_ARRAY:
+			return compileArray(c, node, target);
+
+		case CNODE_INDEX:
+			return compileIndex(c, node, target);
+
+		case CNODE_LET:
+		case CNODE_RETURN:
+			return compileStatement(c, ref, target);
+	}
+
+	c->failed = true;
+	return 0;
+}
+
+static uint16_t compileLet(struct VmCompiler* c, const struct CompactNode* node, uint32_t target) {
+	const char* name = compactText(c->ast, node->a);
+	struct VmLocal* local = findLocal(c, name);
+	if (local && !local->captured) {
+		const uint16_t reg = (uint16_t)(local - c->locals);
+		compileExpression(c, node->b, reg);
+		local->bound = true;
+		if (target == VM_ANY_REGISTER) {
+			return reg;
+		}
+		if (target != reg) {
+			emit(c, VM_MOVE, (uint16_t)target, reg, 0);
+		}
+		return (uint16_t)target;
+	}
+
+	const uint16_t value = compileExpression(c, node->b, target);
+	emitWide(c, VM_SET_NAME, value, addNameConstant(c, name));
+	return value;
+}
+
+static uint16_t compileStatement(struct VmCompiler* c, NodeRef ref, uint32_t target) {
+	const struct CompactNode* node = &c->ast->nodes[ref];
+	if (node->type == CNODE_LET) {
+		return compileLet(c, node, target);
+	}
+
+	if (node->type == CNODE_RETURN) {
+		const uint16_t value = compileExpression(c, node->a, target);
+		if (c->topLevel) {
+			const uint16_t wrapped = allocRegister(c);
+			emit(c, VM_WRAP_RETURN, wrapped, value, 0);
+			emit(c, VM_RETURN, wrapped, 0, 0);
+		}
+		else {
+			emit(c, VM_RETURN, value, 0, 0);
+		}
+		return value;
+	}
+
+	return compileExpression(c, ref, target);
+}
+
+static struct VmFunction* newVmFunction(struct VmProgram* program, NodeRef node) {
+	struct VmFunction* fn = (struct VmFunction*)calloc(1, sizeof *fn);
+	if (!fn) {
+		perror("calloc (vm function) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	fn->node = node;
+	fn->program = program;
+	fn->jit = (struct VmJitState*)calloc(1, sizeof *fn->jit);
+	if (!fn->jit) {
+		perror("calloc (vm jit state) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	return fn;
+}
+
+static uint32_t compileFunction(struct VmProgram* program, NodeRef ref, bool* failed) {
+	const struct CompactAst* ast = program->ast;
+	const struct CompactNode* node = &ast->nodes[ref];
+
+	struct VmFunction* fn = newVmFunction(program, ref);
+	if (program->functionsLen == program->functionsCap) {
+		program->functions = (struct VmFunction**)growBuffer(program->functions, &program->functionsCap, sizeof *program->functions);
+	}
+	const uint32_t index = program->functionsLen++;
+	program->functions[index] = fn;
+
+	struct VmNameList names = { NULL, 0, 0 };
+	collectFunctionLocals(ast, node, &names);
+	size_t paramCount = 0;
+	compactList(ast, node->a, &paramCount);
+	if (names.len >= VM_MAX_REGISTERS) {
+		free((void*)names.names);
+		*failed = true;
+		return index;
+	}
+
+	struct VmCompiler c;
+	memset(&c, 0, sizeof c);
+	c.program = program;
+	c.ast = ast;
+	c.fn = fn;
+	c.localsLen = names.len;
+	c.locals = (struct VmLocal*)calloc(names.len + 1, sizeof *c.locals);
+	if (!c.locals) {
+		perror("calloc (vm locals) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < names.len; i++) {
+		c.locals[i].name = names.names[i];
+		c.locals[i].bound = i < paramCount;
+	}
+	free((void*)names.names);
+	markCaptured(&c, node->b, false);
+
+	fn->paramCount = (uint16_t)paramCount;
+	fn->localCount = (uint16_t)c.localsLen;
+	fn->registerCount = (uint16_t)c.localsLen;
+	c.top = (uint32_t)c.localsLen;
+
+	//Captured parameters are moved into the environment of the call up front
+	for (size_t i = 0; i < c.localsLen; i++) {
+		fn->ownEnv = fn->ownEnv || c.locals[i].captured;
+		if (i < paramCount && c.locals[i].captured && findLocal(&c, c.locals[i].name) == &c.locals[i]) {
+			emitWide(&c, VM_SET_NAME, (uint16_t)i, addNameConstant(&c, c.locals[i].name));
+		}
+	}
+
+	const uint16_t result = compileBlock(&c, node->b, VM_ANY_REGISTER);
+	emit(&c, VM_RETURN, result, 0, 0);
+
+	free(c.locals);
+	*failed = *failed || c.failed;
+	return index;
+}
+
+static struct VmFunction* compileChunk(struct VmProgram* program, NodeRef ref, bool* failed) {
+	struct VmFunction* fn = newVmFunction(program, ref);
+
+	struct VmCompiler c;
+	memset(&c, 0, sizeof c);
+	c.program = program;
+	c.ast = program->ast;
+	c.fn = fn;
+	c.topLevel = true;
+
+	const uint16_t result = compileStatement(&c, ref, VM_ANY_REGISTER);
+	emit(&c, VM_RETURN, result, 0, 0);
+
+	*failed = *failed || c.failed;
+	return fn;
+}
+
+struct VmProgram* compileVmProgram(const struct CompactAst* ast) {
+	struct VmProgram* program = (struct VmProgram*)calloc(1, sizeof *program);
+	if (!program) {
+		perror("calloc (vm program) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+	program->ast = ast;
+	program->jitThreshold = VM_JIT_THRESHOLD;
+
+	size_t count = 0;
+	const uint32_t* statements = compactList(ast, ast->nodes[ast->root].a, &count);
+	program->statements = (struct VmFunction**)calloc(count + 1, sizeof *program->statements);
+	if (!program->statements) {
+		perror("calloc (vm statements) returned `NULL`\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bool failed = false;
+	for (size_t i = 0; i < count && !failed; i++) {
+		program->statements[program->statementsLen++] = compileChunk(program, statements[i], &failed);
+	}
+
+	if (failed) {
+		freeVmProgram(program);
+		return NULL;
+	}
+	return program;
+}
+
+static void freeVmFunction(struct VmFunction* fn) {
+	free(fn->code);
+	free(fn->constants);
+	free(fn->names);
+	freeVmJitCode(fn->jit->code);
+	free(fn->jit);
+	free(fn);
+}
+
+void freeVmProgram(struct VmProgram* program) {
+	if (!program) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < program->functionsLen; i++) {
+		freeVmFunction(program->functions[i]);
+	}
+	for (size_t i = 0; i < program->statementsLen; i++) {
+		freeVmFunction(program->statements[i]);
+	}
+	free(program->functions);
+	free(program->statements);
+	free(program->stack);
+	free(program->frames);
+	free(program);
+}
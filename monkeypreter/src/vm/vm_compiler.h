@@ -0,0 +1,10 @@
+#pragma once
+#include "bytecode.h"
+
+//Compiles a compact AST into register bytecode. Parameters and `let` bindings of a function get a register
+//of their own, names that are not locals of the function are looked up in the environment like the
+//evaluators do. Locals a nested function reads stay in the environment of the call instead.
+//ast has to be bound and outlive the program. NULL when the AST does not fit the instruction format
+struct VmProgram* compileVmProgram(const struct CompactAst* ast);
+//After every function object created from program is gone
+void freeVmProgram(struct VmProgram* program);
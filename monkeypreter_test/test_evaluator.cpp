@@ -7,6 +7,16 @@ extern "C" {
 	#include "parser/ast.c"
 	#include "evaluator/object.h"
 	#include "evaluator/object.c"
+	#include "evaluator/array.h"
+	#include "evaluator/array.c"
+	#include "evaluator/simd.h"
+	#include "evaluator/simd.c"
+	#include "evaluator/sort.h"
+	#include "evaluator/sort.c"
+	#include "util/cpu_features.h"
+	#include "util/cpu_features.c"
+	#include "util/writer.h"
+	#include "util/writer.c"
 	#include "evaluator/environment.h"
 	#include "evaluator/environment.c"
 	#include "evaluator/hash_map.h"
@@ -17,6 +27,28 @@ extern "C" {
 	#include "evaluator/builtins.h"
 	#include "evaluator/evaluator.h"
 	#include "evaluator/evaluator.c"
+	#include "evaluator/captures.h"
+	#include "evaluator/captures.c"
+	#include "evaluator/compact_evaluator.h"
+	#include "evaluator/compact_evaluator.c"
+	#include "evaluator/closure_compiler.h"
+	#include "evaluator/closure_compiler.c"
+	#include "vm/bytecode.h"
+	#include "vm/vm_compiler.h"
+	#include "vm/vm_compiler.c"
+	#include "vm/vm.h"
+	#include "vm/vm.c"
+	#include "vm/disassembler.h"
+	#include "vm/disassembler.c"
+	#include "vm/jit.h"
+	#include "vm/jit.c"
+	#include "evaluator/constants.h"
+	#include "evaluator/constants.c"
+	#include "parser/ast_cache.h"
+	#include "parser/optimizer.h"
+	#include "parser/optimizer.c"
+	#include "transpiler/transpiler.h"
+	#include "transpiler/transpiler.c"
 }
 
 struct Object* testEval(const char* input) {
@@ -26,7 +58,7 @@ struct Object* testEval(const char* input) {
 	struct MonkeyGC* gc = createMonkeyGC();
 	struct ObjectEnvironment* env = newEnvironment(gc);
 	struct Object* obj = evalProgram(program, env);
-	freeProgram(program);
+	//Function objects point into the AST, leak it with the GC
 	freeParser(&parser);
 	deleteEnvironment(env);
 	//Can't delete GC --> Deletes all objects including last object + object might depend on other objects (array)
@@ -34,6 +66,83 @@ struct Object* testEval(const char* input) {
 	return obj;
 }
 
+//Program is flattened and only the compact AST is kept
+struct Object* testEvalCompact(const char* input) {
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct CompactAst* ast = compactProgram(program);
+	freeProgram(program);
+	freeParser(&parser);
+	bindCompactConstants(ast);
+
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* obj = evalCompactProgram(ast, env);
+	deleteEnvironment(env);
+	//Function objects point into the AST, leak it with the GC
+	return obj;
+}
+
+//Compact AST compiled into function pointers, both are leaked like in testEvalCompact
+struct Object* testEvalCompiled(const char* input) {
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct CompactAst* ast = compactProgram(program);
+	freeProgram(program);
+	freeParser(&parser);
+	bindCompactConstants(ast);
+
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* obj = evalCompiledProgram(compileProgram(ast), env);
+	deleteEnvironment(env);
+	return obj;
+}
+
+//Compact AST compiled to register bytecode, leaked like in testEvalCompact
+struct Object* testEvalVm(const char* input) {
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct CompactAst* ast = compactProgram(program);
+	freeProgram(program);
+	freeParser(&parser);
+	bindCompactConstants(ast);
+
+	struct VmProgram* vmProgram = compileVmProgram(ast);
+	if (!vmProgram) {
+		return newEvalError(createMonkeyGC(), "program does not fit the vm");
+	}
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* obj = evalVmProgram(vmProgram, env);
+	deleteEnvironment(env);
+	return obj;
+}
+
+struct Object* testEvalOptimized(const char* input) {
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	optimizeProgram(program);
+	bindConstants(program);
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* obj = evalProgram(program, env);
+	freeParser(&parser);
+	deleteEnvironment(env);
+	return obj;
+}
+
+//Evaluates input after binding build(arr, n), which pushes n, n - 1, ..., 1 onto arr one at a time
+struct Object* testEvalWithArrayBuilder(const char* input) {
+	char source[512];
+	snprintf(source, sizeof source, "let build = fn(arr, n) { if (n == 0) { arr } else { build(push(arr, n), n - 1) } }; %s", input);
+	return testEval(source);
+}
+
 bool testIntegerObject(const struct Object* obj, int64_t expected) {
 
 	if(obj->type != OBJ_INT) {
@@ -93,20 +202,22 @@ bool testIntegerArrayObject(const struct Object* obj, struct ExpectedArray expec
 		return false;
 	}
 
-	struct ObjectList arr = obj->value.arr;
+	const size_t size = arrayLength(obj);
 
-	if(arr.size != expected.expectedArrSize) {
-		printf("wrong array size, expected: %llu, got: %llu\n", expected.expectedArrSize, arr.size);
+	if(size != expected.expectedArrSize) {
+		printf("wrong array size, expected: %llu, got: %llu\n", expected.expectedArrSize, size);
 		return false;
 	}
 
-	for (size_t i = 0; i < (size_t) arr.size; i++) {
-		if (!testIntegerObject(obj->value.arr.objects[i], expected.expectedObjects[i].value.integer)) {
-			return false;
-		}
+	//Packed elements get boxed on access
+	struct MonkeyGC* gc = createMonkeyGC();
+	bool ok = true;
+	for (size_t i = 0; i < size && ok; i++) {
+		ok = testIntegerObject(arrayGet(gc, obj, i), expected.expectedObjects[i].value.integer);
 	}
+	deleteMonkeyGC(gc);
 
-	return true;
+	return ok;
 
 }
 TEST(TestEval, TestEval_01_IntegerExpr) {
@@ -357,14 +468,7 @@ TEST(TestEval, TestEval_08_FunctionObject) {
 
 	char expectedBody[] = "(x + 2)";
 
-	char* body = (char*) malloc(MAX_PROGRAM_LEN);
-	if(!body) {
-		perror("malloc (test function body) returned `NULL`\n");
-		FAIL();
-	}
-
-	body[0] = '\0';
-	blockStatementToStr(body, func.body);
+	char* body = blockStatementToStr(func.body);
 
 	if(strcmp(body, expectedBody) != 0) {
 		printf("Body is not: '%s', got '%s'\n", expectedBody, body);
@@ -578,22 +682,26 @@ TEST(TestEval, TestEval_13_ArrayLiterals) {
 		FAIL();
 	}
 
-	if(evaluated->value.arr.size != 3) {
-		printf("array has wrong number of elements. got=%llu", evaluated->value.arr.size);
+	if(arrayLength(evaluated) != 3) {
+		printf("array has wrong number of elements. got=%llu", arrayLength(evaluated));
 		FAIL();
 	}
 
-	if(!testIntegerObject(evaluated->value.arr.objects[0], 1)) {
+	struct MonkeyGC* gc = createMonkeyGC();
+
+	if(!testIntegerObject(arrayGet(gc, evaluated, 0), 1)) {
 		FAIL();
 	}
 
-	if (!testIntegerObject(evaluated->value.arr.objects[1], 4)) {
+	if (!testIntegerObject(arrayGet(gc, evaluated, 1), 4)) {
 		FAIL();
 	}
 
-	if (!testIntegerObject(evaluated->value.arr.objects[2], 6)) {
+	if (!testIntegerObject(arrayGet(gc, evaluated, 2), 6)) {
 		FAIL();
 	}
+
+	deleteMonkeyGC(gc);
 }
 
 TEST(TestEval, TestEval_14_ArrayIndexExpr) {
@@ -678,3 +786,1038 @@ TEST(TestEval, TestEval_14_ArrayIndexExpr) {
 		}
 	}
 }
+
+TEST(TestEval, TestEval_15_PersistentArrays) {
+	struct TestPersistentArray {
+		char input[128];
+		int64_t expected;
+	} tests[]{
+		//Spans several trie levels
+		{"let a = build([], 1100); len(a);", 1100},
+		{"let a = build([], 1100); a[0];", 1100},
+		{"let a = build([], 1100); a[31] + a[32];", 2137},
+		{"let a = build([], 1100); a[1055];", 45},
+		{"let a = build([], 1100); last(a);", 1},
+		//Pushing onto the same array twice must not leak into the other result
+		{"let a = build([], 100); let b = push(a, 7); let c = push(a, 8); b[100] + c[100] * 10 + len(a);", 187},
+		//cdr shares the trie
+		{"let a = build([], 40); let s = push(cdr(a), 5); len(s) + s[39] * 1000 + a[1];", 5079},
+	};
+
+	for (int i = 0; i < 7; i++) {
+		printf("Starting test %d\n", i);
+		struct Object* evaluated = testEvalWithArrayBuilder(tests[i].input);
+		if (!testIntegerObject(evaluated, tests[i].expected)) {
+			FAIL();
+		}
+	}
+}
+
+TEST(TestEval, TestEval_16_PackedIntegerArrays) {
+	struct TestPackedArray {
+		char input[96];
+		ExpectedVal expected;
+		ExpectedType type;
+	} tests[]{
+		{"sum(range(1000))", {.expectedInt = 499500}, EXPECT_INT},
+		{"sum(cdr(range(100)))", {.expectedInt = 4950}, EXPECT_INT},
+		{"min([5, -3, 9, 2, 7, 1])", {.expectedInt = -3}, EXPECT_INT},
+		{"max(range(-50, 70))", {.expectedInt = 69}, EXPECT_INT},
+		{"min([])", {.ptr = nullptr}, EXPECT_NULL},
+		{"dot(range(100), range(100))", {.expectedInt = 328350}, EXPECT_INT},
+		//Leaves of both arrays are misaligned
+		{"dot(cdr(range(101)), range(100))", {.expectedInt = 333300}, EXPECT_INT},
+		{"sum(add(range(100), range(100)))", {.expectedInt = 9900}, EXPECT_INT},
+		{"max(mul(range(-40, 40), range(-40, 40)))", {.expectedInt = 1600}, EXPECT_INT},
+		//Pushing a non integer falls back to boxed elements
+		{"let a = push(range(40), \"x\"); len(a) + a[39]", {.expectedInt = 80}, EXPECT_INT},
+		{"sum(push([1, 2], true))", {.expectedString = "argument to `sum` must only contain INTEGER"}, EXPECT_STRING},
+		{"dot([1], [1, 2])", {.expectedString = "arguments to `dot` must have the same length, got 1 and 2"}, EXPECT_STRING},
+	};
+
+	for (int i = 0; i < 12; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		struct Object* evaluated = testEval(tests[i].input);
+
+		switch (tests[i].type) {
+			case EXPECT_INT:
+				if (!testIntegerObject(evaluated, tests[i].expected.expectedInt)) {
+					FAIL();
+				}
+				break;
+
+			case EXPECT_STRING:
+				if (evaluated->type != OBJ_ERROR || strcmp(evaluated->value.error.msg, tests[i].expected.expectedString) != 0) {
+					printf("Wrong result, expected error: %s, got: %s\n", tests[i].expected.expectedString, inspectObject(evaluated));
+					FAIL();
+				}
+				break;
+
+			case EXPECT_NULL:
+				if (!testNullObject(evaluated)) {
+					FAIL();
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	if (!testEval("[1, 2, 3]")->value.arr.packed || testEval("push([1, 2, 3], \"x\")")->value.arr.packed) {
+		printf("Integer arrays should be packed until a non integer is pushed\n");
+		FAIL();
+	}
+
+	//The second push onto `a` copies its tail, the copied elements move into the trie when the tail fills up
+	struct Object* pushed = testEval("let a = range(60); let b = push(a, 0); let c = push(a, 60); push(push(push(push(push(c, 61), 62), 63), 64), 65)");
+	if (!pushed->value.arr.packed || arrayLength(pushed) != 66) {
+		printf("Expected a packed array of 66 elements, got %s\n", inspectObject(pushed));
+		FAIL();
+	}
+	for (size_t i = 0; i < 66; i++) {
+		if (arrayGetInteger(pushed, i) != (int64_t)i) {
+			printf("Wrong element %llu after pushing past the tail, got %lld\n", i, arrayGetInteger(pushed, i));
+			FAIL();
+		}
+	}
+}
+
+TEST(TestEval, TestEval_17_HigherOrderBuiltins) {
+	struct TestHigherOrder {
+		char input[128];
+		ExpectedVal expected;
+		ExpectedType type;
+	} tests[]{
+		{"let a = map([1, 2, 3], fn(x) { x * 2 }); a[0] + a[1] * 10 + a[2] * 100", {.expectedInt = 642}, EXPECT_INT},
+		{"len(map(range(1000), fn(x) { x + 1 }))", {.expectedInt = 1000}, EXPECT_INT},
+		{"sum(map(range(100), fn(x) { x * x }))", {.expectedInt = 328350}, EXPECT_INT},
+		{"map([1, 2], fn(x) { \"s\" })[1]", {.expectedString = "s"}, EXPECT_STRING},
+		{"len(map([], fn(x) { x }))", {.expectedInt = 0}, EXPECT_INT},
+		{"sum(filter(range(10), fn(x) { x > 4 }))", {.expectedInt = 35}, EXPECT_INT},
+		{"len(filter([1, false, 3, false], fn(x) { x }))", {.expectedInt = 2}, EXPECT_INT},
+		{"reduce(range(101), 0, fn(acc, x) { acc + x })", {.expectedInt = 5050}, EXPECT_INT},
+		{"reduce([], 7, fn(acc, x) { acc + x })", {.expectedInt = 7}, EXPECT_INT},
+		{"reduce([1, 2, 3], 0, fn(acc, x) { if (x == 2) { return acc * 10; } acc + x })", {.expectedInt = 13}, EXPECT_INT},
+		{"each([1, 2], fn(x) { x })", {.expectedInt = 0}, EXPECT_NULL},
+		{"len(map([[1], [2, 3]], len))", {.expectedInt = 2}, EXPECT_INT},
+		{"map([1, 2], fn(x) { x + true })", {.expectedString = "type mismatch: INTEGER + BOOLEAN"}, EXPECT_STRING},
+		{"map(1, fn(x) { x })", {.expectedString = "argument to `map` must be ARRAY, got INTEGER"}, EXPECT_STRING},
+		{"filter([1], 2)", {.expectedString = "argument to `filter` must be FUNCTION, got INTEGER"}, EXPECT_STRING},
+		{"reduce([1], 0, fn(x) { x })", {.expectedString = "function passed to `reduce` must take 2 arguments, got 1"}, EXPECT_STRING},
+	};
+
+	for (int i = 0; i < 16; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		struct Object* evaluated = testEval(tests[i].input);
+
+		switch (tests[i].type) {
+			case EXPECT_INT:
+				if (!testIntegerObject(evaluated, tests[i].expected.expectedInt)) {
+					FAIL();
+				}
+				break;
+
+			case EXPECT_STRING:
+				if (evaluated->type == OBJ_STRING) {
+					if (strcmp(evaluated->value.string, tests[i].expected.expectedString) != 0) {
+						printf("Wrong string, expected: %s, got: %s\n", tests[i].expected.expectedString, evaluated->value.string);
+						FAIL();
+					}
+				}
+				else if (evaluated->type != OBJ_ERROR || strcmp(evaluated->value.error.msg, tests[i].expected.expectedString) != 0) {
+					printf("Wrong result, expected error: %s, got: %s\n", tests[i].expected.expectedString, inspectObject(evaluated));
+					FAIL();
+				}
+				break;
+
+			case EXPECT_NULL:
+				if (!testNullObject(evaluated)) {
+					FAIL();
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+TEST(TestEval, TestEval_18_Sort) {
+	struct TestSort {
+		char input[256];
+		ExpectedVal expected;
+		ExpectedType type;
+	} tests[]{
+		{"let s = sort([3, 1, 2]); s[0] + s[1] * 10 + s[2] * 100", {.expectedInt = 321}, EXPECT_INT},
+		{"let a = [3, 1, 2]; let s = sort(a); a[0]", {.expectedInt = 3}, EXPECT_INT},
+		{"sort([5, -3, 0, -100, 9223372036854775807])[0]", {.expectedInt = -100}, EXPECT_INT},
+		{"len(sort([]))", {.expectedInt = 0}, EXPECT_INT},
+		//Permutation of 0..2999, radix path
+		{"let s = sort(map(range(3000), fn(x) { x * 7919 - (x * 7919 / 3001) * 3001 })); reduce(range(2999), 0, fn(acc, i) { if (s[i + 1] < s[i]) { acc + 1 } else { acc } })", {.expectedInt = 0}, EXPECT_INT},
+		{"let s = sort(map(range(1000), fn(x) { 500 - x })); s[0] + s[999] * 1000", {.expectedInt = 499501}, EXPECT_INT},
+		{"sort([\"pear\", \"apple\", \"fig\", \"apples\", \"\"])[2]", {.expectedString = "apples"}, EXPECT_STRING},
+		{"sort(map(range(60), fn(x) { if (x - (x / 3) * 3 == 0) { \"cab\" } else { if (x - (x / 3) * 3 == 1) { \"ca\" } else { \"b\" } } }))[20]", {.expectedString = "ca"}, EXPECT_STRING},
+		{"sort(map(range(60), fn(x) { if (x - (x / 3) * 3 == 0) { \"cab\" } else { if (x - (x / 3) * 3 == 1) { \"ca\" } else { \"b\" } } }))[40]", {.expectedString = "cab"}, EXPECT_STRING},
+		{"sort([1, 5, 3], fn(a, b) { a > b })[0]", {.expectedInt = 5}, EXPECT_INT},
+		//Comparator sort is stable
+		{"let s = sort([[2, 1], [1, 2], [2, 3], [1, 4]], fn(a, b) { a[0] < b[0] }); s[0][1] * 1000 + s[1][1] * 100 + s[2][1] * 10 + s[3][1]", {.expectedInt = 2413}, EXPECT_INT},
+		{"let s = sort(map(range(200), fn(x) { x * 37 - (x * 37 / 211) * 211 }), fn(a, b) { a < b }); reduce(range(199), 0, fn(acc, i) { if (s[i + 1] < s[i]) { acc + 1 } else { acc } })", {.expectedInt = 0}, EXPECT_INT},
+		{"sort([1, 2], fn(a, b) { a + true })", {.expectedString = "type mismatch: INTEGER + BOOLEAN"}, EXPECT_STRING},
+		{"sort([1, \"a\"])", {.expectedString = "argument to `sort` must only contain INTEGER or STRING without a comparator"}, EXPECT_STRING},
+		{"sort(1)", {.expectedString = "argument to `sort` must be ARRAY, got INTEGER"}, EXPECT_STRING},
+	};
+
+	for (int i = 0; i < 15; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		struct Object* evaluated = testEval(tests[i].input);
+
+		switch (tests[i].type) {
+			case EXPECT_INT:
+				if (!testIntegerObject(evaluated, tests[i].expected.expectedInt)) {
+					FAIL();
+				}
+				break;
+
+			case EXPECT_STRING:
+				if (evaluated->type == OBJ_STRING) {
+					if (strcmp(evaluated->value.string, tests[i].expected.expectedString) != 0) {
+						printf("Wrong string, expected: %s, got: %s\n", tests[i].expected.expectedString, evaluated->value.string);
+						FAIL();
+					}
+				}
+				else if (evaluated->type != OBJ_ERROR || strcmp(evaluated->value.error.msg, tests[i].expected.expectedString) != 0) {
+					printf("Wrong result, expected error: %s, got: %s\n", tests[i].expected.expectedString, inspectObject(evaluated));
+					FAIL();
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+TEST(TestEval, TestEval_19_InspectObject) {
+	struct TestInspect {
+		char input[64];
+		char expected[160];
+	} tests[]{
+		{"[1, -2, 3]", "[1, -2, 3]"},
+		{"[1, [2, true], \"s\"]", "[1, [2, true], s\n]"},
+		{"cdr(range(35))", "[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34]"},
+		{"[]", "[]"},
+		{"-9223372036854775807 - 1", "-9223372036854775808"},
+		{"fn(x, y) { x + y }", "fn(x, y) {\n(x + y)\n}"},
+	};
+
+	for (int i = 0; i < 6; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		char* inspected = inspectObject(testEval(tests[i].input));
+		if (strcmp(inspected, tests[i].expected) != 0) {
+			printf("Wrong inspect output, expected: %s, got: %s\n", tests[i].expected, inspected);
+			FAIL();
+		}
+		free(inspected);
+	}
+
+	//Stream writers flush whenever the buffer fills and once more when freed
+	FILE* stream = tmpfile();
+	char buffer[8];
+	struct Writer writer = createStreamWriter(stream, buffer, sizeof(buffer));
+	writeObject(&writer, testEval("range(1000)"));
+	freeWriter(&writer);
+
+	char* expected = inspectObject(testEval("range(1000)"));
+	long written = ftell(stream);
+	rewind(stream);
+	char* streamed = (char*)calloc(written + 1, 1);
+	fread(streamed, 1, written, stream);
+	fclose(stream);
+
+	if (strcmp(streamed, expected) != 0) {
+		printf("Streamed output does not match inspectObject\n");
+		FAIL();
+	}
+	free(streamed);
+	free(expected);
+}
+
+TEST(TestEval, TestEval_20_CompactEvaluator) {
+	const char* tests[] = {
+		"let fibonacci = fn(x) { if (x == 0) { 0 } else { if (x == 1) { 1 } else { fibonacci(x - 1) + fibonacci(x - 2); } } }; fibonacci(15);",
+		"let newAdder = fn(x) { fn(y) { x + y }; }; let addTwo = newAdder(2); addTwo(3);",
+		"let f = fn(x) { if (x > 1) { if (x > 2) { return x * 10; } return 1; } 0; }; [f(3), f(2), f(0)];",
+		"map([1, 2, 3], fn(x) { x * x });",
+		"reduce(range(10), 0, fn(acc, x) { acc + x });",
+		"let s = sort([3, 1, 2], fn(a, b) { b < a }); s[0] + len(s);",
+		"fn(a, b) { let c = a + b; c; }",
+		"\"mon\" + \"key\";",
+		"let a = [1, fn(x) { x }, \"s\"]; a[1](a[0]);",
+		"-true;",
+		"if (10 > 1) { true + false; 10; }",
+		"let a = 1; a + true; a;",
+		"foobar;",
+		"1(2);",
+		"len(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"let many = fn(a, b, c, d, e, f, g, h, i, j) { [a, j] }; many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"return !5; 10;",
+	};
+
+	for (int i = 0; i < 17; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* actual = inspectObject(testEvalCompact(tests[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Compact evaluator differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+
+	//Returning a bound value must leave the binding alone
+	if (!testIntegerObject(testEvalCompact("let a = 5; let f = fn() { return a; }; f(); a;"), 5)) {
+		FAIL();
+	}
+
+	//More iterations than the GC threshold between two top level statements
+	if (!testIntegerObject(testEvalCompact("let sum = fn(x) { if (x == 0) { return 0; } x + sum(x - 1) }; sum(500); sum(600);"), 180300)) {
+		FAIL();
+	}
+}
+
+TEST(TestEval, TestEval_21_Optimizer) {
+	struct TestOptimize {
+		char input[96];
+		char expected[96];
+	} tests[]{
+		{"10 * (20 / 2);", "100"},
+		{"-(1 - 3) + 9223372036854775807;", "-9223372036854775807"},
+		{"!5; !!true; 1 < 2 == true;", "falsetruetrue"},
+		{"\"mon\" + \"key\";", "monkey"},
+		{"let x = if (1 < 2) { 5 } else { 6 };", "let x = 5;"},
+		{"if (false) { 1 }; if (0) { 2 } else { 3; 4 }; 5", "345"},
+		{"if (true) { }", "iftrue "},
+		{"1 / 0; true + 1; -true; true > false; x + 1;", "(1 / 0)(true + 1)(-true)(true > false)(x + 1)"},
+		{"fn(x) { let a = 5; let f = fn() { b }; let b = [1]; f; x }", "fn(x){\nlet f = fn(){\nb\n};let b = [1];fx\n}"},
+		{"fn(x) { let f = fn() { b }; let b = [1]; x }", "fn(x){\nlet b = [1];x\n}"},
+		{"fn() { let a = a + 1; let b = 2; }", "fn(){\nlet a = (a + 1);let b = 2;\n}"},
+		{"fn() { if (true) { let a = 1; } a }", "fn(){\nlet a = 1;a\n}"},
+	};
+
+	for (int i = 0; i < 12; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		Lexer lexer = createLexer(tests[i].input);
+		Parser parser = createParser(&lexer);
+		Program* program = parseProgram(&parser);
+		optimizeProgram(program);
+		char* optimized = programToStr(program);
+		if (strcmp(optimized, tests[i].expected) != 0) {
+			printf("Wrong optimized program, expected: %s, got: %s\n", tests[i].expected, optimized);
+			FAIL();
+		}
+		free(optimized);
+		freeProgram(program);
+		freeParser(&parser);
+	}
+
+	//Same results as without the pass
+	const char* programs[] = {
+		"let f = fn(x) { let unused = [1, \"s\"]; if (1 < 2) { let y = x * (2 + 3); } y + 1 }; f(2);",
+		"let f = fn() { if (true) { return 1; } 2 }; f();",
+		"let f = fn() { if (false) { 1 } }; f();",
+		"let f = fn() { let a = 7; }; f();",
+		"if (\"s\") { 1 } else { 2 };",
+		"if ([]) { 1 } else { 2 };",
+		"let a = \"0123456789012345678901234567890\" + \"01234567890123456789012345678901234\"; len(a);",
+		"9223372036854775807 / -1;",
+		"1 + true;",
+	};
+
+	for (int i = 0; i < 9; i++) {
+		printf("Testing input: %s\n", programs[i]);
+		char* expected = inspectObject(testEval(programs[i]));
+		char* actual = inspectObject(testEvalOptimized(programs[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Optimized program differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+}
+
+TEST(TestEval, TestEval_22_ImmortalConstants) {
+	const char* input = "[1, \"two\", [3, true]]";
+
+	//Tree: every evaluation returns the object bound to the literal
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	bindConstants(program);
+
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* first = evalProgram(program, env);
+	struct Object* second = evalProgram(program, env);
+	if (first != second || first != program->statements[0].expr->constant || gc->size != 0) {
+		printf("Array literal was built again, GC size %llu\n", (unsigned long long)gc->size);
+		FAIL();
+	}
+
+	char* inspected = inspectObject(first);
+	if (strcmp(inspected, "[1, two\n, [3, true]]") != 0) {
+		printf("Wrong constant, got %s\n", inspected);
+		FAIL();
+	}
+	free(inspected);
+
+	//Collecting must leave constants alone
+	collectMonkeyGarbage(gc, env);
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeProgram(program);
+	freeParser(&parser);
+
+	//Compact: equal literals share one slot of the pool
+	lexer = createLexer("let a = 1; let b = 1; let c = \"s\"; let d = \"s\"; let e = [a]; [1, 2];");
+	parser = createParser(&lexer);
+	program = parseProgram(&parser);
+	struct CompactAst* ast = compactProgram(program);
+	freeProgram(program);
+	freeParser(&parser);
+	if (ast->constantsLen != 4) {
+		printf("Wrong number of constants, expected 4, got %u\n", ast->constantsLen);
+		FAIL();
+	}
+
+	bindCompactConstants(ast);
+	gc = createMonkeyGC();
+	env = newEnvironment(gc);
+	first = evalCompactProgram(ast, env);
+	second = evalCompactProgram(ast, env);
+	if (first != second || environmentGet(env, "a") != environmentGet(env, "b") || environmentGet(env, "c") != environmentGet(env, "d")) {
+		printf("Compact literals were built again\n");
+		FAIL();
+	}
+
+	//[a] is not constant, the array is built on every evaluation
+	struct Object* e = environmentGet(env, "e");
+	if (gc->size != 2 || arrayLength(e) != 1 || arrayGetInteger(e, 0) != 1) {
+		printf("Wrong GC size, expected 2, got %llu\n", (unsigned long long)gc->size);
+		FAIL();
+	}
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeCompactConstants(ast);
+	freeCompactAst(ast);
+
+	//Constants are never changed by the program that uses them
+	const char* tests[] = {
+		"let f = fn() { return 5; }; f(); f() + f();",
+		"let f = fn() { return true; }; f(); [f(), true];",
+		"let a = [1, 2]; let b = push(a, 3); [a, b, rest(a), first(a)];",
+		"let f = fn() { [1, [2]] }; let x = f(); let y = f(); x[1][0] + y[0];",
+		"let s = \"mon\"; let t = s + \"key\"; [s, t];",
+		"let sum = fn(x) { if (x == 0) { return 0; } x + sum(x - 1) }; sum(500); sum(600);",
+		"map([1, 2, 3], fn(x) { [x, \"x\"] });",
+	};
+
+	for (int i = 0; i < 7; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* tree = inspectObject(testEvalOptimized(tests[i]));
+		char* compact = inspectObject(testEvalCompact(tests[i]));
+		if (strcmp(tree, expected) != 0 || strcmp(compact, expected) != 0) {
+			printf("Constants change the result, expected: %s, got: %s and %s\n", expected, tree, compact);
+			FAIL();
+		}
+		free(expected);
+		free(tree);
+		free(compact);
+	}
+}
+
+TEST(TestEval, TestEval_23_CompactDispatch) {
+	//Every opcode, with and without its integer fast path
+	const char* tests[] = {
+		"[1 + 2, 5 - 7, 3 * -4, 7 / 2, -7 / 2, 1 < 2, 2 > 1, 1 == 1, 1 != 1]",
+		"[true == true, true != false, !true, !!5, !0, -(-5), 9223372036854775807 / -1]",
+		"\"mon\" + \"key\";",
+		"\"a\" - \"b\";",
+		"true + 1;",
+		"true < false;",
+		"-true;",
+		"if (1 > 2) { 1 }",
+		"if (1) { }",
+		"let f = fn() { }; f();",
+		"let f = fn(x) { if (x > 0) { return x; 5 } }; [f(1), f(0)];",
+		"let f = fn(x) { if (x > 0) { f(x - 1) } else { 42 } }; f(2000);",
+		"let f = fn(x) { let y = x * 2; if (y > 10) { y } else { let z = y + 1; z } }; [f(3), f(6)];",
+	};
+
+	for (int i = 0; i < 13; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* actual = inspectObject(testEvalCompact(tests[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Compact evaluator differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+}
+
+static struct CompactAst* compactInput(const char* input) {
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct CompactAst* ast = compactProgram(program);
+	freeProgram(program);
+	freeParser(&parser);
+	return ast;
+}
+
+static struct CompactNode* findCompactNode(const struct CompactAst* ast, uint8_t type) {
+	for (NodeRef i = 0; i < ast->nodesLen; i++) {
+		if (ast->nodes[i].type == type) {
+			return &ast->nodes[i];
+		}
+	}
+	return NULL;
+}
+
+static struct Object* evalCompactInput(struct CompactAst* ast) {
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	struct Object* obj = evalCompactProgram(ast, env);
+	deleteEnvironment(env);
+	return obj;
+}
+
+TEST(TestEval, TestEval_24_Quickening) {
+	struct TestQuicken {
+		char input[96];
+		uint8_t type;
+		uint16_t expected;
+		char result[16];
+	} tests[]{
+		{"let f = fn(a, b) { a + b }; f(1, 2);", CNODE_INFIX, CODE_ADD_INT, "3"},
+		{"let f = fn(a, b) { a + b }; f(\"a\", \"b\");", CNODE_INFIX, CODE_ADD_STRING, "ab\n"},
+		{"let f = fn(a, b) { a + b }; f(1, 2); f(\"a\", \"b\");", CNODE_INFIX, CODE_INFIX, "ab\n"},
+		{"let f = fn(a, b) { a == b }; f(true, true);", CNODE_INFIX, CODE_EQ_BOOL, "true"},
+		{"let f = fn(a, b) { a == b }; f(true, true); f(1, 1);", CNODE_INFIX, CODE_INFIX, "true"},
+		{"let f = fn(a, b) { a / b }; f(7, 2); f(7, 0 - 1);", CNODE_INFIX, CODE_DIVIDE_INT, "-7"},
+		{"let f = fn(a, b) { a < b }; f(1, 2); f(true, false);", CNODE_INFIX, CODE_INFIX, "ERROR: unknown"},
+		{"let f = fn(a) { -a }; f(1);", CNODE_PREFIX, CODE_MINUS_INT, "-1"},
+		{"let f = fn(a) { -a }; f(1); f(true);", CNODE_PREFIX, CODE_PREFIX, "ERROR: unknown"},
+		{"let f = fn(a, i) { a[i] }; f([1, 2], 1);", CNODE_INDEX, CODE_INDEX_ARRAY, "2"},
+		{"let f = fn(a, i) { a[i] }; f([1, 2], 1); f(1, 1);", CNODE_INDEX, CODE_INDEX_ANY, "ERROR: index"},
+		{"let f = fn(a) { a < 1 }; 5;", CNODE_INFIX, CODE_LT, "5"},
+	};
+
+	for (int i = 0; i < 12; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		struct CompactAst* ast = compactInput(tests[i].input);
+		char* result = inspectObject(evalCompactInput(ast));
+
+		const struct CompactNode* node = findCompactNode(ast, tests[i].type);
+		if (node->opcode != tests[i].expected) {
+			printf("Wrong opcode, expected %u, got %u\n", tests[i].expected, node->opcode);
+			FAIL();
+		}
+		if (strncmp(result, tests[i].result, strlen(tests[i].result)) != 0) {
+			printf("Wrong result, expected %s, got %s\n", tests[i].result, result);
+			FAIL();
+		}
+		free(result);
+	}
+
+	//Nodes of a cached AST are quickened in the process, the file keeps the decoded opcodes
+	const char input[] = "let f = fn(a, b) { a + b }; f(1, 2);";
+	const char path[] = "test_quickening.mast";
+	const uint64_t sourceHash = astCacheHash(input, sizeof(input) - 1);
+	struct CompactAst* ast = compactInput(input);
+	ASSERT_TRUE(writeAstCache(path, ast, sourceHash, sizeof(input) - 1));
+
+	struct AstCache cache;
+	ASSERT_TRUE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+	if (!testIntegerObject(evalCompactInput(&cache.ast), 3) || findCompactNode(&cache.ast, CNODE_INFIX)->opcode != CODE_ADD_INT) {
+		FAIL();
+	}
+	closeAstCache(&cache);
+
+	ASSERT_TRUE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+	ASSERT_EQ(findCompactNode(&cache.ast, CNODE_INFIX)->opcode, CODE_ADD);
+	closeAstCache(&cache);
+	remove(path);
+}
+
+TEST(TestEval, TestEval_25_ClosureCompiler) {
+	//Every node function, including the variants for an integer literal on the right
+	const char* tests[] = {
+		"let fibonacci = fn(x) { if (x < 2) { x } else { fibonacci(x - 1) + fibonacci(x - 2) } }; fibonacci(15);",
+		"[1 + 2, 5 - 7, 3 * -4, 7 / 2, -7 / 2, 1 < 2, 2 > 1, 1 == 1, 1 != 1]",
+		"let f = fn(a) { [a + 1, a - 1, a * 2, a / 2, a < 1, a > 1, a == 1, a != 1] }; f(3);",
+		"let f = fn(a) { [a + 1] }; f(true);",
+		"let f = fn(a) { a / 0 }; f(\"a\");",
+		"let f = fn(a, b) { a / b }; [f(9223372036854775807, 0 - 1), f(7, 2)];",
+		"[true == true, true != false, !true, !!5, !0, -(-5), -true]",
+		"\"mon\" + \"key\";",
+		"let a = \"s\"; a + a;",
+		"let newAdder = fn(x) { fn(y) { x + y }; }; let addTwo = newAdder(2); addTwo(3);",
+		"let f = fn(x) { if (x > 1) { if (x > 2) { return x * 10; } return 1; } 0; }; [f(3), f(2), f(0)];",
+		"let f = fn() { }; f();",
+		"if (1 > 2) { 1 }",
+		"let a = [1, fn(x) { x }, \"s\"]; a[1](a[0]);",
+		"let a = [1, 2, 3]; [a[0], a[2], a[3], a[0 - 1]];",
+		"let f = fn(a, i) { a[i] }; f(1, 1);",
+		"map([1, 2, 3], fn(x) { x * x });",
+		"let s = sort([3, 1, 2], fn(a, b) { b < a }); s[0] + len(s);",
+		"let many = fn(a, b, c, d, e, f, g, h, i, j) { [a, j] }; many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"len(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"let f = fn(a) { let b = a; let c = 5; b + c }; f(4);",
+		"let x = 1; let f = fn() { let x = 2; x }; [f(), x];",
+		"let g = fn(a) { a }; g();",
+		"let a = 5; let g = fn(a) { a }; g();",
+		"foobar;",
+		"1(2);",
+		"let a = foobar + 1; a;",
+		"return !5; 10;",
+		"fn(a, b) { let c = a + b; c; }",
+	};
+
+	for (int i = 0; i < 29; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* actual = inspectObject(testEvalCompiled(tests[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Closure compiler differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+
+	//More iterations than the GC threshold between two top level statements
+	if (!testIntegerObject(testEvalCompiled("let sum = fn(x) { if (x == 0) { return 0; } x + sum(x - 1) }; sum(500); sum(600);"), 180300)) {
+		FAIL();
+	}
+}
+
+TEST(TestEval, TestEval_26_RegisterVm) {
+	const char* tests[] = {
+		"let fibonacci = fn(x) { if (x < 2) { x } else { fibonacci(x - 1) + fibonacci(x - 2) } }; fibonacci(15);",
+		"[1 + 2, 5 - 7, 3 * -4, 7 / 2, -7 / 2, 1 < 2, 2 > 1, 1 == 1, 1 != 1]",
+		"let f = fn(a) { [a + 1, a - 1, a * 2, a / 2, a < 1, a > 1, a == 1, a != 1] }; f(3);",
+		"let f = fn(a, b) { [a + b, a - b, a * b, a / b, a < b, a > b, a == b, a != b] }; f(7, 2);",
+		"let f = fn(a) { [a + 1] }; f(true);",
+		"let f = fn(a, b) { a / b }; [f(9223372036854775807, 0 - 1), f(7, 2)];",
+		"[true == true, true != false, !true, !!5, !0, -(-5), -true]",
+		"\"mon\" + \"key\";",
+		"let newAdder = fn(x) { fn(y) { x + y }; }; let addTwo = newAdder(2); addTwo(3);",
+		"let counter = fn(x) { let inc = fn() { x + 1 }; let x = 10; inc() }; counter(1);",
+		"let f = fn(x) { if (x > 1) { if (x > 2) { return x * 10; } return 1; } 0; }; [f(3), f(2), f(0)];",
+		"let f = fn() { }; f();",
+		"if (1 > 2) { 1 }",
+		"if (1 < 2) { 1 }",
+		"let a = [1, fn(x) { x }, \"s\"]; a[1](a[0]);",
+		"let a = [1, 2, 3]; [a[0], a[2], a[3], a[0 - 1]];",
+		"let f = fn(a, i) { a[i] }; f(1, 1);",
+		"map([1, 2, 3], fn(x) { x * x });",
+		"reduce(range(10), 0, fn(acc, x) { acc + x });",
+		"let s = sort([3, 1, 2], fn(a, b) { b < a }); s[0] + len(s);",
+		"let many = fn(a, b, c, d, e, f, g, h, i, j) { [a, j] }; many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"len(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);",
+		"let x = 1; let f = fn() { let y = x; let x = 2; [y, x] }; [f(), x];",
+		"let x = 1; let f = fn(c) { if (c) { let x = 2; } x }; [f(true), f(false)];",
+		"let f = fn(a) { let a = a + 1; let b = if (a > 1) { let a = 10; a } else { a }; [a, b] }; f(1);",
+		"let f = fn(a) { a + if (true) { let a = 5; a } else { 0 } }; f(1);",
+		"let f = fn(a) { (if (true) { let a = 5; a } else { 0 }) + a }; f(1);",
+		"let f = fn(a, b) { let g = fn() { a + b }; let a = 100; g() }; f(1, 2);",
+		"let f = fn(n) { let fact = fn(k) { if (k < 2) { 1 } else { k * fact(k - 1) } }; fact(n) }; f(10);",
+		"let f = fn(a, a) { a }; f(1, 2);",
+		"let f = fn(a, b) { if (a > b) { a } else { b } }; f(1, 2);",
+		"let f = fn(x) { map([1, 2], fn(y) { x * y }) }; f(3);",
+		"let f = fn() { return foobar; }; f();",
+		"foobar;",
+		"1(2);",
+		"let a = foobar + 1; a;",
+		"return !5; 10;",
+		"if (true) { return 1; } 2;",
+		"let f = fn(x) { if (x > 0) { f(x - 1) } else { 42 } }; f(3000);",
+		"fn(a, b) { let c = a + b; c; }",
+		//Missing arguments leave their parameters unbound
+		"let g = fn(a) { a }; g();",
+		"let a = 5; let g = fn(a) { a }; g();",
+		"let f = fn(a, b) { let h = fn() { b }; h() }; f(1);",
+		"let b = 2; let f = fn(a, b) { fn() { a + b } }; f(1)();",
+		"let b = 2; let f = fn(a, b) { a + b }; let loop = fn(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + f(1)) } }; loop(1500, 0);",
+		//Rebinding a name after a cached lookup
+		"let x = 1; let f = fn() { x }; let a = f(); let x = 2; [a, f()];",
+		"let f = fn() { len }; let a = f(); let len = 3; [a(\"ab\"), f()];",
+	};
+
+	for (int i = 0; i < 47; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* actual = inspectObject(testEvalVm(tests[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Register vm differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+
+	struct Object* missing = testEvalVm("let g = fn(a) { a }; g();");
+	if (missing->type != OBJ_ERROR || strcmp(missing->value.error.msg, "identifier not found: a") != 0) {
+		printf("Reading a missing argument should fail, got: %s\n", inspectObject(missing));
+		FAIL();
+	}
+
+	//More iterations than the GC threshold between two top level statements
+	if (!testIntegerObject(testEvalVm("let sum = fn(x) { if (x == 0) { return 0; } x + sum(x - 1) }; sum(500); sum(600);"), 180300)) {
+		FAIL();
+	}
+}
+
+TEST(TestEval, TestEval_27_VmDisassembler) {
+	struct CompactAst* ast = compactInput("let f = fn(x, n) { let g = fn() { n }; if (x < 2) { x } else { f(x - 1, n) + g() } };");
+	bindCompactConstants(ast);
+	struct VmProgram* program = compileVmProgram(ast);
+	ASSERT_NE(program, nullptr);
+
+	//Locals are registers, the captured n lives in the environment of the call and arguments are passed in a window
+	const char* expected =
+		"statement 0, 1 registers\n"
+		"     0  FUNCTION    r0, function 0\n"
+		"     1  SET_NAME    f, r0\n"
+		"     2  RETURN      r0\n"
+		"function 0 fn(x, n), 8 registers, environment\n"
+		"     0  SET_NAME    n, r1\n"
+		"     1  FUNCTION    r2, function 1\n"
+		"     2  LTK         r4, r0, 2\n"
+		"     3  JUMP_FALSE  r4, -> 6\n"
+		"     4  MOVE        r3, r0\n"
+		"     5  JUMP        -> 13\n"
+		"     6  MOVE        r4, r2\n"
+		"     7  CALL        r4, r4()\n"
+		"     8  GET_NAME    r5, f\n"
+		"     9  SUBK        r6, r0, 1\n"
+		"    10  GET_NAME    r7, n\n"
+		"    11  CALL        r5, r5(r6, r7)\n"
+		"    12  ADD         r3, r5, r4\n"
+		"    13  RETURN      r3\n"
+		"function 1 fn(), 1 registers\n"
+		"     0  GET_NAME    r0, n\n"
+		"     1  RETURN      r0\n";
+	char* actual = disassembleVmProgram(program);
+	if (strcmp(actual, expected) != 0) {
+		printf("Disassembly differs, got:\n%s", actual);
+		FAIL();
+	}
+	free(actual);
+	freeVmProgram(program);
+	freeCompactConstants(ast);
+	freeCompactAst(ast);
+}
+
+TEST(TestEval, TestEval_28_VmJit) {
+	//loop(n) makes f hot first, the statement after it then runs f natively
+	const char* tests[] = {
+		"let fibonacci = fn(x) { if (x < 2) { x } else { fibonacci(x - 1) + fibonacci(x - 2) } }; fibonacci(20);",
+		"let f = fn(a, b) { [a + b, a - b, a * b, a / b, a < b, a > b, a == b, a != b, a + 3, a - 3, a * 3, a / 3, a < 3, a > 3, a == 3, a != 3] }; let loop = fn(n) { if (n > 0) { f(n, 7); loop(n - 1) } }; loop(1500); f(17, 4);",
+		//Guards fail on other types and on division by -1
+		"let f = fn(a, b) { a + b }; let loop = fn(n) { if (n > 0) { f(n, n); loop(n - 1) } }; loop(1500); [f(\"mon\", \"key\"), f(true, 1), f(2, 3)];",
+		"let f = fn(a, b) { a / b }; let loop = fn(n) { if (n > 0) { f(n, n); loop(n - 1) } }; loop(1500); [f(7, 0 - 1), f(7, 2)];",
+		"let f = fn(a) { if (a) { 1 } else { 2 } }; let loop = fn(n) { if (n > 0) { f(n); loop(n - 1) } }; loop(1500); [f(0), f(\"\"), f([]), f(false), f(true)];",
+		//Everything without a template goes through the VM
+		"let make = fn(n) { let g = fn(x) { x + n }; g }; let loop = fn(n, acc) { if (n > 0) { loop(n - 1, make(n)(acc)) } else { acc } }; loop(1500, 0);",
+		"let f = fn(a, i) { let b = [a, -a, !a, len(a)]; b[i] }; let loop = fn(n) { if (n > 0) { f([n], 0); loop(n - 1) } }; loop(1500); [f([1], 0), f([1], 1), f([1], 2), f([1], 3), f([1], 4)];",
+		"let f = fn(x) { x * 2 }; reduce(map(range(2000), f), 0, fn(acc, x) { acc + x });",
+		"let f = fn(x) { if (x > 1) { return x; } foobar }; let loop = fn(n) { if (n > 0) { f(n + 2); loop(n - 1) } }; loop(1500); f(0);",
+		"let x = 1; let f = fn(c) { if (c) { let x = 2; } x }; let loop = fn(n) { if (n > 0) { f(true); loop(n - 1) } }; loop(1500); [f(true), f(false)];",
+	};
+
+	for (int i = 0; i < 10; i++) {
+		printf("Testing input: %s\n", tests[i]);
+		char* expected = inspectObject(testEval(tests[i]));
+		char* actual = inspectObject(testEvalVm(tests[i]));
+		if (strcmp(actual, expected) != 0) {
+			printf("Native code differs, expected: %s, got: %s\n", expected, actual);
+			FAIL();
+		}
+		free(expected);
+		free(actual);
+	}
+
+	//Overflow wraps around like in the interpreter, the tree evaluator can not be asked here
+	struct {
+		const char* input;
+		const char* expected;
+	} overflows[] = {
+		{"let f = fn(a, b) { a + b }; let loop = fn(n) { if (n > 0) { f(n, n); loop(n - 1) } }; loop(1500); [f(9223372036854775807, 1), f(2, 3)];", "[-9223372036854775808, 5]"},
+		{"let f = fn(a) { a * 2 }; let loop = fn(n) { if (n > 0) { f(n); loop(n - 1) } }; loop(1500); [f(4611686018427387904), f(3)];", "[-9223372036854775808, 6]"},
+		{"let f = fn(a, b) { a - b }; let loop = fn(n) { if (n > 0) { f(n, n); loop(n - 1) } }; loop(1500); [f(0 - 9223372036854775807, 2), f(1, 2)];", "[9223372036854775807, -1]"},
+	};
+	for (int i = 0; i < 3; i++) {
+		printf("Testing input: %s\n", overflows[i].input);
+		char* actual = inspectObject(testEvalVm(overflows[i].input));
+		if (strcmp(actual, overflows[i].expected) != 0) {
+			printf("Native code differs, expected: %s, got: %s\n", overflows[i].expected, actual);
+			FAIL();
+		}
+		free(actual);
+	}
+
+	//Native calls stop nesting on the C stack past VM_JIT_MAX_DEPTH
+	if (!testIntegerObject(testEvalVm("let f = fn(x) { if (x > 0) { f(x - 1) } else { 42 } }; f(100000);"), 42)) {
+		FAIL();
+	}
+
+#ifdef VM_JIT
+	struct CompactAst* ast = compactInput("let f = fn(x) { if (x < 2) { x } else { f(x - 1) + f(x - 2) } }; f(20);");
+	bindCompactConstants(ast);
+	struct VmProgram* program = compileVmProgram(ast);
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	if (!testIntegerObject(evalVmProgram(program, env), 6765)) {
+		FAIL();
+	}
+	ASSERT_NE(program->functions[0]->jit->code, nullptr);
+	ASSERT_EQ(program->functions[0]->jit->deopts, 0u);
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeVmProgram(program);
+	freeCompactConstants(ast);
+	freeCompactAst(ast);
+#endif
+}
+
+TEST(TestEval, TestEval_29_Transpiler) {
+	Lexer lexer = createLexer("let fib = fn(x) { if (x < 2) { x } else { fib(x - 1) + fib(x - 2) } }; let make = fn(n) { fn(y) { n + y } }; print(fib(10), make(1)(2));");
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	ASSERT_EQ(parser.errorsLen, 0u);
+	optimizeProgram(program);
+	char* c = transpileProgram(program);
+
+	const char* fragments[] = {
+		//Parameters that no nested function reads are C locals
+		"static struct Object* fn0(struct ObjectEnvironment* closure, struct MonkeyGC* gc, struct Object* p0) {\n\tstruct Object* m_x = NULL;\n\tstruct ObjectEnvironment* env = closure;\n",
+		//fib is bound once at the top level, its calls skip applyFunction
+		"t9 = fn0(t5->value.function.env, gc, t8);",
+		"known0 = t0;",
+		//n is read by the nested function and lives in the environment of the call
+		"struct ObjectEnvironment* env = newEnclosedEnvironment(closure);\n\tif (p0) {\n\t\tenvironmentSetHashed(env, \"n\", UINT32_C(110), p0);",
+		"monkeyClosure(gc, env, &fn2Native);",
+		//Function objects print their literal
+		"static const struct NativeFunction fn2Native = { fn2Entry,\n\t\"fn(y) {\\n\"\n\t\"(n + y)\\n\"\n\t\"}\",\n\t1 };",
+		//Calls of anything else go through applyFunction
+		"t9 = monkeyCall(t0, a9, 2, gc);",
+		"return monkeyRun(statements, sizeof statements / sizeof *statements);",
+	};
+	for (int i = 0; i < 8; i++) {
+		if (!strstr(c, fragments[i])) {
+			printf("Missing from the C program: %s\n%s\n", fragments[i], c);
+			FAIL();
+		}
+	}
+	free(c);
+	freeProgram(program);
+	freeParser(&parser);
+}
+
+TEST(TestEval, TestEval_30_CallCache) {
+	struct {
+		const char* input;
+		const char* expected;
+	} tests[] = {
+		//Rebinding the callee invalidates the cache of every call through its name
+		{"let f = fn() { 1 }; let g = fn() { f() }; let a = g(); let f = fn() { 2 }; [a, g()];", "[1, 2]"},
+		//Same call, closures over different environments
+		{"let make = fn(h) { fn() { h() } }; let a = make(fn() { 1 }); let b = make(fn() { 2 }); [a(), b(), a()];", "[1, 2, 1]"},
+		//The recursive call fills the cache while the outer call already bound the name itself
+		{"let f = fn() { 1 }; let g = fn(c) { if (c) { let f = fn() { 2 }; g(false); } f() }; g(true);", "2"},
+		{"let f = fn(a) { len(a) }; [f([1]), f([1, 2]), f(\"abc\")];", "[1, 2, 3]"},
+	};
+	for (int i = 0; i < 4; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		char* actual = inspectObject(testEval(tests[i].input));
+		if (strcmp(actual, tests[i].expected) != 0) {
+			printf("Expected: %s, got: %s\n", tests[i].expected, actual);
+			FAIL();
+		}
+		free(actual);
+	}
+
+	Lexer lexer = createLexer("let fib = fn(x) { if (x < 2) { x } else { fib(x - 1) + fib(x - 2) } }; fib(15);");
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	if (!testIntegerObject(evalProgram(program, env), 610)) {
+		FAIL();
+	}
+	//Both recursive calls hold fib and skip the type dispatch of applyFunction
+	const struct Expression* sum = program->statements[0].expr->function.body->statements[0].expr->ifelse.alternative->statements[0].expr;
+	ASSERT_EQ(sum->infix.left->call.cache.callee, environmentGet(env, "fib"));
+	ASSERT_EQ(sum->infix.right->call.cache.callee, environmentGet(env, "fib"));
+	ASSERT_EQ(sum->infix.left->call.cache.apply, applyAstFunction);
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeParser(&parser);
+}
+
+TEST(TestEval, TestEval_31_BuiltinResolution) {
+	struct {
+		const char* input;
+		const char* expected;
+	} tests[] = {
+		//A parameter named like a builtin only hides it inside its function
+		{"let f = fn(first) { first + 1 }; [f(1), first([5])];", "[2, 5]"},
+		//Bound after the reference was resolved to the builtin
+		{"let a = fn() { sum([1, 2]) }; let b = a(); let sum = fn(x) { 7 }; [b, a()];", "[3, 7]"},
+		{"let g = fn() { let last = fn(x) { 0 }; last([1]) }; [g(), last([1, 2])];", "[0, 2]"},
+	};
+	for (int i = 0; i < 3; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		char* actual = inspectObject(testEval(tests[i].input));
+		char* vmActual = inspectObject(testEvalVm(tests[i].input));
+		if (strcmp(actual, tests[i].expected) != 0 || strcmp(vmActual, tests[i].expected) != 0) {
+			printf("Expected: %s, got: %s (register vm: %s)\n", tests[i].expected, actual, vmActual);
+			FAIL();
+		}
+		free(actual);
+		free(vmActual);
+	}
+
+	Lexer lexer = createLexer("len([1]); count;");
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	ASSERT_EQ(program->statements[0].expr->call.function->ident.builtin, getBuiltin("len"));
+	ASSERT_EQ(program->statements[1].expr->ident.builtin, nullptr);
+	freeProgram(program);
+	freeParser(&parser);
+}
+
+TEST(TestEval, TestEval_32_FlatClosures) {
+	struct {
+		const char* input;
+		const char* expected;
+	} tests[] = {
+		{"let newAdder = fn(x) { fn(y) { x + y } }; let addTwo = newAdder(2); [addTwo(3), newAdder(5)(1)];", "[5, 6]"},
+		{"let a = fn(x) { let y = x * 2; fn(z) { fn() { x + y + z } } }; a(1)(2)();", "5"},
+		//Bound after the closure is created, it has to see the environment of the call
+		{"let counter = fn(x) { let inc = fn() { x + 1 }; let x = 10; inc() }; counter(1);", "11"},
+		{"let f = fn(n) { let fact = fn(k) { if (k < 2) { 1 } else { k * fact(k - 1) } }; fact(n) }; f(10);", "3628800"},
+		{"let x = 1; let f = fn(c) { if (c) { let x = 2; } fn() { x } }; [f(true)(), f(false)()];", "[2, 1]"},
+		{"let f = fn(x) { let g = fn() { x }; let x = x + 1; g }; f(1)();", "2"},
+		{"let f = fn(x) { if (x > 0) { f(x - 1) } else { 42 } }; f(3000);", "42"},
+		//Read before the function binds the name itself, that is still the x of f
+		{"let f = fn(x) { let g = fn() { let y = x; let x = 5; y + x }; g() }; f(1);", "6"},
+		//b binds x only after h read it and maybe not at all, b still has to reach the x of the function around it
+		{"let a = fn(x) { let b = fn() { let h = fn() { x }; let y = h(); let x = 3; y }; b() }; a(1);", "1"},
+		{"let c = fn(x) { let b = fn(z) { if (z) { let x = 3; } fn() { x } }; [b(true)(), b(false)()] }; c(1)", "[3, 1]"},
+	};
+	for (int i = 0; i < 10; i++) {
+		printf("Testing input: %s\n", tests[i].input);
+		char* actual = inspectObject(testEval(tests[i].input));
+		if (strcmp(actual, tests[i].expected) != 0) {
+			printf("Expected: %s, got: %s\n", tests[i].expected, actual);
+			FAIL();
+		}
+		free(actual);
+	}
+
+	Lexer lexer = createLexer("let make = fn(x) { let big = [1, 2, 3]; let y = x * 2; fn(z) { fn() { x + y + z } } }; let g = make(1)(2); let h = fn(x) { let inc = fn() { x }; let x = 2; inc };");
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+	evalProgram(program, env);
+
+	const struct FunctionLiteral* make = &program->statements[0].expr->function;
+	const struct FunctionLiteral* middle = &make->body->statements[2].expr->function;
+	const struct FunctionLiteral* inner = &middle->body->statements[0].expr->function;
+	ASSERT_EQ(make->capturesLen, 0);
+	ASSERT_TRUE(make->freesFrame);
+	ASSERT_EQ(middle->capturesLen, 2);
+	ASSERT_TRUE(middle->flat);
+	ASSERT_EQ(inner->capturesLen, 3);
+	ASSERT_TRUE(inner->flat);
+	//g holds x, y and z only, neither big nor the frames of the calls
+	struct Object* g = environmentGet(env, "g");
+	ASSERT_EQ(g->value.function.env->store->size, 3);
+	ASSERT_EQ(g->value.function.env->outer, env);
+
+	const struct FunctionLiteral* h = &program->statements[2].expr->function;
+	const struct FunctionLiteral* inc = &h->body->statements[0].expr->function;
+	ASSERT_FALSE(inc->flat);
+	ASSERT_FALSE(h->freesFrame);
+
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeParser(&parser);
+}
+
+static size_t countFrames(const struct MonkeyGC* gc) {
+	size_t count = 0;
+	for (const struct ObjectEnvironment* frame = gc->frames; frame; frame = frame->outer) {
+		count++;
+	}
+	return count;
+}
+
+TEST(TestEval, TestEval_33_FrameStack) {
+	struct MonkeyGC* gc = createMonkeyGC();
+	struct ObjectEnvironment* env = newEnvironment(gc);
+
+	Lexer lexer = createLexer("let f = fn(x) { if (x > 0) { f(x - 1) } else { 0 } }; f(200);");
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	if (!testIntegerObject(evalProgram(program, env), 0)) {
+		FAIL();
+	}
+	//Every frame of the deepest recursion went back onto the stack
+	ASSERT_EQ(countFrames(gc), 201);
+
+	//And a second recursion as deep takes all its frames from there
+	Lexer again = createLexer("[f(200), f(150)];");
+	Parser againParser = createParser(&again);
+	Program* againProgram = parseProgram(&againParser);
+	evalProgram(againProgram, env);
+	ASSERT_EQ(countFrames(gc), 201);
+
+	//A frame a closure holds on to is never released
+	Lexer kept = createLexer("let g = fn(x) { let h = fn() { x }; let x = x + 1; h }; g(1)();");
+	Parser keptParser = createParser(&kept);
+	Program* keptProgram = parseProgram(&keptParser);
+	if (!testIntegerObject(evalProgram(keptProgram, env), 2)) {
+		FAIL();
+	}
+	ASSERT_EQ(countFrames(gc), 200);
+
+	//Environments of flat closures go back when the GC collects the closures
+	Lexer flat = createLexer("let make = fn(x) { fn() { x } }; make(1); make(2)();");
+	Parser flatParser = createParser(&flat);
+	Program* flatProgram = parseProgram(&flatParser);
+	if (!testIntegerObject(evalProgram(flatProgram, env), 2)) {
+		FAIL();
+	}
+	const size_t frames = countFrames(gc);
+	//The first collection keeps the results evalProgram marked
+	collectMonkeyGarbage(gc, env);
+	collectMonkeyGarbage(gc, env);
+	ASSERT_EQ(countFrames(gc), frames + 2);
+
+	deleteEnvironment(env);
+	deleteMonkeyGC(gc);
+	freeParser(&parser);
+	freeParser(&againParser);
+	freeParser(&keptParser);
+	freeParser(&flatParser);
+}
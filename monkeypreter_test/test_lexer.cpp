@@ -5,6 +5,10 @@ extern "C" {
 	#include "lexer/lexer.c"
 	#include "lexer/token.h"
 	#include "lexer/token.c"
+	#include "lexer/token_buffer.h"
+	#include "lexer/token_buffer.c"
+	#include "util/mapped_file.h"
+	#include "util/mapped_file.c"
 }
 
 TEST(TestLexer, TestNextToken_01) {
@@ -228,3 +232,146 @@ TEST(TestLexer, TestNextToken_03) {
 		ASSERT_STREQ(token.literal, expectedTokens[i].literal);
 	}
 }
+
+TEST(TestLexer, TestNextToken_04) {
+	//Near misses of every keyword, identifiers longer than the literal are split
+	const char* input = "lets le fnx f truee tru fals falsee iff i els elsee retur returns\r\n\t"
+		"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaabbb 007";
+	Lexer lexer = createLexer(input);
+
+	constexpr Token expectedTokens[]{
+		{TokenTypeIdent, "lets"},
+		{TokenTypeIdent, "le"},
+		{TokenTypeIdent, "fnx"},
+		{TokenTypeIdent, "f"},
+		{TokenTypeIdent, "truee"},
+		{TokenTypeIdent, "tru"},
+		{TokenTypeIdent, "fals"},
+		{TokenTypeIdent, "falsee"},
+		{TokenTypeIdent, "iff"},
+		{TokenTypeIdent, "i"},
+		{TokenTypeIdent, "els"},
+		{TokenTypeIdent, "elsee"},
+		{TokenTypeIdent, "retur"},
+		{TokenTypeIdent, "returns"},
+		{TokenTypeIdent, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"},
+		{TokenTypeIdent, "bbb"},
+		{TokenTypeInt, "007"},
+		{TokenTypeEof, ""},
+	};
+
+	constexpr int expectedLength = sizeof(expectedTokens) / sizeof(expectedTokens[0]);
+
+	for (int i = 0; i < expectedLength; i++) {
+		Token token = nextToken(&lexer);
+		ASSERT_EQ(token.type, expectedTokens[i].type);
+		ASSERT_STREQ(token.literal, expectedTokens[i].literal);
+	}
+}
+
+TEST(TestLexer, TestNextToken_05) {
+	//Runs long enough for the vector scanners, strings longer than a literal are truncated
+	const char* input = "let                                  \t\t\t\t\n\n\r\n     x = \"0123456789012345678901234567890123456789\";"
+		"\"abcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabcdefghij\" "
+		"some_quite_long_identifier_with_underscores 123456789012345678901234567890 \"unterminated string that ends the input";
+	Lexer lexer = createLexer(input);
+
+	constexpr Token expectedTokens[]{
+		{TokenTypeLet, "let"},
+		{TokenTypeIdent, "x"},
+		{TokenTypeAssign, "="},
+		{TokenTypeString, "0123456789012345678901234567890123456789"},
+		{TokenTypeSemicolon, ";"},
+		{TokenTypeString, "abcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabc"},
+		{TokenTypeIdent, "some_quite_long_identifier_with_underscores"},
+		{TokenTypeInt, "123456789012345678901234567890"},
+		{TokenTypeString, "unterminated string that ends the input"},
+		{TokenTypeEof, ""},
+	};
+
+	constexpr int expectedLength = sizeof(expectedTokens) / sizeof(expectedTokens[0]);
+
+	for (int i = 0; i < expectedLength; i++) {
+		Token token = nextToken(&lexer);
+		ASSERT_EQ(token.type, expectedTokens[i].type);
+		ASSERT_STREQ(token.literal, expectedTokens[i].literal);
+	}
+}
+
+TEST(TestLexer, TestTokenBuffer_01) {
+	const char* input = "let five = \"five\";\n  five != 10";
+	Lexer lexer = createLexer(input);
+	TokenBuffer tokens = createTokenBuffer(&lexer);
+
+	constexpr Token expectedTokens[]{
+		{TokenTypeLet, "let"},
+		{TokenTypeIdent, "five"},
+		{TokenTypeAssign, "="},
+		{TokenTypeString, "five"},
+		{TokenTypeSemicolon, ";"},
+		{TokenTypeIdent, "five"},
+		{TokenTypeNotEqual, "!="},
+		{TokenTypeInt, "10"},
+		{TokenTypeEof, ""},
+	};
+	constexpr size_t expectedStarts[]{ 0, 4, 9, 12, 17, 21, 26, 29, 31 };
+
+	constexpr int expectedLength = sizeof(expectedTokens) / sizeof(expectedTokens[0]);
+	ASSERT_EQ(tokens.size, expectedLength);
+
+	for (int i = 0; i < expectedLength; i++) {
+		Token token = getBufferedToken(&tokens, i);
+		ASSERT_EQ(token.type, expectedTokens[i].type);
+		ASSERT_STREQ(token.literal, expectedTokens[i].literal);
+		ASSERT_EQ(tokens.starts[i], expectedStarts[i]);
+	}
+
+	//Reading past the end keeps returning EOF
+	ASSERT_EQ(getBufferedToken(&tokens, 100).type, TokenTypeEof);
+	freeTokenBuffer(&tokens);
+}
+
+TEST(TestLexer, TestNextToken_06) {
+	//Mapped files are not NUL terminated, the lexer has to stop at inputLength
+	const char input[] = { 'l', 'e', 't', ' ', 'x', '=', '"', 'a', 'b', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0' };
+	Lexer lexer = createLexerWithLength(input, 8);
+
+	constexpr Token expectedTokens[]{
+		{TokenTypeLet, "let"},
+		{TokenTypeIdent, "x"},
+		{TokenTypeAssign, "="},
+		{TokenTypeString, "a"},
+		{TokenTypeEof, ""},
+	};
+
+	for (const Token& expected : expectedTokens) {
+		Token token = nextToken(&lexer);
+		ASSERT_EQ(token.type, expected.type);
+		ASSERT_STREQ(token.literal, expected.literal);
+	}
+}
+
+TEST(TestLexer, TestMappedFile_01) {
+	const char* path = "monkey_mapped_file_test.monkey";
+	const char source[] = "let answer = 42;";
+
+	FILE* file = fopen(path, "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(source, 1, sizeof(source) - 1, file);
+	fclose(file);
+
+	struct MappedFile mapped;
+	ASSERT_TRUE(mapFile(path, &mapped));
+	ASSERT_EQ(mapped.size, sizeof(source) - 1);
+
+	Lexer lexer = createLexerWithLength(mapped.data, mapped.size);
+	TokenBuffer tokens = createTokenBuffer(&lexer);
+	ASSERT_EQ(tokens.size, 6);
+	ASSERT_STREQ(getBufferedToken(&tokens, 3).literal, "42");
+
+	freeTokenBuffer(&tokens);
+	unmapFile(&mapped);
+	remove(path);
+
+	ASSERT_FALSE(mapFile(path, &mapped));
+}
@@ -5,6 +5,14 @@ extern "C" {
 	//#include "parser/parser.c"
 	#include "parser/ast.h"
 	//#include "parser/ast.c"
+	#include "parser/parallel_parser.h"
+	#include "parser/parallel_parser.c"
+	#include "parser/compact_ast.h"
+	#include "parser/compact_ast.c"
+	#include "parser/ast_cache.h"
+	#include "parser/ast_cache.c"
+	#include "util/thread.h"
+	#include "util/thread.c"
 }
 
 bool testIntegerLiteral(Expression* expr, int64_t integerVal) {
@@ -1117,4 +1125,272 @@ TEST(TestParser, TestParser_17_IndexExpressions) {
 		FAIL();
 	}
 
-}
\ No newline at end of file
+}
+TEST(TestParser, TestParser_18_TokenBuffer) {
+
+	char input[] = "let add = fn(x, y) { x + y; }; let s = \"str\"; if (add(1, 2) > a[0]) { return -1; } else { !true };";
+
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	checkParserErrors(&parser);
+	char* expected = programToStr(program);
+
+	Lexer bufferedLexer = createLexer(input);
+	TokenBuffer tokens = createTokenBuffer(&bufferedLexer);
+
+	//Parsing the same buffer twice must not need the lexer again
+	for (int i = 0; i < 2; i++) {
+		Parser bufferedParser = createParserFromTokens(&tokens);
+
+		if (parserTokenAhead(&bufferedParser, 0) != TokenTypeLet || parserTokenAhead(&bufferedParser, 3) != TokenTypeFunction) {
+			printf("Wrong lookahead from token buffer\n");
+			FAIL();
+		}
+
+		Program* bufferedProgram = parseProgram(&bufferedParser);
+		checkParserErrors(&bufferedParser);
+		char* actual = programToStr(bufferedProgram);
+
+		if (strcmp(actual, expected) != 0) {
+			printf("Expected %s, got %s", expected, actual);
+			FAIL();
+		}
+
+		free(actual);
+		freeProgram(bufferedProgram);
+		freeParser(&bufferedParser);
+	}
+
+	freeTokenBuffer(&tokens);
+	free(expected);
+	freeProgram(program);
+	freeParser(&parser);
+}
+
+TEST(TestParser, TestParser_19_SplitTopLevelStatements) {
+
+	//Only the `;` after `}`, `"` and `]` are at the top level
+	const char input[] = "let f = fn() { 1; 2; }; let s = \";\"; let a = [1, (2; 3)]; a;";
+	size_t chunkEnds[16];
+
+	size_t chunks = splitTopLevelStatements(input, sizeof(input) - 1, 16, chunkEnds);
+	const size_t expectedEnds[] = { 23, 36, 57, 60 };
+
+	ASSERT_EQ(chunks, 4);
+	for (size_t i = 0; i < chunks; i++) {
+		ASSERT_EQ(chunkEnds[i], expectedEnds[i]);
+	}
+
+	ASSERT_EQ(splitTopLevelStatements(input, sizeof(input) - 1, 1, chunkEnds), 1);
+	ASSERT_EQ(chunkEnds[0], sizeof(input) - 1);
+}
+
+TEST(TestParser, TestParser_20_ParallelParse) {
+
+	//Big enough for several chunks, errors at the start and the end
+	const char statement[] = "let value = fn(x, y) { if (x > y) { [x, \"y;\"] } else { y * 2 } }; ";
+	const size_t repeat = 4 * PARALLEL_PARSE_MIN_CHUNK / (sizeof(statement) - 1);
+	const char head[] = "let a \"s\"; ";
+	const char tail[] = "let x 5;";
+
+	std::string input = head;
+	for (size_t i = 0; i < repeat; i++) {
+		input += statement;
+	}
+	input += tail;
+
+	Lexer lexer = createLexerWithLength(input.c_str(), input.size());
+	Parser parser = createParser(&lexer);
+	Program* expected = parseProgram(&parser);
+
+	struct ParallelParse parse = parseProgramParallel(input.c_str(), input.size(), 4);
+
+	ASSERT_EQ(parse.program->size, expected->size);
+	ASSERT_EQ(parse.errorsLen, parser.errorsLen);
+	for (size_t i = 0; i < parse.errorsLen; i++) {
+		ASSERT_STREQ(parse.errors[i], parser.errors[i]);
+	}
+
+	for (size_t i = 0; i < expected->size; i++) {
+		ASSERT_EQ(parse.program->statements[i].type, expected->statements[i].type);
+		ASSERT_STREQ(parse.program->statements[i].token.literal, expected->statements[i].token.literal);
+	}
+
+	freeParallelParseErrors(&parse);
+	freeProgram(parse.program);
+	freeProgram(expected);
+	freeParser(&parser);
+}
+
+TEST(TestParser, TestParser_21_CompactAst) {
+
+	char input[] = "let add = fn(x, y) { x + y; }; let s = \"str\"; if (add(1, 2) > a[0]) { return -1; } else { !true }; add(x, [x, 9223372036854775807]);";
+
+	ASSERT_EQ(sizeof(struct CompactNode), 16);
+
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	checkParserErrors(&parser);
+	char* expected = programToStr(program);
+
+	struct CompactAst* ast = compactProgram(program);
+	struct Writer writer = createStringWriter(64);
+	writeCompactNode(&writer, ast, ast->root);
+	char* actual = takeWriterString(&writer);
+
+	if (strcmp(actual, expected) != 0) {
+		printf("Expected %s, got %s", expected, actual);
+		FAIL();
+	}
+
+	//Top level block with one entry per statement
+	const struct CompactNode* root = &ast->nodes[ast->root];
+	size_t count = 0;
+	const uint32_t* statements = compactList(ast, root->a, &count);
+	ASSERT_EQ(root->type, CNODE_BLOCK);
+	ASSERT_EQ(count, program->size);
+	ASSERT_EQ(ast->nodes[statements[0]].type, CNODE_LET);
+	ASSERT_EQ(ast->nodes[statements[2]].type, CNODE_IF);
+
+	//Every `x` shares the text of the parameter
+	const struct CompactNode* call = &ast->nodes[statements[3]];
+	const uint32_t* arguments = compactList(ast, call->b, &count);
+	ASSERT_EQ(call->type, CNODE_CALL);
+	ASSERT_EQ(count, 2);
+	const uint32_t* parameters = compactList(ast, ast->nodes[ast->nodes[statements[0]].b].a, &count);
+	ASSERT_EQ(ast->nodes[arguments[0]].a, parameters[0]);
+	ASSERT_STREQ(compactText(ast, parameters[0]), "x");
+
+	const uint32_t* elements = compactList(ast, ast->nodes[arguments[1]].a, &count);
+	ASSERT_EQ(compactInteger(&ast->nodes[elements[1]]), INT64_MAX);
+
+	ASSERT_LT(compactAstBytes(ast), ast->treeBytes);
+
+	free(actual);
+	free(expected);
+	freeCompactAst(ast);
+	freeProgram(program);
+	freeParser(&parser);
+}
+
+static void patchFile(const char* path, long offset, const void* bytes, size_t len) {
+	FILE* file = fopen(path, "r+b");
+	fseek(file, offset, SEEK_SET);
+	fwrite(bytes, 1, len, file);
+	fclose(file);
+}
+
+TEST(TestParser, TestParser_22_AstCache) {
+
+	const char* path = "monkey_ast_cache_test.mast";
+	char input[] = "let add = fn(x, y) { x + y; }; let s = \"str\"; if (add(1, 2) > a[0]) { return -1; } else { !true };";
+	const uint64_t sourceHash = astCacheHash(input, sizeof(input) - 1);
+
+	ASSERT_NE(sourceHash, astCacheHash(input, sizeof(input) - 2));
+
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	checkParserErrors(&parser);
+	char* expected = programToStr(program);
+	struct CompactAst* ast = compactProgram(program);
+
+	struct AstCache cache;
+	remove(path);
+	ASSERT_FALSE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+	ASSERT_TRUE(writeAstCache(path, ast, sourceHash, sizeof(input) - 1));
+
+	//Loaded pools point into the mapping
+	ASSERT_TRUE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+	ASSERT_EQ((const char*)cache.ast.nodes, cache.file.data + sizeof(struct AstCacheHeader));
+	ASSERT_EQ(cache.ast.nodesLen, ast->nodesLen);
+	ASSERT_EQ(cache.ast.treeBytes, ast->treeBytes);
+
+	struct Writer writer = createStringWriter(64);
+	writeCompactNode(&writer, &cache.ast, cache.ast.root);
+	char* actual = takeWriterString(&writer);
+	if (strcmp(actual, expected) != 0) {
+		printf("Expected %s, got %s", expected, actual);
+		FAIL();
+	}
+	free(actual);
+	closeAstCache(&cache);
+
+	//Other source
+	ASSERT_FALSE(openAstCache(path, sourceHash + 1, sizeof(input) - 1, &cache));
+	ASSERT_FALSE(openAstCache(path, sourceHash, sizeof(input), &cache));
+
+	//Other version
+	const uint32_t version = AST_CACHE_VERSION + 1;
+	patchFile(path, offsetof(struct AstCacheHeader, version), &version, sizeof version);
+	ASSERT_FALSE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+
+	//Flipped payload byte
+	ASSERT_TRUE(writeAstCache(path, ast, sourceHash, sizeof(input) - 1));
+	const char flipped = 0x7f;
+	patchFile(path, sizeof(struct AstCacheHeader) + 5, &flipped, 1);
+	ASSERT_FALSE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+
+	//Truncated file
+	ASSERT_TRUE(writeAstCache(path, ast, sourceHash, sizeof(input) - 1));
+	FILE* file = fopen(path, "rb");
+	char buffer[4096];
+	size_t size = fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+	file = fopen(path, "wb");
+	fwrite(buffer, 1, size - 1, file);
+	fclose(file);
+	ASSERT_FALSE(openAstCache(path, sourceHash, sizeof(input) - 1, &cache));
+
+	remove(path);
+	free(expected);
+	freeCompactAst(ast);
+	freeProgram(program);
+	freeParser(&parser);
+}
+
+TEST(TestParser, TestParser_23_LargeProgramToStr) {
+	//Larger than the old fixed 1 MB buffer
+	const char statement[] = "let value = [1, (2 * x), fn(a){\na\n}];";
+	const size_t statementLen = sizeof(statement) - 1;
+	const size_t count = 50000;
+
+	char* input = (char*)malloc(statementLen * count + 1);
+	for (size_t i = 0; i < count; i++) {
+		memcpy(input + i * statementLen, statement, statementLen);
+	}
+	input[statementLen * count] = '\0';
+
+	Lexer lexer = createLexer(input);
+	Parser parser = createParser(&lexer);
+	Program* program = parseProgram(&parser);
+	checkParserErrors(&parser);
+
+	//Printing the parsed program gives back the input
+	char* actual = programToStr(program);
+	if (strcmp(actual, input) != 0) {
+		printf("Wrong program string of %llu bytes\n", (unsigned long long)strlen(actual));
+		FAIL();
+	}
+
+	//Streamed output matches the string
+	FILE* stream = tmpfile();
+	printProgram(stream, program);
+	long written = ftell(stream);
+	rewind(stream);
+	char* streamed = (char*)calloc(written + 1, 1);
+	fread(streamed, 1, written, stream);
+	fclose(stream);
+	if (strcmp(streamed, actual) != 0) {
+		printf("Streamed program does not match programToStr\n");
+		FAIL();
+	}
+
+	free(streamed);
+	free(actual);
+	free(input);
+	freeProgram(program);
+	freeParser(&parser);
+}